@@ -7,6 +7,7 @@
 #define PRECALC64 1
 
 #include "miner.h"
+#include "scan.h"
 
 extern "C" {
 #include "sph/sph_blake.h"
@@ -37,6 +38,40 @@ void blake256hash(void *output, const void *input, int8_t rounds = 14)
 	memcpy(output, hash, 32);
 }
 
+/* the reference hashes of blakecoin/vanilla and blake */
+void blake256hash_8(void *output, const void *input)
+{
+	blake256hash(output, input, 8);
+}
+
+void blake256hash_14(void *output, const void *input)
+{
+	blake256hash(output, input, 14);
+}
+
+/* scanners of the cpu backend (Algo256/cpu_blake256.cpp), the GPU loop is below */
+static const struct scan_algo blake256_8_scan = {
+	"blakecoin",
+	blake256hash_8,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	blake256_8_cpu_hash,
+	blake256_8_cpu_precalc
+};
+
+static const struct scan_algo blake256_14_scan = {
+	"blake",
+	blake256hash_14,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	blake256_14_cpu_hash,
+	blake256_14_cpu_precalc
+};
+
 #include "cuda_helper.h"
 
 #if PRECALC64
@@ -685,6 +720,9 @@ static void blake256_cpu_setBlock_16(int thr_id, uint32_t *penddata, const uint3
 extern int scanhash_blake256(int thr_id, uint32_t *pdata, uint32_t *ptarget,
 	uint32_t max_nonce, uint32_t *hashes_done, int8_t blakerounds=14)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, blakerounds == 8 ? &blake256_8_scan : &blake256_14_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	const uint32_t first_nonce = pdata[19];
 	uint32_t _ALIGN(64) endiandata[20];
 #if PRECALC64
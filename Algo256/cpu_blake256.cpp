@@ -0,0 +1,42 @@
+/**
+ * Blake-256 of blake, blakecoin and vanilla on the cpu, the midstate and
+ * the header kernel are batched (cpu_hash.blake256_*, cpu_blake.cpp)
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+static void blake256_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count,
+	cpu_precalc_fn precalc, cpu_hash80p_fn hash80)
+{
+	uint32_t local[CPU_PRECALC_WORDS];
+	const uint32_t *pre = l->precalc;
+
+	if(!pre)
+	{
+		precalc(local, endiandata);
+		pre = local;
+	}
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	hash80(l->hash, pre, l->nonce, l->count);
+}
+
+void blake256_8_cpu_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	cpu_hash.blake256_8_precalc(precalc, endiandata);
+}
+
+void blake256_14_cpu_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	cpu_hash.blake256_14_precalc(precalc, endiandata);
+}
+
+void blake256_8_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	blake256_cpu_hash(l, endiandata, first_nonce, count, cpu_hash.blake256_8_precalc, cpu_hash.blake256_8_80);
+}
+
+void blake256_14_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	blake256_cpu_hash(l, endiandata, first_nonce, count, cpu_hash.blake256_14_precalc, cpu_hash.blake256_14_80);
+}
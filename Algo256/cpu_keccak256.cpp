@@ -0,0 +1,13 @@
+/**
+ * Keccak-256 of Maxcoin on the cpu, the header kernel is batched
+ * (cpu_hash.keccak256_80, cpu_keccak.cpp)
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void keccak256_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.keccak256_80(l->hash, endiandata, l->nonce, l->count);
+}
@@ -10,7 +10,7 @@ extern "C"
 #include "sph/sph_keccak.h"
 }
 #include "miner.h"
-
+#include "scan.h"
 
 #include "cuda_helper.h"
 
@@ -32,10 +32,25 @@ void keccak256_hash(void *state, const void *input)
 	memcpy(state, hash, 32);
 }
 
+/* scanner of the cpu backend (Algo256/cpu_keccak256.cpp), the GPU loop is below */
+static const struct scan_algo keccak256_scan = {
+	"keccak",
+	keccak256_hash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	keccak256_cpu_hash,
+	NULL
+};
+
 extern int scanhash_keccak256(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &keccak256_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *h_nounce = nullptr;
 
 	const uint32_t first_nonce = pdata[19];
@@ -0,0 +1,21 @@
+/**
+ * Jackpot on the cpu, batched with branch compaction
+ *
+ * Same stages as jackpothash(), each round has two "hash[0] & 0x01"
+ * branches which partition the lanes instead of masking them.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void jackpot_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.keccak512_80(l->hash, endiandata, l->nonce, l->count);
+
+	for(int round = 0; round < 3; round++)
+	{
+		cpu_lanes_branch(l, 0, 0x01, cpu_hash.groestl512, cpu_hash.skein512);
+		cpu_lanes_branch(l, 0, 0x01, cpu_hash.blake512, cpu_hash.jh512);
+	}
+}
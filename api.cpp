@@ -8,7 +8,7 @@
  * Software Foundation; either version 2 of the License, or (at your option)
  * any later version.  See COPYING for more details.
  */
-#define APIVERSION "1.3"
+#define APIVERSION "1.4"
 
 #ifdef WIN32
 # define  _WINSOCK_DEPRECATED_NO_WARNINGS
@@ -335,8 +335,16 @@ static char *gethistory(char *params)
 	struct stats_data data[50];
 	int thrid = params ? atoi(params) : -1;
 	char *p = buffer;
-	int records = stats_get_history(thrid, data, ARRAY_SIZE(data));
+	int records;
 	*buffer = '\0';
+	if (thrid < -1 || thrid >= opt_n_threads)
+		return buffer;
+	if (statsfile_active()) {
+		// the persisted history
+		records = statsfile_get_history(thrid == -1 ? -1 : device_map[thrid], data, ARRAY_SIZE(data));
+	} else {
+		records = stats_get_history(thrid, data, ARRAY_SIZE(data));
+	}
 	for (int i = 0; i < records; i++) {
 		time_t ts = data[i].tm_stat;
 		p += sprintf(p, "GPU=%d;H=%u;KHS=%.2f;DIFF=%.6f;"
@@ -366,21 +374,66 @@ static char *getscanlog(char *params)
 	return buffer;
 }
 
+/**
+ * Pool side hashrate from the accepted share difficulties
+ * over 5mn, 15mn and 1h, compared to the gpu hashrate
+ */
+static char *getshares(char *params)
+{
+	struct share_stats st;
+	char *p = buffer;
+	*buffer = '\0';
+	for (int i = 0; i < SHARES_WINDOWS; i++) {
+		shares_get_stats(shares_windows[i], (double) global_hashrate, &st);
+		p += sprintf(p, "WIN=%d;TIME=%.0f;ACC=%u;REJ=%u;KHS=%.2f;"
+				"EKHS=%.2f;EKHS_LO=%.2f;EKHS_HI=%.2f;LUCK=%.3f;Z=%.2f|",
+			st.window, st.elapsed, st.accepted, st.rejected, st.reported / 1000.0,
+			st.hashrate / 1000.0, st.hashrate_lo / 1000.0, st.hashrate_hi / 1000.0,
+			st.luck, st.zscore);
+	}
+	return buffer;
+}
+
+/**
+ * Share outcomes and submit latencies (ms) per pool
+ * AGE: job age when the nonce was found, QUEUE: found to sent,
+ * ANSWER: sent to pool answer (50, 90 and 99th percentiles)
+ */
+static char *getsubmits(char *params)
+{
+	struct pool_share_stats st[4];
+	char *p = buffer;
+	int pools = shares_get_pools(st, ARRAY_SIZE(st));
+	*buffer = '\0';
+	for (int i = 0; i < pools; i++) {
+		p += sprintf(p, "URL=%s;", st[i].url);
+		for (int o = 0; o < SHARE_OUTCOMES; o++)
+			p += sprintf(p, "%s=%u;", share_outcome_names[o], st[i].outcome[o]);
+		p += sprintf(p, "AGE50=%u;AGE90=%u;AGE99=%u;QUEUE50=%u;QUEUE90=%u;QUEUE99=%u;"
+				"ANSWER50=%u;ANSWER90=%u;ANSWER99=%u;INFLIGHT=%u|",
+			st[i].job_age[0], st[i].job_age[1], st[i].job_age[2],
+			st[i].queue[0], st[i].queue[1], st[i].queue[2],
+			st[i].answer[0], st[i].answer[1], st[i].answer[2], st[i].inflight);
+	}
+	return buffer;
+}
+
 /**
  * Some debug infos about memory usage
  */
 static char *getmeminfo(char *params)
 {
-	uint64_t smem, hmem, totmem;
-	uint32_t srec, hrec;
+	uint64_t smem, hmem, fmem, totmem;
+	uint32_t srec, hrec, frec;
 
 	stats_getmeminfo(&smem, &srec);
 	hashlog_getmeminfo(&hmem, &hrec);
+	statsfile_getmeminfo(&fmem, &frec);
 	totmem = smem + hmem;
 
 	*buffer = '\0';
-	sprintf(buffer, "STATS=%u;HASHLOG=%u;MEM=%llu|",
-		srec, hrec, totmem);
+	sprintf(buffer, "STATS=%u;HASHLOG=%u;MEM=%llu;FILEREC=%u;FILEMEM=%llu|",
+		srec, hrec, totmem, frec, (unsigned long long)fmem);
 
 	return buffer;
 }
@@ -399,6 +452,8 @@ struct CMDS {
 	{ "hwinfo",  gethwinfos },
 	{ "meminfo", getmeminfo },
 	{ "scanlog", getscanlog },
+	{ "shares",  getshares },
+	{ "submits", getsubmits },
 	/* keep it the last */
 	{ "help",    gethelp },
 };
@@ -47,6 +47,8 @@
 using namespace std;
 
 #include "miner.h"
+#include "scan.h"
+#include "mockdev.h"
 
 #ifdef WIN32
 #include <Mmsystem.h>
@@ -165,6 +167,9 @@ static bool opt_extranonce = true;
 bool opt_trust_pool = false;
 int num_cpus;
 int active_gpus;
+// the cpu backend threads of --backend, after the gpu threads
+int cpu_miner_threads = 0;
+static bool opt_backend_cuda = true;
 bool need_nvsettings = false;
 bool need_memclockrst = false;
 char * device_name[MAX_GPUS] = { nullptr };
@@ -299,8 +304,20 @@ Options:\n\
   -b, --api-bind=...    IP address and port number for the miner API (example: 127.0.0.1:4068)\n\
   -S, --syslog          use system log for output messages\n\
       --syslog-prefix=... allow to change syslog tool name\n\
+      --log-file=FILE   also write the log messages to FILE\n\
+      --log-max-size=N  rotate the log file after N MB (default: 0 = never)\n\
+      --stats-file=FILE keep the hashrate and share history in FILE\n\
+      --stats-records=N size of a new stats file (default: 65536 records)\n\
+      --stats-dump=FILE print the history of a stats file and exit\n\
   -B, --background      run the miner in the background\n\
       --benchmark       run in offline benchmark mode\n\
+      --backend=LIST    hash with the cuda (default) and/or cpu backend (cuda, cpu or cuda,cpu)\n\
+                        cpu algos: blake, blakecoin, vanilla, c11, deep, doom, luffa,\n\
+                        dmd-gr, groestl, myr-gr, keccak, quark, qubit, skein, whirl,\n\
+                        whirlpoolx, x11, x13, x15, x17\n\
+      --autotune        measure the best intensity of the devices without a tune result\n\
+      --tune-file=FILE  file of the tune results (default: ccminer-tune.json)\n\
+      --tune-latency=N  max time of a batch when tuning, in ms (default: 100)\n\
       --no-cpu-verify   don't verify the found results\n\
   -c, --config=FILE     load a JSON-format configuration file\n\
   -V, --version         display version information and exit\n\
@@ -312,6 +329,12 @@ Options:\n\
       --pstate=N        (not for 10xx cards) Set the gpu power state (352.21+ driver)\n\
       --plimit=N        Set the gpu power limit (352.21+ driver)\n"
 #endif
+#ifdef USE_MOCKDEV
+"\
+      --mock-devices=N  number of simulated devices (default: 1)\n\
+      --mock-hashrate=H simulated H/s per device, random nonces (default: 0 = hash on the cpu)\n\
+      --mock-latency=N  add N ms to each simulated batch\n"
+#endif
 "";
 
 static char const short_options[] =
@@ -324,7 +347,9 @@ static struct option const options[] =
 {
 	{ "algo", 1, NULL, 'a' },
 	{ "api-bind", 1, NULL, 'b' },
+	{ "autotune", 0, NULL, 1083 },
 	{ "background", 0, NULL, 'B' },
+	{ "backend", 1, NULL, 1079 },
 	{ "benchmark", 0, NULL, 1005 },
 	{ "cert", 1, NULL, 1001 },
 	{ "no-cpu-verify", 0, NULL, 1022 },
@@ -335,6 +360,13 @@ static struct option const options[] =
 	{ "debug", 0, NULL, 'D' },
 	{ "help", 0, NULL, 'h' },
 	{ "intensity", 1, NULL, 'i' },
+	{ "log-file", 1, NULL, 1074 },
+	{ "log-max-size", 1, NULL, 1075 },
+#ifdef USE_MOCKDEV
+	{ "mock-devices", 1, NULL, 1080 },
+	{ "mock-hashrate", 1, NULL, 1081 },
+	{ "mock-latency", 1, NULL, 1082 },
+#endif
 	{ "ndevs", 0, NULL, 'n' },
 	{ "no-color", 0, NULL, 1002 },
 	{ "no-gbt", 0, NULL, 1011 },
@@ -348,11 +380,16 @@ static struct option const options[] =
 	{ "retry-pause", 1, NULL, 'R' },
 	{ "scantime", 1, NULL, 's' },
 	{ "statsavg", 1, NULL, 'N' },
+	{ "stats-file", 1, NULL, 1076 },
+	{ "stats-records", 1, NULL, 1077 },
+	{ "stats-dump", 1, NULL, 1078 },
 #ifdef HAVE_SYSLOG_H
 	{ "syslog", 0, NULL, 'S' },
 	{ "syslog-prefix", 1, NULL, 1008 },
 #endif
 	{ "threads", 1, NULL, 't' },
+	{ "tune-file", 1, NULL, 1084 },
+	{ "tune-latency", 1, NULL, 1085 },
 	{ "Disable extranounce support", 1, NULL, 'e' },
 	{ "timeout", 1, NULL, 'T' },
 	{ "url", 1, NULL, 'o' },
@@ -372,8 +409,37 @@ static struct option const options[] =
 
 struct work _ALIGN(64) g_work;
 time_t g_work_time;
+
+/* the stratum job, for the workers to build the headers of their own extranonce2 */
+struct worker_tmpl {
+	uint32_t seq;          /* template number, 0 if none */
+	uint32_t midstate[8];  /* sha256 of the coinbase blocks before the extranonce2 */
+	size_t midlen;
+	uchar *tail;           /* rest of the coinbase */
+	size_t tail_size;
+	size_t xnonce2_off;    /* in the tail */
+	size_t xnonce2_size;
+	int merkle_count;
+	uchar *merkle;         /* 32 bytes per branch */
+	bool sha256d;          /* sha256d coinbase hash, else a single sha256 */
+};
+static struct worker_tmpl g_tmpl; /* with g_work, under g_work_lock */
 static pthread_mutex_t g_work_lock = PTHREAD_MUTEX_INITIALIZER;
 
+/* solo mode: the handles of the workio thread, all in rpc_multi which
+   keeps their connections to the node between the requests */
+static CURLM *rpc_multi;
+static CURL *rpc_info_curl, *rpc_gbt_curl;
+
+/* height and network infos of the current block in solo mode, kept until
+   getwork gives another prevhash or longpoll sees a new block */
+static struct {
+	uint32_t prevhash[8];
+	uint32_t height;
+	bool valid;
+} block_cache;
+static pthread_mutex_t block_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
 
 #ifdef __linux /* Linux specific policy and affinity management */
 #include <sched.h>
@@ -484,7 +550,7 @@ void proper_exit(int reason)
 #ifdef USE_WRAPNVML
 		if(hnvml)
 		{
-			for(int n = 0; n < opt_n_threads; n++)
+			for(int n = 0; n < opt_n_threads - cpu_miner_threads; n++)
 			{
 				nvml_reset_clocks(hnvml, device_map[n]);
 			}
@@ -501,6 +567,8 @@ void proper_exit(int reason)
 		}
 #endif
 	}
+	statsfile_close();
+	applog_stop();
 	sleep(1);
 	exit(reason);
 }
@@ -574,6 +642,7 @@ static bool work_decode(const json_t *val, struct work *work)
 
 	/* use work ntime as job id (solo-mining) */
 	cbin2hex(work->job_id, (const char*)&work->data[17], 4);
+	gettimeofday(&work->tv_job, NULL);
 
 	return true;
 }
@@ -602,10 +671,11 @@ static void calc_diff(struct work *work, int known)
 	}
 }
 
-static int share_result(int result, const char *reason)
+static int share_result(uint32_t id, int result, const char *reason)
 {
 	char s[32] = { 0 };
 	double hashrate = 0.;
+	struct share_data sd;
 
 	pthread_mutex_lock(&stats_lock);
 
@@ -615,6 +685,9 @@ static int share_result(int result, const char *reason)
 	}
 	result ? accepted_count++ : rejected_count++;
 	pthread_mutex_unlock(&stats_lock);
+	shares_result(id, result, reason, &sd);
+	if(sd.thr_id != 0xff)
+		stratum.answer_msec = sd.answer_msec;
 
 	global_hashrate = llround(hashrate);
 
@@ -669,12 +742,22 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 	if(!have_stratum && !stale_work && allow_gbt)
 	{
 		struct work wheight = { 0 };
-		if(get_blocktemplate(curl, &wheight))
+		bool cached = false;
+		// longpoll drops the cache on a new block, else it can be late
+		if(have_longpoll)
+		{
+			pthread_mutex_lock(&block_cache_lock);
+			cached = block_cache.valid && block_cache.height;
+			wheight.height = block_cache.height;
+			pthread_mutex_unlock(&block_cache_lock);
+		}
+		if(cached || get_blocktemplate(curl, &wheight))
 		{
 			if(work->height && work->height < wheight.height)
 			{
 				if(opt_debug)
 					applog(LOG_WARNING, "block %u was already solved", work->height, wheight.height);
+				shares_discarded(work, work->data[19], SHARE_STALE);
 				return true;
 			}
 		}
@@ -684,6 +767,7 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 	{
 //		if(opt_debug)
 			applog(LOG_WARNING, "stale share detected, discarding");
+		shares_discarded(work, opt_algo == ALGO_SIA ? work->data[8] : work->data[19], SHARE_STALE);
 		rejected_count++;
 		return true;
 	}
@@ -693,14 +777,14 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 	{
 		uint32_t sent = 0;
 		uint32_t ntime, nonce;
-		char *ntimestr, *noncestr, *xnonce2str;
+		char ntimestr[17], noncestr[17], xnonce2str[2 * sizeof(work->xnonce2) + 1];
 
 		if(opt_algo != ALGO_SIA)
 		{
 			le32enc(&ntime, work->data[17]);
 			le32enc(&nonce, work->data[19]);
-			noncestr = bin2hex((const uchar*)(&nonce), 4);
-			ntimestr = bin2hex((const uchar*)(&ntime), 4);
+			hex_encode(noncestr, &nonce, 4);
+			hex_encode(ntimestr, &ntime, 4);
 		}
 		else
 		{
@@ -710,8 +794,8 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 			uint64_t nonce64 = nonce;
 			le32enc(&nonce, work->data[9]);
 			nonce64 += (uint64_t)nonce << 32;
-			noncestr = bin2hex((const uchar*)(&nonce64), 8);
-			ntimestr = bin2hex((const uchar*)(&ntime64), 8);
+			hex_encode(noncestr, &nonce64, 8);
+			hex_encode(ntimestr, &ntime64, 8);
 		}
 
 
@@ -725,26 +809,25 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 				applog(LOG_WARNING, "nonce %s was already sent %u seconds ago", noncestr, sent);
 				hashlog_dump_job(work->job_id);
 			}
-			free(noncestr);
+			shares_discarded(work, nonce, SHARE_DUPLICATE);
 			// prevent useless computing on some pools
 			g_work_time = 0;
 			restart_threads();
 			return true;
 		}
 
-		xnonce2str = bin2hex(work->xnonce2, work->xnonce2_len);
+		hex_encode(xnonce2str, work->xnonce2, min(work->xnonce2_len, sizeof(work->xnonce2)));
 
+		/* registered before the send, the answer can come at once */
+		uint32_t id = shares_submitted(work, nonce);
 		sprintf(s,
-				"{\"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\":4}",
-				rpc_user, work->job_id + 8, xnonce2str, ntimestr, noncestr);
-		free(xnonce2str);
-		free(ntimestr);
-		free(noncestr);
+				"{\"method\": \"mining.submit\", \"params\": [\"%s\", \"%s\", \"%s\", \"%s\", \"%s\"], \"id\":%u}",
+				rpc_user, work->job_id + 8, xnonce2str, ntimestr, noncestr, id);
 
-		gettimeofday(&stratum.tv_submit, NULL);
 		if(unlikely(!stratum_send_line(&stratum, s)))
 		{
 			applog(LOG_ERR, "submit_upstream_work stratum_send_line failed");
+			shares_cancel(id);
 			return false;
 		}
 
@@ -756,40 +839,37 @@ static bool submit_upstream_work(CURL *curl, struct work *work)
 	{
 
 		/* build hex string */
-		char *str = NULL;
+		char str[2 * sizeof(work->data) + 1];
 		for(int i = 0; i < (work->datasize >> 2); i++)
 			le32enc(work->data + i, work->data[i]);
-		str = bin2hex((uchar*)work->data, work->datasize);
-		if(unlikely(!str))
-		{
-			applog(LOG_ERR, "submit_upstream_work OOM");
-			return false;
-		}
+		hex_encode(str, work->data, min(work->datasize, sizeof(work->data)));
 
 		/* build JSON-RPC request */
+		uint32_t id = shares_submitted(work, work->data[19]);
 		sprintf(s,
-				"{\"method\": \"getwork\", \"params\": [\"%s\"], \"id\":4}\r\n",
-				str);
+				"{\"method\": \"getwork\", \"params\": [\"%s\"], \"id\":%u}\r\n",
+				str, id);
 
-		/* issue JSON-RPC request */
-		val = json_rpc_call(curl, rpc_url, rpc_userpass, s, false, false, NULL);
+		/* issue JSON-RPC request, on the connection of the getwork */
+		struct rpc_request r = { curl, s };
+		json_rpc_call_multi(rpc_multi, rpc_url, rpc_userpass, &r, 1, false);
+		val = r.val;
 		if(unlikely(!val))
 		{
 			applog(LOG_ERR, "submit_upstream_work json_rpc_call failed");
+			shares_cancel(id);
 			return false;
 		}
 
 		res = json_object_get(val, "result");
 		reason = json_object_get(val, "reject-reason");
-		if(!share_result(json_is_true(res), reason ? json_string_value(reason) : NULL))
+		if(!share_result(id, json_is_true(res), reason ? json_string_value(reason) : NULL))
 		{
 			if(check_dups)
 				hashlog_purge_job(work->job_id);
 		}
 
 		json_decref(val);
-
-		free(str);
 	}
 
 	return true;
@@ -855,15 +935,8 @@ static const char *gbt_req =
 //	"{\"capabilities\": " GBT_CAPABILITIES "}"
 "], \"id\":9}\r\n";
 
-static bool get_blocktemplate(CURL *curl, struct work *work)
+static bool gbt_result(json_t *val, int curl_err, struct work *work)
 {
-	if(!allow_gbt)
-		return false;
-
-	int curl_err = 0;
-	json_t *val = json_rpc_call(curl, rpc_url, rpc_userpass, gbt_req,
-								want_longpoll, have_longpoll, &curl_err);
-
 	if(!val && curl_err == -1)
 	{
 		// when getblocktemplate is not supported, disable it
@@ -882,19 +955,23 @@ static bool get_blocktemplate(CURL *curl, struct work *work)
 	return rc;
 }
 
-// good alternative for wallet mining, difficulty and net hashrate
-static const char *info_req =
-"{\"method\": \"getmininginfo\", \"params\": [], \"id\":8}\r\n";
-
-static bool get_mininginfo(CURL *curl, struct work *work)
+static bool get_blocktemplate(CURL *curl, struct work *work)
 {
-	if(have_stratum || !allow_mininginfo)
+	if(!allow_gbt)
 		return false;
 
 	int curl_err = 0;
-	json_t *val = json_rpc_call(curl, rpc_url, rpc_userpass, info_req,
-								want_longpoll, have_longpoll, &curl_err);
+	struct rpc_request r = { curl, gbt_req, &curl_err };
+	json_rpc_call_multi(rpc_multi, rpc_url, rpc_userpass, &r, 1, want_longpoll);
+	return gbt_result(r.val, curl_err, work);
+}
 
+// good alternative for wallet mining, difficulty and net hashrate
+static const char *info_req =
+"{\"method\": \"getmininginfo\", \"params\": [], \"id\":8}\r\n";
+
+static bool mininginfo_result(json_t *val, int curl_err)
+{
 	if(!val && curl_err == -1)
 	{
 		allow_mininginfo = false;
@@ -961,28 +1038,58 @@ double expectedblocktime(const uint32_t *target)
 static const char *rpc_req =
 "{\"method\": \"getwork\", \"params\": [], \"id\":0}\r\n";
 
+/* add the getmininginfo and getblocktemplate requests still supported */
+static int block_info_requests(struct rpc_request *r, int *curl_err, int n, int *info, int *gbt)
+{
+	*info = *gbt = -1;
+	if(allow_mininginfo)
+	{
+		r[n].curl = rpc_info_curl;
+		r[n].rpc_req = info_req;
+		r[n].curl_err = &curl_err[n];
+		*info = n++;
+	}
+	if(allow_gbt)
+	{
+		r[n].curl = rpc_gbt_curl;
+		r[n].rpc_req = gbt_req;
+		r[n].curl_err = &curl_err[n];
+		*gbt = n++;
+	}
+	return n;
+}
+
+/**
+ * getwork, with the block infos only when the block changed: then they
+ * are asked with the getwork if the block is already known to be new
+ * (first call, longpoll), else right after it, both at once.
+ */
 static bool get_upstream_work(CURL *curl, struct work *work)
 {
-	json_t *val;
-	bool rc;
+	struct rpc_request r[3] = { { curl, rpc_req } };
+	int curl_err[3] = { 0 };
+	int count = 1, info = -1, gbt = -1;
+	bool rc, cached;
 	struct timeval tv_start, tv_end, diff;
 
+	pthread_mutex_lock(&block_cache_lock);
+	cached = block_cache.valid;
+	pthread_mutex_unlock(&block_cache_lock);
+	if(!cached && !have_stratum)
+		count = block_info_requests(r, curl_err, 1, &info, &gbt);
+
 	gettimeofday(&tv_start, NULL);
-	val = json_rpc_call(curl, rpc_url, rpc_userpass, rpc_req,
-						want_longpoll, false, NULL);
+	json_rpc_call_multi(rpc_multi, rpc_url, rpc_userpass, r, count, want_longpoll);
 	gettimeofday(&tv_end, NULL);
 
-	if(have_stratum)
+	if(have_stratum || !r[0].val)
 	{
-		if(val)
-			json_decref(val);
-		return true;
+		for(int i = 0; i < count; i++)
+			json_decref(r[i].val);
+		return have_stratum;
 	}
 
-	if(!val)
-		return false;
-
-	rc = work_decode(json_object_get(val, "result"), work);
+	rc = work_decode(json_object_get(r[0].val, "result"), work);
 
 	if(opt_protocol && rc)
 	{
@@ -992,10 +1099,35 @@ static bool get_upstream_work(CURL *curl, struct work *work)
 			   (1000.0 * diff.tv_sec) + (0.001 * diff.tv_usec));
 	}
 
-	json_decref(val);
+	json_decref(r[0].val);
 
-	get_mininginfo(curl, work);
-	get_blocktemplate(curl, work);
+	if(count == 1)
+	{
+		pthread_mutex_lock(&block_cache_lock);
+		cached = block_cache.valid && !memcmp(block_cache.prevhash, &work->data[1], sizeof(block_cache.prevhash));
+		if(cached)
+			work->height = block_cache.height;
+		pthread_mutex_unlock(&block_cache_lock);
+		if(cached)
+			return rc;
+		count = block_info_requests(r, curl_err, 1, &info, &gbt);
+		json_rpc_call_multi(rpc_multi, rpc_url, rpc_userpass, r + 1, count - 1, want_longpoll);
+	}
+
+	if(info >= 0)
+		mininginfo_result(r[info].val, curl_err[info]);
+	if(gbt >= 0)
+		gbt_result(r[gbt].val, curl_err[gbt], work);
+
+	if(rc)
+	{
+		// an unknown height is only final if gbt is not supported
+		pthread_mutex_lock(&block_cache_lock);
+		memcpy(block_cache.prevhash, &work->data[1], sizeof(block_cache.prevhash));
+		block_cache.height = work->height;
+		block_cache.valid = work->height || !allow_gbt;
+		pthread_mutex_unlock(&block_cache_lock);
+	}
 
 	return rc;
 }
@@ -1080,7 +1212,10 @@ static void *workio_thread(void *userdata)
 	bool ok = true;
 
 	curl = curl_easy_init();
-	if(unlikely(!curl))
+	rpc_info_curl = curl_easy_init();
+	rpc_gbt_curl = curl_easy_init();
+	rpc_multi = curl_multi_init();
+	if(unlikely(!curl || !rpc_info_curl || !rpc_gbt_curl || !rpc_multi))
 	{
 		applog(LOG_ERR, "CURL initialization failed");
 		return NULL;
@@ -1216,7 +1351,93 @@ err_out:
 	return false;
 }
 
-static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
+static void worker_tmpl_set(struct worker_tmpl *t, const uint32_t *midstate, size_t midlen,
+	const uchar *tail, size_t tail_size, int merkle_count)
+{
+	memcpy(t->midstate, midstate, sizeof(t->midstate));
+	t->midlen = midlen;
+	t->tail_size = tail_size;
+	t->merkle_count = merkle_count;
+	t->tail = (uchar*)realloc(t->tail, tail_size + 1);
+	t->merkle = (uchar*)realloc(t->merkle, 32 * merkle_count + 1);
+	if(t->tail == NULL || t->merkle == NULL)
+	{
+		applog(LOG_ERR, "Out of memory!");
+		proper_exit(2);
+	}
+	memcpy(t->tail, tail, tail_size);
+}
+
+/* snapshot of the current job, sctx->work_lock held */
+static void stratum_gen_tmpl(struct stratum_ctx *sctx, struct worker_tmpl *t)
+{
+	static uint32_t seq = 0;
+	const struct stratum_job *job = &sctx->job;
+
+	worker_tmpl_set(t, job->coinbase_midstate, job->coinbase_midlen, job->coinbase + job->coinbase_midlen,
+		job->coinbase_size - job->coinbase_midlen, job->merkle_count);
+	for(int i = 0; i < job->merkle_count; i++)
+		memcpy(t->merkle + 32 * i, job->merkle[i], 32);
+	t->xnonce2_off = (job->xnonce2 - job->coinbase) - job->coinbase_midlen;
+	t->xnonce2_size = sctx->xnonce2_size;
+	switch(opt_algo)
+	{
+		case ALGO_FUGUE256:
+		case ALGO_GROESTL:
+		case ALGO_KECCAK:
+		case ALGO_BLAKECOIN:
+		case ALGO_WHC:
+			t->sha256d = false;
+			break;
+		default:
+			t->sha256d = true;
+	}
+	if(!++seq)
+		seq++;
+	t->seq = seq;
+}
+
+static void worker_tmpl_copy(struct worker_tmpl *dst, const struct worker_tmpl *src)
+{
+	worker_tmpl_set(dst, src->midstate, src->midlen, src->tail, src->tail_size, src->merkle_count);
+	memcpy(dst->merkle, src->merkle, 32 * src->merkle_count);
+	dst->xnonce2_off = src->xnonce2_off;
+	dst->xnonce2_size = src->xnonce2_size;
+	dst->sha256d = src->sha256d;
+	dst->seq = src->seq;
+}
+
+/**
+ * Merkle root of the worker's own extranonce2: the thread id in the last
+ * byte, the counter 'n' in the others. False when the counter is past
+ * the extranonce2 size (the work is not changed).
+ */
+static bool stratum_worker_header(struct worker_tmpl *t, struct work *work, int thr_id, uint64_t n)
+{
+	uchar *xnonce2 = t->tail + t->xnonce2_off;
+	uchar merkle_root[64];
+	size_t i;
+
+	if(t->xnonce2_size < 2 || (t->xnonce2_size < 9 && (n >> (8 * (t->xnonce2_size - 1)))))
+		return false;
+	for(i = 0; i < t->xnonce2_size - 1; i++, n >>= 8)
+		xnonce2[i] = (uchar)n;
+	xnonce2[i] = (uchar)thr_id;
+	work->xnonce2_len = t->xnonce2_size;
+	memcpy(work->xnonce2, xnonce2, t->xnonce2_size);
+
+	sha256_tail(merkle_root, t->midstate, (int)t->midlen, t->tail, (int)t->tail_size, t->sha256d);
+	for(int m = 0; m < t->merkle_count; m++)
+	{
+		memcpy(merkle_root + 32, t->merkle + 32 * m, 32);
+		sha256d(merkle_root, merkle_root, 64);
+	}
+	for(i = 0; i < 8; i++)
+		work->data[9 + i] = be32dec((uint32_t *)merkle_root + i);
+	return true;
+}
+
+static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work, struct worker_tmpl *tmpl)
 {
 	extern void siahash(const void *data, unsigned int len, void *hash);
 	uchar merkle_root[1024];
@@ -1229,6 +1450,8 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 	}
 
 	pthread_mutex_lock(&sctx->work_lock);
+	if(tmpl)
+		stratum_gen_tmpl(sctx, tmpl);
 
 	// store the job ntime as high part of jobid
 	snprintf(work->job_id, sizeof(work->job_id), "%07x %s",
@@ -1238,6 +1461,7 @@ static bool stratum_gen_work(struct stratum_ctx *sctx, struct work *work)
 
 	// also store the block number
 	work->height = sctx->job.height;
+	work->tv_job = sctx->job.tv_received;
 
 	/* Generate merkle root */
 	switch(opt_algo)
@@ -1365,12 +1589,17 @@ static void *miner_thread(void *userdata)
 	struct work work;
 	uint64_t loopcnt = 0;
 	uint32_t max_nonce;
-	uint32_t end_nonce = UINT32_MAX / opt_n_threads * (thr_id + 1) - (thr_id + 1);
 	bool extrajob = false;
+	int exhausted = 0;
 	char s[16];
 	int rc = 0;
+	// own extranonce2 and header, else the threads mine the shared g_work
+	const bool own_xnonce2 = have_stratum && opt_extranonce && opt_algo != ALGO_SIA;
+	struct worker_tmpl tmpl;
+	uint64_t xnonce2_count = 0;
 
 	memset(&work, 0, sizeof(work)); // prevent work from being used uninitialized
+	memset(&tmpl, 0, sizeof(tmpl));
 
 	if(opt_priority > 0)
 	{
@@ -1426,7 +1655,12 @@ static void *miner_thread(void *userdata)
 		}
 	}
 
-	get_cuda_arch(&cuda_arch[thr_id]);
+#ifdef USE_MOCKDEV
+	cuda_arch[thr_id] = device_sm[device_map[thr_id]];
+#else
+	if(thr_id < opt_n_threads - cpu_miner_threads)
+		get_cuda_arch(&cuda_arch[thr_id]);
+#endif
 
 	while(!stop_mining)
 	{
@@ -1450,18 +1684,27 @@ static void *miner_thread(void *userdata)
 		uint32_t hashes_done = 0;
 		uint32_t start_nonce;
 		uint32_t scan_time = have_longpoll ? LP_SCANTIME : opt_scantime;
-		uint64_t max64, minmax;
+		uint32_t sched_key[20];
 
+		bool own_work = false;
 		if(have_stratum)
 		{
+			// next extranonce2 of the job, no need to lock
+			if(exhausted && tmpl.seq && stratum_worker_header(&tmpl, &work, thr_id, xnonce2_count + 1))
+			{
+				xnonce2_count++;
+				exhausted = 0;
+			}
 			pthread_mutex_lock(&g_work_lock);
-			if(loopcnt == 0 || time(NULL) >= (g_work_time + opt_scantime))
+			// the stratum thread makes a template per job, the workers take it
+			own_work = own_xnonce2 && g_tmpl.seq && g_tmpl.xnonce2_size >= 2;
+			if(!own_work && (loopcnt == 0 || time(NULL) >= (g_work_time + opt_scantime)))
 				extrajob = true;
-			if(nonceptr[0] >= end_nonce - 0x00010000 || extrajob)
+			if(!own_work && (exhausted || extrajob))
 			{
 				extrajob = false;
 				int loop = 0;
-				while(!stratum_gen_work(&stratum, &g_work) && !stop_mining)
+				while(!stratum_gen_work(&stratum, &g_work, NULL) && !stop_mining)
 				{
 					pthread_mutex_unlock(&g_work_lock);
 					if(loop > 0)
@@ -1475,11 +1718,11 @@ static void *miner_thread(void *userdata)
 		else
 		{
 			pthread_mutex_lock(&g_work_lock);
-			if((time(NULL) - g_work_time) >= scan_time || nonceptr[0] >= (end_nonce - 0x10000))
+			if((time(NULL) - g_work_time) >= scan_time || exhausted)
 			{
 				if(opt_debug && g_work_time && !opt_quiet)
-					applog(LOG_DEBUG, "work time %u/%us nonce %x/%x", time(NULL) - g_work_time,
-					scan_time, nonceptr[0], end_nonce);
+					applog(LOG_DEBUG, "work time %u/%us nonce %x", time(NULL) - g_work_time,
+					scan_time, nonceptr[0]);
 				/* obtain new work from internal workio thread */
 				if(unlikely(!get_work(mythr, &g_work)))
 				{
@@ -1506,7 +1749,9 @@ static void *miner_thread(void *userdata)
 		}
 
 		int different;
-		if(opt_algo != ALGO_SIA)
+		if(own_work)
+			different = tmpl.seq != g_tmpl.seq;
+		else if(opt_algo != ALGO_SIA)
 			different = memcmp(work.data, g_work.data, wcmplen);
 		else
 			different = memcmp(work.data, g_work.data, 7*4) || memcmp(work.data + 9, g_work.data + 9, 44);
@@ -1531,7 +1776,13 @@ static void *miner_thread(void *userdata)
 			if(opt_debug && opt_algo == ALGO_SIA)
 				applog(LOG_DEBUG, "thread %d: high nonce = %08X", thr_id, work.data[9]);
 			memcpy(&work, &g_work, sizeof(struct work));
-			nonceptr[0] = (UINT32_MAX / opt_n_threads) * thr_id; // 0 if single thr
+			tmpl.seq = 0;
+			if(own_work)
+			{
+				worker_tmpl_copy(&tmpl, &g_tmpl);
+				xnonce2_count = 0;
+				stratum_worker_header(&tmpl, &work, thr_id, 0);
+			}
 		}
 		else
 		{
@@ -1539,85 +1790,30 @@ static void *miner_thread(void *userdata)
 				applog(LOG_DEBUG, "thread %d: continue with old work", thr_id);
 		}
 		work_restart[thr_id].restart = 0;
-		pthread_mutex_unlock(&g_work_lock);
-		/* adjust max_nonce to meet target scan time */
+
+		/* next nonce range, sized to meet the target scan time */
 		uint32_t max64time;
 		if(have_stratum)
 			max64time = LP_SCANTIME;
 		else
 			max64time = (uint32_t)max(1, scan_time + g_work_time - time(NULL));
 
-		max64 = max64time * (uint32_t)thr_hashrates[thr_id];
-
-		/* on start, max64 should not be 0,
-		*    before hashrate is computed */
-		switch(opt_algo)
+		memcpy(sched_key, work.data, sizeof(sched_key));
+		if(opt_algo != ALGO_SIA)
+			sched_key[19] = 0;
+		else
+			sched_key[7] = sched_key[8] = 0;
+		if(!nonce_sched_next(thr_id, sched_key, max64time, &start_nonce, &max_nonce))
 		{
-			case ALGO_KECCAK:
-				minmax = 83000000 * max64time;
-				break;
-			case ALGO_BLAKE:
-			case ALGO_SIA:
-				minmax = 260000000 * max64time;
-				break;
-			case ALGO_BLAKECOIN:
-			case ALGO_VANILLA:
-				minmax = 470000000 * max64time;
-				break;
-			case ALGO_BITCOIN:
-				minmax = 100000000 * max64time;
-				break;
-			case ALGO_QUBIT:
-			case ALGO_QUARK:
-				minmax = 3100000 * max64time;
-				break;
-			case ALGO_JACKPOT:
-				minmax = 2800000 * max64time;
-				break;
-			case ALGO_SKEIN:
-			case ALGO_WHCX:
-			case ALGO_DOOM:
-			case ALGO_LUFFA_DOOM:
-				minmax = 38000000 * max64time;
-				break;
-			case ALGO_NIST5:
-			case ALGO_S3:
-				minmax = 4600000 * max64time;
-				break;
-			case ALGO_X11:
-			case ALGO_C11:
-				minmax = 1500000 * max64time;
-				break;
-			case ALGO_X13:
-				minmax = 1200000 * max64time;
-				break;
-			case ALGO_X17:
-			case ALGO_X15:
-				minmax = 1000000 * max64time;
-				break;
-			case ALGO_LYRA2v2:
-				minmax = 1900000 * max64time;
-				break;
-			case ALGO_NEO:
-				minmax = 90000 * max64time;
-				break;
-			default:
-				minmax = 4000 * max64time;
+			pthread_mutex_unlock(&g_work_lock);
+			// the new work has the same header (no extranonce), wait for a new job
+			if(exhausted++ > 0)
+				sleep(1);
+			continue;
 		}
-		max64 = max(minmax, max64);
-
-		// we can't scan more than uint capacity
-		max64 = min(UINT32_MAX, max64);
-		start_nonce = nonceptr[0];
-
-		/* never let small ranges at end */
-		if(end_nonce >= UINT32_MAX - 256)
-			end_nonce = UINT32_MAX;
-
-		if((max64 + start_nonce) >= end_nonce)
-			max_nonce = end_nonce;
-		else
-			max_nonce = (uint32_t)(max64 + start_nonce);
+		exhausted = 0;
+		pthread_mutex_unlock(&g_work_lock);
+		nonceptr[0] = start_nonce;
 
 		// todo: keep it rounded for gpu threads ?
 
@@ -1644,6 +1840,10 @@ static void *miner_thread(void *userdata)
 		}
 
 		/* scan nonces for a proof-of-work hash */
+#ifdef USE_MOCKDEV
+		rc = scanhash_mock(thr_id, work.data, work.target,
+						   max_nonce, &hashes_done);
+#else
 		switch(opt_algo)
 		{
 
@@ -1800,6 +2000,7 @@ static void *miner_thread(void *userdata)
 			/* should never happen */
 			goto out;
 		}
+#endif
 		mining_has_stopped[thr_id] = true;
 		/* record scanhash elapsed time */
 		gettimeofday(&tv_end, NULL);
@@ -1816,6 +2017,7 @@ static void *miner_thread(void *userdata)
 				applog(LOG_NOTICE, CL_CYN "found => %08x" CL_GRN " %08x", nonceptr[12], swab32(nonceptr[12])); // data[21]
 		}
 		timeval_subtract(&diff, &tv_end, &tv_start);
+		nonce_sched_done(thr_id, sched_key, start_nonce, hashes_done, (double)diff.tv_sec + 1e-6 * diff.tv_usec);
 
 		if(diff.tv_sec > 0 || (diff.tv_sec == 0 && diff.tv_usec>2000)) // avoid totally wrong hash rates
 		{
@@ -1895,6 +2097,8 @@ static void *miner_thread(void *userdata)
 				found2 = nonceptr[12];
 				nonceptr[12] = databackup;
 			}
+			work.thr_id = thr_id;
+			gettimeofday(&work.tv_found, NULL);
 			if(!submit_work(mythr, &work))
 				break;
 
@@ -1995,6 +2199,9 @@ start:
 			{
 				if(!opt_quiet)
 					applog(LOG_BLUE, "%s detected new block", short_url);
+				pthread_mutex_lock(&block_cache_lock);
+				block_cache.valid = false;
+				pthread_mutex_unlock(&block_cache_lock);
 				g_work_time = time(NULL);
 				restart_threads();
 			}
@@ -2031,9 +2238,24 @@ static bool stratum_handle_response(char *buf)
 {
 	json_t *val, *err_val, *res_val, *id_val;
 	json_error_t err;
-	struct timeval tv_answer, diff;
+	struct stratum_line m;
+	int64_t id;
 	bool ret = false;
 
+	// a plain answer to a submit: integer id, true, false or null, no error message
+	if(stratum_parse_line(buf, &m) && m.result.s && json_span_int(&m.id, &id) && json_span_null(&m.error))
+	{
+		const bool accepted = m.result.len == 4 && !memcmp(m.result.s, "true", 4);
+		if(accepted || json_span_null(&m.result) || (m.result.len == 5 && !memcmp(m.result.s, "false", 5)))
+		{
+			// ignore subscribe late answer (yaamp)
+			if(id < 4)
+				return false;
+			share_result((uint32_t)id, accepted, NULL);
+			return true;
+		}
+	}
+
 	val = JSON_LOADS(buf, &err);
 	if(!val)
 	{
@@ -2052,12 +2274,8 @@ static bool stratum_handle_response(char *buf)
 	if(json_integer_value(id_val) < 4)
 		goto out;
 
-	gettimeofday(&tv_answer, NULL);
-	timeval_subtract(&diff, &tv_answer, &stratum.tv_submit);
-	// store time required to the pool to answer to a submit
-	stratum.answer_msec = (1000 * diff.tv_sec) + (uint32_t)(0.001 * diff.tv_usec);
-
-	share_result(json_is_true(res_val),
+	// matched to the submit by its id, the answers can come in any order
+	share_result((uint32_t)json_integer_value(id_val), json_is_true(res_val),
 				 err_val ? json_string_value(json_array_get(err_val, 1)) : NULL);
 
 	ret = true;
@@ -2095,6 +2313,7 @@ static void *stratum_thread(void *userdata)
 			g_work_time = 0;
 			pthread_mutex_unlock(&g_work_lock);
 			restart_threads();
+			shares_drop_pending();
 
 			if(!stratum_connect(&stratum, stratum.url) ||
 			   !stratum_subscribe(&stratum) ||
@@ -2117,7 +2336,7 @@ static void *stratum_thread(void *userdata)
 		   (!g_work_time || strncmp(stratum.job.job_id, g_work.job_id + 8, 120)))
 		{
 			pthread_mutex_lock(&g_work_lock);
-			stratum_gen_work(&stratum, &g_work);
+			stratum_gen_work(&stratum, &g_work, &g_tmpl);
 			g_work_time = time(NULL);
 			if(stratum.job.clean)
 			{
@@ -2260,7 +2479,6 @@ static void parse_arg(int key, char *arg)
 		else
 		{
 			int n = 0;
-			int ngpus = cuda_num_devices();
 			uint32_t last = 0;
 			char *pch = arg;
 			do
@@ -2500,6 +2718,83 @@ static void parse_arg(int key, char *arg)
 			opt_syslog_pfx = strdup(arg);
 		}
 		break;
+	case 1074:
+		free(opt_log_file);
+		opt_log_file = strdup(arg);
+		break;
+	case 1075:
+		v = atoi(arg);
+		if(v < 0)
+			show_usage_and_exit(1);
+		opt_log_max_size = v;
+		break;
+	case 1076:
+		free(opt_stats_file);
+		opt_stats_file = strdup(arg);
+		break;
+	case 1077:
+		v = atoi(arg);
+		if(v < 16)
+			show_usage_and_exit(1);
+		opt_stats_records = v;
+		break;
+	case 1078: /* --stats-dump */
+		statsfile_dump(arg);
+		exit(0);
+		break;
+	case 1079:
+	{
+		char *pch = strtok(arg, ",");
+		opt_backend_cuda = false;
+		cpu_miner_threads = 0;
+		while(pch != NULL)
+		{
+			const struct scan_backend *backend = scan_backend_find(pch);
+			if(!backend)
+				show_usage_and_exit(1);
+			if(backend == &scan_backend_cuda)
+				opt_backend_cuda = true;
+			else
+				cpu_miner_threads = 1;
+			pch = strtok(NULL, ",");
+		}
+		if(!opt_backend_cuda && !cpu_miner_threads)
+			show_usage_and_exit(1);
+		break;
+	}
+	case 1083:
+		opt_autotune = true;
+		break;
+	case 1084:
+		free(opt_tune_file);
+		opt_tune_file = strdup(arg);
+		break;
+	case 1085:
+		v = atoi(arg);
+		if(v < 1)
+			show_usage_and_exit(1);
+		opt_tune_latency = v;
+		break;
+#ifdef USE_MOCKDEV
+	case 1080:
+		v = atoi(arg);
+		if(v < 1 || v > MAX_GPUS)
+			show_usage_and_exit(1);
+		opt_mock_devices = v;
+		break;
+	case 1081:
+		d = atof(arg);
+		if(d < 0.)
+			show_usage_and_exit(1);
+		opt_mock_hashrate = d;
+		break;
+	case 1082:
+		v = atoi(arg);
+		if(v < 0)
+			show_usage_and_exit(1);
+		opt_mock_latency = v;
+		break;
+#endif
 	case 1020:
 		v = atoi(arg);
 		if(v < -1)
@@ -2793,6 +3088,37 @@ static int msver(void)
 	return version;
 }
 
+/* algos which run on the generic scan driver, so on the cpu backend too */
+static bool algo_has_cpu_scan(enum sha_algos algo)
+{
+	switch(algo)
+	{
+	case ALGO_BLAKE:
+	case ALGO_BLAKECOIN:
+	case ALGO_C11:
+	case ALGO_DEEP:
+	case ALGO_DMD_GR:
+	case ALGO_DOOM:
+	case ALGO_GROESTL:
+	case ALGO_KECCAK:
+	case ALGO_LUFFA_DOOM:
+	case ALGO_MYR_GR:
+	case ALGO_QUARK:
+	case ALGO_QUBIT:
+	case ALGO_SKEIN:
+	case ALGO_VANILLA:
+	case ALGO_WHC:
+	case ALGO_WHCX:
+	case ALGO_X11:
+	case ALGO_X13:
+	case ALGO_X15:
+	case ALGO_X17:
+		return true;
+	default:
+		return false;
+	}
+}
+
 bool strictaliasingtest(short *h, long *k)
 {
 	*h = 5;
@@ -2879,29 +3205,12 @@ int main(int argc, char *argv[])
 #else
 	num_cpus = 1;
 #endif
-	// number of gpus
-	active_gpus = cuda_num_devices();
-
 	// default thread to device map
 	for(i = 0; i < MAX_GPUS; i++)
 	{
 		device_map[i] = i;
 	}
 
-	for(int i = 0; i < active_gpus; i++)
-	{
-		int dev_id = device_map[i];
-		cudaError_t err;
-		cudaDeviceProp props;
-		err = cudaGetDeviceProperties(&props, dev_id);
-		if(err != cudaSuccess)
-		{
-			applog(LOG_ERR, "%s", cudaGetErrorString(err));
-			exit(1);
-		}
-		device_name[dev_id] = strdup(props.name);
-	}
-
 	/* parse command line */
 	parse_cmdline(argc, argv);
 	if(opt_algo == ALGO_INVALID)
@@ -2909,11 +3218,69 @@ int main(int argc, char *argv[])
 		applog(LOG_ERR, "Error: no algo or invalid algo");
 		exit(EXIT_FAILURE);
 	}
+	if(cpu_miner_threads && !algo_has_cpu_scan(opt_algo))
+	{
+		applog(LOG_ERR, "Error: no cpu backend for %s, see --cputest", algo_names[opt_algo]);
+		exit(EXIT_FAILURE);
+	}
+
+	// number of gpus, the cpu backend alone doesn't need the cuda driver
+	if(opt_backend_cuda)
+	{
+		int ngpus = cuda_num_devices();
+		if(!active_gpus) // else set by -d
+			active_gpus = ngpus;
+		for(int dev_id = 0; dev_id < ngpus; dev_id++)
+		{
+			cudaError_t err;
+			cudaDeviceProp props;
+			err = cudaGetDeviceProperties(&props, dev_id);
+			if(err != cudaSuccess)
+			{
+				applog(LOG_ERR, "%s", cudaGetErrorString(err));
+				exit(1);
+			}
+			device_name[dev_id] = strdup(props.name);
+		}
+	}
+#ifdef USE_MOCKDEV
+	mockdev_init();
+#endif
 
-	if(!opt_n_threads)
+	if(!opt_backend_cuda)
+		opt_n_threads = 0;
+	else if(!opt_n_threads)
 		opt_n_threads = active_gpus;
+	if(opt_n_threads + cpu_miner_threads > MAX_GPUS)
+	{
+		applog(LOG_ERR, "Error: more than %d miner threads", MAX_GPUS);
+		exit(EXIT_FAILURE);
+	}
+
+	if(opt_n_threads)
+		cuda_get_device_sm();
 
-	cuda_get_device_sm();
+	// the cpu threads follow the gpu ones, on a device slot of their own
+	if(cpu_miner_threads)
+	{
+		int dev_id = 0;
+		for(i = 0; i < opt_n_threads; i++)
+			dev_id = max(dev_id, device_map[i] + 1);
+		for(i = opt_n_threads; i < opt_n_threads + cpu_miner_threads; i++)
+		{
+			while(dev_id < MAX_GPUS && device_name[dev_id])
+				dev_id++;
+			if(dev_id >= MAX_GPUS)
+			{
+				applog(LOG_ERR, "Error: no device slot left for the cpu backend");
+				exit(EXIT_FAILURE);
+			}
+			device_map[i] = dev_id;
+			device_name[dev_id] = strdup("CPU");
+			scan_backend_set(i, &scan_backend_cpu);
+		}
+		opt_n_threads += cpu_miner_threads;
+	}
 
 	if(opt_protocol)
 	{
@@ -3054,6 +3421,10 @@ int main(int argc, char *argv[])
 	if(use_syslog)
 		openlog(opt_syslog_pfx, LOG_PID, LOG_USER);
 #endif
+	applog_start();
+	statsfile_open();
+	scan_tune_load();
+	shares_init(rpc_url);
 
 	work_restart = (struct work_restart *)calloc(opt_n_threads, sizeof(*work_restart));
 	if(work_restart == NULL)
@@ -0,0 +1,782 @@
+/**
+ * AES-NI kernels of the AES based stages: echo512, shavite512,
+ * groestl512 and fugue512 on 64-byte lanes, groestl512 of the 80-byte
+ * header (see cpu_batch.h)
+ *
+ * The sph versions use 32-bit T-tables, here one aesenc does a full AES
+ * round of 16 bytes. Built at the AES-NI level and above (cpu_kernels.h),
+ * cpu_batch_init() puts them in cpu_hash on a cpu with AES-NI. With VAES
+ * the echo, shavite and groestl kernels run two lanes per 256-bit
+ * register or four per 512-bit one, the same code instantiated on
+ * __m256i and __m512i. A Fugue step mixes 4 of its 36 words and depends
+ * on the previous one, 4 lanes are interleaved instead.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(CPU_BATCH_AES)
+
+#include <immintrin.h>
+
+namespace CPU_ISA {
+
+/* 128 and 256-bit versions of the few operations used */
+
+static inline __m128i v_xor(__m128i a, __m128i b) { return _mm_xor_si128(a, b); }
+static inline __m128i v_and(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+static inline __m128i v_aesenc(__m128i a, __m128i k) { return _mm_aesenc_si128(a, k); }
+static inline __m128i v_aesenclast(__m128i a, __m128i k) { return _mm_aesenclast_si128(a, k); }
+static inline __m128i v_shuffle8(__m128i a, __m128i m) { return _mm_shuffle_epi8(a, m); }
+static inline __m128i v_rot32(__m128i a) { return _mm_shuffle_epi32(a, 0x39); }
+static inline __m128i v_alignr4(__m128i hi, __m128i lo) { return _mm_alignr_epi8(hi, lo, 4); }
+static inline __m128i v_add32(__m128i a, __m128i b) { return _mm_add_epi32(a, b); }
+static inline __m128i v_unpacklo16(__m128i a, __m128i b) { return _mm_unpacklo_epi16(a, b); }
+static inline __m128i v_unpackhi16(__m128i a, __m128i b) { return _mm_unpackhi_epi16(a, b); }
+static inline __m128i v_unpacklo32(__m128i a, __m128i b) { return _mm_unpacklo_epi32(a, b); }
+static inline __m128i v_unpackhi32(__m128i a, __m128i b) { return _mm_unpackhi_epi32(a, b); }
+static inline __m128i v_unpacklo64(__m128i a, __m128i b) { return _mm_unpacklo_epi64(a, b); }
+static inline __m128i v_unpackhi64(__m128i a, __m128i b) { return _mm_unpackhi_epi64(a, b); }
+
+/* multiplication by 2 in GF(2^8) of each byte */
+static inline __m128i v_xtime(__m128i a)
+{
+	const __m128i hi = _mm_cmpgt_epi8(_mm_setzero_si128(), a);
+	return _mm_xor_si128(_mm_add_epi8(a, a), _mm_and_si128(hi, _mm_set1_epi8(0x1b)));
+}
+
+#if defined(__VAES__) && defined(__AVX2__)
+#define CPU_AES_X2 1
+
+static inline __m256i v_xor(__m256i a, __m256i b) { return _mm256_xor_si256(a, b); }
+static inline __m256i v_and(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+static inline __m256i v_aesenc(__m256i a, __m256i k) { return _mm256_aesenc_epi128(a, k); }
+static inline __m256i v_aesenclast(__m256i a, __m256i k) { return _mm256_aesenclast_epi128(a, k); }
+static inline __m256i v_shuffle8(__m256i a, __m256i m) { return _mm256_shuffle_epi8(a, m); }
+static inline __m256i v_rot32(__m256i a) { return _mm256_shuffle_epi32(a, 0x39); }
+static inline __m256i v_alignr4(__m256i hi, __m256i lo) { return _mm256_alignr_epi8(hi, lo, 4); }
+static inline __m256i v_add32(__m256i a, __m256i b) { return _mm256_add_epi32(a, b); }
+static inline __m256i v_unpacklo16(__m256i a, __m256i b) { return _mm256_unpacklo_epi16(a, b); }
+static inline __m256i v_unpackhi16(__m256i a, __m256i b) { return _mm256_unpackhi_epi16(a, b); }
+static inline __m256i v_unpacklo32(__m256i a, __m256i b) { return _mm256_unpacklo_epi32(a, b); }
+static inline __m256i v_unpackhi32(__m256i a, __m256i b) { return _mm256_unpackhi_epi32(a, b); }
+static inline __m256i v_unpacklo64(__m256i a, __m256i b) { return _mm256_unpacklo_epi64(a, b); }
+static inline __m256i v_unpackhi64(__m256i a, __m256i b) { return _mm256_unpackhi_epi64(a, b); }
+
+static inline __m256i v_xtime(__m256i a)
+{
+	const __m256i hi = _mm256_cmpgt_epi8(_mm256_setzero_si256(), a);
+	return _mm256_xor_si256(_mm256_add_epi8(a, a), _mm256_and_si256(hi, _mm256_set1_epi8(0x1b)));
+}
+#endif
+
+#if defined(CPU_AES_X2) && defined(__AVX512F__) && defined(__AVX512BW__)
+#define CPU_AES_X4 1
+
+static inline __m512i v_xor(__m512i a, __m512i b) { return _mm512_xor_si512(a, b); }
+static inline __m512i v_and(__m512i a, __m512i b) { return _mm512_and_si512(a, b); }
+static inline __m512i v_aesenc(__m512i a, __m512i k) { return _mm512_aesenc_epi128(a, k); }
+static inline __m512i v_aesenclast(__m512i a, __m512i k) { return _mm512_aesenclast_epi128(a, k); }
+static inline __m512i v_shuffle8(__m512i a, __m512i m) { return _mm512_shuffle_epi8(a, m); }
+static inline __m512i v_rot32(__m512i a) { return _mm512_shuffle_epi32(a, (_MM_PERM_ENUM)0x39); }
+static inline __m512i v_alignr4(__m512i hi, __m512i lo) { return _mm512_alignr_epi8(hi, lo, 4); }
+static inline __m512i v_add32(__m512i a, __m512i b) { return _mm512_add_epi32(a, b); }
+static inline __m512i v_unpacklo16(__m512i a, __m512i b) { return _mm512_unpacklo_epi16(a, b); }
+static inline __m512i v_unpackhi16(__m512i a, __m512i b) { return _mm512_unpackhi_epi16(a, b); }
+static inline __m512i v_unpacklo32(__m512i a, __m512i b) { return _mm512_unpacklo_epi32(a, b); }
+static inline __m512i v_unpackhi32(__m512i a, __m512i b) { return _mm512_unpackhi_epi32(a, b); }
+static inline __m512i v_unpacklo64(__m512i a, __m512i b) { return _mm512_unpacklo_epi64(a, b); }
+static inline __m512i v_unpackhi64(__m512i a, __m512i b) { return _mm512_unpackhi_epi64(a, b); }
+
+static inline __m512i v_xtime(__m512i a)
+{
+	const __mmask64 hi = _mm512_movepi8_mask(a);
+	return _mm512_xor_si512(_mm512_add_epi8(a, a), _mm512_maskz_mov_epi8(hi, _mm512_set1_epi8(0x1b)));
+}
+#endif
+
+/**
+ * Lanes of a vector type: one 16-byte word of each lane, the lanes
+ * are 64 bytes apart in the batch
+ */
+template<int N> struct lanes;
+
+template<> struct lanes<1> {
+	typedef __m128i V;
+	static inline __m128i load(const uint64_t *p, int w) { return _mm_loadu_si128((const __m128i *)p + w); }
+	static inline void store(uint64_t *p, int w, __m128i v) { _mm_storeu_si128((__m128i *)p + w, v); }
+	static inline __m128i set(__m128i c) { return c; }
+	static inline __m128i zero() { return _mm_setzero_si128(); }
+};
+
+#ifdef CPU_AES_X2
+template<> struct lanes<2> {
+	typedef __m256i V;
+	static inline __m256i load(const uint64_t *p, int w)
+	{
+		return _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)p + w)),
+			_mm_loadu_si128((const __m128i *)(p + 8) + w), 1);
+	}
+	static inline void store(uint64_t *p, int w, __m256i v)
+	{
+		_mm_storeu_si128((__m128i *)p + w, _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i *)(p + 8) + w, _mm256_extracti128_si256(v, 1));
+	}
+	static inline __m256i set(__m128i c) { return _mm256_broadcastsi128_si256(c); }
+	static inline __m256i zero() { return _mm256_setzero_si256(); }
+};
+#endif
+
+#ifdef CPU_AES_X4
+template<> struct lanes<4> {
+	typedef __m512i V;
+	static inline __m512i load(const uint64_t *p, int w)
+	{
+		__m512i v = _mm512_castsi128_si512(_mm_loadu_si128((const __m128i *)p + w));
+		v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(p + 8) + w), 1);
+		v = _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(p + 16) + w), 2);
+		return _mm512_inserti32x4(v, _mm_loadu_si128((const __m128i *)(p + 24) + w), 3);
+	}
+	static inline void store(uint64_t *p, int w, __m512i v)
+	{
+		_mm_storeu_si128((__m128i *)p + w, _mm512_castsi512_si128(v));
+		_mm_storeu_si128((__m128i *)(p + 8) + w, _mm512_extracti32x4_epi32(v, 1));
+		_mm_storeu_si128((__m128i *)(p + 16) + w, _mm512_extracti32x4_epi32(v, 2));
+		_mm_storeu_si128((__m128i *)(p + 24) + w, _mm512_extracti32x4_epi32(v, 3));
+	}
+	static inline __m512i set(__m128i c) { return _mm512_broadcast_i32x4(c); }
+	static inline __m512i zero() { return _mm512_setzero_si512(); }
+};
+#endif
+
+/* the widest vector first, the remaining lanes one by one */
+#if defined(CPU_AES_X4)
+#define AES_LANES(fn, hash, count) do { \
+	uint32_t i = 0; \
+	for(; i + 4 <= count; i += 4) \
+		fn<4>(&hash[i * 8]); \
+	for(; i + 2 <= count; i += 2) \
+		fn<2>(&hash[i * 8]); \
+	for(; i < count; i++) \
+		fn<1>(&hash[i * 8]); \
+} while(0)
+#elif defined(CPU_AES_X2)
+#define AES_LANES(fn, hash, count) do { \
+	uint32_t i = 0; \
+	for(; i + 2 <= count; i += 2) \
+		fn<2>(&hash[i * 8]); \
+	for(; i < count; i++) \
+		fn<1>(&hash[i * 8]); \
+} while(0)
+#else
+#define AES_LANES(fn, hash, count) do { \
+	for(uint32_t i = 0; i < count; i++) \
+		fn<1>(&hash[i * 8]); \
+} while(0)
+#endif
+
+/* ECHO-512, one 128-byte block: 8 chaining words and the padded message */
+
+template<int N> static inline void echo_mix_column(typename lanes<N>::V *W, int a, int b, int c, int d)
+{
+	typedef typename lanes<N>::V V;
+	const V ab = v_xor(W[a], W[b]);
+	const V bc = v_xor(W[b], W[c]);
+	const V cd = v_xor(W[c], W[d]);
+	const V abx = v_xtime(ab);
+	const V bcx = v_xtime(bc);
+	const V cdx = v_xtime(cd);
+	const V wa = W[a], wc = W[c], wd = W[d];
+	W[a] = v_xor(v_xor(abx, bc), wd);
+	W[b] = v_xor(v_xor(bcx, wa), cd);
+	W[c] = v_xor(v_xor(cdx, ab), wd);
+	W[d] = v_xor(v_xor(v_xor(abx, bcx), v_xor(cdx, ab)), wc);
+}
+
+template<int N> static void echo512_lanes(uint64_t *hash)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	const V one = L::set(_mm_set_epi32(0, 0, 0, 1));
+	const V iv = L::set(_mm_set_epi32(0, 0, 0, 512));
+	V W[16], M[4], K = iv;
+
+	for(int i = 0; i < 4; i++)
+		M[i] = L::load(hash, i);
+	// V, then the message, the padding and the 128-bit bit count
+	for(int i = 0; i < 8; i++)
+		W[i] = iv;
+	for(int i = 0; i < 4; i++)
+		W[8 + i] = M[i];
+	W[12] = L::set(_mm_set_epi32(0, 0, 0, 0x80));
+	W[13] = L::zero();
+	W[14] = L::set(_mm_set_epi32(0x02000000, 0, 0, 0));
+	W[15] = L::set(_mm_set_epi32(0, 0, 0, 512));
+
+	for(int r = 0; r < 10; r++)
+	{
+		for(int i = 0; i < 16; i++)
+		{
+			W[i] = v_aesenc(v_aesenc(W[i], K), L::zero());
+			K = v_add32(K, one);
+		}
+		// shift rows
+		V t = W[1]; W[1] = W[5]; W[5] = W[9]; W[9] = W[13]; W[13] = t;
+		t = W[2]; W[2] = W[10]; W[10] = t;
+		t = W[6]; W[6] = W[14]; W[14] = t;
+		t = W[15]; W[15] = W[11]; W[11] = W[7]; W[7] = W[3]; W[3] = t;
+		echo_mix_column<N>(W, 0, 1, 2, 3);
+		echo_mix_column<N>(W, 8, 9, 10, 11);
+		// only the words 0-3 and 8-11 are used after the last round
+		if(r < 9)
+		{
+			echo_mix_column<N>(W, 4, 5, 6, 7);
+			echo_mix_column<N>(W, 12, 13, 14, 15);
+		}
+	}
+	for(int i = 0; i < 4; i++)
+		L::store(hash, i, v_xor(v_xor(iv, M[i]), v_xor(W[i], W[i + 8])));
+}
+
+/* SHAvite-3-512, one 128-byte block: the message and its padding are the key */
+
+static const uint32_t shavite512_iv[16] = {
+	0x72FCCDD8, 0x79CA4727, 0x128A077B, 0x40D55AEC,
+	0xD1901A06, 0x430AE307, 0xB29F5CD1, 0xDF07FBFC,
+	0x8E45D73D, 0x681AB538, 0xBDE86578, 0xDD577E47,
+	0xE275EADE, 0x502D9FCD, 0xB9357178, 0x022A4B9A
+};
+
+/* four keyed AES rounds of the Feistel function */
+template<int N> static inline typename lanes<N>::V shavite_f(typename lanes<N>::V x, const typename lanes<N>::V *rk)
+{
+	typedef lanes<N> L;
+	x = v_aesenc(v_xor(x, rk[0]), L::zero());
+	x = v_aesenc(v_xor(x, rk[1]), L::zero());
+	x = v_aesenc(v_xor(x, rk[2]), L::zero());
+	return v_aesenc(v_xor(x, rk[3]), L::zero());
+}
+
+template<int N> static void shavite512_lanes(uint64_t *hash)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	V rk[112], P[4], H[4];
+
+	for(int i = 0; i < 4; i++)
+		rk[i] = L::load(hash, i);
+	// 0x80, the bit count (512) at byte 110 and the digest size at 126
+	rk[4] = L::set(_mm_set_epi32(0, 0, 0, 0x80));
+	rk[5] = L::zero();
+	rk[6] = L::set(_mm_set_epi32(0x02000000, 0, 0, 0));
+	rk[7] = L::set(_mm_set_epi32(0x02000000, 0, 0, 0));
+
+	// key schedule, the counter is mixed in four of the nonlinear words
+	for(int n = 8; n < 112; )
+	{
+		for(int s = 0; s < 8; s++, n++)
+		{
+			rk[n] = v_xor(v_aesenc(v_rot32(rk[n - 8]), L::zero()), rk[n - 1]);
+			if(n == 8)
+				rk[n] = v_xor(rk[n], L::set(_mm_set_epi32(-1, 0, 0, 512)));
+			else if(n == 41)
+				rk[n] = v_xor(rk[n], L::set(_mm_set_epi32(~512, 0, 0, 0)));
+			else if(n == 79)
+				rk[n] = v_xor(rk[n], L::set(_mm_set_epi32(-1, 512, 0, 0)));
+			else if(n == 110)
+				rk[n] = v_xor(rk[n], L::set(_mm_set_epi32(-1, 0, 512, 0)));
+		}
+		if(n == 112)
+			break;
+		for(int s = 0; s < 8; s++, n++)
+			rk[n] = v_xor(rk[n - 8], v_alignr4(rk[n - 1], rk[n - 2]));
+	}
+
+	for(int i = 0; i < 4; i++)
+		P[i] = H[i] = L::set(_mm_loadu_si128((const __m128i *)shavite512_iv + i));
+	for(int r = 0; r < 14; r++)
+	{
+		P[0] = v_xor(P[0], shavite_f<N>(P[1], &rk[8 * r]));
+		P[2] = v_xor(P[2], shavite_f<N>(P[3], &rk[8 * r + 4]));
+		const V t = P[3];
+		P[3] = P[2]; P[2] = P[1]; P[1] = P[0]; P[0] = t;
+	}
+	for(int i = 0; i < 4; i++)
+		L::store(hash, i, v_xor(H[i], P[i]));
+}
+
+/**
+ * Groestl-512: the 8x16 byte state as 8 rows, a row in each 16-byte word.
+ * SubBytes and ShiftBytes are one aesenclast after a byte shuffle which
+ * undoes the AES ShiftRows and rotates the row, MixBytes xors rows.
+ * A 64-byte lane or an 80-byte header is a single padded block.
+ */
+
+static inline __m128i groestl_row_shuffle(int shift)
+{
+	uint8_t m[16];
+	// aesenclast reads byte (k + 4*(k%4)) % 16 for its byte k
+	for(int k = 0; k < 16; k++)
+		m[(k + 4 * (k % 4)) % 16] = (uint8_t)((k + shift) % 16);
+	return _mm_loadu_si128((const __m128i *)m);
+}
+
+/*
+ * Filled by aes_init() from cpu_kernels_set() of the level in use, not by
+ * a constructor: those of every level would run at load with their
+ * instructions, on any cpu.
+ */
+static struct groestl_consts {
+	__m128i shift_p[8], shift_q[8];
+	__m128i column;     /* (j << 4) of each column */
+	__m128i interleave; /* bytes of two columns by row */
+	__m128i deinterleave;
+} gc;
+
+static void groestl_init(void)
+{
+	static const int sp[8] = { 0, 1, 2, 3, 4, 5, 6, 11 };
+	static const int sq[8] = { 1, 3, 5, 11, 0, 2, 4, 6 };
+	uint8_t c[16], il[16], dl[16];
+	for(int r = 0; r < 8; r++)
+	{
+		gc.shift_p[r] = groestl_row_shuffle(sp[r]);
+		gc.shift_q[r] = groestl_row_shuffle(sq[r]);
+	}
+	for(int j = 0; j < 16; j++)
+	{
+		c[j] = (uint8_t)(j << 4);
+		il[j] = (uint8_t)((j >> 1) + 8 * (j & 1));
+		dl[(j >> 1) + 8 * (j & 1)] = (uint8_t)j;
+	}
+	gc.column = _mm_loadu_si128((const __m128i *)c);
+	gc.interleave = _mm_loadu_si128((const __m128i *)il);
+	gc.deinterleave = _mm_loadu_si128((const __m128i *)dl);
+}
+
+/* 8x8 transpose of 16-bit elements, rows <-> pairs of columns */
+template<int N> static inline void groestl_transpose(typename lanes<N>::V *x)
+{
+	typedef typename lanes<N>::V V;
+	V a[8], b[8];
+	for(int i = 0; i < 4; i++)
+	{
+		a[2 * i] = v_unpacklo16(x[2 * i], x[2 * i + 1]);
+		a[2 * i + 1] = v_unpackhi16(x[2 * i], x[2 * i + 1]);
+	}
+	for(int i = 0; i < 2; i++)
+	{
+		for(int j = 0; j < 2; j++)
+		{
+			b[4 * i + j] = v_unpacklo32(a[4 * i + j], a[4 * i + j + 2]);
+			b[4 * i + j + 2] = v_unpackhi32(a[4 * i + j], a[4 * i + j + 2]);
+		}
+	}
+	// b[0]: rows 0-1, b[2]: rows 2-3, b[1]: rows 4-5, b[3]: rows 6-7
+	static const int order[4] = { 0, 2, 1, 3 };
+	for(int i = 0; i < 4; i++)
+	{
+		x[2 * i] = v_unpacklo64(b[order[i]], b[order[i] + 4]);
+		x[2 * i + 1] = v_unpackhi64(b[order[i]], b[order[i] + 4]);
+	}
+}
+
+/* 128 bytes in column order (8 words of 2 columns) to 8 rows */
+template<int N> static inline void groestl_to_rows(typename lanes<N>::V *x)
+{
+	typedef typename lanes<N>::V V;
+	const V il = lanes<N>::set(gc.interleave);
+	for(int i = 0; i < 8; i++)
+		x[i] = v_shuffle8(x[i], il);
+	groestl_transpose<N>(x);
+}
+
+template<int N> static inline void groestl_to_columns(typename lanes<N>::V *x)
+{
+	typedef typename lanes<N>::V V;
+	const V dl = lanes<N>::set(gc.deinterleave);
+	groestl_transpose<N>(x);
+	for(int i = 0; i < 8; i++)
+		x[i] = v_shuffle8(x[i], dl);
+}
+
+/* coefficients 02 02 03 04 05 03 05 07, bit by bit, with t_i = a_i ^ a_i+1 */
+template<int N> static inline void groestl_mix_bytes(typename lanes<N>::V *a)
+{
+	typedef typename lanes<N>::V V;
+	V t[8], x[8];
+	for(int i = 0; i < 8; i++)
+		t[i] = v_xor(a[i], a[(i + 1) & 7]);
+	for(int i = 0; i < 8; i++)
+		x[i] = a[i];
+	for(int i = 0; i < 8; i++)
+	{
+		const V s0 = v_xor(x[(i + 2) & 7], v_xor(t[(i + 4) & 7], t[(i + 6) & 7]));
+		const V s1 = v_xor(v_xor(t[i], x[(i + 2) & 7]), v_xor(x[(i + 5) & 7], x[(i + 7) & 7]));
+		const V s2 = v_xor(t[(i + 3) & 7], t[(i + 6) & 7]);
+		a[i] = v_xor(s0, v_xtime(v_xor(s1, v_xtime(s2))));
+	}
+}
+
+template<int N> static inline void groestl_p_round(typename lanes<N>::V *a, int r)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	const V column = L::set(gc.column);
+	a[0] = v_xor(a[0], v_xor(column, L::set(_mm_set1_epi8((char)r))));
+	for(int i = 0; i < 8; i++)
+		a[i] = v_aesenclast(v_shuffle8(a[i], L::set(gc.shift_p[i])), L::zero());
+	groestl_mix_bytes<N>(a);
+}
+
+template<int N> static inline void groestl_q_round(typename lanes<N>::V *a, int r)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	const V ones = L::set(_mm_set1_epi8(-1));
+	const V column = L::set(gc.column);
+	for(int i = 0; i < 7; i++)
+		a[i] = v_xor(a[i], ones);
+	a[7] = v_xor(a[7], v_xor(v_xor(ones, column), L::set(_mm_set1_epi8((char)r))));
+	for(int i = 0; i < 8; i++)
+		a[i] = v_aesenclast(v_shuffle8(a[i], L::set(gc.shift_q[i])), L::zero());
+	groestl_mix_bytes<N>(a);
+}
+
+template<int N> static inline void groestl_p(typename lanes<N>::V *a)
+{
+	for(int r = 0; r < 14; r++)
+		groestl_p_round<N>(a, r);
+}
+
+template<int N> static inline void groestl_q(typename lanes<N>::V *a)
+{
+	for(int r = 0; r < 14; r++)
+		groestl_q_round<N>(a, r);
+}
+
+/*
+ * P and Q of a block do not depend on each other. With 32 vector
+ * registers (AVX-512) both states stay in registers and their rounds
+ * interleave, with 16 the spills cost more than the overlap gives.
+ */
+template<int N> static inline void groestl_pq(typename lanes<N>::V *p, typename lanes<N>::V *q)
+{
+#if defined(__AVX512F__)
+	for(int r = 0; r < 14; r++)
+	{
+		groestl_p_round<N>(p, r);
+		groestl_q_round<N>(q, r);
+	}
+#else
+	groestl_p<N>(p);
+	groestl_q<N>(q);
+#endif
+}
+
+/* h = P(h ^ m) ^ Q(m) ^ h, on rows */
+template<int N> static inline void groestl512_compress(typename lanes<N>::V *h, const typename lanes<N>::V *m)
+{
+	typedef typename lanes<N>::V V;
+	V p[8], q[8];
+	for(int i = 0; i < 8; i++)
+	{
+		p[i] = v_xor(h[i], m[i]);
+		q[i] = m[i];
+	}
+	groestl_pq<N>(p, q);
+	for(int i = 0; i < 8; i++)
+		h[i] = v_xor(h[i], v_xor(p[i], q[i]));
+}
+
+/* h = P(h) ^ h, the output is the second half of the columns */
+template<int N> static inline void groestl512_final(typename lanes<N>::V *h)
+{
+	typedef typename lanes<N>::V V;
+	V p[8];
+	for(int i = 0; i < 8; i++)
+		p[i] = h[i];
+	groestl_p<N>(p);
+	for(int i = 0; i < 8; i++)
+		h[i] = v_xor(h[i], p[i]);
+	groestl_to_columns<N>(h);
+}
+
+/* single block of the padded message m (columns), the digest in the lanes */
+template<int N> static inline void groestl512_block(uint64_t *hash, typename lanes<N>::V *m)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	V h[8];
+
+	// the IV is 512 (the digest size) in the last column
+	for(int i = 0; i < 8; i++)
+		h[i] = L::zero();
+	h[6] = L::set(_mm_set_epi32(0x02000000, 0, 0, 0));
+	groestl_to_rows<N>(m);
+
+	groestl512_compress<N>(h, m);
+	groestl512_final<N>(h);
+	for(int i = 0; i < 4; i++)
+		L::store(hash, i, h[4 + i]);
+}
+
+template<int N> static void groestl512_lanes(uint64_t *hash)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	V m[8];
+
+	for(int i = 0; i < 4; i++)
+		m[i] = L::load(hash, i);
+	// 0x80 and the block count (1), big endian at the end
+	m[4] = L::set(_mm_set_epi32(0, 0, 0, 0x80));
+	m[5] = m[6] = L::zero();
+	m[7] = L::set(_mm_set_epi32(0x01000000, 0, 0, 0));
+	groestl512_block<N>(hash, m);
+}
+
+/* the 80-byte header fits a block too, 0x80 follows the nonce */
+template<int N> static void groestl512_80_lanes(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce)
+{
+	typedef lanes<N> L;
+	typedef typename L::V V;
+	uint64_t tail[8 * N];
+	V m[8];
+
+	for(int i = 0; i < 4; i++)
+		m[i] = L::set(_mm_loadu_si128((const __m128i *)endiandata + i));
+	// words 16 to 19 of each lane, as lanes<N>::load reads them
+	for(int l = 0; l < N; l++)
+	{
+		uint32_t *t = (uint32_t *)&tail[l * 8];
+		memcpy(t, &endiandata[16], 12);
+		be32enc(&t[3], nonce[l]);
+	}
+	m[4] = L::load(tail, 0);
+	m[5] = L::set(_mm_set_epi32(0, 0, 0, 0x80));
+	m[6] = L::zero();
+	m[7] = L::set(_mm_set_epi32(0x01000000, 0, 0, 0));
+	groestl512_block<N>(hash, m);
+}
+
+/**
+ * Fugue-512: the words are kept in memory order, so the 4 words of a
+ * SMIX are an AES state (byte 4*column + row). The state slides down a
+ * buffer, a rotation right by n moves the start n words down.
+ */
+
+static const uint32_t fugue512_iv[16] = {
+	0x8807a57e, 0xe616af75, 0xc5d3e4db, 0xac9ab027,
+	0xd915f117, 0xb6eecc54, 0x06e8020b, 0x4a92efd1,
+	0xaac6e2c9, 0xddb21398, 0xcae65838, 0x437f203f,
+	0x25ea78e7, 0x951fddd6, 0xda6ed11d, 0xe13e3567
+};
+
+/* words rotated for 64 bytes: 18 input words, then 32 and 13 final rounds */
+#define FUGUE_ROT_64   (18 * 12 + 32 * 3 + 13 * 35)
+#define FUGUE_LANES    4
+
+/* filled by aes_init(), like gc */
+static struct fugue_consts {
+	__m128i inv_shift_rows, shift_rows;
+	__m128i rot1, rot2, rot3;   /* bytes of a column rotated */
+	__m128i off_diag;
+	__m128i coef1, coef2, coef4;
+} fc;
+
+static void fugue_init(void)
+{
+	uint8_t isr[16], sr[16], r1[16], r2[16], r3[16], od[16], c1[16], c2[16], c4[16];
+	for(int c = 0; c < 4; c++)
+	{
+		for(int r = 0; r < 4; r++)
+		{
+			const int k = 4 * c + r;
+			sr[k] = (uint8_t)(4 * ((c + r) % 4) + r);
+			isr[sr[k]] = (uint8_t)k;
+			r1[k] = (uint8_t)(4 * c + (r + 1) % 4);
+			r2[k] = (uint8_t)(4 * c + (r + 2) % 4);
+			r3[k] = (uint8_t)(4 * c + (r + 3) % 4);
+			od[k] = (c == r) ? 0 : 0xff;
+			c1[k] = (c < 3) ? 0xff : 0;
+			c2[k] = (c == 2) ? 0xff : 0;
+			c4[k] = (c >= 2) ? 0xff : 0;
+		}
+	}
+	fc.inv_shift_rows = _mm_loadu_si128((const __m128i *)isr);
+	fc.shift_rows = _mm_loadu_si128((const __m128i *)sr);
+	fc.rot1 = _mm_loadu_si128((const __m128i *)r1);
+	fc.rot2 = _mm_loadu_si128((const __m128i *)r2);
+	fc.rot3 = _mm_loadu_si128((const __m128i *)r3);
+	fc.off_diag = _mm_loadu_si128((const __m128i *)od);
+	fc.coef1 = _mm_loadu_si128((const __m128i *)c1);
+	fc.coef2 = _mm_loadu_si128((const __m128i *)c2);
+	fc.coef4 = _mm_loadu_si128((const __m128i *)c4);
+}
+
+/**
+ * SubBytes, then the super-mix: each column times N = circ(1 4 7 1),
+ * shifted like the AES rows, plus the row sums without the diagonal
+ * times 1 1 7 4 for the columns 0 to 3
+ */
+static inline void fugue_smix(uint32_t *S)
+{
+	const __m128i x = _mm_set_epi32(S[3], S[2], S[1], S[0]);
+	const __m128i a = _mm_aesenclast_si128(_mm_shuffle_epi8(x, fc.inv_shift_rows), _mm_setzero_si128());
+
+	__m128i u = _mm_and_si128(a, fc.off_diag);
+	u = _mm_xor_si128(u, _mm_shuffle_epi32(u, 0x4e));
+	u = _mm_xor_si128(u, _mm_shuffle_epi32(u, 0xb1));
+	const __m128i u2 = v_xtime(u);
+	const __m128i u4 = v_xtime(u2);
+	const __m128i t = _mm_xor_si128(_mm_and_si128(u, fc.coef1), _mm_xor_si128(_mm_and_si128(u2, fc.coef2), _mm_and_si128(u4, fc.coef4)));
+
+	const __m128i b1 = _mm_shuffle_epi8(a, fc.rot1);
+	const __m128i b2 = _mm_shuffle_epi8(a, fc.rot2);
+	const __m128i b3 = _mm_shuffle_epi8(a, fc.rot3);
+	const __m128i c = _mm_xor_si128(_mm_xor_si128(a, b3), _mm_xor_si128(b2, v_xtime(_mm_xor_si128(b2, v_xtime(_mm_xor_si128(b1, b2))))));
+	const __m128i y = _mm_xor_si128(_mm_shuffle_epi8(c, fc.shift_rows), t);
+	S[0] = _mm_cvtsi128_si32(y);
+	S[1] = _mm_extract_epi32(y, 1);
+	S[2] = _mm_extract_epi32(y, 2);
+	S[3] = _mm_extract_epi32(y, 3);
+}
+
+static inline void fugue_ror(uint32_t *&S, int n)
+{
+	S -= n;
+	for(int k = 0; k < n; k++)
+		S[k] = S[k + 36];
+}
+
+static inline void fugue_cmix_smix(uint32_t *&S)
+{
+	fugue_ror(S, 3);
+	S[0] ^= S[4]; S[1] ^= S[5]; S[2] ^= S[6];
+	S[18] ^= S[4]; S[19] ^= S[5]; S[20] ^= S[6];
+	fugue_smix(S);
+}
+
+/* N lanes interleaved, a SMIX depends on the previous one */
+template<int N> static void fugue512_lanes(uint64_t *hash)
+{
+	uint32_t buf[N][36 + FUGUE_ROT_64];
+	uint32_t *S[N];
+	uint32_t in[N][18];
+
+	for(int l = 0; l < N; l++)
+	{
+		S[l] = buf[l] + FUGUE_ROT_64;
+		memset(S[l], 0, 20 * sizeof(uint32_t));
+		for(int i = 0; i < 16; i++)
+			S[l][20 + i] = swab32(fugue512_iv[i]);
+		memcpy(in[l], &hash[l * 8], 64);
+		// the 64-bit bit count, big endian
+		in[l][16] = 0;
+		in[l][17] = swab32(512);
+	}
+
+	for(int w = 0; w < 18; w++)
+	{
+		for(int l = 0; l < N; l++)
+		{
+			uint32_t *s = S[l];
+			s[22] ^= s[0];
+			s[0] = in[l][w];
+			s[8] ^= s[0];
+			s[1] ^= s[24];
+			s[4] ^= s[27];
+			s[7] ^= s[30];
+		}
+		for(int k = 0; k < 4; k++)
+		{
+			for(int l = 0; l < N; l++)
+				fugue_cmix_smix(S[l]);
+		}
+	}
+	for(int i = 0; i < 32; i++)
+	{
+		for(int l = 0; l < N; l++)
+			fugue_cmix_smix(S[l]);
+	}
+	for(int i = 0; i < 13; i++)
+	{
+		static const int x[4][3] = { { 9, 18, 27 }, { 10, 18, 27 }, { 10, 19, 27 }, { 10, 19, 28 } };
+		for(int k = 0; k < 4; k++)
+		{
+			for(int l = 0; l < N; l++)
+			{
+				uint32_t *&s = S[l];
+				s[4] ^= s[0];
+				s[x[k][0]] ^= s[0];
+				s[x[k][1]] ^= s[0];
+				s[x[k][2]] ^= s[0];
+				fugue_ror(s, k < 3 ? 9 : 8);
+				fugue_smix(s);
+			}
+		}
+	}
+	for(int l = 0; l < N; l++)
+	{
+		uint32_t *s = S[l];
+		s[4] ^= s[0];
+		s[9] ^= s[0];
+		s[18] ^= s[0];
+		s[27] ^= s[0];
+		memcpy(&hash[l * 8 + 0], &s[1], 16);
+		memcpy(&hash[l * 8 + 2], &s[9], 16);
+		memcpy(&hash[l * 8 + 4], &s[18], 16);
+		memcpy(&hash[l * 8 + 6], &s[27], 16);
+	}
+}
+
+void aes_echo512_64(uint64_t *hash, uint32_t count)
+{
+	AES_LANES(echo512_lanes, hash, count);
+}
+
+void aes_shavite512_64(uint64_t *hash, uint32_t count)
+{
+	AES_LANES(shavite512_lanes, hash, count);
+}
+
+void aes_groestl512_64(uint64_t *hash, uint32_t count)
+{
+	AES_LANES(groestl512_lanes, hash, count);
+}
+
+void aes_groestl512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	uint32_t i = 0;
+#ifdef CPU_AES_X4
+	for(; i + 4 <= count; i += 4)
+		groestl512_80_lanes<4>(&hash[i * 8], endiandata, &nonce[i]);
+#endif
+#ifdef CPU_AES_X2
+	for(; i + 2 <= count; i += 2)
+		groestl512_80_lanes<2>(&hash[i * 8], endiandata, &nonce[i]);
+#endif
+	for(; i < count; i++)
+		groestl512_80_lanes<1>(&hash[i * 8], endiandata, &nonce[i]);
+}
+
+void aes_fugue512_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+	for(; i + FUGUE_LANES <= count; i += FUGUE_LANES)
+		fugue512_lanes<FUGUE_LANES>(&hash[i * 8]);
+	for(; i < count; i++)
+		fugue512_lanes<1>(&hash[i * 8]);
+}
+
+void aes_init(void)
+{
+	groestl_init();
+	fugue_init();
+}
+
+} // namespace CPU_ISA
+
+#endif /* CPU_BATCH_AES */
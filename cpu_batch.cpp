@@ -0,0 +1,449 @@
+/**
+ * Batched CPU hashing with branch compaction (see cpu_batch.h)
+ */
+#include <stdio.h>
+#include <string.h>
+
+extern "C"
+{
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_groestl.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "sph/sph_luffa.h"
+#include "sph/sph_cubehash.h"
+#include "sph/sph_shavite.h"
+#include "sph/sph_simd.h"
+#include "sph/sph_echo.h"
+#include "sph/sph_hamsi.h"
+#include "sph/sph_fugue.h"
+#include "sph/sph_shabal.h"
+#include "sph/sph_whirlpool.h"
+#include "sph/sph_sha2.h"
+#include "sph/sph_haval.h"
+}
+
+#include "miner.h"
+#include "cpu_batch.h"
+
+/* sph reference kernels, one lane at a time */
+
+#define SPH_HASH64(name, ctxtype) \
+static void sph_##name##_64(uint64_t *hash, uint32_t count) \
+{ \
+	ctxtype ctx; \
+	for(uint32_t i = 0; i < count; i++, hash += 8) \
+	{ \
+		sph_##name##_init(&ctx); \
+		sph_##name(&ctx, hash, 64); \
+		sph_##name##_close(&ctx, hash); \
+	} \
+}
+
+SPH_HASH64(blake512, sph_blake512_context)
+SPH_HASH64(bmw512, sph_bmw512_context)
+SPH_HASH64(groestl512, sph_groestl512_context)
+SPH_HASH64(skein512, sph_skein512_context)
+SPH_HASH64(jh512, sph_jh512_context)
+SPH_HASH64(keccak512, sph_keccak512_context)
+SPH_HASH64(luffa512, sph_luffa512_context)
+SPH_HASH64(cubehash512, sph_cubehash512_context)
+SPH_HASH64(shavite512, sph_shavite512_context)
+SPH_HASH64(simd512, sph_simd512_context)
+SPH_HASH64(echo512, sph_echo512_context)
+SPH_HASH64(hamsi512, sph_hamsi512_context)
+SPH_HASH64(fugue512, sph_fugue512_context)
+SPH_HASH64(shabal512, sph_shabal512_context)
+SPH_HASH64(whirlpool, sph_whirlpool_context)
+SPH_HASH64(whirlpool1, sph_whirlpool1_context)
+SPH_HASH64(sha512, sph_sha512_context)
+SPH_HASH64(haval256_5, sph_haval256_5_context)
+SPH_HASH64(sha256, sph_sha256_context)
+
+/* the first 64 bytes do not depend on the nonce, absorb them once */
+#define SPH_HASH80(name, ctxtype) \
+static void sph_##name##_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count) \
+{ \
+	ctxtype ctx0, ctx; \
+	uint32_t tail[4]; \
+	sph_##name##_init(&ctx0); \
+	sph_##name(&ctx0, endiandata, 64); \
+	memcpy(tail, &endiandata[16], 12); \
+	for(uint32_t i = 0; i < count; i++, hash += 8) \
+	{ \
+		be32enc(&tail[3], nonce[i]); \
+		memcpy(&ctx, &ctx0, sizeof(ctx)); \
+		sph_##name(&ctx, tail, 16); \
+		sph_##name##_close(&ctx, hash); \
+	} \
+}
+
+SPH_HASH80(blake512, sph_blake512_context)
+SPH_HASH80(keccak512, sph_keccak512_context)
+SPH_HASH80(keccak256, sph_keccak256_context)
+SPH_HASH80(whirlpool, sph_whirlpool_context)
+SPH_HASH80(whirlpool1, sph_whirlpool1_context)
+SPH_HASH80(luffa512, sph_luffa512_context)
+SPH_HASH80(groestl512, sph_groestl512_context)
+
+/* the fused stages of x11 and qubit */
+static void sph_luffa_cubehash512_64(uint64_t *hash, uint32_t count)
+{
+	sph_luffa512_64(hash, count);
+	sph_cubehash512_64(hash, count);
+}
+
+static void sph_luffa_cubehash512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	sph_luffa512_80(hash, endiandata, nonce, count);
+	sph_cubehash512_64(hash, count);
+}
+
+struct cpu_hash_kernels cpu_hash = {
+	sph_blake512_80,
+	sph_keccak512_80,
+	sph_keccak256_80,
+	sph_whirlpool_80,
+	sph_whirlpool1_80,
+	sph_luffa512_80,
+	sph_luffa_cubehash512_80,
+	sph_groestl512_80,
+	sph_blake512_64,
+	sph_bmw512_64,
+	sph_groestl512_64,
+	sph_skein512_64,
+	sph_jh512_64,
+	sph_keccak512_64,
+	sph_luffa512_64,
+	sph_cubehash512_64,
+	sph_luffa_cubehash512_64,
+	sph_shavite512_64,
+	sph_simd512_64,
+	sph_echo512_64,
+	sph_hamsi512_64,
+	sph_fugue512_64,
+	sph_shabal512_64,
+	sph_whirlpool_64,
+	sph_whirlpool1_64,
+	sph_sha512_64,
+	sph_haval256_5_64,
+	sph_sha256_64,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL,
+	NULL
+};
+
+/* the kernel builds (cpu_kernels.h), the highest level the cpu runs first */
+#define CPU_LEVEL(ns) namespace ns { void cpu_kernels_set(struct cpu_hash_kernels *k); }
+#ifdef CPU_DISPATCH
+CPU_LEVEL(cpu_sse2)
+CPU_LEVEL(cpu_aes)
+CPU_LEVEL(cpu_avx2)
+CPU_LEVEL(cpu_avx2_vaes)
+CPU_LEVEL(cpu_avx512)
+CPU_LEVEL(cpu_avx512_vaes)
+#else
+CPU_LEVEL(cpu_native)
+#endif
+
+#define CPU_SSE2   0x01
+#define CPU_SSE41  0x02
+#define CPU_AESNI  0x04
+#define CPU_AVX2   0x08
+#define CPU_AVX512 0x10 /* F, BW, VL and DQ */
+#define CPU_VAES   0x20
+#define CPU_VBMI   0x40
+
+static const struct {
+	const char *name;
+	void (*set)(struct cpu_hash_kernels *k);
+	uint32_t features;
+} cpu_levels[] = {
+#ifdef CPU_DISPATCH
+	{ "avx512+vaes", cpu_avx512_vaes::cpu_kernels_set, CPU_AESNI | CPU_AVX2 | CPU_AVX512 | CPU_VAES | CPU_VBMI },
+	{ "avx512", cpu_avx512::cpu_kernels_set, CPU_AESNI | CPU_AVX2 | CPU_AVX512 },
+	{ "avx2+vaes", cpu_avx2_vaes::cpu_kernels_set, CPU_AESNI | CPU_AVX2 | CPU_VAES },
+	{ "avx2", cpu_avx2::cpu_kernels_set, CPU_AESNI | CPU_AVX2 },
+	{ "aes", cpu_aes::cpu_kernels_set, CPU_AESNI | CPU_SSE41 },
+	{ "sse2", cpu_sse2::cpu_kernels_set, CPU_SSE2 }
+#else
+	{ "native", cpu_native::cpu_kernels_set, 0 }
+#endif
+};
+
+static uint32_t cpu_features(void)
+{
+	uint32_t f = 0;
+#ifdef CPU_DISPATCH
+	// also checks that the OS saves the AVX and AVX-512 registers
+	__builtin_cpu_init();
+	if(__builtin_cpu_supports("sse2")) f |= CPU_SSE2;
+	if(__builtin_cpu_supports("sse4.1")) f |= CPU_SSE41;
+	if(__builtin_cpu_supports("aes")) f |= CPU_AESNI;
+	if(__builtin_cpu_supports("avx2")) f |= CPU_AVX2;
+	if(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw") &&
+		__builtin_cpu_supports("avx512vl") && __builtin_cpu_supports("avx512dq")) f |= CPU_AVX512;
+	if(__builtin_cpu_supports("vaes")) f |= CPU_VAES;
+	if(__builtin_cpu_supports("avx512vbmi")) f |= CPU_VBMI;
+#endif
+	return f;
+}
+
+/**
+ * A vector kernel pays for its full width whatever the lane count and
+ * runs a single lane on scalars, which sph does faster. Below these
+ * counts (cpubench -b at the avx512 level, narrower levels cross over
+ * sooner) the lanes go to sph one by one.
+ */
+#define CPU_SMALL64(name, min) \
+static cpu_hash64_fn vec_##name; \
+static void small_##name##_64(uint64_t *hash, uint32_t count) \
+{ \
+	if(count < min) \
+		sph_##name##_64(hash, count); \
+	else \
+		vec_##name(hash, count); \
+}
+
+CPU_SMALL64(keccak512, 8)
+CPU_SMALL64(luffa512, 2)
+CPU_SMALL64(cubehash512, 3)
+CPU_SMALL64(luffa_cubehash512, 3)
+CPU_SMALL64(whirlpool, 5)
+CPU_SMALL64(whirlpool1, 5)
+CPU_SMALL64(hamsi512, 4)
+CPU_SMALL64(sha512, 2)
+CPU_SMALL64(haval256_5, 2)
+
+#define CPU_SMALL_SET(name) do { \
+	if(cpu_hash.name != sph_##name##_64) \
+	{ \
+		vec_##name = cpu_hash.name; \
+		cpu_hash.name = small_##name##_64; \
+	} \
+} while(0)
+
+static pthread_mutex_t cpu_batch_lock = PTHREAD_MUTEX_INITIALIZER;
+static bool cpu_batch_ready = false;
+static const char *cpu_batch_level_name = "sph";
+
+/**
+ * Select the fastest kernels for this cpu
+ */
+void cpu_batch_init(void)
+{
+	pthread_mutex_lock(&cpu_batch_lock);
+	if(!cpu_batch_ready)
+	{
+		const uint32_t features = cpu_features();
+		for(size_t i = 0; i < sizeof(cpu_levels) / sizeof(cpu_levels[0]); i++)
+		{
+			if((features & cpu_levels[i].features) == cpu_levels[i].features)
+			{
+				cpu_levels[i].set(&cpu_hash);
+				cpu_batch_level_name = cpu_levels[i].name;
+				break;
+			}
+		}
+		CPU_SMALL_SET(keccak512);
+		CPU_SMALL_SET(luffa512);
+		CPU_SMALL_SET(cubehash512);
+		CPU_SMALL_SET(luffa_cubehash512);
+		CPU_SMALL_SET(whirlpool);
+		CPU_SMALL_SET(whirlpool1);
+		CPU_SMALL_SET(hamsi512);
+		CPU_SMALL_SET(sha512);
+		CPU_SMALL_SET(haval256_5);
+		cpu_batch_ready = true;
+	}
+	pthread_mutex_unlock(&cpu_batch_lock);
+}
+
+/* name of the kernel level in use, "sph" if none */
+const char *cpu_batch_level(void)
+{
+	return cpu_batch_level_name;
+}
+
+bool cpu_lanes_alloc(struct cpu_lanes *l, uint32_t max)
+{
+	memset(l, 0, sizeof(*l));
+	l->nonce = (uint32_t *)aligned_calloc(max * sizeof(uint32_t));
+	l->nonce2 = (uint32_t *)aligned_calloc(max * sizeof(uint32_t));
+	l->hash = (uint64_t *)aligned_calloc(max * 64);
+	l->hash2 = (uint64_t *)aligned_calloc(max * 64);
+	if(!l->nonce || !l->nonce2 || !l->hash || !l->hash2)
+	{
+		cpu_lanes_free(l);
+		return false;
+	}
+	l->max = max;
+	return true;
+}
+
+void cpu_lanes_free(struct cpu_lanes *l)
+{
+	if(l->nonce) aligned_free(l->nonce);
+	if(l->nonce2) aligned_free(l->nonce2);
+	if(l->hash) aligned_free(l->hash);
+	if(l->hash2) aligned_free(l->hash2);
+	memset(l, 0, sizeof(*l));
+}
+
+void cpu_lanes_set_nonces(struct cpu_lanes *l, uint32_t first_nonce, uint32_t count)
+{
+	l->count = min(count, l->max);
+	for(uint32_t i = 0; i < l->count; i++)
+		l->nonce[i] = first_nonce + i;
+}
+
+/**
+ * Move the lanes where (hash32[word] & mask) is set to the front
+ * @return number of lanes with the bit set
+ */
+uint32_t cpu_lanes_partition(struct cpu_lanes *l, int word, uint32_t mask)
+{
+	uint32_t lo = 0, hi = l->count;
+	for(uint32_t i = 0; i < l->count; i++)
+	{
+		const uint32_t *h32 = (const uint32_t *)&l->hash[i * 8];
+		uint32_t dst = (h32[word] & mask) ? lo++ : --hi;
+		l->nonce2[dst] = l->nonce[i];
+		memcpy(&l->hash2[dst * 8], &l->hash[i * 8], 64);
+	}
+	uint32_t *n = l->nonce; l->nonce = l->nonce2; l->nonce2 = n;
+	uint64_t *h = l->hash; l->hash = l->hash2; l->hash2 = h;
+	return lo;
+}
+
+/**
+ * Data dependent stage: both kernels run on a compacted group
+ */
+void cpu_lanes_branch(struct cpu_lanes *l, int word, uint32_t mask, cpu_hash64_fn if_set, cpu_hash64_fn if_clear)
+{
+	uint32_t nset = cpu_lanes_partition(l, word, mask);
+	if(nset)
+		if_set(l->hash, nset);
+	if(l->count > nset)
+		if_clear(&l->hash[nset * 8], l->count - nset);
+}
+
+/**
+ * Compare the 256-bit results with the target
+ * @return number of nonces stored in found[]
+ */
+int cpu_lanes_check(const struct cpu_lanes *l, const uint32_t *ptarget, uint32_t *found, int max_found)
+{
+	int n = 0;
+	for(uint32_t i = 0; i < l->count && n < max_found; i++)
+	{
+		const uint32_t *h32 = (const uint32_t *)&l->hash[i * 8];
+		if(h32[7] <= ptarget[7] && fulltest(h32, ptarget))
+			found[n++] = l->nonce[i];
+	}
+	return n;
+}
+
+/**
+ * Compare a batch with the reference hash (--cputest)
+ */
+bool cpu_batch_selftest(const char *name, cpu_batch_hash_fn batch, cpu_ref_hash_fn ref, uint32_t count)
+{
+	struct cpu_lanes l;
+	uint32_t endiandata[20], vhash[8];
+	uint32_t bad = 0, first_bad = 0;
+
+	for(int k = 0; k < 20; k++)
+		endiandata[k] = 0x01010101U * (uint32_t)k;
+	if(!cpu_lanes_alloc(&l, count))
+		return false;
+
+	batch(&l, endiandata, 0x1000, count);
+	for(uint32_t i = 0; i < l.count; i++)
+	{
+		be32enc(&endiandata[19], l.nonce[i]);
+		ref(vhash, endiandata);
+		if(memcmp(vhash, &l.hash[i * 8], 32))
+		{
+			if(!bad++) first_bad = l.nonce[i];
+		}
+	}
+	if(bad || l.count != count)
+		printf("%12s: batch of %u, %u mismatch (nonce %08x)\n", name, count, bad, first_bad);
+	else
+		printf("%12s: batch of %u ok\n", name, count);
+	cpu_lanes_free(&l);
+	return bad == 0;
+}
+
+/**
+ * Compare the selected 64-byte kernels with sph (--cputest)
+ */
+bool cpu_kernels_selftest(uint32_t count)
+{
+	static const struct {
+		const char *name;
+		cpu_hash64_fn *fn;
+		cpu_hash64_fn ref;
+	} kernels[] = {
+		{ "blake512", &cpu_hash.blake512, sph_blake512_64 },
+		{ "bmw512", &cpu_hash.bmw512, sph_bmw512_64 },
+		{ "groestl512", &cpu_hash.groestl512, sph_groestl512_64 },
+		{ "skein512", &cpu_hash.skein512, sph_skein512_64 },
+		{ "jh512", &cpu_hash.jh512, sph_jh512_64 },
+		{ "keccak512", &cpu_hash.keccak512, sph_keccak512_64 },
+		{ "luffa512", &cpu_hash.luffa512, sph_luffa512_64 },
+		{ "cubehash512", &cpu_hash.cubehash512, sph_cubehash512_64 },
+		{ "luffa_cubehash512", &cpu_hash.luffa_cubehash512, sph_luffa_cubehash512_64 },
+		{ "shavite512", &cpu_hash.shavite512, sph_shavite512_64 },
+		{ "simd512", &cpu_hash.simd512, sph_simd512_64 },
+		{ "echo512", &cpu_hash.echo512, sph_echo512_64 },
+		{ "hamsi512", &cpu_hash.hamsi512, sph_hamsi512_64 },
+		{ "fugue512", &cpu_hash.fugue512, sph_fugue512_64 },
+		{ "shabal512", &cpu_hash.shabal512, sph_shabal512_64 },
+		{ "whirlpool", &cpu_hash.whirlpool, sph_whirlpool_64 },
+		{ "whirlpool1", &cpu_hash.whirlpool1, sph_whirlpool1_64 },
+		{ "sha512", &cpu_hash.sha512, sph_sha512_64 },
+		{ "haval256_5", &cpu_hash.haval256_5, sph_haval256_5_64 },
+		{ "sha256", &cpu_hash.sha256, sph_sha256_64 }
+	};
+	uint64_t *hash = (uint64_t *)aligned_calloc(count * 64);
+	uint64_t *ref = (uint64_t *)aligned_calloc(count * 64);
+	bool ok = true;
+
+	if(!hash || !ref)
+	{
+		if(hash) aligned_free(hash);
+		if(ref) aligned_free(ref);
+		return false;
+	}
+	for(size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); k++)
+	{
+		// only the kernels which replace sph
+		if(*kernels[k].fn == kernels[k].ref)
+			continue;
+		for(uint32_t i = 0; i < count * 8; i++)
+			ref[i] = hash[i] = 0x9e3779b97f4a7c15ULL * (i + 1) + k;
+		(*kernels[k].fn)(hash, count);
+		kernels[k].ref(ref, count);
+		uint32_t bad = 0;
+		for(uint32_t i = 0; i < count; i++)
+		{
+			if(memcmp(&hash[i * 8], &ref[i * 8], 64))
+				bad++;
+		}
+		if(bad)
+			printf("%12s: %u lanes, %u mismatch\n", kernels[k].name, count, bad);
+		else
+			printf("%12s: %u lanes ok\n", kernels[k].name, count);
+		ok = ok && !bad;
+	}
+	aligned_free(hash);
+	aligned_free(ref);
+	return ok;
+}
@@ -0,0 +1,116 @@
+#ifndef CPU_BATCH_H
+#define CPU_BATCH_H
+
+/**
+ * Batched CPU hashing with branch compaction
+ *
+ * The lanes of a batch are 64-byte hashes with their nonce. Before a
+ * data dependent branch (quark, jackpot...) the lanes are partitioned
+ * in two contiguous groups, like the GPU compactTest kernels do with
+ * their nonce lists, so each stage kernel always runs on full vectors.
+ * The order of the lanes is not kept, the nonce follows its hash.
+ */
+
+#include <stdint.h>
+
+struct cpu_lanes {
+	uint32_t count;
+	uint32_t max;
+	uint32_t *nonce;
+	uint64_t *hash;   /* 8 words per lane */
+	/* partition scratch */
+	uint32_t *nonce2;
+	uint64_t *hash2;
+	/* cpu_precalc_fn output for the current header, NULL if none */
+	const uint32_t *precalc;
+};
+
+/* in place hash of 'count' contiguous 64-byte lanes */
+typedef void (*cpu_hash64_fn)(uint64_t *hash, uint32_t count);
+/* hash of the 80-byte header (big endian words) with the nonce of each lane */
+typedef void (*cpu_hash80_fn)(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+/* once per header, the part of the hash shared by all the nonces (midstate...) */
+#define CPU_PRECALC_WORDS 32
+typedef void (*cpu_precalc_fn)(uint32_t *precalc, const uint32_t *endiandata);
+/* hash of the header from the cpu_precalc_fn output of its kernel set, with the nonce of each lane */
+typedef void (*cpu_hash80p_fn)(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count);
+
+/* stage kernels, the sph ones by default, replaced by cpu_batch_init() (cpu_kernels.h) */
+struct cpu_hash_kernels {
+	cpu_hash80_fn blake512_80;
+	cpu_hash80_fn keccak512_80;
+	cpu_hash80_fn keccak256_80;          /* 32-byte digest, the rest of the lane is kept */
+	cpu_hash80_fn whirlpool_80;
+	cpu_hash80_fn whirlpool1_80;
+	cpu_hash80_fn luffa512_80;
+	cpu_hash80_fn luffa_cubehash512_80;   /* luffa512_80 then cubehash512 */
+	cpu_hash80_fn groestl512_80;
+	cpu_hash64_fn blake512;
+	cpu_hash64_fn bmw512;
+	cpu_hash64_fn groestl512;
+	cpu_hash64_fn skein512;
+	cpu_hash64_fn jh512;
+	cpu_hash64_fn keccak512;
+	cpu_hash64_fn luffa512;
+	cpu_hash64_fn cubehash512;
+	cpu_hash64_fn luffa_cubehash512;   /* luffa512 then cubehash512 */
+	cpu_hash64_fn shavite512;
+	cpu_hash64_fn simd512;
+	cpu_hash64_fn echo512;
+	cpu_hash64_fn hamsi512;
+	cpu_hash64_fn fugue512;
+	cpu_hash64_fn shabal512;
+	cpu_hash64_fn whirlpool;
+	cpu_hash64_fn whirlpool1;   /* Whirlpool-T of whirlcoin */
+	cpu_hash64_fn sha512;
+	cpu_hash64_fn haval256_5;   /* 32-byte digest, the rest of the lane is kept */
+	cpu_hash64_fn sha256;       /* 32-byte digest, the rest of the lane is kept */
+	/* no sph form: NULL before cpu_batch_init(), every level sets them */
+	cpu_precalc_fn blake256_8_precalc;
+	cpu_precalc_fn blake256_14_precalc;
+	cpu_hash80p_fn blake256_8_80;    /* 32-byte digest, the rest of the lane is kept */
+	cpu_hash80p_fn blake256_14_80;
+	cpu_precalc_fn skein512_precalc;
+	cpu_hash80p_fn skein512_80;
+};
+extern struct cpu_hash_kernels cpu_hash;
+
+/* full algo on a batch, fills the lanes for [first_nonce, first_nonce+count) */
+typedef void (*cpu_batch_hash_fn)(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+/* reference (single) hash of the algo */
+typedef void (*cpu_ref_hash_fn)(void *state, const void *input);
+
+void cpu_batch_init(void);
+const char *cpu_batch_level(void);
+bool cpu_lanes_alloc(struct cpu_lanes *l, uint32_t max);
+void cpu_lanes_free(struct cpu_lanes *l);
+void cpu_lanes_set_nonces(struct cpu_lanes *l, uint32_t first_nonce, uint32_t count);
+uint32_t cpu_lanes_partition(struct cpu_lanes *l, int word, uint32_t mask);
+void cpu_lanes_branch(struct cpu_lanes *l, int word, uint32_t mask, cpu_hash64_fn if_set, cpu_hash64_fn if_clear);
+int cpu_lanes_check(const struct cpu_lanes *l, const uint32_t *ptarget, uint32_t *found, int max_found);
+bool cpu_batch_selftest(const char *name, cpu_batch_hash_fn batch, cpu_ref_hash_fn ref, uint32_t count);
+bool cpu_kernels_selftest(uint32_t count);
+
+void quark_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void jackpot_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void x11_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void c11_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void x13_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void x15_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void x17_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void whc_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void whirlpoolx_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void qubit_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void deep_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void doom_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void groestl_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void myriad_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void skein_cpu_precalc(uint32_t *precalc, const uint32_t *endiandata);
+void skein_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void keccak256_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void blake256_8_cpu_precalc(uint32_t *precalc, const uint32_t *endiandata);
+void blake256_8_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+void blake256_14_cpu_precalc(uint32_t *precalc, const uint32_t *endiandata);
+void blake256_14_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count);
+
+#endif
@@ -0,0 +1,321 @@
+/**
+ * Blake-256 (8 and 14 rounds) header kernels, one nonce per vector lane
+ *
+ * Like the PRECALC64 path of the GPU, the first 64 bytes of the header
+ * are compressed once per work into the midstate (set_block of the cpu
+ * backend, see cpu_precalc_fn). The first round of the second block is
+ * done there too, except what depends on the nonce: G0, G2, G3, the
+ * first half of G1 and the first addition of G6 and G7. An iteration
+ * then hashes 16, 8 or 4 nonces with AVX-512, AVX2 or SSE2, the rounds
+ * being unrolled by template for 8 (blakecoin, vanilla) and 14 (blake).
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+/* layout of the precalc words */
+#define BLAKE_PRE_H   0  /* midstate */
+#define BLAKE_PRE_M   8  /* data words 16..18 */
+#define BLAKE_PRE_V  16  /* state after the nonce independent part of round 0 */
+
+static constexpr uint8_t blake_sigma[10][16] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+	{ 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+	{ 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+	{  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+	{  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+	{  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+	{ 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+	{ 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+	{  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+	{ 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 }
+};
+
+static const uint32_t blake_c[16] = {
+	0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344,
+	0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89,
+	0x452821E6, 0x38D01377, 0xBE5466CF, 0x34E90C6C,
+	0xC0AC29B7, 0xC97C50DD, 0x3F84D5B5, 0xB5470917
+};
+
+static const uint32_t blake_iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+/* 32-bit lanes of the vector types, the same few operations on each */
+
+struct blake_x1 {
+	typedef uint32_t V;
+	enum { N = 1 };
+	static inline V set1(uint32_t a) { return a; }
+	static inline V load(const uint32_t *p) { return *p; }
+	static inline void store(uint32_t *p, V a) { *p = a; }
+	static inline V add(V a, V b) { return a + b; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	template<int n> static inline V rotr(V a) { return (a >> n) | (a << (32 - n)); }
+};
+
+#if defined(__AVX512F__)
+struct blake_x16 {
+	typedef __m512i V;
+	enum { N = 16 };
+	static inline V set1(uint32_t a) { return _mm512_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint32_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V add(V a, V b) { return _mm512_add_epi32(a, b); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	template<int n> static inline V rotr(V a) { return _mm512_ror_epi32(a, n); }
+};
+typedef blake_x16 blake_wide;
+#elif defined(__AVX2__)
+struct blake_x8 {
+	typedef __m256i V;
+	enum { N = 8 };
+	static inline V set1(uint32_t a) { return _mm256_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	template<int n> static inline V rotr(V a) { return _mm256_or_si256(_mm256_srli_epi32(a, n), _mm256_slli_epi32(a, 32 - n)); }
+};
+/* the byte rotations are a single shuffle */
+template<> inline __m256i blake_x8::rotr<16>(__m256i a)
+{
+	return _mm256_shuffle_epi8(a, _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+		2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+template<> inline __m256i blake_x8::rotr<8>(__m256i a)
+{
+	return _mm256_shuffle_epi8(a, _mm256_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12,
+		1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+}
+typedef blake_x8 blake_wide;
+#elif defined(__SSE2__)
+struct blake_x4 {
+	typedef __m128i V;
+	enum { N = 4 };
+	static inline V set1(uint32_t a) { return _mm_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm_storeu_si128((__m128i *)p, a); }
+	static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+	static inline V vxor(V a, V b) { return _mm_xor_si128(a, b); }
+	template<int n> static inline V rotr(V a) { return _mm_or_si128(_mm_srli_epi32(a, n), _mm_slli_epi32(a, 32 - n)); }
+};
+#if defined(__SSSE3__)
+template<> inline __m128i blake_x4::rotr<16>(__m128i a)
+{
+	return _mm_shuffle_epi8(a, _mm_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13));
+}
+template<> inline __m128i blake_x4::rotr<8>(__m128i a)
+{
+	return _mm_shuffle_epi8(a, _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12));
+}
+#endif
+typedef blake_x4 blake_wide;
+#else
+typedef blake_x1 blake_wide;
+#endif
+
+#define BLAKE_G_HALF1(W, a, b, c, d, x) do { \
+	a = W::add(a, W::add(b, x)); \
+	d = W::template rotr<16>(W::vxor(d, a)); \
+	c = W::add(c, d); \
+	b = W::template rotr<12>(W::vxor(b, c)); \
+} while(0)
+
+#define BLAKE_G_HALF2(W, a, b, c, d, x) do { \
+	a = W::add(a, W::add(b, x)); \
+	d = W::template rotr<8>(W::vxor(d, a)); \
+	c = W::add(c, d); \
+	b = W::template rotr<7>(W::vxor(b, c)); \
+} while(0)
+
+/*
+ * m[s] ^ c[s'] of each G of round r, mc[r][j] for the message word
+ * sigma[r][j]. The nonce (message word 3) is the only one which differs
+ * between the lanes, mc[] then holds c[s'] alone.
+ */
+template<class W, int s>
+static inline typename W::V blake_msg(uint32_t mc, typename W::V nonce)
+{
+	return s == 3 ? W::vxor(nonce, W::set1(mc)) : W::set1(mc);
+}
+
+#define BLAKE_G(W, r, i, a, b, c, d) do { \
+	BLAKE_G_HALF1(W, v[a], v[b], v[c], v[d], (blake_msg<W, blake_sigma[r % 10][2 * i]>(mc[r][2 * i], nonce))); \
+	BLAKE_G_HALF2(W, v[a], v[b], v[c], v[d], (blake_msg<W, blake_sigma[r % 10][2 * i + 1]>(mc[r][2 * i + 1], nonce))); \
+} while(0)
+
+template<class W, int r, int R>
+struct blake_rounds {
+	static inline void run(typename W::V *v, typename W::V nonce, const uint32_t (*mc)[16])
+	{
+		BLAKE_G(W, r, 0, 0, 4,  8, 12);
+		BLAKE_G(W, r, 1, 1, 5,  9, 13);
+		BLAKE_G(W, r, 2, 2, 6, 10, 14);
+		BLAKE_G(W, r, 3, 3, 7, 11, 15);
+		BLAKE_G(W, r, 4, 0, 5, 10, 15);
+		BLAKE_G(W, r, 5, 1, 6, 11, 12);
+		BLAKE_G(W, r, 6, 2, 7,  8, 13);
+		BLAKE_G(W, r, 7, 3, 4,  9, 14);
+		blake_rounds<W, r + 1, R>::run(v, nonce, mc);
+	}
+};
+
+template<class W, int R>
+struct blake_rounds<W, R, R> {
+	static inline void run(typename W::V *, typename W::V, const uint32_t (*)[16]) {}
+};
+
+/* the second block of W::N nonces, the 8 words of each hash to 'out' (stride 16) */
+template<class W, int R>
+static inline void blake256_lanes(uint32_t *out, const uint32_t *pre, const uint32_t (*mc)[16], const uint32_t *pnonce)
+{
+	typedef typename W::V V;
+	const V nonce = W::load(pnonce);
+	V v[16];
+	uint32_t h[8][W::N];
+
+	for(int k = 0; k < 16; k++)
+		v[k] = W::set1(pre[BLAKE_PRE_V + k]);
+
+	// end of round 0: second half of G1, G4..G7 (v2 and v3 already added)
+	BLAKE_G_HALF2(W, v[1], v[5], v[9], v[13], W::vxor(nonce, W::set1(mc[0][3])));
+	BLAKE_G_HALF1(W, v[0], v[5], v[10], v[15], W::set1(mc[0][8]));
+	BLAKE_G_HALF2(W, v[0], v[5], v[10], v[15], W::set1(mc[0][9]));
+	BLAKE_G_HALF1(W, v[1], v[6], v[11], v[12], W::set1(mc[0][10]));
+	BLAKE_G_HALF2(W, v[1], v[6], v[11], v[12], W::set1(mc[0][11]));
+	v[13] = W::template rotr<16>(W::vxor(v[13], v[2]));
+	v[8] = W::add(v[8], v[13]);
+	v[7] = W::template rotr<12>(W::vxor(v[7], v[8]));
+	BLAKE_G_HALF2(W, v[2], v[7], v[8], v[13], W::set1(mc[0][13]));
+	v[14] = W::template rotr<16>(W::vxor(v[14], v[3]));
+	v[9] = W::add(v[9], v[14]);
+	v[4] = W::template rotr<12>(W::vxor(v[4], v[9]));
+	BLAKE_G_HALF2(W, v[3], v[4], v[9], v[14], W::set1(mc[0][15]));
+
+	blake_rounds<W, 1, R>::run(v, nonce, mc);
+
+	for(int k = 0; k < 8; k++)
+		W::store(h[k], W::vxor(W::set1(pre[BLAKE_PRE_H + k]), W::vxor(v[k], v[k + 8])));
+	for(int j = 0; j < W::N; j++)
+	{
+		for(int k = 0; k < 8; k++)
+			out[j * 16 + k] = swab32(h[k][j]);
+	}
+}
+
+/* scalar compression of a full block, for the midstate */
+static void blake256_compress(uint32_t *h, const uint32_t *m, uint32_t t0, int rounds)
+{
+	uint32_t v[16];
+
+	memcpy(v, h, 32);
+	memcpy(v + 8, blake_c, 32);
+	v[12] ^= t0;
+	v[13] ^= t0;
+	for(int r = 0; r < rounds; r++)
+	{
+		static const uint8_t g[8][4] = {
+			{ 0, 4, 8, 12 }, { 1, 5, 9, 13 }, { 2, 6, 10, 14 }, { 3, 7, 11, 15 },
+			{ 0, 5, 10, 15 }, { 1, 6, 11, 12 }, { 2, 7, 8, 13 }, { 3, 4, 9, 14 }
+		};
+		const uint8_t *s = blake_sigma[r % 10];
+		for(int i = 0; i < 8; i++)
+		{
+			uint32_t &a = v[g[i][0]], &b = v[g[i][1]], &c = v[g[i][2]], &d = v[g[i][3]];
+			BLAKE_G_HALF1(blake_x1, a, b, c, d, m[s[2 * i]] ^ blake_c[s[2 * i + 1]]);
+			BLAKE_G_HALF2(blake_x1, a, b, c, d, m[s[2 * i + 1]] ^ blake_c[s[2 * i]]);
+		}
+	}
+	for(int k = 0; k < 8; k++)
+		h[k] ^= v[k] ^ v[k + 8];
+}
+
+/* midstate and nonce independent part of round 0, once per header */
+static void blake256_precalc(uint32_t *pre, const uint32_t *endiandata, int rounds)
+{
+	uint32_t m[16], *h = &pre[BLAKE_PRE_H], *v = &pre[BLAKE_PRE_V];
+
+	memset(pre, 0, CPU_PRECALC_WORDS * sizeof(uint32_t));
+	for(int k = 0; k < 16; k++)
+		m[k] = swab32(endiandata[k]);
+	memcpy(h, blake_iv, 32);
+	blake256_compress(h, m, 512, rounds);
+	for(int k = 0; k < 3; k++)
+		pre[BLAKE_PRE_M + k] = swab32(endiandata[16 + k]);
+
+	// second block: data 16..18, nonce, padding and the 640 bits length
+	memset(m, 0, sizeof(m));
+	memcpy(m, &pre[BLAKE_PRE_M], 12);
+	m[4] = 0x80000000;
+	m[13] = 1;
+	m[15] = 640;
+	memcpy(v, h, 32);
+	memcpy(v + 8, blake_c, 32);
+	v[12] ^= 640;
+	v[13] ^= 640;
+	BLAKE_G_HALF1(blake_x1, v[0], v[4], v[8], v[12], m[0] ^ blake_c[1]);
+	BLAKE_G_HALF2(blake_x1, v[0], v[4], v[8], v[12], m[1] ^ blake_c[0]);
+	BLAKE_G_HALF1(blake_x1, v[1], v[5], v[9], v[13], m[2] ^ blake_c[3]);
+	BLAKE_G_HALF1(blake_x1, v[2], v[6], v[10], v[14], m[4] ^ blake_c[5]);
+	BLAKE_G_HALF2(blake_x1, v[2], v[6], v[10], v[14], m[5] ^ blake_c[4]);
+	BLAKE_G_HALF1(blake_x1, v[3], v[7], v[11], v[15], m[6] ^ blake_c[7]);
+	BLAKE_G_HALF2(blake_x1, v[3], v[7], v[11], v[15], m[7] ^ blake_c[6]);
+	v[2] += v[7] + (m[12] ^ blake_c[13]);
+	v[3] += v[4] + (m[14] ^ blake_c[15]);
+}
+
+/* the 32-byte hash of each nonce, the rest of the lane is kept */
+template<int R>
+static void blake256_80(uint64_t *hash, const uint32_t *pre, const uint32_t *nonce, uint32_t count)
+{
+	uint32_t mc[R][16], m[16] = { 0 };
+	uint32_t *out = (uint32_t *)hash;
+	uint32_t i = 0;
+
+	memcpy(m, &pre[BLAKE_PRE_M], 12);
+	m[4] = 0x80000000;
+	m[13] = 1;
+	m[15] = 640;
+	for(int r = 0; r < R; r++)
+	{
+		for(int j = 0; j < 16; j++)
+			mc[r][j] = m[blake_sigma[r % 10][j]] ^ blake_c[blake_sigma[r % 10][j ^ 1]];
+	}
+
+	for(; i + blake_wide::N <= count; i += blake_wide::N)
+		blake256_lanes<blake_wide, R>(&out[i * 16], pre, mc, &nonce[i]);
+	for(; i < count; i++)
+		blake256_lanes<blake_x1, R>(&out[i * 16], pre, mc, &nonce[i]);
+}
+
+void vec_blake256_8_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	blake256_precalc(precalc, endiandata, 8);
+}
+
+void vec_blake256_14_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	blake256_precalc(precalc, endiandata, 14);
+}
+
+void vec_blake256_8_80(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count)
+{
+	blake256_80<8>(hash, precalc, nonce, count);
+}
+
+void vec_blake256_14_80(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count)
+{
+	blake256_80<14>(hash, precalc, nonce, count);
+}
+
+} // namespace CPU_ISA
@@ -0,0 +1,24 @@
+/**
+ * Groestlcoin (and Diamond) and Myriad-Groestl on the cpu, batched
+ *
+ * Both start with Groestl-512 of the header: groestlhash() runs a second
+ * groestl512, myriadhash() a SHA-256 of the 64-byte hash.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void groestl_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.groestl512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.groestl512(l->hash, l->count);
+}
+
+void myriad_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.groestl512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.sha256(l->hash, l->count);
+}
@@ -0,0 +1,331 @@
+/**
+ * Hamsi-512 of the 64-byte lanes with vector arithmetic (see cpu_batch.h)
+ *
+ * sph expands each 8-byte message block with eight 256-entry tables of
+ * 16 words, 128 KB in sph/hamsi_helper.c, indexed by the message bytes.
+ * The expansion is linear, so here it is the xor of the rows of the
+ * 64-entry table (4 KB, the SPH_HAMSI_EXPAND_BIG 1 form of the same
+ * file) selected by the message bits, with a vector mask per bit. The
+ * table is read in order for all the lanes, whatever the data. The
+ * rounds work on 32-bit words, one lane of 4 (SSE2), 8 (AVX2) or 16
+ * (AVX-512) per vector element, a single lane uses scalar rounds. The
+ * padding and the length blocks are the same for all 64-byte messages,
+ * their expansion is a table row.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+extern "C"
+{
+#include "sph/sph_hamsi.h"
+}
+
+namespace CPU_ISA {
+
+/* the one bit per row tables only: T512[64][16] (and T256) */
+#define SPH_HAMSI_EXPAND_SMALL 1
+#define SPH_HAMSI_EXPAND_BIG   1
+#include "sph/hamsi_helper.c"
+
+/* rows of T512 of the padding block (0x80) and of the length (512 bits) */
+#define HAMSI_PAD_ROW  7
+#define HAMSI_LEN_ROW  49
+
+static const uint32_t hamsi_iv512[16] = {
+	0x73746565, 0x6c706172, 0x6b204172, 0x656e6265,
+	0x72672031, 0x302c2062, 0x75732032, 0x3434362c,
+	0x20422d33, 0x30303120, 0x4c657576, 0x656e2d48,
+	0x65766572, 0x6c65652c, 0x2042656c, 0x6769756d
+};
+
+static const uint32_t hamsi_alpha_n[32] = {
+	0xff00f0f0, 0xccccaaaa, 0xf0f0cccc, 0xff00aaaa,
+	0xccccaaaa, 0xf0f0ff00, 0xaaaacccc, 0xf0f0ff00,
+	0xf0f0cccc, 0xaaaaff00, 0xccccff00, 0xaaaaf0f0,
+	0xaaaaf0f0, 0xff00cccc, 0xccccf0f0, 0xff00aaaa,
+	0xccccaaaa, 0xff00f0f0, 0xff00aaaa, 0xf0f0cccc,
+	0xf0f0ff00, 0xccccaaaa, 0xf0f0ff00, 0xaaaacccc,
+	0xaaaaff00, 0xf0f0cccc, 0xaaaaf0f0, 0xccccff00,
+	0xff00cccc, 0xaaaaf0f0, 0xff00aaaa, 0xccccf0f0
+};
+
+static const uint32_t hamsi_alpha_f[32] = {
+	0xcaf9639c, 0x0ff0f9c0, 0x639c0ff0, 0xcaf9f9c0,
+	0x0ff0f9c0, 0x639ccaf9, 0xf9c00ff0, 0x639ccaf9,
+	0x639c0ff0, 0xf9c0caf9, 0x0ff0caf9, 0xf9c0639c,
+	0xf9c0639c, 0xcaf90ff0, 0x0ff0639c, 0xcaf9f9c0,
+	0x0ff0f9c0, 0xcaf9639c, 0xcaf9f9c0, 0x639c0ff0,
+	0x639ccaf9, 0x0ff0f9c0, 0x639ccaf9, 0xf9c00ff0,
+	0xf9c0caf9, 0x639c0ff0, 0xf9c0639c, 0x0ff0caf9,
+	0xcaf90ff0, 0xf9c0639c, 0xcaf9f9c0, 0x0ff0639c
+};
+
+/* place of the expanded message (m) and of the chaining value (c) in the state */
+static const uint8_t hamsi_m_pos[16] = {
+	0x00, 0x01, 0x04, 0x05, 0x0A, 0x0B, 0x0E, 0x0F,
+	0x10, 0x11, 0x14, 0x15, 0x1A, 0x1B, 0x1E, 0x1F
+};
+static const uint8_t hamsi_c_pos[16] = {
+	0x02, 0x03, 0x06, 0x07, 0x08, 0x09, 0x0C, 0x0D,
+	0x12, 0x13, 0x16, 0x17, 0x18, 0x19, 0x1C, 0x1D
+};
+
+/*
+ * 32-bit lanes of the vector types, the same few operations on each;
+ * expand() xors into m[16] the rows t[b] of the bits b set in x
+ */
+
+#if defined(__SSE2__)
+/* a single lane, the 16 words of a row in four SSE2 vectors for the expansion */
+struct hamsi_x1 {
+	typedef uint32_t V;
+	enum { N = 1 };
+	static inline V set1(uint32_t a) { return a; }
+	static inline V load(const uint32_t *p) { return *p; }
+	static inline void store(uint32_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V vand(V a, V b) { return a & b; }
+	static inline V vor(V a, V b) { return a | b; }
+	static inline V vnot(V a) { return ~a; }
+	template<int n> static inline V rotl(V a) { return (a << n) | (a >> (32 - n)); }
+	template<int n> static inline V shl(V a) { return a << n; }
+	static inline void expand(V *m, V x, const uint32_t (*t)[16])
+	{
+		__m128i acc[4];
+		for(int q = 0; q < 4; q++)
+			acc[q] = _mm_loadu_si128((const __m128i *)&m[4 * q]);
+		for(int b = 0; b < 32; b++, x >>= 1)
+		{
+			const __m128i k = _mm_set1_epi32(-(int)(x & 1));
+			for(int q = 0; q < 4; q++)
+				acc[q] = _mm_xor_si128(acc[q], _mm_and_si128(k, _mm_loadu_si128((const __m128i *)&t[b][4 * q])));
+		}
+		for(int q = 0; q < 4; q++)
+			_mm_storeu_si128((__m128i *)&m[4 * q], acc[q]);
+	}
+};
+#endif
+
+#if defined(__AVX512F__)
+struct hamsi_x16 {
+	typedef __m512i V;
+	enum { N = 16 };
+	static inline V set1(uint32_t a) { return _mm512_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint32_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V vand(V a, V b) { return _mm512_and_si512(a, b); }
+	static inline V vor(V a, V b) { return _mm512_or_si512(a, b); }
+	static inline V vnot(V a) { return _mm512_ternarylogic_epi32(a, a, a, 0x55); }
+	template<int n> static inline V rotl(V a) { return _mm512_rol_epi32(a, n); }
+	template<int n> static inline V shl(V a) { return _mm512_slli_epi32(a, n); }
+	static inline void expand(V *m, V x, const uint32_t (*t)[16])
+	{
+		for(int b = 0; b < 32; b++)
+		{
+			const __mmask16 k = _mm512_test_epi32_mask(x, set1(1U << b));
+			for(int i = 0; i < 16; i++)
+				m[i] = _mm512_mask_xor_epi32(m[i], k, m[i], set1(t[b][i]));
+		}
+	}
+};
+typedef hamsi_x16 hamsi_wide;
+#elif defined(__AVX2__)
+struct hamsi_x8 {
+	typedef __m256i V;
+	enum { N = 8 };
+	static inline V set1(uint32_t a) { return _mm256_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V vand(V a, V b) { return _mm256_and_si256(a, b); }
+	static inline V vor(V a, V b) { return _mm256_or_si256(a, b); }
+	static inline V vnot(V a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+	template<int n> static inline V rotl(V a) { return _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n)); }
+	template<int n> static inline V shl(V a) { return _mm256_slli_epi32(a, n); }
+	/* from the top bit down, its sign gives the mask */
+	static inline void expand(V *m, V x, const uint32_t (*t)[16])
+	{
+		for(int b = 31; b >= 0; b--)
+		{
+			const V k = _mm256_srai_epi32(x, 31);
+			x = _mm256_add_epi32(x, x);
+			for(int i = 0; i < 16; i++)
+				m[i] = vxor(m[i], vand(k, set1(t[b][i])));
+		}
+	}
+};
+typedef hamsi_x8 hamsi_wide;
+#elif defined(__SSE2__)
+struct hamsi_x4 {
+	typedef __m128i V;
+	enum { N = 4 };
+	static inline V set1(uint32_t a) { return _mm_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm_storeu_si128((__m128i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm_xor_si128(a, b); }
+	static inline V vand(V a, V b) { return _mm_and_si128(a, b); }
+	static inline V vor(V a, V b) { return _mm_or_si128(a, b); }
+	static inline V vnot(V a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+	template<int n> static inline V rotl(V a) { return _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - n)); }
+	template<int n> static inline V shl(V a) { return _mm_slli_epi32(a, n); }
+	static inline void expand(V *m, V x, const uint32_t (*t)[16])
+	{
+		for(int b = 31; b >= 0; b--)
+		{
+			const V k = _mm_srai_epi32(x, 31);
+			x = _mm_add_epi32(x, x);
+			for(int i = 0; i < 16; i++)
+				m[i] = vxor(m[i], vand(k, set1(t[b][i])));
+		}
+	}
+};
+typedef hamsi_x4 hamsi_wide;
+#endif
+
+#if defined(CPU_BATCH_HAMSI)
+
+/* SBOX and L of sph/hamsi.c */
+template<class W>
+static inline void hamsi_sbox(typename W::V &a, typename W::V &b, typename W::V &c, typename W::V &d)
+{
+	typename W::V t = a;
+	a = W::vand(a, c);
+	a = W::vxor(a, d);
+	c = W::vxor(W::vxor(c, b), a);
+	d = W::vxor(W::vor(d, t), b);
+	t = W::vxor(t, c);
+	b = d;
+	d = W::vxor(W::vor(d, t), a);
+	a = W::vand(a, b);
+	t = W::vxor(t, a);
+	b = W::vxor(W::vxor(b, d), t);
+	a = c;
+	c = b;
+	b = d;
+	d = W::vnot(t);
+}
+
+template<class W>
+static inline void hamsi_l(typename W::V &a, typename W::V &b, typename W::V &c, typename W::V &d)
+{
+	a = W::template rotl<13>(a);
+	c = W::template rotl<3>(c);
+	b = W::vxor(b, W::vxor(a, c));
+	d = W::vxor(d, W::vxor(c, W::template shl<3>(a)));
+	b = W::template rotl<1>(b);
+	d = W::template rotl<7>(d);
+	a = W::vxor(a, W::vxor(b, d));
+	c = W::vxor(c, W::vxor(d, W::template shl<7>(b)));
+	a = W::template rotl<5>(a);
+	c = W::template rotl<22>(c);
+}
+
+template<class W>
+static inline void hamsi_round(typename W::V *s, uint32_t rc, const uint32_t *alpha)
+{
+	for(int i = 0; i < 32; i++)
+		s[i] = W::vxor(s[i], W::set1(i == 1 ? alpha[i] ^ rc : alpha[i]));
+	for(int i = 0; i < 8; i++)
+		hamsi_sbox<W>(s[i], s[i + 0x08], s[i + 0x10], s[i + 0x18]);
+	hamsi_l<W>(s[0x00], s[0x09], s[0x12], s[0x1B]);
+	hamsi_l<W>(s[0x01], s[0x0A], s[0x13], s[0x1C]);
+	hamsi_l<W>(s[0x02], s[0x0B], s[0x14], s[0x1D]);
+	hamsi_l<W>(s[0x03], s[0x0C], s[0x15], s[0x1E]);
+	hamsi_l<W>(s[0x04], s[0x0D], s[0x16], s[0x1F]);
+	hamsi_l<W>(s[0x05], s[0x0E], s[0x17], s[0x18]);
+	hamsi_l<W>(s[0x06], s[0x0F], s[0x10], s[0x19]);
+	hamsi_l<W>(s[0x07], s[0x08], s[0x11], s[0x1A]);
+	hamsi_l<W>(s[0x00], s[0x02], s[0x05], s[0x07]);
+	hamsi_l<W>(s[0x10], s[0x13], s[0x15], s[0x16]);
+	hamsi_l<W>(s[0x09], s[0x0B], s[0x0C], s[0x0E]);
+	hamsi_l<W>(s[0x19], s[0x1A], s[0x1C], s[0x1F]);
+}
+
+/* one block: 6 rounds (P), 12 for the length block (PF), then the feedforward */
+template<class W>
+static inline void hamsi_block(typename W::V *c, const typename W::V *m, const uint32_t *alpha, int rounds)
+{
+	typename W::V s[32];
+
+	for(int i = 0; i < 16; i++)
+	{
+		s[hamsi_m_pos[i]] = m[i];
+		s[hamsi_c_pos[i]] = c[i];
+	}
+	for(int r = 0; r < rounds; r++)
+		hamsi_round<W>(s, (uint32_t)r, alpha);
+	for(int i = 0; i < 8; i++)
+	{
+		c[i] = W::vxor(c[i], s[i]);
+		c[i + 8] = W::vxor(c[i + 8], s[i + 0x10]);
+	}
+}
+
+/* the 8 message blocks of W::N lanes, then the padding and the length */
+template<class W>
+static inline void hamsi_64_lanes(uint64_t *hash)
+{
+	typedef typename W::V V;
+	uint32_t lo[W::N], hi[W::N], out[16][W::N];
+	V c[16], m[16];
+
+	for(int i = 0; i < 16; i++)
+		c[i] = W::set1(hamsi_iv512[i]);
+	for(int k = 0; k < 8; k++)
+	{
+		for(int j = 0; j < W::N; j++)
+		{
+			lo[j] = (uint32_t)hash[j * 8 + k];
+			hi[j] = (uint32_t)(hash[j * 8 + k] >> 32);
+		}
+		for(int i = 0; i < 16; i++)
+			m[i] = W::set1(0);
+		W::expand(m, W::load(lo), &T512[0]);
+		W::expand(m, W::load(hi), &T512[32]);
+		hamsi_block<W>(c, m, hamsi_alpha_n, 6);
+	}
+	for(int i = 0; i < 16; i++)
+		m[i] = W::set1(T512[HAMSI_PAD_ROW][i]);
+	hamsi_block<W>(c, m, hamsi_alpha_n, 6);
+	for(int i = 0; i < 16; i++)
+		m[i] = W::set1(T512[HAMSI_LEN_ROW][i]);
+	hamsi_block<W>(c, m, hamsi_alpha_f, 12);
+
+	// the digest is the big endian chaining value
+	for(int i = 0; i < 16; i++)
+		W::store(out[i], c[i]);
+	for(int j = 0; j < W::N; j++)
+	{
+		for(int k = 0; k < 8; k++)
+			hash[j * 8 + k] = swab32(out[2 * k][j]) | ((uint64_t)swab32(out[2 * k + 1][j]) << 32);
+	}
+}
+
+void vec_hamsi512_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for(; i + hamsi_wide::N <= count; i += hamsi_wide::N)
+		hamsi_64_lanes<hamsi_wide>(&hash[i * 8]);
+	if(count - i > 1)
+	{
+		// the leftover lanes in a partial vector
+		uint64_t t[hamsi_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		hamsi_64_lanes<hamsi_wide>(t);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		hamsi_64_lanes<hamsi_x1>(&hash[i * 8]);
+}
+
+#endif
+
+} // namespace CPU_ISA
@@ -0,0 +1,243 @@
+/**
+ * HAVAL-256/5 of the 64-byte lanes with vector arithmetic (see cpu_batch.h)
+ *
+ * A 64-byte message and its padding fill a single 128-byte block: the
+ * words 16 to 31 are the same for all the lanes (0x01, zeros, the pass
+ * count and output size, the length of 512 bits). The 5 passes of 32
+ * steps work on 32-bit words, one lane of 8 (AVX2) or 16 (AVX-512) per
+ * vector element, a single lane uses the same code on scalars.
+ *
+ * The digest is 32 bytes, the upper half of the lane is kept as
+ * sph_haval256_5 leaves it.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+static const uint32_t haval_iv[8] = {
+	0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344,
+	0xA4093822, 0x299F31D0, 0x082EFA98, 0xEC4E6C89
+};
+
+/* words 16 to 31 of the block of a 64-byte message */
+static const uint32_t haval_pad[16] = {
+	0x00000001, 0, 0, 0, 0, 0, 0, 0,
+	0, 0, 0, 0, 0, 0x40290000, 512, 0
+};
+
+/* order of the message words in the passes (MP2 to MP5 of sph/haval.c) */
+static const uint8_t haval_mp[5][32] = {
+	{  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15,
+	  16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31 },
+	{  5, 14, 26, 18, 11, 28,  7, 16,  0, 23, 20, 22,  1, 10,  4,  8,
+	  30,  3, 21,  9, 17, 24, 29,  6, 19, 12, 15, 13,  2, 25, 31, 27 },
+	{ 19,  9,  4, 20, 28, 17,  8, 22, 29, 14, 25, 12, 24, 30, 16, 26,
+	  31, 15,  7,  3,  1,  0, 18, 27, 13,  6, 21, 10, 23, 11,  5,  2 },
+	{ 24,  4,  0, 14,  2,  7, 28, 23, 26,  6, 30, 20, 18, 25, 19,  3,
+	  22, 11, 31, 21,  8, 27, 12,  9,  1, 29,  5, 15, 17, 10, 16, 13 },
+	{ 27,  3, 21, 26, 17, 11, 20, 29, 19,  0, 12,  7, 13,  8, 31, 10,
+	   5,  9, 14, 30, 18,  6, 28, 24,  2, 23, 16, 22,  4,  1, 25, 15 }
+};
+
+/* step constants, none in the first pass */
+static const uint32_t haval_rk[5][32] = {
+	{ 0 },
+	{ 0x452821E6, 0x38D01377, 0xBE5466CF, 0x34E90C6C, 0xC0AC29B7, 0xC97C50DD, 0x3F84D5B5, 0xB5470917,
+	  0x9216D5D9, 0x8979FB1B, 0xD1310BA6, 0x98DFB5AC, 0x2FFD72DB, 0xD01ADFB7, 0xB8E1AFED, 0x6A267E96,
+	  0xBA7C9045, 0xF12C7F99, 0x24A19947, 0xB3916CF7, 0x0801F2E2, 0x858EFC16, 0x636920D8, 0x71574E69,
+	  0xA458FEA3, 0xF4933D7E, 0x0D95748F, 0x728EB658, 0x718BCD58, 0x82154AEE, 0x7B54A41D, 0xC25A59B5 },
+	{ 0x9C30D539, 0x2AF26013, 0xC5D1B023, 0x286085F0, 0xCA417918, 0xB8DB38EF, 0x8E79DCB0, 0x603A180E,
+	  0x6C9E0E8B, 0xB01E8A3E, 0xD71577C1, 0xBD314B27, 0x78AF2FDA, 0x55605C60, 0xE65525F3, 0xAA55AB94,
+	  0x57489862, 0x63E81440, 0x55CA396A, 0x2AAB10B6, 0xB4CC5C34, 0x1141E8CE, 0xA15486AF, 0x7C72E993,
+	  0xB3EE1411, 0x636FBC2A, 0x2BA9C55D, 0x741831F6, 0xCE5C3E16, 0x9B87931E, 0xAFD6BA33, 0x6C24CF5C },
+	{ 0x7A325381, 0x28958677, 0x3B8F4898, 0x6B4BB9AF, 0xC4BFE81B, 0x66282193, 0x61D809CC, 0xFB21A991,
+	  0x487CAC60, 0x5DEC8032, 0xEF845D5D, 0xE98575B1, 0xDC262302, 0xEB651B88, 0x23893E81, 0xD396ACC5,
+	  0x0F6D6FF3, 0x83F44239, 0x2E0B4482, 0xA4842004, 0x69C8F04A, 0x9E1F9B5E, 0x21C66842, 0xF6E96C9A,
+	  0x670C9C61, 0xABD388F0, 0x6A51A0D2, 0xD8542F68, 0x960FA728, 0xAB5133A3, 0x6EEF0B6C, 0x137A3BE4 },
+	{ 0xBA3BF050, 0x7EFB2A98, 0xA1F1651D, 0x39AF0176, 0x66CA593E, 0x82430E88, 0x8CEE8619, 0x456F9FB4,
+	  0x7D84A5C3, 0x3B8B5EBE, 0xE06F75D8, 0x85C12073, 0x401A449F, 0x56C16AA6, 0x4ED3AA62, 0x363F7706,
+	  0x1BFEDF72, 0x429B023D, 0x37D0D724, 0xD00A1248, 0xDB0FEAD3, 0x49F1C09B, 0x075372C9, 0x80991B7B,
+	  0x25D479D8, 0xF6E8DEF7, 0xE3FE501A, 0xB6794C3B, 0x976CE0BD, 0x04C006BA, 0xC1A94FB6, 0x409F60C4 }
+};
+
+/* 32-bit lanes of the vector types */
+
+struct haval_x1 {
+	typedef uint32_t V;
+	enum { N = 1 };
+	static inline V set1(uint32_t a) { return a; }
+	static inline V load(const uint32_t *p) { return *p; }
+	static inline void store(uint32_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V vand(V a, V b) { return a & b; }
+	static inline V vor(V a, V b) { return a | b; }
+	static inline V andnot(V a, V b) { return ~a & b; }
+	static inline V add(V a, V b) { return a + b; }
+	template<int n> static inline V rotr(V a) { return (a >> n) | (a << (32 - n)); }
+};
+
+#if defined(__AVX512F__)
+struct haval_x16 {
+	typedef __m512i V;
+	enum { N = 16 };
+	static inline V set1(uint32_t a) { return _mm512_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint32_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V vand(V a, V b) { return _mm512_and_si512(a, b); }
+	static inline V vor(V a, V b) { return _mm512_or_si512(a, b); }
+	static inline V andnot(V a, V b) { return _mm512_andnot_si512(a, b); }
+	static inline V add(V a, V b) { return _mm512_add_epi32(a, b); }
+	template<int n> static inline V rotr(V a) { return _mm512_ror_epi32(a, n); }
+};
+typedef haval_x16 haval_wide;
+#elif defined(__AVX2__)
+struct haval_x8 {
+	typedef __m256i V;
+	enum { N = 8 };
+	static inline V set1(uint32_t a) { return _mm256_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V vand(V a, V b) { return _mm256_and_si256(a, b); }
+	static inline V vor(V a, V b) { return _mm256_or_si256(a, b); }
+	static inline V andnot(V a, V b) { return _mm256_andnot_si256(a, b); }
+	static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+	template<int n> static inline V rotr(V a) { return _mm256_or_si256(_mm256_srli_epi32(a, n), _mm256_slli_epi32(a, 32 - n)); }
+};
+typedef haval_x8 haval_wide;
+#endif
+
+#if defined(CPU_BATCH_HAVAL)
+
+/*
+ * The boolean functions of the 5 passes with the phi permutations of
+ * HAVAL-x/5 (FP5_1 to FP5_5 of sph/haval.c), x6 .. x0 are the state
+ * words in step order.
+ */
+template<class W, int p>
+static inline typename W::V haval_f(typename W::V x6, typename W::V x5, typename W::V x4, typename W::V x3,
+	typename W::V x2, typename W::V x1, typename W::V x0)
+{
+	typedef typename W::V V;
+	V a6, a5, a4, a3, a2, a1, a0;
+
+	switch(p)
+	{
+	case 0:   // F1(x3, x4, x1, x0, x5, x2, x6)
+		a6 = x3; a5 = x4; a4 = x1; a3 = x0; a2 = x5; a1 = x2; a0 = x6;
+		return W::vxor(W::vxor(W::vand(a1, W::vxor(a0, a4)), W::vand(a2, a5)), W::vxor(W::vand(a3, a6), a0));
+	case 1:   // F2(x6, x2, x1, x0, x3, x4, x5)
+		a6 = x6; a5 = x2; a4 = x1; a3 = x0; a2 = x3; a1 = x4; a0 = x5;
+		return W::vxor(W::vxor(W::vand(a2, W::vxor(W::vxor(W::andnot(a3, a1), W::vand(a4, a5)), W::vxor(a6, a0))),
+			W::vand(a4, W::vxor(a1, a5))), W::vxor(W::vand(a3, a5), a0));
+	case 2:   // F3(x2, x6, x0, x4, x3, x1, x5)
+		a6 = x2; a5 = x6; a4 = x0; a3 = x4; a2 = x3; a1 = x1; a0 = x5;
+		return W::vxor(W::vxor(W::vand(a3, W::vxor(W::vand(a1, a2), W::vxor(a6, a0))), W::vand(a1, a4)),
+			W::vxor(W::vand(a2, a5), a0));
+	case 3:   // F4(x1, x5, x3, x2, x0, x4, x6)
+		a6 = x1; a5 = x5; a4 = x3; a3 = x2; a2 = x0; a1 = x4; a0 = x6;
+		return W::vxor(W::vxor(W::vand(a3, W::vxor(W::vxor(W::vand(a1, a2), W::vor(a4, a6)), a5)),
+			W::vand(a4, W::vxor(W::vxor(W::andnot(a2, a5), a1), W::vxor(a6, a0)))), W::vxor(W::vand(a2, a6), a0));
+	default:  // F5(x2, x5, x0, x6, x4, x3, x1)
+		a6 = x2; a5 = x5; a4 = x0; a3 = x6; a2 = x4; a1 = x3; a0 = x1;
+		return W::vxor(W::vxor(W::andnot(W::vxor(W::vand(W::vand(a1, a2), a3), a5), a0), W::vand(a1, a4)),
+			W::vxor(W::vand(a2, a5), W::vand(a3, a6)));
+	}
+}
+
+/* step k of a group of 8, x7 is s[7 - k] and the roles rotate by one each step */
+template<class W, int p>
+static inline void haval_step(typename W::V *s, int k, typename W::V w)
+{
+	typedef typename W::V V;
+	V t = haval_f<W, p>(s[(6 - k) & 7], s[(5 - k) & 7], s[(4 - k) & 7], s[(3 - k) & 7],
+		s[(2 - k) & 7], s[(1 - k) & 7], s[(0 - k) & 7]);
+	V &x7 = s[(7 - k) & 7];
+	x7 = W::add(W::add(W::template rotr<7>(t), W::template rotr<11>(x7)), w);
+}
+
+template<class W, int p>
+static inline void haval_pass(typename W::V *s, const typename W::V *m)
+{
+	const uint8_t *mp = haval_mp[p];
+	const uint32_t *rk = haval_rk[p];
+
+	for(int i = 0; i < 32; i += 8)
+	{
+		haval_step<W, p>(s, 0, W::add(m[mp[i + 0]], W::set1(rk[i + 0])));
+		haval_step<W, p>(s, 1, W::add(m[mp[i + 1]], W::set1(rk[i + 1])));
+		haval_step<W, p>(s, 2, W::add(m[mp[i + 2]], W::set1(rk[i + 2])));
+		haval_step<W, p>(s, 3, W::add(m[mp[i + 3]], W::set1(rk[i + 3])));
+		haval_step<W, p>(s, 4, W::add(m[mp[i + 4]], W::set1(rk[i + 4])));
+		haval_step<W, p>(s, 5, W::add(m[mp[i + 5]], W::set1(rk[i + 5])));
+		haval_step<W, p>(s, 6, W::add(m[mp[i + 6]], W::set1(rk[i + 6])));
+		haval_step<W, p>(s, 7, W::add(m[mp[i + 7]], W::set1(rk[i + 7])));
+	}
+}
+
+/* W::N contiguous lanes */
+template<class W>
+static inline void haval256_5_64_lanes(uint64_t *hash)
+{
+	typedef typename W::V V;
+	uint32_t t[16][W::N];
+	V m[32], s[8];
+
+	for(int j = 0; j < W::N; j++)
+	{
+		const uint32_t *h32 = (const uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			t[i][j] = h32[i];
+	}
+	for(int i = 0; i < 16; i++)
+		m[i] = W::load(t[i]);
+	for(int i = 16; i < 32; i++)
+		m[i] = W::set1(haval_pad[i - 16]);
+
+	for(int i = 0; i < 8; i++)
+		s[i] = W::set1(haval_iv[i]);
+	haval_pass<W, 0>(s, m);
+	haval_pass<W, 1>(s, m);
+	haval_pass<W, 2>(s, m);
+	haval_pass<W, 3>(s, m);
+	haval_pass<W, 4>(s, m);
+
+	for(int i = 0; i < 8; i++)
+		W::store(t[i], W::add(s[i], W::set1(haval_iv[i])));
+	for(int j = 0; j < W::N; j++)
+	{
+		uint32_t *h32 = (uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 8; i++)
+			h32[i] = t[i][j];
+	}
+}
+
+void vec_haval256_5_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for(; i + haval_wide::N <= count; i += haval_wide::N)
+		haval256_5_64_lanes<haval_wide>(&hash[i * 8]);
+	if(count - i > 1)
+	{
+		// the leftover lanes in a partial vector
+		uint64_t t[haval_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		haval256_5_64_lanes<haval_wide>(t);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		haval256_5_64_lanes<haval_x1>(&hash[i * 8]);
+}
+
+#endif
+
+} // namespace CPU_ISA
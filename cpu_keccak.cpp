@@ -0,0 +1,261 @@
+/**
+ * Keccak-f[1600] on several lanes at once: keccak512 of the chained
+ * 64-byte hashes and of the 80-byte header (see cpu_batch.h), and the
+ * keccak256 header kernel of Maxcoin
+ *
+ * sph works on one state of 25 64-bit words, here each word is a vector
+ * holding the same word of 8 (AVX-512) or 4 (AVX2) states. The lanes of
+ * a batch are loaded word by word and the leftover ones use the 64-bit
+ * version of the same code. As in sph this is the original Keccak (pad
+ * byte 0x01), not SHA-3.
+ *
+ * The 80-byte header is one block for keccak256 and only the nonce
+ * word differs between the lanes. For keccak512 the first 72 bytes are
+ * a full block, it is permuted once for the whole batch.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+static const uint64_t keccak_rc[24] = {
+	0x0000000000000001ULL, 0x0000000000008082ULL, 0x800000000000808AULL, 0x8000000080008000ULL,
+	0x000000000000808BULL, 0x0000000080000001ULL, 0x8000000080008081ULL, 0x8000000000008009ULL,
+	0x000000000000008AULL, 0x0000000000000088ULL, 0x0000000080008009ULL, 0x000000008000000AULL,
+	0x000000008000808BULL, 0x800000000000008BULL, 0x8000000000008089ULL, 0x8000000000008003ULL,
+	0x8000000000008002ULL, 0x8000000000000080ULL, 0x000000000000800AULL, 0x800000008000000AULL,
+	0x8000000080008081ULL, 0x8000000000008080ULL, 0x0000000080000001ULL, 0x8000000080008008ULL
+};
+
+/* rotation of the word x + 5y and its place after pi, (y, 2x + 3y) */
+static constexpr int keccak_rho[25] = {
+	 0,  1, 62, 28, 27,
+	36, 44,  6, 55, 20,
+	 3, 10, 43, 25, 39,
+	41, 45, 15, 21,  8,
+	18,  2, 61, 56, 14
+};
+
+static constexpr int keccak_pi[25] = {
+	 0, 10, 20,  5, 15,
+	16,  1, 11, 21,  6,
+	 7, 17,  2, 12, 22,
+	23,  8, 18,  3, 13,
+	14, 24,  9, 19,  4
+};
+
+/* 64-bit lanes of the vector types, the same few operations on each */
+
+struct keccak_x1 {
+	typedef uint64_t V;
+	enum { N = 1 };
+	static inline V set1(uint64_t a) { return a; }
+	static inline V load(const uint64_t *p) { return *p; }
+	static inline void store(uint64_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V xor3(V a, V b, V c) { return a ^ b ^ c; }
+	/* a ^ (~b & c) */
+	static inline V chi(V a, V b, V c) { return a ^ (~b & c); }
+	template<int n> static inline V rotl(V a) { return n ? (a << n) | (a >> (64 - n)) : a; }
+};
+
+#if defined(__AVX512F__)
+struct keccak_x8 {
+	typedef __m512i V;
+	enum { N = 8 };
+	static inline V set1(uint64_t a) { return _mm512_set1_epi64((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint64_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V xor3(V a, V b, V c) { return _mm512_ternarylogic_epi64(a, b, c, 0x96); }
+	static inline V chi(V a, V b, V c) { return _mm512_ternarylogic_epi64(a, b, c, 0xD2); }
+	template<int n> static inline V rotl(V a) { return _mm512_rol_epi64(a, n); }
+};
+typedef keccak_x8 keccak_wide;
+#elif defined(__AVX2__)
+struct keccak_x4 {
+	typedef __m256i V;
+	enum { N = 4 };
+	static inline V set1(uint64_t a) { return _mm256_set1_epi64x((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint64_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V xor3(V a, V b, V c) { return _mm256_xor_si256(_mm256_xor_si256(a, b), c); }
+	static inline V chi(V a, V b, V c) { return _mm256_xor_si256(a, _mm256_andnot_si256(b, c)); }
+	template<int n> static inline V rotl(V a) { return _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - n)); }
+};
+/* the byte rotations are a single shuffle */
+template<> inline __m256i keccak_x4::rotl<8>(__m256i a)
+{
+	return _mm256_shuffle_epi8(a, _mm256_setr_epi8(7, 0, 1, 2, 3, 4, 5, 6, 15, 8, 9, 10, 11, 12, 13, 14,
+		7, 0, 1, 2, 3, 4, 5, 6, 15, 8, 9, 10, 11, 12, 13, 14));
+}
+template<> inline __m256i keccak_x4::rotl<56>(__m256i a)
+{
+	return _mm256_shuffle_epi8(a, _mm256_setr_epi8(1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8,
+		1, 2, 3, 4, 5, 6, 7, 0, 9, 10, 11, 12, 13, 14, 15, 8));
+}
+typedef keccak_x4 keccak_wide;
+#else
+typedef keccak_x1 keccak_wide;
+#endif
+
+#define KECCAK_RHO_PI(i) b[keccak_pi[i]] = K::template rotl<keccak_rho[i]>(K::vxor(a[i], d[i % 5]))
+
+template<class K>
+static inline void keccak_f(typename K::V *a)
+{
+	typedef typename K::V V;
+	V b[25], c[5], d[5];
+
+	for(int r = 0; r < 24; r++)
+	{
+		// theta
+		for(int x = 0; x < 5; x++)
+			c[x] = K::xor3(K::xor3(a[x], a[x + 5], a[x + 10]), a[x + 15], a[x + 20]);
+		for(int x = 0; x < 5; x++)
+			d[x] = K::vxor(c[(x + 4) % 5], K::template rotl<1>(c[(x + 1) % 5]));
+		// rho and pi
+		KECCAK_RHO_PI(0);  KECCAK_RHO_PI(1);  KECCAK_RHO_PI(2);  KECCAK_RHO_PI(3);  KECCAK_RHO_PI(4);
+		KECCAK_RHO_PI(5);  KECCAK_RHO_PI(6);  KECCAK_RHO_PI(7);  KECCAK_RHO_PI(8);  KECCAK_RHO_PI(9);
+		KECCAK_RHO_PI(10); KECCAK_RHO_PI(11); KECCAK_RHO_PI(12); KECCAK_RHO_PI(13); KECCAK_RHO_PI(14);
+		KECCAK_RHO_PI(15); KECCAK_RHO_PI(16); KECCAK_RHO_PI(17); KECCAK_RHO_PI(18); KECCAK_RHO_PI(19);
+		KECCAK_RHO_PI(20); KECCAK_RHO_PI(21); KECCAK_RHO_PI(22); KECCAK_RHO_PI(23); KECCAK_RHO_PI(24);
+		// chi and iota
+		for(int y = 0; y < 25; y += 5)
+		{
+			for(int x = 0; x < 5; x++)
+				a[y + x] = K::chi(b[y + x], b[y + (x + 1) % 5], b[y + (x + 2) % 5]);
+		}
+		a[0] = K::vxor(a[0], K::set1(keccak_rc[r]));
+	}
+}
+
+/* word k of the K::N lanes of 8 words from 'hash', and back */
+template<class K>
+static inline typename K::V keccak_load_word(const uint64_t *hash, int k)
+{
+	uint64_t t[K::N];
+	for(int j = 0; j < K::N; j++)
+		t[j] = hash[j * 8 + k];
+	return K::load(t);
+}
+
+template<class K>
+static inline void keccak_store_word(uint64_t *hash, int k, typename K::V v)
+{
+	uint64_t t[K::N];
+	K::store(t, v);
+	for(int j = 0; j < K::N; j++)
+		hash[j * 8 + k] = t[j];
+}
+
+/* header word 9 (bytes 72..79) with the nonce of each lane */
+template<class K>
+static inline typename K::V keccak_nonce_word(const uint32_t *endiandata, const uint32_t *nonce)
+{
+	uint64_t t[K::N];
+	for(int j = 0; j < K::N; j++)
+		t[j] = endiandata[18] | ((uint64_t)swab32(nonce[j]) << 32);
+	return K::load(t);
+}
+
+/* keccak512 of 64 bytes: 8 message words, the padding in the 9th */
+template<class K>
+static inline void keccak512_64_lanes(uint64_t *hash)
+{
+	typename K::V a[25];
+
+	for(int k = 0; k < 8; k++)
+		a[k] = keccak_load_word<K>(hash, k);
+	a[8] = K::set1(0x8000000000000001ULL);
+	for(int k = 9; k < 25; k++)
+		a[k] = K::set1(0);
+	keccak_f<K>(a);
+	for(int k = 0; k < 8; k++)
+		keccak_store_word<K>(hash, k, a[k]);
+}
+
+/* keccak512 of 80 bytes from the state after the first 72 */
+template<class K>
+static inline void keccak512_80_lanes(uint64_t *hash, const uint64_t *s0, const uint32_t *endiandata, const uint32_t *nonce)
+{
+	typename K::V a[25];
+
+	for(int k = 0; k < 25; k++)
+		a[k] = K::set1(s0[k]);
+	a[0] = K::vxor(a[0], keccak_nonce_word<K>(endiandata, nonce));
+	a[1] = K::vxor(a[1], K::set1(0x01));
+	a[8] = K::vxor(a[8], K::set1(0x8000000000000000ULL));
+	keccak_f<K>(a);
+	for(int k = 0; k < 8; k++)
+		keccak_store_word<K>(hash, k, a[k]);
+}
+
+/* keccak256 of 80 bytes, one block of 136: words 0..8 of the header are in s0 */
+template<class K>
+static inline void keccak256_80_lanes(uint64_t *hash, const uint64_t *s0, const uint32_t *endiandata, const uint32_t *nonce)
+{
+	typename K::V a[25];
+
+	for(int k = 0; k < 25; k++)
+		a[k] = K::set1(s0[k]);
+	a[9] = keccak_nonce_word<K>(endiandata, nonce);
+	keccak_f<K>(a);
+	for(int k = 0; k < 4; k++)
+		keccak_store_word<K>(hash, k, a[k]);
+}
+
+static void keccak_header_words(uint64_t *w, const uint32_t *endiandata, int count)
+{
+	for(int k = 0; k < count; k++)
+		w[k] = endiandata[2 * k] | ((uint64_t)endiandata[2 * k + 1] << 32);
+}
+
+#if defined(CPU_BATCH_KECCAK)
+
+void avx_keccak512_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+	for(; i + keccak_wide::N <= count; i += keccak_wide::N)
+		keccak512_64_lanes<keccak_wide>(&hash[i * 8]);
+	for(; i < count; i++)
+		keccak512_64_lanes<keccak_x1>(&hash[i * 8]);
+}
+
+void avx_keccak512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	uint64_t s0[25] = { 0 };
+	uint32_t i = 0;
+
+	keccak_header_words(s0, endiandata, 9);
+	keccak_f<keccak_x1>(s0);
+	for(; i + keccak_wide::N <= count; i += keccak_wide::N)
+		keccak512_80_lanes<keccak_wide>(&hash[i * 8], s0, endiandata, &nonce[i]);
+	for(; i < count; i++)
+		keccak512_80_lanes<keccak_x1>(&hash[i * 8], s0, endiandata, &nonce[i]);
+}
+
+#endif
+
+void vec_keccak256_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	uint64_t s0[25] = { 0 };
+	uint32_t i = 0;
+
+	keccak_header_words(s0, endiandata, 9);
+	s0[10] = 0x01;
+	s0[16] = 0x8000000000000000ULL;
+	for(; i + keccak_wide::N <= count; i += keccak_wide::N)
+		keccak256_80_lanes<keccak_wide>(&hash[i * 8], s0, endiandata, &nonce[i]);
+	for(; i < count; i++)
+		keccak256_80_lanes<keccak_x1>(&hash[i * 8], s0, endiandata, &nonce[i]);
+}
+
+} // namespace CPU_ISA
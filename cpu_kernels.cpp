@@ -0,0 +1,61 @@
+/**
+ * Kernel table of one instruction set level (see cpu_kernels.h)
+ */
+#include "miner.h"
+#include "cpu_kernels.h"
+
+namespace CPU_ISA {
+
+void cpu_kernels_set(struct cpu_hash_kernels *k)
+{
+	k->blake256_8_precalc = vec_blake256_8_precalc;
+	k->blake256_14_precalc = vec_blake256_14_precalc;
+	k->blake256_8_80 = vec_blake256_8_80;
+	k->blake256_14_80 = vec_blake256_14_80;
+	k->skein512_precalc = vec_skein512_precalc;
+	k->skein512_80 = vec_skein512_80;
+	k->keccak256_80 = vec_keccak256_80;
+#ifdef CPU_BATCH_AES
+	aes_init();
+	k->groestl512_80 = aes_groestl512_80;
+	k->groestl512 = aes_groestl512_64;
+	k->shavite512 = aes_shavite512_64;
+	k->echo512 = aes_echo512_64;
+	k->fugue512 = aes_fugue512_64;
+#endif
+#ifdef CPU_BATCH_KECCAK
+	k->keccak512_80 = avx_keccak512_80;
+	k->keccak512 = avx_keccak512_64;
+#endif
+#ifdef CPU_BATCH_WHIRLPOOL
+	avx_whirlpool_init();
+	k->whirlpool_80 = avx_whirlpool_80;
+	k->whirlpool1_80 = avx_whirlpool1_80;
+	k->whirlpool = avx_whirlpool_64;
+	k->whirlpool1 = avx_whirlpool1_64;
+#endif
+#ifdef CPU_BATCH_HAMSI
+	k->hamsi512 = vec_hamsi512_64;
+#endif
+#ifdef CPU_BATCH_LUFFA
+	k->luffa512_80 = vec_luffa512_80;
+	k->luffa_cubehash512_80 = vec_luffa_cubehash512_80;
+	k->luffa512 = vec_luffa512_64;
+	k->cubehash512 = vec_cubehash512_64;
+	k->luffa_cubehash512 = vec_luffa_cubehash512_64;
+#endif
+#ifdef CPU_BATCH_SIMD
+	k->simd512 = vec_simd512_64;
+#endif
+#ifdef CPU_BATCH_SHA512
+	k->sha512 = vec_sha512_64;
+#endif
+#ifdef CPU_BATCH_HAVAL
+	k->haval256_5 = vec_haval256_5_64;
+#endif
+#ifdef CPU_BATCH_SHA256
+	k->sha256 = vec_sha256_64;
+#endif
+}
+
+} // namespace CPU_ISA
@@ -0,0 +1,139 @@
+#ifndef CPU_KERNELS_H
+#define CPU_KERNELS_H
+
+/**
+ * Stage kernels of cpu_batch.h for one instruction set level
+ *
+ * The kernel files are built once per level (Makefile.am), each time
+ * with the target flags of the level and CPU_ISA set to its namespace,
+ * so the SSE2, AES-NI, AVX2, VAES and AVX-512 versions of the same code
+ * are linked side by side. cpu_batch_init() asks the cpu which levels it
+ * runs and calls the cpu_kernels_set() of the highest one, the kernels
+ * missing at that level stay the sph ones. Without CPU_DISPATCH (Visual
+ * Studio, not x86-64) the files are built once with the flags of the
+ * program, in the namespace cpu_native.
+ *
+ * A kernel gives the same bytes as the sph function it replaces, at
+ * every level, cpu_kernels_selftest() (--cputest) compares them.
+ */
+
+#include "cpu_batch.h"
+
+#ifndef CPU_ISA
+#define CPU_ISA cpu_native
+#endif
+
+/* AES-NI kernels (cpu_aes.cpp) */
+#if defined(__AES__) && defined(__SSE4_1__)
+#define CPU_BATCH_AES 1
+#endif
+
+/* AVX2 / AVX-512 Keccak kernels (cpu_keccak.cpp), 4 or 8 lanes per vector */
+#if defined(__AVX2__)
+#define CPU_BATCH_KECCAK 1
+#endif
+
+/* Whirlpool without the 16 KB tables (cpu_whirlpool.cpp) */
+#if defined(__AVX2__)
+#define CPU_BATCH_WHIRLPOOL 1
+#endif
+
+/* Hamsi-512 with the 4 KB expansion table (cpu_hamsi.cpp), 4 to 16 lanes per vector */
+#if defined(__SSE2__)
+#define CPU_BATCH_HAMSI 1
+#endif
+
+/* Luffa-512 and CubeHash-512, alone or fused (cpu_luffa.cpp), 4 to 16 lanes per vector */
+#if defined(__SSE2__)
+#define CPU_BATCH_LUFFA 1
+#endif
+
+/* SIMD-512 (cpu_simd.cpp), 4 to 16 lanes per vector, pmulld needs SSE4.1 */
+#if defined(__SSE4_1__)
+#define CPU_BATCH_SIMD 1
+#endif
+
+/* SHA-512 and HAVAL-256/5 of x17 (cpu_sha512.cpp, cpu_haval.cpp), 4 or 8 lanes of 64 bits, 8 or 16 of 32 bits */
+#if defined(__AVX2__)
+#define CPU_BATCH_SHA512 1
+#define CPU_BATCH_HAVAL 1
+#endif
+
+/* SHA-256 of myriad-groestl and skein (cpu_sha256.cpp), 4 to 16 lanes per vector */
+#if defined(__SSE2__)
+#define CPU_BATCH_SHA256 1
+#endif
+
+namespace CPU_ISA {
+
+/* put the kernels built at this level in k */
+void cpu_kernels_set(struct cpu_hash_kernels *k);
+
+/* blake256 of the header from its midstate, on scalars without SSE2 (cpu_blake.cpp) */
+void vec_blake256_8_precalc(uint32_t *precalc, const uint32_t *endiandata);
+void vec_blake256_14_precalc(uint32_t *precalc, const uint32_t *endiandata);
+void vec_blake256_8_80(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count);
+void vec_blake256_14_80(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count);
+
+/* skein512 of the header from its midstate, on scalars without AVX2 (cpu_skein.cpp) */
+void vec_skein512_precalc(uint32_t *precalc, const uint32_t *endiandata);
+void vec_skein512_80(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count);
+
+/* keccak256 of the header, on scalars without AVX2 */
+void vec_keccak256_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+
+#ifdef CPU_BATCH_AES
+/* constants of the kernels, before their first use */
+void aes_init(void);
+void aes_echo512_64(uint64_t *hash, uint32_t count);
+void aes_shavite512_64(uint64_t *hash, uint32_t count);
+void aes_groestl512_64(uint64_t *hash, uint32_t count);
+void aes_groestl512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+void aes_fugue512_64(uint64_t *hash, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_KECCAK
+void avx_keccak512_64(uint64_t *hash, uint32_t count);
+void avx_keccak512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_WHIRLPOOL
+/* tables of the kernels, before their first use */
+void avx_whirlpool_init(void);
+void avx_whirlpool_64(uint64_t *hash, uint32_t count);
+void avx_whirlpool1_64(uint64_t *hash, uint32_t count);
+void avx_whirlpool_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+void avx_whirlpool1_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_HAMSI
+void vec_hamsi512_64(uint64_t *hash, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_LUFFA
+void vec_luffa512_64(uint64_t *hash, uint32_t count);
+void vec_cubehash512_64(uint64_t *hash, uint32_t count);
+void vec_luffa_cubehash512_64(uint64_t *hash, uint32_t count);
+void vec_luffa512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+void vec_luffa_cubehash512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_SIMD
+void vec_simd512_64(uint64_t *hash, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_SHA512
+void vec_sha512_64(uint64_t *hash, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_HAVAL
+void vec_haval256_5_64(uint64_t *hash, uint32_t count);
+#endif
+
+#ifdef CPU_BATCH_SHA256
+void vec_sha256_64(uint64_t *hash, uint32_t count);
+#endif
+
+} // namespace CPU_ISA
+
+#endif
@@ -0,0 +1,553 @@
+/**
+ * Luffa-512 and CubeHash-512 of the 64-byte lanes with vector arithmetic,
+ * alone or fused as in x11 (see cpu_batch.h)
+ *
+ * Both work on 32-bit words only: the 4-bit S-box of Luffa is a few
+ * and/or/xor per word and CubeHash is add, rotate and xor. Each word
+ * of the state is a vector holding the same word of 4 (SSE2), 8 (AVX2)
+ * or 16 (AVX-512) lanes, a single lane uses the same code on scalars.
+ * The fused stage keeps the Luffa digest in the vectors and feeds it to
+ * CubeHash, as x11_luffaCubehash512_cpu_hash_64 does on the GPU, so the
+ * lanes are transposed once for the two hashes.
+ *
+ * For the 80-byte header (qubit, deep, doom) the first two 32-byte
+ * blocks of Luffa do not depend on the nonce, they are absorbed once
+ * per call.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+static const uint32_t luffa_iv[5][8] = {
+	{ 0x6d251e69, 0x44b051e0, 0x4eaa6fb4, 0xdbf78465,
+	  0x6e292011, 0x90152df4, 0xee058139, 0xdef610bb },
+	{ 0xc3b44b95, 0xd9d2f256, 0x70eee9a0, 0xde099fa3,
+	  0x5d9b0557, 0x8fc944b3, 0xcf1ccf0e, 0x746cd581 },
+	{ 0xf7efc89d, 0x5dba5781, 0x04016ce5, 0xad659c05,
+	  0x0306194f, 0x666d1836, 0x24aa230a, 0x8b264ae7 },
+	{ 0x858075d5, 0x36d79cce, 0xe571f7d7, 0x204b1f67,
+	  0x35870c6a, 0x57e9e923, 0x14bcb808, 0x7cde72ce },
+	{ 0x6c68e9be, 0x5ec41e22, 0xc825b7c7, 0xaffb4363,
+	  0xf5df3999, 0x0fc688f1, 0xb07224cc, 0x03e86cea }
+};
+
+/* round constants of the 5 sub-permutations, added to words 0 and 4 */
+static const uint32_t luffa_rc[5][2][8] = {
+	{ { 0x303994a6, 0xc0e65299, 0x6cc33a12, 0xdc56983e, 0x1e00108f, 0x7800423d, 0x8f5b7882, 0x96e1db12 },
+	  { 0xe0337818, 0x441ba90d, 0x7f34d442, 0x9389217f, 0xe5a8bce6, 0x5274baf4, 0x26889ba7, 0x9a226e9d } },
+	{ { 0xb6de10ed, 0x70f47aae, 0x0707a3d4, 0x1c1e8f51, 0x707a3d45, 0xaeb28562, 0xbaca1589, 0x40a46f3e },
+	  { 0x01685f3d, 0x05a17cf4, 0xbd09caca, 0xf4272b28, 0x144ae5cc, 0xfaa7ae2b, 0x2e48f1c1, 0xb923c704 } },
+	{ { 0xfc20d9d2, 0x34552e25, 0x7ad8818f, 0x8438764a, 0xbb6de032, 0xedb780c8, 0xd9847356, 0xa2c78434 },
+	  { 0xe25e72c1, 0xe623bb72, 0x5c58a4a4, 0x1e38e2e7, 0x78e38b9d, 0x27586719, 0x36eda57f, 0x703aace7 } },
+	{ { 0xb213afa5, 0xc84ebe95, 0x4e608a22, 0x56d858fe, 0x343b138f, 0xd0ec4e3d, 0x2ceb4882, 0xb3ad2208 },
+	  { 0xe028c9bf, 0x44756f91, 0x7e8fce32, 0x956548be, 0xfe191be2, 0x3cb226e5, 0x5944a28e, 0xa1c4c355 } },
+	{ { 0xf0d2e9e3, 0xac11d7fa, 0x1bcb66f2, 0x6f2d9bc9, 0x78602649, 0x8edae952, 0x3b6ba548, 0xedae9520 },
+	  { 0x5090d577, 0x2d1925ab, 0xb46496ac, 0xd1925ab0, 0x29131ab6, 0x0fc053c3, 0x3f014f0c, 0xfc053c31 } }
+};
+
+static const uint32_t cubehash_iv512[32] = {
+	0x2aea2a61, 0x50f494d4, 0x2d538b8b, 0x4167d83e,
+	0x3fee2313, 0xc701cf8c, 0xcc39968e, 0x50ac5695,
+	0x4d42c787, 0xa647a8b3, 0x97cf0bef, 0x825b4537,
+	0xeef864d2, 0xf22090c4, 0xd0e5cd33, 0xa23911ae,
+	0xfcd398d9, 0x148fe485, 0x1b017bef, 0xb6444532,
+	0x6a536159, 0x2ff5781c, 0x91fa7934, 0x0dbadea9,
+	0xd65c8a2b, 0xa5a70e75, 0xb1c62456, 0xbc796576,
+	0x1921c8f7, 0xe7989af1, 0x7795d246, 0xd43e3b44
+};
+
+/* 32-bit lanes of the vector types, the same few operations on each */
+
+struct luffa_x1 {
+	typedef uint32_t V;
+	enum { N = 1 };
+	static inline V set1(uint32_t a) { return a; }
+	static inline V load(const uint32_t *p) { return *p; }
+	static inline void store(uint32_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V vand(V a, V b) { return a & b; }
+	static inline V vor(V a, V b) { return a | b; }
+	static inline V vnot(V a) { return ~a; }
+	static inline V add(V a, V b) { return a + b; }
+	static inline V bswap(V a) { return swab32(a); }
+	template<int n> static inline V rotl(V a) { return (a << n) | (a >> (32 - n)); }
+};
+
+#if defined(__AVX512F__)
+struct luffa_x16 {
+	typedef __m512i V;
+	enum { N = 16 };
+	static inline V set1(uint32_t a) { return _mm512_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint32_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V vand(V a, V b) { return _mm512_and_si512(a, b); }
+	static inline V vor(V a, V b) { return _mm512_or_si512(a, b); }
+	static inline V vnot(V a) { return _mm512_ternarylogic_epi32(a, a, a, 0x55); }
+	static inline V add(V a, V b) { return _mm512_add_epi32(a, b); }
+#if defined(__AVX512BW__)
+	static inline V bswap(V a)
+	{
+		const __m512i k = _mm512_broadcast_i32x4(_mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+		return _mm512_shuffle_epi8(a, k);
+	}
+#else
+	static inline V bswap(V a)
+	{
+		a = _mm512_rol_epi32(a, 16);
+		return _mm512_or_si512(_mm512_slli_epi32(_mm512_and_si512(a, set1(0x00ff00ff)), 8),
+			_mm512_and_si512(_mm512_srli_epi32(a, 8), set1(0x00ff00ff)));
+	}
+#endif
+	template<int n> static inline V rotl(V a) { return _mm512_rol_epi32(a, n); }
+};
+typedef luffa_x16 luffa_wide;
+#elif defined(__AVX2__)
+struct luffa_x8 {
+	typedef __m256i V;
+	enum { N = 8 };
+	static inline V set1(uint32_t a) { return _mm256_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V vand(V a, V b) { return _mm256_and_si256(a, b); }
+	static inline V vor(V a, V b) { return _mm256_or_si256(a, b); }
+	static inline V vnot(V a) { return _mm256_xor_si256(a, _mm256_set1_epi32(-1)); }
+	static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+	static inline V bswap(V a)
+	{
+		const __m256i k = _mm256_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+			12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+		return _mm256_shuffle_epi8(a, k);
+	}
+	template<int n> static inline V rotl(V a) { return _mm256_or_si256(_mm256_slli_epi32(a, n), _mm256_srli_epi32(a, 32 - n)); }
+};
+typedef luffa_x8 luffa_wide;
+#elif defined(__SSE2__)
+struct luffa_x4 {
+	typedef __m128i V;
+	enum { N = 4 };
+	static inline V set1(uint32_t a) { return _mm_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm_storeu_si128((__m128i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm_xor_si128(a, b); }
+	static inline V vand(V a, V b) { return _mm_and_si128(a, b); }
+	static inline V vor(V a, V b) { return _mm_or_si128(a, b); }
+	static inline V vnot(V a) { return _mm_xor_si128(a, _mm_set1_epi32(-1)); }
+	static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+#if defined(__SSSE3__)
+	static inline V bswap(V a)
+	{
+		return _mm_shuffle_epi8(a, _mm_set_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3));
+	}
+#else
+	static inline V bswap(V a)
+	{
+		a = _mm_or_si128(_mm_slli_epi32(a, 16), _mm_srli_epi32(a, 16));
+		return _mm_or_si128(_mm_slli_epi32(_mm_and_si128(a, set1(0x00ff00ff)), 8),
+			_mm_and_si128(_mm_srli_epi32(a, 8), set1(0x00ff00ff)));
+	}
+#endif
+	template<int n> static inline V rotl(V a) { return _mm_or_si128(_mm_slli_epi32(a, n), _mm_srli_epi32(a, 32 - n)); }
+};
+typedef luffa_x4 luffa_wide;
+#endif
+
+#if defined(CPU_BATCH_LUFFA)
+
+/* multiplication by 2 of a 256-bit word (M2 of sph/luffa.c) */
+template<class W>
+static inline void luffa_m2(typename W::V *d, const typename W::V *s)
+{
+	typename W::V t = s[7];
+	d[7] = s[6];
+	d[6] = s[5];
+	d[5] = s[4];
+	d[4] = W::vxor(s[3], t);
+	d[3] = W::vxor(s[2], t);
+	d[2] = s[1];
+	d[1] = W::vxor(s[0], t);
+	d[0] = t;
+}
+
+template<class W>
+static inline void luffa_xor(typename W::V *d, const typename W::V *a, const typename W::V *b)
+{
+	for(int i = 0; i < 8; i++)
+		d[i] = W::vxor(a[i], b[i]);
+}
+
+/* message injection MI5, m is NULL for a block of zeros */
+template<class W>
+static inline void luffa_mi(typename W::V (*v)[8], const typename W::V *m)
+{
+	typename W::V a[8], b[8], t[8];
+
+	luffa_xor<W>(a, v[0], v[1]);
+	luffa_xor<W>(a, a, v[2]);
+	luffa_xor<W>(a, a, v[3]);
+	luffa_xor<W>(a, a, v[4]);
+	luffa_m2<W>(a, a);
+	for(int j = 0; j < 5; j++)
+		luffa_xor<W>(v[j], v[j], a);
+
+	luffa_m2<W>(b, v[0]);
+	luffa_xor<W>(b, b, v[1]);
+	for(int j = 1; j < 4; j++)
+	{
+		luffa_m2<W>(v[j], v[j]);
+		luffa_xor<W>(v[j], v[j], v[j + 1]);
+	}
+	luffa_m2<W>(v[4], v[4]);
+	luffa_xor<W>(v[4], v[4], v[0]);
+	luffa_m2<W>(v[0], b);
+	luffa_xor<W>(v[0], v[0], v[4]);
+	for(int j = 4; j > 1; j--)
+	{
+		luffa_m2<W>(v[j], v[j]);
+		luffa_xor<W>(v[j], v[j], v[j - 1]);
+	}
+	luffa_m2<W>(v[1], v[1]);
+	luffa_xor<W>(v[1], v[1], b);
+
+	if(m)
+	{
+		for(int i = 0; i < 8; i++)
+			t[i] = m[i];
+		for(int j = 0; j < 5; j++)
+		{
+			if(j)
+				luffa_m2<W>(t, t);
+			luffa_xor<W>(v[j], v[j], t);
+		}
+	}
+}
+
+template<class W>
+static inline void luffa_sub_crumb(typename W::V &a0, typename W::V &a1, typename W::V &a2, typename W::V &a3)
+{
+	typename W::V t = a0;
+	a0 = W::vor(a0, a1);
+	a2 = W::vxor(a2, a3);
+	a1 = W::vnot(a1);
+	a0 = W::vxor(a0, a3);
+	a3 = W::vand(a3, t);
+	a1 = W::vxor(a1, a3);
+	a3 = W::vxor(a3, a2);
+	a2 = W::vand(a2, a0);
+	a0 = W::vnot(a0);
+	a2 = W::vxor(a2, a1);
+	a1 = W::vor(a1, a3);
+	t = W::vxor(t, a1);
+	a3 = W::vxor(a3, a2);
+	a2 = W::vand(a2, a1);
+	a1 = W::vxor(a1, a0);
+	a0 = t;
+}
+
+template<class W>
+static inline void luffa_mix_word(typename W::V &u, typename W::V &v)
+{
+	v = W::vxor(v, u);
+	u = W::vxor(W::template rotl<2>(u), v);
+	v = W::vxor(W::template rotl<14>(v), u);
+	u = W::vxor(W::template rotl<10>(u), v);
+	v = W::template rotl<1>(v);
+}
+
+/* the 8 steps of one of the 5 sub-permutations */
+template<class W>
+static inline void luffa_q(typename W::V *x, const uint32_t (*rc)[8])
+{
+	for(int r = 0; r < 8; r++)
+	{
+		luffa_sub_crumb<W>(x[0], x[1], x[2], x[3]);
+		luffa_sub_crumb<W>(x[5], x[6], x[7], x[4]);
+		luffa_mix_word<W>(x[0], x[4]);
+		luffa_mix_word<W>(x[1], x[5]);
+		luffa_mix_word<W>(x[2], x[6]);
+		luffa_mix_word<W>(x[3], x[7]);
+		x[0] = W::vxor(x[0], W::set1(rc[0][r]));
+		x[4] = W::vxor(x[4], W::set1(rc[1][r]));
+	}
+}
+
+/* P5 with the tweak of the words 4 to 7 */
+template<class W>
+static inline void luffa_p(typename W::V (*v)[8])
+{
+	for(int i = 4; i < 8; i++)
+	{
+		v[1][i] = W::template rotl<1>(v[1][i]);
+		v[2][i] = W::template rotl<2>(v[2][i]);
+		v[3][i] = W::template rotl<3>(v[3][i]);
+		v[4][i] = W::template rotl<4>(v[4][i]);
+	}
+	for(int j = 0; j < 5; j++)
+		luffa_q<W>(v[j], luffa_rc[j]);
+}
+
+/* the padding block, then two blank rounds each giving half of the digest */
+template<class W>
+static inline void luffa_close(typename W::V (*v)[8], typename W::V *out, const typename W::V *pad)
+{
+	luffa_mi<W>(v, pad);
+	luffa_p<W>(v);
+	for(int h = 0; h < 2; h++)
+	{
+		luffa_mi<W>(v, NULL);
+		luffa_p<W>(v);
+		for(int i = 0; i < 8; i++)
+			out[8 * h + i] = W::vxor(W::vxor(W::vxor(v[0][i], v[1][i]), W::vxor(v[2][i], v[3][i])), v[4][i]);
+	}
+}
+
+/* Luffa-512 of 64 bytes, m and out are the big endian words */
+template<class W>
+static inline void luffa512_64(typename W::V *out, const typename W::V *m)
+{
+	typename W::V v[5][8], pad[8];
+
+	for(int j = 0; j < 5; j++)
+		for(int i = 0; i < 8; i++)
+			v[j][i] = W::set1(luffa_iv[j][i]);
+	luffa_mi<W>(v, &m[0]);
+	luffa_p<W>(v);
+	luffa_mi<W>(v, &m[8]);
+	luffa_p<W>(v);
+	pad[0] = W::set1(0x80000000);
+	for(int i = 1; i < 8; i++)
+		pad[i] = W::set1(0);
+	luffa_close<W>(v, out, pad);
+}
+
+/*
+ * CubeHash round, the swaps of the reference description are a renaming
+ * of the words: x[0..15] are the words 0jklm, x[16..31] the words 1jklm
+ */
+template<class W>
+static inline void cubehash_round(typename W::V *x)
+{
+	typename W::V y[16], z[16];
+
+	for(int i = 0; i < 16; i++)
+	{
+		x[16 + i] = W::add(x[16 + i], x[i]);
+		x[i] = W::template rotl<7>(x[i]);
+	}
+	for(int i = 0; i < 16; i++)
+		y[i] = W::vxor(x[i ^ 8], x[16 + i]);
+	for(int i = 0; i < 16; i++)
+	{
+		z[i] = W::add(x[16 + (i ^ 2)], y[i]);
+		y[i] = W::template rotl<11>(y[i]);
+	}
+	for(int i = 0; i < 16; i++)
+	{
+		x[i] = W::vxor(y[i ^ 4], z[i]);
+		x[16 + i] = z[i ^ 1];
+	}
+}
+
+template<class W>
+static inline void cubehash_rounds(typename W::V *x, int n)
+{
+	for(int r = 0; r < n; r++)
+		cubehash_round<W>(x);
+}
+
+/* CubeHash-512 of 64 bytes, m and out are the little endian words */
+template<class W>
+static inline void cubehash512_64(typename W::V *out, const typename W::V *m)
+{
+	typename W::V x[32];
+
+	for(int i = 0; i < 32; i++)
+		x[i] = W::set1(cubehash_iv512[i]);
+	for(int b = 0; b < 2; b++)
+	{
+		for(int i = 0; i < 8; i++)
+			x[i] = W::vxor(x[i], m[8 * b + i]);
+		cubehash_rounds<W>(x, 16);
+	}
+	x[0] = W::vxor(x[0], W::set1(0x80));
+	cubehash_rounds<W>(x, 16);
+	x[31] = W::vxor(x[31], W::set1(1));
+	cubehash_rounds<W>(x, 160);
+	for(int i = 0; i < 16; i++)
+		out[i] = x[i];
+}
+
+enum {
+	LC_LUFFA = 1,
+	LC_CUBEHASH = 2
+};
+
+/* W::N contiguous lanes: Luffa, CubeHash or both */
+template<class W, int mode>
+static inline void lc_64_lanes(uint64_t *hash)
+{
+	typedef typename W::V V;
+	uint32_t t[16][W::N];
+	V m[16];
+
+	for(int j = 0; j < W::N; j++)
+	{
+		const uint32_t *h32 = (const uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			t[i][j] = h32[i];
+	}
+	for(int i = 0; i < 16; i++)
+		m[i] = W::load(t[i]);
+	if(mode & LC_LUFFA)
+	{
+		for(int i = 0; i < 16; i++)
+			m[i] = W::bswap(m[i]);
+		luffa512_64<W>(m, m);
+		for(int i = 0; i < 16; i++)
+			m[i] = W::bswap(m[i]);
+	}
+	if(mode & LC_CUBEHASH)
+		cubehash512_64<W>(m, m);
+	for(int i = 0; i < 16; i++)
+		W::store(t[i], m[i]);
+	for(int j = 0; j < W::N; j++)
+	{
+		uint32_t *h32 = (uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			h32[i] = t[i][j];
+	}
+}
+
+template<int mode>
+static void lc_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for(; i + luffa_wide::N <= count; i += luffa_wide::N)
+		lc_64_lanes<luffa_wide, mode>(&hash[i * 8]);
+	if(count - i > 1)
+	{
+		// the leftover lanes in a partial vector
+		uint64_t t[luffa_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		lc_64_lanes<luffa_wide, mode>(t);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		lc_64_lanes<luffa_x1, mode>(&hash[i * 8]);
+}
+
+void vec_luffa512_64(uint64_t *hash, uint32_t count)
+{
+	lc_64<LC_LUFFA>(hash, count);
+}
+
+void vec_cubehash512_64(uint64_t *hash, uint32_t count)
+{
+	lc_64<LC_CUBEHASH>(hash, count);
+}
+
+void vec_luffa_cubehash512_64(uint64_t *hash, uint32_t count)
+{
+	lc_64<LC_LUFFA | LC_CUBEHASH>(hash, count);
+}
+
+/*
+ * 80-byte header: v is the state after the first 64 bytes, the last
+ * block holds the words 16 to 18, the nonce and the padding
+ */
+template<class W, int mode>
+static inline void lc_80_lanes(uint64_t *hash, const uint32_t (*mid)[8], const uint32_t *tail, const uint32_t *nonce)
+{
+	typedef typename W::V V;
+	uint32_t t[16][W::N];
+	V v[5][8], m[8], out[16];
+
+	for(int j = 0; j < 5; j++)
+		for(int i = 0; i < 8; i++)
+			v[j][i] = W::set1(mid[j][i]);
+	for(int i = 0; i < 3; i++)
+		m[i] = W::set1(tail[i]);
+	m[3] = W::load(nonce);
+	m[4] = W::set1(0x80000000);
+	for(int i = 5; i < 8; i++)
+		m[i] = W::set1(0);
+	luffa_mi<W>(v, m);
+	luffa_p<W>(v);
+	// the padding was in the last block, the next one is blank
+	luffa_mi<W>(v, NULL);
+	luffa_p<W>(v);
+	for(int h = 0; h < 2; h++)
+	{
+		if(h)
+		{
+			luffa_mi<W>(v, NULL);
+			luffa_p<W>(v);
+		}
+		for(int i = 0; i < 8; i++)
+			out[8 * h + i] = W::bswap(W::vxor(W::vxor(W::vxor(v[0][i], v[1][i]), W::vxor(v[2][i], v[3][i])), v[4][i]));
+	}
+	if(mode & LC_CUBEHASH)
+		cubehash512_64<W>(out, out);
+	for(int i = 0; i < 16; i++)
+		W::store(t[i], out[i]);
+	for(int j = 0; j < W::N; j++)
+	{
+		uint32_t *h32 = (uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			h32[i] = t[i][j];
+	}
+}
+
+template<int mode>
+static void lc_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	uint32_t mid[5][8], m[16], tail[3];
+	uint32_t i = 0;
+
+	// the bytes of endiandata, read as big endian words
+	for(int k = 0; k < 16; k++)
+		m[k] = swab32(endiandata[k]);
+	for(int k = 0; k < 3; k++)
+		tail[k] = swab32(endiandata[16 + k]);
+	memcpy(mid, luffa_iv, sizeof(mid));
+	luffa_mi<luffa_x1>(mid, &m[0]);
+	luffa_p<luffa_x1>(mid);
+	luffa_mi<luffa_x1>(mid, &m[8]);
+	luffa_p<luffa_x1>(mid);
+
+	for(; i + luffa_wide::N <= count; i += luffa_wide::N)
+		lc_80_lanes<luffa_wide, mode>(&hash[i * 8], mid, tail, &nonce[i]);
+	if(count - i > 1)
+	{
+		uint64_t t[luffa_wide::N * 8];
+		uint32_t n[luffa_wide::N] = { 0 };
+		memcpy(n, &nonce[i], (count - i) * sizeof(uint32_t));
+		lc_80_lanes<luffa_wide, mode>(t, mid, tail, n);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		lc_80_lanes<luffa_x1, mode>(&hash[i * 8], mid, tail, &nonce[i]);
+}
+
+void vec_luffa512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	lc_80<LC_LUFFA>(hash, endiandata, nonce, count);
+}
+
+void vec_luffa_cubehash512_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	lc_80<LC_LUFFA | LC_CUBEHASH>(hash, endiandata, nonce, count);
+}
+
+#endif
+
+} // namespace CPU_ISA
@@ -0,0 +1,211 @@
+/**
+ * SHA-256 of the 64-byte lanes with vector arithmetic (see cpu_batch.h)
+ *
+ * A 64-byte message takes two blocks, the second one is only the
+ * padding (0x80, zeros and the length of 512 bits): its message
+ * schedule is the same for all the lanes and is folded with K256 in a
+ * table. The rounds work on 32-bit words, one lane of 4 (SSE2), 8 (AVX2)
+ * or 16 (AVX-512) per vector element, a single lane uses the same code
+ * on scalars.
+ *
+ * The digest is 32 bytes, the upper half of the lane is kept as
+ * sph_sha256 leaves it.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+static const uint32_t sha256_iv[8] = {
+	0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A,
+	0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+static const uint32_t sha256_k[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2};
+
+/* K256 + W of the padding block, its schedule expanded */
+static const uint32_t sha256_pad_wk[64] = {
+	0xC28A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF374,
+	0x649B69C1, 0xF0FE4786, 0x0FE1EDC6, 0x240CF254, 0x4FE9346F, 0x6CC984BE, 0x61B9411E, 0x16F988FA,
+	0xF2C65152, 0xA88E5A6D, 0xB019FC65, 0xB9D99EC7, 0x9A1231C3, 0xE70EEAA0, 0xFDB1232B, 0xC7353EB0,
+	0x3069BAD5, 0xCB976D5F, 0x5A0F118F, 0xDC1EEEFD, 0x0A35B689, 0xDE0B7A04, 0x58F4CA9D, 0xE15D5B16,
+	0x007F3E86, 0x37088980, 0xA507EA32, 0x6FAB9537, 0x17406110, 0x0D8CD6F1, 0xCDAA3B6D, 0xC0BBBE37,
+	0x83613BDA, 0xDB48A363, 0x0B02E931, 0x6FD15CA7, 0x521AFACA, 0x31338431, 0x6ED41A95, 0x6D437890,
+	0xC39C91F2, 0x9ECCABBD, 0xB5C9A0E6, 0x532FB63C, 0xD2C741C6, 0x07237EA3, 0xA4954B68, 0x4C191D76
+};
+
+/* 32-bit lanes of the vector types */
+
+struct sha256_x1 {
+	typedef uint32_t V;
+	enum { N = 1 };
+	static inline V set1(uint32_t a) { return a; }
+	static inline V load(const uint32_t *p) { return *p; }
+	static inline void store(uint32_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V add(V a, V b) { return a + b; }
+	template<int n> static inline V shr(V a) { return a >> n; }
+	template<int n> static inline V rotr(V a) { return (a >> n) | (a << (32 - n)); }
+	static inline V ch(V x, V y, V z) { return ((y ^ z) & x) ^ z; }
+	static inline V maj(V x, V y, V z) { return (x & y) | ((x | y) & z); }
+};
+
+#if defined(__AVX512F__)
+struct sha256_x16 {
+	typedef __m512i V;
+	enum { N = 16 };
+	static inline V set1(uint32_t a) { return _mm512_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint32_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V add(V a, V b) { return _mm512_add_epi32(a, b); }
+	template<int n> static inline V shr(V a) { return _mm512_srli_epi32(a, n); }
+	template<int n> static inline V rotr(V a) { return _mm512_ror_epi32(a, n); }
+	static inline V ch(V x, V y, V z) { return _mm512_ternarylogic_epi32(x, y, z, 0xca); }
+	static inline V maj(V x, V y, V z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe8); }
+};
+typedef sha256_x16 sha256_wide;
+#elif defined(__AVX2__)
+struct sha256_x8 {
+	typedef __m256i V;
+	enum { N = 8 };
+	static inline V set1(uint32_t a) { return _mm256_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+	template<int n> static inline V shr(V a) { return _mm256_srli_epi32(a, n); }
+	template<int n> static inline V rotr(V a) { return _mm256_or_si256(_mm256_srli_epi32(a, n), _mm256_slli_epi32(a, 32 - n)); }
+	static inline V ch(V x, V y, V z) { return _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(y, z), x), z); }
+	static inline V maj(V x, V y, V z) { return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(_mm256_or_si256(x, y), z)); }
+};
+typedef sha256_x8 sha256_wide;
+#elif defined(__SSE2__)
+struct sha256_x4 {
+	typedef __m128i V;
+	enum { N = 4 };
+	static inline V set1(uint32_t a) { return _mm_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm_storeu_si128((__m128i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm_xor_si128(a, b); }
+	static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+	template<int n> static inline V shr(V a) { return _mm_srli_epi32(a, n); }
+	template<int n> static inline V rotr(V a) { return _mm_or_si128(_mm_srli_epi32(a, n), _mm_slli_epi32(a, 32 - n)); }
+	static inline V ch(V x, V y, V z) { return _mm_xor_si128(_mm_and_si128(_mm_xor_si128(y, z), x), z); }
+	static inline V maj(V x, V y, V z) { return _mm_or_si128(_mm_and_si128(x, y), _mm_and_si128(_mm_or_si128(x, y), z)); }
+};
+typedef sha256_x4 sha256_wide;
+#endif
+
+#if defined(CPU_BATCH_SHA256)
+
+/* round r of a group of 8, the roles of the state words rotate by one each round */
+template<class W>
+static inline void sha256_step(typename W::V *s, int r, typename W::V wk)
+{
+	typedef typename W::V V;
+	V &a = s[(8 - r) & 7], &b = s[(9 - r) & 7], &c = s[(10 - r) & 7], &d = s[(11 - r) & 7];
+	V &e = s[(12 - r) & 7], &f = s[(13 - r) & 7], &g = s[(14 - r) & 7], &h = s[(15 - r) & 7];
+
+	V s1 = W::vxor(W::vxor(W::template rotr<6>(e), W::template rotr<11>(e)), W::template rotr<25>(e));
+	V s0 = W::vxor(W::vxor(W::template rotr<2>(a), W::template rotr<13>(a)), W::template rotr<22>(a));
+	V t1 = W::add(W::add(h, s1), W::add(W::ch(e, f, g), wk));
+	V t2 = W::add(s0, W::maj(a, b, c));
+	d = W::add(d, t1);
+	h = W::add(t1, t2);
+}
+
+/* W::N contiguous lanes */
+template<class W>
+static inline void sha256_64_lanes(uint64_t *hash)
+{
+	typedef typename W::V V;
+	uint32_t t[16][W::N];
+	V w[64], s[8], h[8];
+
+	// big endian words, swapped with the transposition
+	for(int j = 0; j < W::N; j++)
+	{
+		const uint32_t *h32 = (const uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			t[i][j] = swab32(h32[i]);
+	}
+	for(int i = 0; i < 16; i++)
+		w[i] = W::load(t[i]);
+	for(int i = 16; i < 64; i++)
+	{
+		V x = w[i - 15], y = w[i - 2];
+		V s0 = W::vxor(W::vxor(W::template rotr<7>(x), W::template rotr<18>(x)), W::template shr<3>(x));
+		V s1 = W::vxor(W::vxor(W::template rotr<17>(y), W::template rotr<19>(y)), W::template shr<10>(y));
+		w[i] = W::add(W::add(w[i - 16], s0), W::add(w[i - 7], s1));
+	}
+
+	for(int i = 0; i < 8; i++)
+		s[i] = W::set1(sha256_iv[i]);
+	for(int i = 0; i < 64; i += 8)
+	{
+		sha256_step<W>(s, 0, W::add(w[i + 0], W::set1(sha256_k[i + 0])));
+		sha256_step<W>(s, 1, W::add(w[i + 1], W::set1(sha256_k[i + 1])));
+		sha256_step<W>(s, 2, W::add(w[i + 2], W::set1(sha256_k[i + 2])));
+		sha256_step<W>(s, 3, W::add(w[i + 3], W::set1(sha256_k[i + 3])));
+		sha256_step<W>(s, 4, W::add(w[i + 4], W::set1(sha256_k[i + 4])));
+		sha256_step<W>(s, 5, W::add(w[i + 5], W::set1(sha256_k[i + 5])));
+		sha256_step<W>(s, 6, W::add(w[i + 6], W::set1(sha256_k[i + 6])));
+		sha256_step<W>(s, 7, W::add(w[i + 7], W::set1(sha256_k[i + 7])));
+	}
+	for(int i = 0; i < 8; i++)
+		s[i] = h[i] = W::add(s[i], W::set1(sha256_iv[i]));
+
+	// the padding block, no message schedule
+	for(int i = 0; i < 64; i += 8)
+	{
+		for(int r = 0; r < 8; r++)
+			sha256_step<W>(s, r, W::set1(sha256_pad_wk[i + r]));
+	}
+
+	for(int i = 0; i < 8; i++)
+		W::store(t[i], W::add(s[i], h[i]));
+	for(int j = 0; j < W::N; j++)
+	{
+		uint32_t *h32 = (uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 8; i++)
+			h32[i] = swab32(t[i][j]);
+	}
+}
+
+void vec_sha256_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for(; i + sha256_wide::N <= count; i += sha256_wide::N)
+		sha256_64_lanes<sha256_wide>(&hash[i * 8]);
+	if(count - i > 1)
+	{
+		// the leftover lanes in a partial vector
+		uint64_t t[sha256_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		sha256_64_lanes<sha256_wide>(t);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		sha256_64_lanes<sha256_x1>(&hash[i * 8]);
+}
+
+#endif
+
+} // namespace CPU_ISA
@@ -0,0 +1,201 @@
+/**
+ * SHA-512 of the 64-byte lanes with vector arithmetic (see cpu_batch.h)
+ *
+ * A 64-byte message and its padding fill a single block: the words 8 to
+ * 15 are the same for all the lanes (0x80, zeros and the length of 512
+ * bits), their round constants are folded with K512. The rounds work on
+ * 64-bit words, one lane of 4 (AVX2) or 8 (AVX-512) per vector element,
+ * a single lane uses the same code on scalars.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+static const uint64_t sha512_iv[8] = {
+	0x6A09E667F3BCC908ULL, 0xBB67AE8584CAA73BULL, 0x3C6EF372FE94F82BULL, 0xA54FF53A5F1D36F1ULL,
+	0x510E527FADE682D1ULL, 0x9B05688C2B3E6C1FULL, 0x1F83D9ABFB41BD6BULL, 0x5BE0CD19137E2179ULL
+};
+
+static const uint64_t sha512_k[80] = {
+	0x428A2F98D728AE22ULL, 0x7137449123EF65CDULL, 0xB5C0FBCFEC4D3B2FULL, 0xE9B5DBA58189DBBCULL,
+	0x3956C25BF348B538ULL, 0x59F111F1B605D019ULL, 0x923F82A4AF194F9BULL, 0xAB1C5ED5DA6D8118ULL,
+	0xD807AA98A3030242ULL, 0x12835B0145706FBEULL, 0x243185BE4EE4B28CULL, 0x550C7DC3D5FFB4E2ULL,
+	0x72BE5D74F27B896FULL, 0x80DEB1FE3B1696B1ULL, 0x9BDC06A725C71235ULL, 0xC19BF174CF692694ULL,
+	0xE49B69C19EF14AD2ULL, 0xEFBE4786384F25E3ULL, 0x0FC19DC68B8CD5B5ULL, 0x240CA1CC77AC9C65ULL,
+	0x2DE92C6F592B0275ULL, 0x4A7484AA6EA6E483ULL, 0x5CB0A9DCBD41FBD4ULL, 0x76F988DA831153B5ULL,
+	0x983E5152EE66DFABULL, 0xA831C66D2DB43210ULL, 0xB00327C898FB213FULL, 0xBF597FC7BEEF0EE4ULL,
+	0xC6E00BF33DA88FC2ULL, 0xD5A79147930AA725ULL, 0x06CA6351E003826FULL, 0x142929670A0E6E70ULL,
+	0x27B70A8546D22FFCULL, 0x2E1B21385C26C926ULL, 0x4D2C6DFC5AC42AEDULL, 0x53380D139D95B3DFULL,
+	0x650A73548BAF63DEULL, 0x766A0ABB3C77B2A8ULL, 0x81C2C92E47EDAEE6ULL, 0x92722C851482353BULL,
+	0xA2BFE8A14CF10364ULL, 0xA81A664BBC423001ULL, 0xC24B8B70D0F89791ULL, 0xC76C51A30654BE30ULL,
+	0xD192E819D6EF5218ULL, 0xD69906245565A910ULL, 0xF40E35855771202AULL, 0x106AA07032BBD1B8ULL,
+	0x19A4C116B8D2D0C8ULL, 0x1E376C085141AB53ULL, 0x2748774CDF8EEB99ULL, 0x34B0BCB5E19B48A8ULL,
+	0x391C0CB3C5C95A63ULL, 0x4ED8AA4AE3418ACBULL, 0x5B9CCA4F7763E373ULL, 0x682E6FF3D6B2B8A3ULL,
+	0x748F82EE5DEFB2FCULL, 0x78A5636F43172F60ULL, 0x84C87814A1F0AB72ULL, 0x8CC702081A6439ECULL,
+	0x90BEFFFA23631E28ULL, 0xA4506CEBDE82BDE9ULL, 0xBEF9A3F7B2C67915ULL, 0xC67178F2E372532BULL,
+	0xCA273ECEEA26619CULL, 0xD186B8C721C0C207ULL, 0xEADA7DD6CDE0EB1EULL, 0xF57D4F7FEE6ED178ULL,
+	0x06F067AA72176FBAULL, 0x0A637DC5A2C898A6ULL, 0x113F9804BEF90DAEULL, 0x1B710B35131C471BULL,
+	0x28DB77F523047D84ULL, 0x32CAAB7B40C72493ULL, 0x3C9EBE0A15C9BEBCULL, 0x431D67C49C100D4CULL,
+	0x4CC5D4BECB3E42B6ULL, 0x597F299CFC657E2AULL, 0x5FCB6FAB3AD6FAECULL, 0x6C44198C4A475817ULL
+};
+
+/* words 8 to 15 of the block of a 64-byte message */
+static const uint64_t sha512_pad[8] = {
+	0x8000000000000000ULL, 0, 0, 0, 0, 0, 0, 512
+};
+
+/* 64-bit lanes of the vector types */
+
+struct sha512_x1 {
+	typedef uint64_t V;
+	enum { N = 1 };
+	static inline V set1(uint64_t a) { return a; }
+	static inline V load(const uint64_t *p) { return *p; }
+	static inline void store(uint64_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V add(V a, V b) { return a + b; }
+	static inline V bswap(V a) { return swab64(a); }
+	template<int n> static inline V shr(V a) { return a >> n; }
+	template<int n> static inline V rotr(V a) { return (a >> n) | (a << (64 - n)); }
+	static inline V ch(V x, V y, V z) { return ((y ^ z) & x) ^ z; }
+	static inline V maj(V x, V y, V z) { return (x & y) | ((x | y) & z); }
+};
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+struct sha512_x8 {
+	typedef __m512i V;
+	enum { N = 8 };
+	static inline V set1(uint64_t a) { return _mm512_set1_epi64((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint64_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V add(V a, V b) { return _mm512_add_epi64(a, b); }
+	static inline V bswap(V a)
+	{
+		const __m512i k = _mm512_broadcast_i32x4(_mm_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7));
+		return _mm512_shuffle_epi8(a, k);
+	}
+	template<int n> static inline V shr(V a) { return _mm512_srli_epi64(a, n); }
+	template<int n> static inline V rotr(V a) { return _mm512_ror_epi64(a, n); }
+	static inline V ch(V x, V y, V z) { return _mm512_ternarylogic_epi64(x, y, z, 0xca); }
+	static inline V maj(V x, V y, V z) { return _mm512_ternarylogic_epi64(x, y, z, 0xe8); }
+};
+typedef sha512_x8 sha512_wide;
+#elif defined(__AVX2__)
+struct sha512_x4 {
+	typedef __m256i V;
+	enum { N = 4 };
+	static inline V set1(uint64_t a) { return _mm256_set1_epi64x((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint64_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V add(V a, V b) { return _mm256_add_epi64(a, b); }
+	static inline V bswap(V a)
+	{
+		const __m256i k = _mm256_set_epi8(8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7,
+			8, 9, 10, 11, 12, 13, 14, 15, 0, 1, 2, 3, 4, 5, 6, 7);
+		return _mm256_shuffle_epi8(a, k);
+	}
+	template<int n> static inline V shr(V a) { return _mm256_srli_epi64(a, n); }
+	template<int n> static inline V rotr(V a) { return _mm256_or_si256(_mm256_srli_epi64(a, n), _mm256_slli_epi64(a, 64 - n)); }
+	static inline V ch(V x, V y, V z) { return _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(y, z), x), z); }
+	static inline V maj(V x, V y, V z) { return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(_mm256_or_si256(x, y), z)); }
+};
+typedef sha512_x4 sha512_wide;
+#endif
+
+#if defined(CPU_BATCH_SHA512)
+
+/* round r of a group of 8, the roles of the state words rotate by one each round */
+template<class W>
+static inline void sha512_step(typename W::V *s, int r, typename W::V wk)
+{
+	typedef typename W::V V;
+	V &a = s[(8 - r) & 7], &b = s[(9 - r) & 7], &c = s[(10 - r) & 7], &d = s[(11 - r) & 7];
+	V &e = s[(12 - r) & 7], &f = s[(13 - r) & 7], &g = s[(14 - r) & 7], &h = s[(15 - r) & 7];
+
+	V s1 = W::vxor(W::vxor(W::template rotr<14>(e), W::template rotr<18>(e)), W::template rotr<41>(e));
+	V s0 = W::vxor(W::vxor(W::template rotr<28>(a), W::template rotr<34>(a)), W::template rotr<39>(a));
+	V t1 = W::add(W::add(h, s1), W::add(W::ch(e, f, g), wk));
+	V t2 = W::add(s0, W::maj(a, b, c));
+	d = W::add(d, t1);
+	h = W::add(t1, t2);
+}
+
+/* W::N contiguous lanes */
+template<class W>
+static inline void sha512_64_lanes(uint64_t *hash)
+{
+	typedef typename W::V V;
+	uint64_t t[8][W::N];
+	V w[80], s[8];
+
+	for(int j = 0; j < W::N; j++)
+		for(int i = 0; i < 8; i++)
+			t[i][j] = hash[j * 8 + i];
+	for(int i = 0; i < 8; i++)
+		w[i] = W::bswap(W::load(t[i]));
+	for(int i = 8; i < 16; i++)
+		w[i] = W::set1(sha512_pad[i - 8]);
+	for(int i = 16; i < 80; i++)
+	{
+		V x = w[i - 15], y = w[i - 2];
+		V s0 = W::vxor(W::vxor(W::template rotr<1>(x), W::template rotr<8>(x)), W::template shr<7>(x));
+		V s1 = W::vxor(W::vxor(W::template rotr<19>(y), W::template rotr<61>(y)), W::template shr<6>(y));
+		w[i] = W::add(W::add(w[i - 16], s0), W::add(w[i - 7], s1));
+	}
+
+	for(int i = 0; i < 8; i++)
+		s[i] = W::set1(sha512_iv[i]);
+	for(int r = 0; r < 8; r++)
+		sha512_step<W>(s, r, W::add(w[r], W::set1(sha512_k[r])));
+	// the padding words, K512 + W is a constant
+	for(int r = 0; r < 8; r++)
+		sha512_step<W>(s, r, W::set1(sha512_k[8 + r] + sha512_pad[r]));
+	for(int i = 16; i < 80; i += 8)
+	{
+		sha512_step<W>(s, 0, W::add(w[i + 0], W::set1(sha512_k[i + 0])));
+		sha512_step<W>(s, 1, W::add(w[i + 1], W::set1(sha512_k[i + 1])));
+		sha512_step<W>(s, 2, W::add(w[i + 2], W::set1(sha512_k[i + 2])));
+		sha512_step<W>(s, 3, W::add(w[i + 3], W::set1(sha512_k[i + 3])));
+		sha512_step<W>(s, 4, W::add(w[i + 4], W::set1(sha512_k[i + 4])));
+		sha512_step<W>(s, 5, W::add(w[i + 5], W::set1(sha512_k[i + 5])));
+		sha512_step<W>(s, 6, W::add(w[i + 6], W::set1(sha512_k[i + 6])));
+		sha512_step<W>(s, 7, W::add(w[i + 7], W::set1(sha512_k[i + 7])));
+	}
+
+	for(int i = 0; i < 8; i++)
+		W::store(t[i], W::bswap(W::add(s[i], W::set1(sha512_iv[i]))));
+	for(int j = 0; j < W::N; j++)
+		for(int i = 0; i < 8; i++)
+			hash[j * 8 + i] = t[i][j];
+}
+
+void vec_sha512_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for(; i + sha512_wide::N <= count; i += sha512_wide::N)
+		sha512_64_lanes<sha512_wide>(&hash[i * 8]);
+	if(count - i > 1)
+	{
+		// the leftover lanes in a partial vector
+		uint64_t t[sha512_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		sha512_64_lanes<sha512_wide>(t);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		sha512_64_lanes<sha512_x1>(&hash[i * 8]);
+}
+
+#endif
+
+} // namespace CPU_ISA
@@ -0,0 +1,461 @@
+/**
+ * SIMD-512 of the 64-byte lanes with vector arithmetic (see cpu_batch.h)
+ *
+ * The number theoretic transform of sph/simd.c (256 points modulo 257)
+ * and the Feistel steps are the same arithmetic for every lane, so each
+ * element of a vector holds one message: 4 (SSE4.1), 8 (AVX2) or 16
+ * (AVX-512) lanes per call of the rounds, a single lane uses the same
+ * code on scalars. The multiplications of the transform need pmulld,
+ * hence SSE4.1 at least.
+ *
+ * A 64-byte message is one block with a blank upper half, the inputs of
+ * the last two rows of each 8-point transform are zero. The second block
+ * holds the length only (512 bits), the same for all the messages: its
+ * expanded words are the table simd_final_w, as d_cw in
+ * x11/simd_functions.cu.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__SSE4_1__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+static const uint32_t simd_iv512[32] = {
+	0x0BA16B95, 0x72F999AD, 0x9FECC2AE, 0xBA3264FC,
+	0x5E894929, 0x8E9F30E5, 0x2F1DAA37, 0xF0F2C558,
+	0xAC506643, 0xA90635A5, 0xE25B878B, 0xAAB7878F,
+	0x88817F7A, 0x0A02892B, 0x559A7550, 0x598F657E,
+	0x7EEF60A1, 0x6B70E3E8, 0x9C1714D1, 0xB958E2A8,
+	0xAB02675E, 0xED1C014F, 0xCD8D65BB, 0xFDB7A257,
+	0x09254899, 0xD699C7BC, 0x9019B6DC, 0x2B9022E4,
+	0x8FA14956, 0x21BF9BD3, 0xB94D0943, 0x6FFDDC22
+};
+
+/* powers of 41 modulo 257, the twiddles of the transform use the first 128 */
+static const int32_t simd_alpha[128] = {
+	  1,  41, 139,  45,  46,  87, 226,  14,  60, 147, 116, 130,
+	190,  80, 196,  69,   2,  82,  21,  90,  92, 174, 195,  28,
+	120,  37, 232,   3, 123, 160, 135, 138,   4, 164,  42, 180,
+	184,  91, 133,  56, 240,  74, 207,   6, 246,  63,  13,  19,
+	  8,  71,  84, 103, 111, 182,   9, 112, 223, 148, 157,  12,
+	235, 126,  26,  38,  16, 142, 168, 206, 222, 107,  18, 224,
+	189,  39,  57,  24, 213, 252,  52,  76,  32,  27,  79, 155,
+	187, 214,  36, 191, 121,  78, 114,  48, 169, 247, 104, 152,
+	 64,  54, 158,  53, 117, 171,  72, 125, 242, 156, 228,  96,
+	 81, 237, 208,  47, 128, 108,  59, 106, 234,  85, 144, 250,
+	227,  55, 199, 192, 162, 217, 159,  94
+};
+
+/* beta^(255*i) modulo 257, added to the transform of a block which is not the last */
+static const int32_t simd_yoff_n[256] = {
+	  1, 163,  98,  40,  95,  65,  58, 202,  30,   7, 113, 172,
+	 23, 151, 198, 149, 129, 210,  49,  20, 176, 161,  29, 101,
+	 15, 132, 185,  86, 140, 204,  99, 203, 193, 105, 153,  10,
+	 88, 209, 143, 179, 136,  66, 221,  43,  70, 102, 178, 230,
+	225, 181, 205,   5,  44, 233, 200, 218,  68,  33, 239, 150,
+	 35,  51,  89, 115, 241, 219, 231, 131,  22, 245, 100, 109,
+	 34, 145, 248,  75, 146, 154, 173, 186, 249, 238, 244, 194,
+	 11, 251,  50, 183,  17, 201, 124, 166,  73,  77, 215,  93,
+	253, 119, 122,  97, 134, 254,  25, 220, 137, 229,  62,  83,
+	165, 167, 236, 175, 255, 188,  61, 177,  67, 127, 141, 110,
+	197, 243,  31, 170, 211, 212, 118, 216, 256,  94, 159, 217,
+	162, 192, 199,  55, 227, 250, 144,  85, 234, 106,  59, 108,
+	128,  47, 208, 237,  81,  96, 228, 156, 242, 125,  72, 171,
+	117,  53, 158,  54,  64, 152, 104, 247, 169,  48, 114,  78,
+	121, 191,  36, 214, 187, 155,  79,  27,  32,  76,  52, 252,
+	213,  24,  57,  39, 189, 224,  18, 107, 222, 206, 168, 142,
+	 16,  38,  26, 126, 235,  12, 157, 148, 223, 112,   9, 182,
+	111, 103,  84,  71,   8,  19,  13,  63, 246,   6, 207,  74,
+	240,  56, 133,  91, 184, 180,  42, 164,   4, 138, 135, 160,
+	123,   3, 232,  37, 120,  28, 195, 174,  92,  90,  21,  82,
+	  2,  69, 196,  80, 190, 130, 116, 147,  60,  14, 226,  87,
+	 46,  45, 139,  41
+};
+
+/* expanded words of the length block, [round][step][word] */
+static const uint32_t simd_final_w[4][8][8] = {
+	{
+		{ 0x531B1720, 0xAC2CDE09, 0x0B902D87, 0x2369B1F4, 0x2931AA01, 0x02E4B082, 0xC914C914, 0xC1DAE1A6 },
+		{ 0xF18C2B5C, 0x08AC306B, 0x27BFC914, 0xCEDC548D, 0xC630C4BE, 0xF18C4335, 0xF0D3427C, 0xBE3DA380 },
+		{ 0x143C02E4, 0xA948C630, 0xA4F2DE09, 0xA71D2085, 0xA439BD84, 0x109FCD6A, 0xEEA8EF61, 0xA5AB1CE8 },
+		{ 0x0B90D4A4, 0x3D6D039D, 0x25944D53, 0xBAA0E034, 0x5BC71E5A, 0xB1F4F2FE, 0x12CADE09, 0x548D41C3 },
+		{ 0x3CB4F80D, 0x36ECEBC4, 0xA66443EE, 0x43351ABD, 0xC7A20C49, 0xEB0BB366, 0xF5293F98, 0x49B6DE09 },
+		{ 0x531B29EA, 0x02E402E4, 0xDB25C405, 0x53D4E543, 0x0AD71720, 0xE1A61A04, 0xB87534C1, 0x3EDF43EE },
+		{ 0x213E50F0, 0x39173EDF, 0xA9485B0E, 0xEEA82EF9, 0x14F55771, 0xFAF15546, 0x3D6DD9B3, 0xAB73B92E },
+		{ 0x582A48FD, 0xEEA81892, 0x4F7EAA01, 0xAF10A88F, 0x11581720, 0x34C124DB, 0xD1C0AB73, 0x1E5AF0D3 }
+	},
+	{
+		{ 0xC34C07F3, 0xC914143C, 0x599CBC12, 0xBCCBE543, 0x385EF3B7, 0x14F54C9A, 0x0AD7C068, 0xB64A21F7 },
+		{ 0xDEC2AF10, 0xC6E9C121, 0x56B8A4F2, 0x1158D107, 0xEB0BA88F, 0x050FAABA, 0xC293264D, 0x548D46D2 },
+		{ 0xACE5E8E0, 0x53D421F7, 0xF470D279, 0xDC974E0C, 0xD6CF55FF, 0xFD1C4F7E, 0x36EC36EC, 0x3E261E5A },
+		{ 0xEBC4FD1C, 0x56B839D0, 0x5B0E21F7, 0x58E3DF7B, 0x5BC7427C, 0xEF613296, 0x1158109F, 0x5A55E318 },
+		{ 0xA7D6B703, 0x1158E76E, 0xB08255FF, 0x50F05771, 0xEEA8E8E0, 0xCB3FDB25, 0x2E40548D, 0xE1A60F2D },
+		{ 0xACE5D616, 0xFD1CFD1C, 0x24DB3BFB, 0xAC2C1ABD, 0xF529E8E0, 0x1E5AE5FC, 0x478BCB3F, 0xC121BC12 },
+		{ 0xF4702B5C, 0xC293FC63, 0xDA6CB2AD, 0x45601FCC, 0xA439E1A6, 0x4E0C0D02, 0xED3621F7, 0xAB73BE3D },
+		{ 0x0E74D4A4, 0xF754CF95, 0xD84136EC, 0x3124AB73, 0x39D03B42, 0x0E74BCCB, 0x0F2DBD84, 0x41C35C80 }
+	},
+	{
+		{ 0xA4135BED, 0xE10E1EF2, 0x6C4F93B1, 0x6E2191DF, 0xE2E01D20, 0xD1952E6B, 0x6A7D9583, 0x131DECE3 },
+		{ 0x369CC964, 0xFB73048D, 0x9E9D6163, 0x280CD7F4, 0xD9C6263A, 0x1062EF9E, 0x2AC7D539, 0xAD2D52D3 },
+		{ 0x0A03F5FD, 0x197CE684, 0xAA72558E, 0xDE5321AD, 0xF0870F79, 0x607A9F86, 0xAFE85018, 0x2AC7D539 },
+		{ 0xE2E01D20, 0x2AC7D539, 0xC6A93957, 0x624C9DB4, 0x6C4F93B1, 0x641E9BE2, 0x452CBAD4, 0x263AD9C6 },
+		{ 0xC964369C, 0xC3053CFB, 0x452CBAD4, 0x95836A7D, 0x4AA2B55E, 0xAB5B54A5, 0xAC4453BC, 0x74808B80 },
+		{ 0xCB3634CA, 0xFC5C03A4, 0x4B8BB475, 0x21ADDE53, 0xE2E01D20, 0xDF3C20C4, 0xBD8F4271, 0xAA72558E },
+		{ 0xFC5C03A4, 0x48D0B730, 0x2AC7D539, 0xD70B28F5, 0x53BCAC44, 0x3FB6C04A, 0x14EFEB11, 0xDB982468 },
+		{ 0x9A1065F0, 0xB0D14F2F, 0x8D5272AE, 0xC4D73B29, 0x91DF6E21, 0x949A6B66, 0x303DCFC3, 0x5932A6CE }
+	},
+	{
+		{ 0x1234EDCC, 0xF5140AEC, 0xCDF1320F, 0x3DE4C21C, 0x48D0B730, 0x1234EDCC, 0x131DECE3, 0x52D3AD2D },
+		{ 0xE684197C, 0x6D3892C8, 0x72AE8D52, 0x6FF3900D, 0x73978C69, 0xEB1114EF, 0x15D8EA28, 0x71C58E3B },
+		{ 0x90F66F0A, 0x15D8EA28, 0x9BE2641E, 0x65F09A10, 0xEA2815D8, 0xBD8F4271, 0x3A40C5C0, 0xD9C6263A },
+		{ 0xB38C4C74, 0xBAD4452C, 0x70DC8F24, 0xAB5B54A5, 0x46FEB902, 0x1A65E59B, 0x0DA7F259, 0xA32A5CD6 },
+		{ 0xD62229DE, 0xB81947E7, 0x6D3892C8, 0x15D8EA28, 0xE59B1A65, 0x065FF9A1, 0xB2A34D5D, 0x6A7D9583 },
+		{ 0x975568AB, 0xFC5C03A4, 0x2E6BD195, 0x966C6994, 0xF2590DA7, 0x263AD9C6, 0x5A1BA5E5, 0xB0D14F2F },
+		{ 0x975568AB, 0x6994966C, 0xF1700E90, 0xD3672C99, 0xCC1F33E1, 0xFC5C03A4, 0x452CBAD4, 0x4E46B1BA },
+		{ 0xF1700E90, 0xB2A34D5D, 0xD0AC2F54, 0x5760A8A0, 0x8C697397, 0x624C9DB4, 0xE85617AA, 0x95836A7D }
+	}
+};
+
+/* rotations of the 4 rounds, the steps use (p0, p1), (p1, p2), (p2, p3), (p3, p0) twice */
+static const int simd_rot[4][4] = {
+	{  3, 23, 17, 27 }, { 28, 19, 22,  7 }, { 29,  9, 15,  5 }, {  4, 13, 10, 25 }
+};
+
+/* the word of step k is added to the A word of index n ^ simd_pp[k % 7] */
+static const int simd_pp[7] = { 1, 6, 2, 3, 5, 7, 4 };
+
+/* 32-bit lanes of the vector types, signed for the transform */
+
+struct simd_x1 {
+	typedef uint32_t V;
+	enum { N = 1 };
+	static inline V set1(uint32_t a) { return a; }
+	static inline V load(const uint32_t *p) { return *p; }
+	static inline void store(uint32_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V vand(V a, V b) { return a & b; }
+	static inline V add(V a, V b) { return a + b; }
+	static inline V sub(V a, V b) { return a - b; }
+	static inline V mul(V a, V b) { return a * b; }
+	static inline V shl(V a, int n) { return a << n; }
+	static inline V shr(V a, int n) { return a >> n; }
+	static inline V sar(V a, int n) { return (uint32_t)((int32_t)a >> n); }
+	static inline V rotl(V a, int n) { return (a << n) | (a >> (32 - n)); }
+	static inline V vif(V x, V y, V z) { return ((y ^ z) & x) ^ z; }
+	static inline V vmaj(V x, V y, V z) { return (x & y) | ((x | y) & z); }
+	/* from -1..257 to -128..128 */
+	static inline V center(V a) { return (int32_t)a <= 128 ? a : a - 257; }
+};
+
+#if defined(__AVX512F__)
+struct simd_x16 {
+	typedef __m512i V;
+	enum { N = 16 };
+	static inline V set1(uint32_t a) { return _mm512_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint32_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V vand(V a, V b) { return _mm512_and_si512(a, b); }
+	static inline V add(V a, V b) { return _mm512_add_epi32(a, b); }
+	static inline V sub(V a, V b) { return _mm512_sub_epi32(a, b); }
+	static inline V mul(V a, V b) { return _mm512_mullo_epi32(a, b); }
+	static inline V shl(V a, int n) { return _mm512_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V shr(V a, int n) { return _mm512_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V sar(V a, int n) { return _mm512_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V rotl(V a, int n) { return _mm512_rolv_epi32(a, set1(n)); }
+	static inline V vif(V x, V y, V z) { return _mm512_ternarylogic_epi32(x, y, z, 0xca); }
+	static inline V vmaj(V x, V y, V z) { return _mm512_ternarylogic_epi32(x, y, z, 0xe8); }
+	static inline V center(V a) { return _mm512_mask_sub_epi32(a, _mm512_cmpgt_epi32_mask(a, set1(128)), a, set1(257)); }
+};
+typedef simd_x16 simd_wide;
+#elif defined(__AVX2__)
+struct simd_x8 {
+	typedef __m256i V;
+	enum { N = 8 };
+	static inline V set1(uint32_t a) { return _mm256_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V vand(V a, V b) { return _mm256_and_si256(a, b); }
+	static inline V add(V a, V b) { return _mm256_add_epi32(a, b); }
+	static inline V sub(V a, V b) { return _mm256_sub_epi32(a, b); }
+	static inline V mul(V a, V b) { return _mm256_mullo_epi32(a, b); }
+	static inline V shl(V a, int n) { return _mm256_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V shr(V a, int n) { return _mm256_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V sar(V a, int n) { return _mm256_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V rotl(V a, int n) { return _mm256_or_si256(shl(a, n), shr(a, 32 - n)); }
+	static inline V vif(V x, V y, V z) { return _mm256_xor_si256(_mm256_and_si256(_mm256_xor_si256(y, z), x), z); }
+	static inline V vmaj(V x, V y, V z) { return _mm256_or_si256(_mm256_and_si256(x, y), _mm256_and_si256(_mm256_or_si256(x, y), z)); }
+	static inline V center(V a) { return _mm256_sub_epi32(a, _mm256_and_si256(_mm256_cmpgt_epi32(a, set1(128)), set1(257))); }
+};
+typedef simd_x8 simd_wide;
+#elif defined(__SSE4_1__)
+struct simd_x4 {
+	typedef __m128i V;
+	enum { N = 4 };
+	static inline V set1(uint32_t a) { return _mm_set1_epi32((int)a); }
+	static inline V load(const uint32_t *p) { return _mm_loadu_si128((const __m128i *)p); }
+	static inline void store(uint32_t *p, V a) { _mm_storeu_si128((__m128i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm_xor_si128(a, b); }
+	static inline V vand(V a, V b) { return _mm_and_si128(a, b); }
+	static inline V add(V a, V b) { return _mm_add_epi32(a, b); }
+	static inline V sub(V a, V b) { return _mm_sub_epi32(a, b); }
+	static inline V mul(V a, V b) { return _mm_mullo_epi32(a, b); }
+	static inline V shl(V a, int n) { return _mm_sll_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V shr(V a, int n) { return _mm_srl_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V sar(V a, int n) { return _mm_sra_epi32(a, _mm_cvtsi32_si128(n)); }
+	static inline V rotl(V a, int n) { return _mm_or_si128(shl(a, n), shr(a, 32 - n)); }
+	static inline V vif(V x, V y, V z) { return _mm_xor_si128(_mm_and_si128(_mm_xor_si128(y, z), x), z); }
+	static inline V vmaj(V x, V y, V z) { return _mm_or_si128(_mm_and_si128(x, y), _mm_and_si128(_mm_or_si128(x, y), z)); }
+	static inline V center(V a) { return _mm_sub_epi32(a, _mm_and_si128(_mm_cmpgt_epi32(a, set1(128)), set1(257))); }
+};
+typedef simd_x4 simd_wide;
+#endif
+
+#if defined(CPU_BATCH_SIMD)
+
+/* REDS1 and REDS2 of sph/simd.c, partial reductions modulo 257 */
+template<class W>
+static inline typename W::V simd_reds1(typename W::V x)
+{
+	return W::sub(W::vand(x, W::set1(0xff)), W::sar(x, 8));
+}
+
+template<class W>
+static inline typename W::V simd_reds2(typename W::V x)
+{
+	return W::add(W::vand(x, W::set1(0xffff)), W::sar(x, 16));
+}
+
+/* FFT8 with the inputs x2 and x3 at zero, they are in the blank half of the block */
+template<class W>
+static inline void simd_fft8(typename W::V *d, typename W::V x0, typename W::V x1)
+{
+	typedef typename W::V V;
+	V b1 = simd_reds1<W>(W::shl(x1, 2));
+	V b2 = W::shl(x1, 4);
+	V b3 = simd_reds1<W>(W::shl(x1, 6));
+
+	d[0] = W::add(x0, x1);
+	d[1] = W::add(x0, b1);
+	d[2] = W::add(x0, b2);
+	d[3] = W::add(x0, b3);
+	d[4] = W::sub(x0, x1);
+	d[5] = W::sub(x0, b1);
+	d[6] = W::sub(x0, b2);
+	d[7] = W::sub(x0, b3);
+}
+
+/* alpha is 2 for 16 points, the twiddles are shifts */
+template<class W>
+static inline void simd_fft16(typename W::V *q, const typename W::V *x, int xb, int xs)
+{
+	typename W::V d1[8], d2[8];
+
+	simd_fft8<W>(d1, x[xb], x[xb + 2 * xs]);
+	simd_fft8<W>(d2, x[xb + xs], x[xb + 3 * xs]);
+	for(int i = 0; i < 8; i++)
+	{
+		typename W::V t = W::shl(d2[i], i);
+		q[i] = W::add(d1[i], t);
+		q[i + 8] = W::sub(d1[i], t);
+	}
+}
+
+/* FFT_LOOP: merges the two halves of 2 * hk points */
+template<class W>
+static inline void simd_fft_loop(typename W::V *q, int hk, int as)
+{
+	typedef typename W::V V;
+	V m = q[0], n = q[hk];
+
+	q[0] = W::add(m, n);
+	q[hk] = W::sub(m, n);
+	for(int u = 1; u < hk; u++)
+	{
+		m = q[u];
+		n = simd_reds2<W>(W::mul(q[u + hk], W::set1(simd_alpha[u * as])));
+		q[u] = W::add(m, n);
+		q[u + hk] = W::sub(m, n);
+	}
+}
+
+template<class W>
+static void simd_fft64(typename W::V *q, const typename W::V *x, int xb, int xs)
+{
+	for(int h = 0; h < 2; h++)
+	{
+		typename W::V *r = &q[32 * h];
+		const int b = xb + h * xs;
+		simd_fft16<W>(r, x, b, 4 * xs);
+		simd_fft16<W>(r + 16, x, b + 2 * xs, 4 * xs);
+		simd_fft_loop<W>(r, 16, 8);
+	}
+	simd_fft_loop<W>(q, 32, 4);
+}
+
+/* FFT256 of the bytes x[0..63], then the offsets of a first block, q in -128..128 */
+template<class W>
+static inline void simd_fft256(typename W::V *q, const typename W::V *x)
+{
+	simd_fft64<W>(&q[0], x, 0, 4);
+	simd_fft64<W>(&q[64], x, 2, 4);
+	simd_fft_loop<W>(&q[0], 64, 2);
+	simd_fft64<W>(&q[128], x, 1, 4);
+	simd_fft64<W>(&q[192], x, 3, 4);
+	simd_fft_loop<W>(&q[128], 64, 2);
+	simd_fft_loop<W>(&q[0], 128, 1);
+	for(int i = 0; i < 256; i++)
+	{
+		typename W::V t = W::add(q[i], W::set1(simd_yoff_n[i]));
+		t = simd_reds1<W>(simd_reds1<W>(simd_reds2<W>(t)));
+		q[i] = W::center(t);
+	}
+}
+
+/* message words of step j of round ri (W_BIG), q is NULL for the length block */
+template<class W>
+static inline void simd_expand(typename W::V *w, const typename W::V *q, int ri, int j)
+{
+	static const int sb[4][8] = {
+		{  4,  6,  0,  2,  7,  5,  3,  1 }, { 15, 11, 12,  8,  9, 13, 10, 14 },
+		{  1,  2,  7,  4,  6,  5,  0,  3 }, {  6,  0,  1,  7,  3,  5,  4,  2 }
+	};
+	// rounds 2 and 3 pair q[i] with q[i + 128] instead of q[i + 1]
+	static const int o1[4] = { 0, 0, 0, 1 }, o2[4] = { 1, 1, 128, 129 };
+	const uint32_t mm = ri < 2 ? 185 : 233;
+
+	if(!q)
+	{
+		for(int k = 0; k < 8; k++)
+			w[k] = W::set1(simd_final_w[ri][j][k]);
+		return;
+	}
+	const typename W::V *p = &q[16 * sb[ri][j]];
+	for(int k = 0; k < 8; k++)
+	{
+		typename W::V l = W::mul(p[2 * k + o1[ri]], W::set1(mm));
+		typename W::V h = W::mul(p[2 * k + o2[ri]], W::set1(mm));
+		w[k] = W::add(W::vand(l, W::set1(0xffff)), W::shl(h, 16));
+	}
+}
+
+/* STEP_BIG: the 8 Feistel ladders A, B, C, D, s[0..7] is A */
+template<class W, bool maj>
+static inline void simd_step(typename W::V *s, const typename W::V *w, int r, int t, int pp)
+{
+	typedef typename W::V V;
+	V *A = s, *B = s + 8, *C = s + 16, *D = s + 24;
+	V tA[8];
+
+	for(int n = 0; n < 8; n++)
+		tA[n] = W::rotl(A[n], r);
+	for(int n = 0; n < 8; n++)
+	{
+		V f = maj ? W::vmaj(A[n], B[n], C[n]) : W::vif(A[n], B[n], C[n]);
+		V tt = W::add(W::add(D[n], w[n]), f);
+		A[n] = W::add(W::rotl(tt, t), tA[n ^ pp]);
+		D[n] = C[n];
+		C[n] = B[n];
+		B[n] = tA[n];
+	}
+}
+
+template<class W>
+static inline void simd_round(typename W::V *s, const typename W::V *q, int ri)
+{
+	const int *p = simd_rot[ri];
+	typename W::V w[8];
+
+	for(int j = 0; j < 8; j++)
+	{
+		simd_expand<W>(w, q, ri, j);
+		if(j < 4)
+			simd_step<W, false>(s, w, p[j & 3], p[(j + 1) & 3], simd_pp[(ri + j) % 7]);
+		else
+			simd_step<W, true>(s, w, p[j & 3], p[(j + 1) & 3], simd_pp[(ri + j) % 7]);
+	}
+}
+
+/* compression of the block already xored in s, v is the state before it */
+template<class W>
+static inline void simd_compress(typename W::V *s, const typename W::V *q, const typename W::V *v)
+{
+	for(int ri = 0; ri < 4; ri++)
+		simd_round<W>(s, q, ri);
+	simd_step<W, false>(s, &v[0], 4, 13, 5);
+	simd_step<W, false>(s, &v[8], 13, 10, 7);
+	simd_step<W, false>(s, &v[16], 10, 25, 4);
+	simd_step<W, false>(s, &v[24], 25, 4, 1);
+}
+
+/* W::N contiguous lanes */
+template<class W>
+static inline void simd512_64_lanes(uint64_t *hash)
+{
+	typedef typename W::V V;
+	uint32_t t[16][W::N];
+	V m[16], x[64], q[256], s[32], v[32];
+
+	for(int j = 0; j < W::N; j++)
+	{
+		const uint32_t *h32 = (const uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			t[i][j] = h32[i];
+	}
+	for(int i = 0; i < 16; i++)
+		m[i] = W::load(t[i]);
+	// the bytes of the block, little endian
+	for(int i = 0; i < 64; i++)
+		x[i] = W::vand(W::shr(m[i >> 2], 8 * (i & 3)), W::set1(0xff));
+	simd_fft256<W>(q, x);
+
+	for(int i = 0; i < 32; i++)
+		v[i] = W::set1(simd_iv512[i]);
+	for(int i = 0; i < 16; i++)
+		s[i] = W::vxor(v[i], m[i]);
+	for(int i = 16; i < 32; i++)
+		s[i] = v[i];
+	simd_compress<W>(s, q, v);
+
+	// length block: 512 in the first word
+	memcpy(v, s, sizeof(v));
+	s[0] = W::vxor(s[0], W::set1(512));
+	simd_compress<W>(s, NULL, v);
+
+	for(int i = 0; i < 16; i++)
+		W::store(t[i], s[i]);
+	for(int j = 0; j < W::N; j++)
+	{
+		uint32_t *h32 = (uint32_t *)&hash[j * 8];
+		for(int i = 0; i < 16; i++)
+			h32[i] = t[i][j];
+	}
+}
+
+void vec_simd512_64(uint64_t *hash, uint32_t count)
+{
+	uint32_t i = 0;
+
+	for(; i + simd_wide::N <= count; i += simd_wide::N)
+		simd512_64_lanes<simd_wide>(&hash[i * 8]);
+	if(count - i > 1)
+	{
+		// the leftover lanes in a partial vector
+		uint64_t t[simd_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		simd512_64_lanes<simd_wide>(t);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		simd512_64_lanes<simd_x1>(&hash[i * 8]);
+}
+
+#endif
+
+} // namespace CPU_ISA
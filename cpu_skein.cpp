@@ -0,0 +1,271 @@
+/**
+ * Skein-512 header kernel of skeincoin, one nonce per 64-bit vector lane
+ *
+ * The 80-byte header is two UBI blocks. The first one does not depend
+ * on the nonce, its chaining value is computed once per work (set_block
+ * of the cpu backend, see cpu_precalc_fn) with the key injection and
+ * the first round of the second block, except the words mixed with the
+ * nonce. An iteration then runs the rest of the second block and the
+ * output block on 8 (AVX-512) or 4 (AVX2) nonces, one per 64-bit
+ * element, on scalars below AVX2.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+/* layout of the precalc words */
+#define SKEIN_PRE_H   0  /* chaining value after the first block */
+#define SKEIN_PRE_P  16  /* words 2..7 of the second block after its first round */
+#define SKEIN_PRE_C  28  /* words 0 and 1 after the key injection, nonce 0 */
+
+static const uint64_t skein_iv512[8] = {
+	0x4903ADFF749C51CEULL, 0x0D95DE399746DF03ULL, 0x8FD1934127C79BCEULL, 0x9A255629FF352CB1ULL,
+	0x5DB62599DF6CA7B0ULL, 0xEABE394CA9D5C3F4ULL, 0x991112C71A75B523ULL, 0xAE18A40B660FCC33ULL
+};
+
+/* tweaks: position (bytes) and first/final flags with the block type */
+#define SKEIN_T1_MSG_FIRST  0x7000000000000000ULL
+#define SKEIN_T1_MSG_FINAL  0xB000000000000000ULL
+#define SKEIN_T1_OUT        0xFF00000000000000ULL
+
+/* 64-bit lanes of the vector types */
+
+struct skein_x1 {
+	typedef uint64_t V;
+	enum { N = 1 };
+	static inline V set1(uint64_t a) { return a; }
+	static inline V load(const uint64_t *p) { return *p; }
+	static inline void store(uint64_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	static inline V add(V a, V b) { return a + b; }
+	template<int n> static inline V rotl(V a) { return (a << n) | (a >> (64 - n)); }
+};
+
+#if defined(__AVX512F__)
+struct skein_x8 {
+	typedef __m512i V;
+	enum { N = 8 };
+	static inline V set1(uint64_t a) { return _mm512_set1_epi64((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint64_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V add(V a, V b) { return _mm512_add_epi64(a, b); }
+	template<int n> static inline V rotl(V a) { return _mm512_rol_epi64(a, n); }
+};
+typedef skein_x8 skein_wide;
+#elif defined(__AVX2__)
+struct skein_x4 {
+	typedef __m256i V;
+	enum { N = 4 };
+	static inline V set1(uint64_t a) { return _mm256_set1_epi64x((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint64_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	static inline V add(V a, V b) { return _mm256_add_epi64(a, b); }
+	template<int n> static inline V rotl(V a) { return _mm256_or_si256(_mm256_slli_epi64(a, n), _mm256_srli_epi64(a, 64 - n)); }
+};
+typedef skein_x4 skein_wide;
+#else
+typedef skein_x1 skein_wide;
+#endif
+
+/* Threefish-512 */
+
+template<class W, int r>
+static inline void skein_mix(typename W::V &x0, typename W::V &x1)
+{
+	x0 = W::add(x0, x1);
+	x1 = W::vxor(W::template rotl<r>(x1), x0);
+}
+
+/* one round on the word pairs of its permutation */
+template<class W, int r0, int r1, int r2, int r3>
+static inline void skein_round(typename W::V &w0, typename W::V &w1, typename W::V &w2, typename W::V &w3,
+	typename W::V &w4, typename W::V &w5, typename W::V &w6, typename W::V &w7)
+{
+	skein_mix<W, r0>(w0, w1);
+	skein_mix<W, r1>(w2, w3);
+	skein_mix<W, r2>(w4, w5);
+	skein_mix<W, r3>(w6, w7);
+}
+
+/* subkey s, k has the 9 words of the extended key, t the 3 of the tweak */
+template<class W, int s>
+static inline void skein_addkey(typename W::V *p, const typename W::V *k, const typename W::V *t)
+{
+	for(int i = 0; i < 5; i++)
+		p[i] = W::add(p[i], k[(s + i) % 9]);
+	p[5] = W::add(p[5], W::add(k[(s + 5) % 9], t[s % 3]));
+	p[6] = W::add(p[6], W::add(k[(s + 6) % 9], t[(s + 1) % 3]));
+	p[7] = W::add(p[7], W::add(k[(s + 7) % 9], W::set1(s)));
+}
+
+/* rounds 1 to 3 of the 8, after the first one */
+template<class W>
+static inline void skein_rounds_1_3(typename W::V *p)
+{
+	skein_round<W, 33, 27, 14, 42>(p[2], p[1], p[4], p[7], p[6], p[5], p[0], p[3]);
+	skein_round<W, 17, 49, 36, 39>(p[4], p[1], p[6], p[3], p[0], p[5], p[2], p[7]);
+	skein_round<W, 44,  9, 54, 56>(p[6], p[1], p[0], p[7], p[2], p[5], p[4], p[3]);
+}
+
+template<class W>
+static inline void skein_rounds_4_7(typename W::V *p)
+{
+	skein_round<W, 39, 30, 34, 24>(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+	skein_round<W, 13, 50, 10, 17>(p[2], p[1], p[4], p[7], p[6], p[5], p[0], p[3]);
+	skein_round<W, 25, 29, 39, 43>(p[4], p[1], p[6], p[3], p[0], p[5], p[2], p[7]);
+	skein_round<W,  8, 35, 56, 22>(p[6], p[1], p[0], p[7], p[2], p[5], p[4], p[3]);
+}
+
+template<class W, int s>
+static inline void skein_8rounds(typename W::V *p, const typename W::V *k, const typename W::V *t)
+{
+	skein_addkey<W, s>(p, k, t);
+	skein_round<W, 46, 36, 19, 37>(p[0], p[1], p[2], p[3], p[4], p[5], p[6], p[7]);
+	skein_rounds_1_3<W>(p);
+	skein_addkey<W, s + 1>(p, k, t);
+	skein_rounds_4_7<W>(p);
+}
+
+/* rounds 8 to 71 and the last subkey */
+template<class W>
+static inline void skein_rounds_8_71(typename W::V *p, const typename W::V *k, const typename W::V *t)
+{
+	skein_8rounds<W, 2>(p, k, t);
+	skein_8rounds<W, 4>(p, k, t);
+	skein_8rounds<W, 6>(p, k, t);
+	skein_8rounds<W, 8>(p, k, t);
+	skein_8rounds<W, 10>(p, k, t);
+	skein_8rounds<W, 12>(p, k, t);
+	skein_8rounds<W, 14>(p, k, t);
+	skein_8rounds<W, 16>(p, k, t);
+	skein_addkey<W, 18>(p, k, t);
+}
+
+template<class W>
+static inline void skein_key(typename W::V *k, typename W::V *t, const typename W::V *h, uint64_t t0, uint64_t t1)
+{
+	k[8] = W::set1(0x1BD11BDAA9FC1A22ULL);
+	for(int i = 0; i < 8; i++)
+	{
+		k[i] = h[i];
+		k[8] = W::vxor(k[8], h[i]);
+	}
+	t[0] = W::set1(t0);
+	t[1] = W::set1(t1);
+	t[2] = W::set1(t0 ^ t1);
+}
+
+/* h = E(h, t, m) ^ m of a block */
+template<class W>
+static inline void skein_ubi(typename W::V *h, const typename W::V *m, uint64_t t0, uint64_t t1)
+{
+	typedef typename W::V V;
+	V k[9], t[3], p[8];
+
+	skein_key<W>(k, t, h, t0, t1);
+	for(int i = 0; i < 8; i++)
+		p[i] = m[i];
+	skein_8rounds<W, 0>(p, k, t);
+	skein_rounds_8_71<W>(p, k, t);
+	for(int i = 0; i < 8; i++)
+		h[i] = W::vxor(p[i], m[i]);
+}
+
+static void skein_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	uint64_t h[8], m[8], k[9], t[3], p[8];
+
+	memcpy(m, endiandata, 64);
+	memcpy(h, skein_iv512, sizeof(h));
+	skein_ubi<skein_x1>(h, m, 64, SKEIN_T1_MSG_FIRST);
+
+	// the second block up to what the nonce changes
+	memset(m, 0, sizeof(m));
+	memcpy(m, &endiandata[16], 12);
+	skein_key<skein_x1>(k, t, h, 80, SKEIN_T1_MSG_FINAL);
+	memcpy(p, m, sizeof(p));
+	skein_addkey<skein_x1, 0>(p, k, t);
+	skein_mix<skein_x1, 36>(p[2], p[3]);
+	skein_mix<skein_x1, 19>(p[4], p[5]);
+	skein_mix<skein_x1, 37>(p[6], p[7]);
+
+	memcpy(&precalc[SKEIN_PRE_H], h, 64);
+	memcpy(&precalc[SKEIN_PRE_P], &p[2], 48);
+	memcpy(&precalc[SKEIN_PRE_C], p, 16);
+}
+
+/* W::N nonces, the 64-byte Skein-512 hash in the lanes */
+template<class W>
+static inline void skein512_80_lanes(uint64_t *hash, const uint64_t *pre, const uint64_t *m, const uint32_t *nonce)
+{
+	typedef typename W::V V;
+	uint64_t t1[8][W::N];
+	V h[8], k[9], t[3], p[8], mn;
+
+	// the nonce is the high half of message word 1, big endian
+	for(int j = 0; j < W::N; j++)
+		t1[0][j] = (uint64_t)swab32(nonce[j]) << 32;
+	mn = W::load(t1[0]);
+
+	for(int i = 0; i < 8; i++)
+		h[i] = W::set1(pre[SKEIN_PRE_H / 2 + i]);
+	skein_key<W>(k, t, h, 80, SKEIN_T1_MSG_FINAL);
+	p[0] = W::set1(pre[SKEIN_PRE_C / 2]);
+	p[1] = W::add(W::set1(pre[SKEIN_PRE_C / 2 + 1]), mn);
+	for(int i = 2; i < 8; i++)
+		p[i] = W::set1(pre[SKEIN_PRE_P / 2 + i - 2]);
+	skein_mix<W, 46>(p[0], p[1]);
+	skein_rounds_1_3<W>(p);
+	skein_addkey<W, 1>(p, k, t);
+	skein_rounds_4_7<W>(p);
+	skein_rounds_8_71<W>(p, k, t);
+	h[0] = W::vxor(p[0], W::set1(m[0]));
+	h[1] = W::vxor(p[1], W::vxor(W::set1(m[1]), mn));
+	for(int i = 2; i < 8; i++)
+		h[i] = p[i];
+
+	// output block: counter 0, 8 bytes
+	skein_key<W>(k, t, h, 8, SKEIN_T1_OUT);
+	for(int i = 0; i < 8; i++)
+		p[i] = W::set1(0);
+	skein_8rounds<W, 0>(p, k, t);
+	skein_rounds_8_71<W>(p, k, t);
+
+	for(int i = 0; i < 8; i++)
+		W::store(t1[i], p[i]);
+	for(int j = 0; j < W::N; j++)
+		for(int i = 0; i < 8; i++)
+			hash[j * 8 + i] = t1[i][j];
+}
+
+void vec_skein512_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	skein_precalc(precalc, endiandata);
+}
+
+void vec_skein512_80(uint64_t *hash, const uint32_t *precalc, const uint32_t *nonce, uint32_t count)
+{
+	uint64_t pre[CPU_PRECALC_WORDS / 2], m[2];
+	uint32_t i = 0;
+
+	memcpy(pre, precalc, sizeof(pre));
+	// message words 0 and 1 of the second block for its feed forward,
+	// nonce 0: the key injection added the chaining value to them
+	m[0] = pre[SKEIN_PRE_C / 2] - pre[SKEIN_PRE_H / 2];
+	m[1] = pre[SKEIN_PRE_C / 2 + 1] - pre[SKEIN_PRE_H / 2 + 1];
+	for(; i + skein_wide::N <= count; i += skein_wide::N)
+		skein512_80_lanes<skein_wide>(&hash[i * 8], pre, m, &nonce[i]);
+	for(; i < count; i++)
+		skein512_80_lanes<skein_x1>(&hash[i * 8], pre, m, &nonce[i]);
+}
+
+} // namespace CPU_ISA
@@ -0,0 +1,29 @@
+/**
+ * Skeincoin on the cpu: Skein-512 of the header from its midstate
+ * (cpu_hash.skein512_*, cpu_skein.cpp), then the batched SHA-256 of the
+ * 64-byte hashes (cpu_hash.sha256). cpu_lanes_check tests the top word
+ * of the target before the others.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void skein_cpu_precalc(uint32_t *precalc, const uint32_t *endiandata)
+{
+	cpu_hash.skein512_precalc(precalc, endiandata);
+}
+
+void skein_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	uint32_t local[CPU_PRECALC_WORDS];
+	const uint32_t *pre = l->precalc;
+
+	if(!pre)
+	{
+		cpu_hash.skein512_precalc(local, endiandata);
+		pre = local;
+	}
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.skein512_80(l->hash, pre, l->nonce, l->count);
+	cpu_hash.sha256(l->hash, l->count);
+}
@@ -0,0 +1,459 @@
+/**
+ * Whirlpool without the big tables: whirlpool (x15, x17, whirlpoolx)
+ * and whirlpool1 (whirlcoin) of the 64-byte lanes and of the 80-byte
+ * header (see cpu_batch.h)
+ *
+ * sph does a round with eight 2 KB tables of 64-bit words, 16 KB for
+ * each variant, which compete for L1 with the other stages of a chain.
+ * Here the S-box is computed from its three 4-bit mini boxes with
+ * vpshufb (or looked up in 256 bytes with vpermi2b on AVX-512 VBMI),
+ * and MixRows multiplies by the circulant matrix with byte rotations and
+ * doublings. A row of the state is a 64-bit word, so a vector holds the
+ * same row of 4 (AVX2) or 8 (AVX-512) lanes. A leftover lane and the
+ * key schedule use one 2 KB table per variant with byte rotations, in
+ * place of the eight tables of sph.
+ *
+ * When the chaining value is the same for all the lanes (first block of
+ * a 64-byte hash, second block of the header) the key schedule is done
+ * once, only the state rounds are run for each lane.
+ */
+#include <string.h>
+
+#include "miner.h"
+#include "cpu_kernels.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#endif
+
+namespace CPU_ISA {
+
+#define WHIRL_ROUNDS 10
+
+/* the matrices of MixRows, cir(1, 1, 4, 1, 8, 5, 2, 9) and cir(1, 1, 3, 1, 5, 8, 9, 5) */
+#define WHIRL_PLAIN 0
+#define WHIRL_T     1
+
+/* mini boxes of the S-box */
+static const uint8_t whirl_e[16] = { 0x1, 0xB, 0x9, 0xC, 0xD, 0x6, 0xF, 0x3, 0xE, 0x8, 0x7, 0x4, 0xA, 0x2, 0x5, 0x0 };
+static const uint8_t whirl_r[16] = { 0x7, 0xC, 0xB, 0xD, 0xE, 0x4, 0x9, 0xF, 0x6, 0x3, 0x8, 0xA, 0x2, 0x5, 0x1, 0x0 };
+
+/*
+ * The tables are filled by avx_whirlpool_init() from cpu_kernels_set()
+ * of the level in use. Constructors would run at load, built with the
+ * instructions of every level.
+ */
+static struct whirl_consts {
+	uint8_t sbox[256];
+	uint8_t e_inv[16];
+	uint8_t e_hi[16];   /* E << 4 */
+	uint64_t rc[WHIRL_ROUNDS];
+} whirl;
+
+/* 64-bit lanes of the vector types, the same few operations on each */
+
+struct whirl_x1 {
+	typedef uint64_t V;
+	enum { N = 1 };
+	static inline V set1(uint64_t a) { return a; }
+	static inline V load(const uint64_t *p) { return *p; }
+	static inline void store(uint64_t *p, V a) { *p = a; }
+	static inline V vxor(V a, V b) { return a ^ b; }
+	/* the byte j of a row moves to j + n */
+	template<int n> static inline V rot(V a) { return n ? (a << (8 * n)) | (a >> (64 - 8 * n)) : a; }
+	static inline V xtime(V a)
+	{
+		const V hi = (a >> 7) & 0x0101010101010101ULL;
+		return ((a & 0x7f7f7f7f7f7f7f7fULL) << 1) ^ (hi * 0x1d);
+	}
+};
+
+#if defined(__AVX512F__) && defined(__AVX512BW__)
+struct whirl_x8 {
+	typedef __m512i V;
+	enum { N = 8 };
+	static inline V set1(uint64_t a) { return _mm512_set1_epi64((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm512_loadu_si512((const void *)p); }
+	static inline void store(uint64_t *p, V a) { _mm512_storeu_si512((void *)p, a); }
+	static inline V vxor(V a, V b) { return _mm512_xor_si512(a, b); }
+	static inline V sel(V m, V a, V b) { return _mm512_ternarylogic_epi64(m, a, b, 0xCA); }
+	template<int n> static inline V rot(V a) { return _mm512_rol_epi64(a, 8 * n); }
+	static inline V xtime(V a)
+	{
+		const V hi = _mm512_maskz_mov_epi8(_mm512_movepi8_mask(a), _mm512_set1_epi8(0x1d));
+		return _mm512_xor_si512(_mm512_add_epi8(a, a), hi);
+	}
+#if defined(__AVX512VBMI__)
+	/* 256-byte lookup: bit 7 of the index picks one of two 128-byte vpermi2b */
+	static inline V sbox(V a)
+	{
+		const __m512i *t = (const __m512i *)whirl.sbox;
+		const V lo = _mm512_permutex2var_epi8(_mm512_loadu_si512(t), a, _mm512_loadu_si512(t + 1));
+		const V hi = _mm512_permutex2var_epi8(_mm512_loadu_si512(t + 2), a, _mm512_loadu_si512(t + 3));
+		return _mm512_mask_blend_epi8(_mm512_movepi8_mask(a), lo, hi);
+	}
+#else
+	static inline V table(const uint8_t *t) { return _mm512_broadcast_i32x4(_mm_loadu_si128((const __m128i *)t)); }
+	static inline V sbox(V a)
+	{
+		const V mask = _mm512_set1_epi8(0x0f);
+		const V u = _mm512_shuffle_epi8(table(whirl_e), _mm512_and_si512(_mm512_srli_epi16(a, 4), mask));
+		const V l = _mm512_shuffle_epi8(table(whirl.e_inv), _mm512_and_si512(a, mask));
+		const V r = _mm512_shuffle_epi8(table(whirl_r), _mm512_xor_si512(u, l));
+		return _mm512_or_si512(_mm512_shuffle_epi8(table(whirl.e_hi), _mm512_xor_si512(u, r)),
+			_mm512_shuffle_epi8(table(whirl.e_inv), _mm512_xor_si512(l, r)));
+	}
+#endif
+};
+typedef whirl_x8 whirl_wide;
+#elif defined(__AVX2__)
+struct whirl_x4 {
+	typedef __m256i V;
+	enum { N = 4 };
+	static inline V set1(uint64_t a) { return _mm256_set1_epi64x((long long)a); }
+	static inline V load(const uint64_t *p) { return _mm256_loadu_si256((const __m256i *)p); }
+	static inline void store(uint64_t *p, V a) { _mm256_storeu_si256((__m256i *)p, a); }
+	static inline V vxor(V a, V b) { return _mm256_xor_si256(a, b); }
+	/* the masks are whole bytes */
+	static inline V sel(V m, V a, V b) { return _mm256_blendv_epi8(b, a, m); }
+	template<int n> static inline V rot(V a)
+	{
+		return _mm256_shuffle_epi8(a, _mm256_setr_epi8(
+			(8 - n) & 7, (9 - n) & 7, (10 - n) & 7, (11 - n) & 7, (12 - n) & 7, (13 - n) & 7, (14 - n) & 7, (15 - n) & 7,
+			8 + ((8 - n) & 7), 8 + ((9 - n) & 7), 8 + ((10 - n) & 7), 8 + ((11 - n) & 7),
+			8 + ((12 - n) & 7), 8 + ((13 - n) & 7), 8 + ((14 - n) & 7), 8 + ((15 - n) & 7),
+			(8 - n) & 7, (9 - n) & 7, (10 - n) & 7, (11 - n) & 7, (12 - n) & 7, (13 - n) & 7, (14 - n) & 7, (15 - n) & 7,
+			8 + ((8 - n) & 7), 8 + ((9 - n) & 7), 8 + ((10 - n) & 7), 8 + ((11 - n) & 7),
+			8 + ((12 - n) & 7), 8 + ((13 - n) & 7), 8 + ((14 - n) & 7), 8 + ((15 - n) & 7)));
+	}
+	static inline V xtime(V a)
+	{
+		const V hi = _mm256_cmpgt_epi8(_mm256_setzero_si256(), a);
+		return _mm256_xor_si256(_mm256_add_epi8(a, a), _mm256_and_si256(hi, _mm256_set1_epi8(0x1d)));
+	}
+	static inline V table(const uint8_t *t) { return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)t)); }
+	static inline V sbox(V a)
+	{
+		const V mask = _mm256_set1_epi8(0x0f);
+		const V u = _mm256_shuffle_epi8(table(whirl_e), _mm256_and_si256(_mm256_srli_epi16(a, 4), mask));
+		const V l = _mm256_shuffle_epi8(table(whirl.e_inv), _mm256_and_si256(a, mask));
+		const V r = _mm256_shuffle_epi8(table(whirl_r), _mm256_xor_si256(u, l));
+		return _mm256_or_si256(_mm256_shuffle_epi8(table(whirl.e_hi), _mm256_xor_si256(u, r)),
+			_mm256_shuffle_epi8(table(whirl.e_inv), _mm256_xor_si256(l, r)));
+	}
+};
+typedef whirl_x4 whirl_wide;
+#else
+typedef whirl_x1 whirl_wide;
+#endif
+
+/* one row times the matrix: the sum of c_n times the row rotated by n bytes, by bit planes */
+template<class W, int M>
+static inline typename W::V whirl_mix(typename W::V x)
+{
+	typedef typename W::V V;
+	const V r1 = W::template rot<1>(x), r2 = W::template rot<2>(x), r3 = W::template rot<3>(x);
+	const V r4 = W::template rot<4>(x), r5 = W::template rot<5>(x), r6 = W::template rot<6>(x);
+	const V r7 = W::template rot<7>(x);
+	V a0, a1, a2, a3;
+
+	if(M == WHIRL_PLAIN)
+	{
+		a0 = W::vxor(W::vxor(W::vxor(x, r1), W::vxor(r3, r5)), r7);
+		a1 = r6;
+		a2 = W::vxor(r2, r5);
+		a3 = W::vxor(r4, r7);
+	}
+	else
+	{
+		a0 = W::vxor(W::vxor(W::vxor(x, r1), W::vxor(r2, r3)), W::vxor(W::vxor(r4, r6), r7));
+		a1 = r2;
+		a2 = W::vxor(r4, r7);
+		a3 = W::vxor(r5, r6);
+	}
+	return W::vxor(a0, W::xtime(W::vxor(a1, W::xtime(W::vxor(a2, W::xtime(a3))))));
+}
+
+/* SubBytes, ShiftColumns (column j down by j rows) and MixRows */
+template<class W, int M>
+static inline void whirl_layer(typename W::V *s)
+{
+	typedef typename W::V V;
+	V t[8];
+
+	for(int i = 0; i < 8; i++)
+		t[i] = W::sbox(s[i]);
+	for(int i = 0; i < 8; i++)
+	{
+		V o = t[i];
+		for(int j = 1; j < 8; j++)
+			o = W::sel(W::set1(0xffULL << (8 * j)), t[(i - j) & 7], o);
+		s[i] = whirl_mix<W, M>(o);
+	}
+}
+
+/*
+ * A single row: MixRows is circulant, so the S-box and the matrix of
+ * byte 0 make one 2 KB table of the variant, byte j is rotated by j
+ */
+static struct whirl_tables {
+	uint64_t t[2][256];
+} whirl_tab;
+
+template<int M>
+static inline void whirl_layer_x1(uint64_t *s)
+{
+	const uint64_t *t = whirl_tab.t[M];
+	uint64_t a[8];
+
+	for(int i = 0; i < 8; i++)
+		a[i] = s[i];
+	for(int i = 0; i < 8; i++)
+	{
+		s[i] = t[a[i] & 0xff]
+			^ whirl_x1::rot<1>(t[(a[(i - 1) & 7] >> 8) & 0xff])
+			^ whirl_x1::rot<2>(t[(a[(i - 2) & 7] >> 16) & 0xff])
+			^ whirl_x1::rot<3>(t[(a[(i - 3) & 7] >> 24) & 0xff])
+			^ whirl_x1::rot<4>(t[(a[(i - 4) & 7] >> 32) & 0xff])
+			^ whirl_x1::rot<5>(t[(a[(i - 5) & 7] >> 40) & 0xff])
+			^ whirl_x1::rot<6>(t[(a[(i - 6) & 7] >> 48) & 0xff])
+			^ whirl_x1::rot<7>(t[a[(i - 7) & 7] >> 56]);
+	}
+}
+
+template<> inline void whirl_layer<whirl_x1, WHIRL_PLAIN>(uint64_t *s)
+{
+	whirl_layer_x1<WHIRL_PLAIN>(s);
+}
+
+template<> inline void whirl_layer<whirl_x1, WHIRL_T>(uint64_t *s)
+{
+	whirl_layer_x1<WHIRL_T>(s);
+}
+
+/* h = E(h, m) ^ h ^ m, the key schedule on each lane */
+template<class W, int M>
+static inline void whirl_compress(typename W::V *h, const typename W::V *m)
+{
+	typename W::V k[8], s[8];
+
+	for(int i = 0; i < 8; i++)
+	{
+		k[i] = h[i];
+		s[i] = W::vxor(m[i], k[i]);
+	}
+	for(int r = 0; r < WHIRL_ROUNDS; r++)
+	{
+		whirl_layer<W, M>(k);
+		k[0] = W::vxor(k[0], W::set1(whirl.rc[r]));
+		whirl_layer<W, M>(s);
+		for(int i = 0; i < 8; i++)
+			s[i] = W::vxor(s[i], k[i]);
+	}
+	for(int i = 0; i < 8; i++)
+		h[i] = W::vxor(h[i], W::vxor(s[i], m[i]));
+}
+
+/* round keys of a chaining value shared by all the lanes, rk[0] is h */
+template<int M>
+static void whirl_keys(uint64_t (*rk)[8], const uint64_t *h)
+{
+	memcpy(rk[0], h, 64);
+	for(int r = 0; r < WHIRL_ROUNDS; r++)
+	{
+		memcpy(rk[r + 1], rk[r], 64);
+		whirl_layer<whirl_x1, M>(rk[r + 1]);
+		rk[r + 1][0] ^= whirl.rc[r];
+	}
+}
+
+/* round keys of the zero chaining value, first block of the 64-byte hashes */
+static struct whirl_zero_keys {
+	uint64_t rk[2][WHIRL_ROUNDS + 1][8];
+} whirl_zero;
+
+void avx_whirlpool_init(void)
+{
+	const uint64_t zero[8] = { 0 };
+
+	for(int i = 0; i < 16; i++)
+	{
+		whirl.e_inv[whirl_e[i]] = (uint8_t)i;
+		whirl.e_hi[i] = (uint8_t)(whirl_e[i] << 4);
+	}
+	for(int x = 0; x < 256; x++)
+	{
+		const uint8_t a = whirl_e[x >> 4], b = whirl.e_inv[x & 15], r = whirl_r[a ^ b];
+		whirl.sbox[x] = (uint8_t)((whirl_e[a ^ r] << 4) | whirl.e_inv[b ^ r]);
+	}
+	// row 0 of the round constants, S(8r) ... S(8r + 7)
+	for(int r = 0; r < WHIRL_ROUNDS; r++)
+	{
+		whirl.rc[r] = 0;
+		for(int j = 0; j < 8; j++)
+			whirl.rc[r] |= (uint64_t)whirl.sbox[8 * r + j] << (8 * j);
+	}
+	for(int x = 0; x < 256; x++)
+	{
+		whirl_tab.t[WHIRL_PLAIN][x] = whirl_mix<whirl_x1, WHIRL_PLAIN>(whirl.sbox[x]);
+		whirl_tab.t[WHIRL_T][x] = whirl_mix<whirl_x1, WHIRL_T>(whirl.sbox[x]);
+	}
+	whirl_keys<WHIRL_PLAIN>(whirl_zero.rk[WHIRL_PLAIN], zero);
+	whirl_keys<WHIRL_T>(whirl_zero.rk[WHIRL_T], zero);
+}
+
+/* whirl_compress() with the round keys of whirl_keys() */
+template<class W, int M>
+static inline void whirl_compress_keys(typename W::V *h, const uint64_t (*rk)[8], const typename W::V *m)
+{
+	typename W::V s[8];
+
+	for(int i = 0; i < 8; i++)
+		s[i] = W::vxor(m[i], W::set1(rk[0][i]));
+	for(int r = 1; r <= WHIRL_ROUNDS; r++)
+	{
+		whirl_layer<W, M>(s);
+		for(int i = 0; i < 8; i++)
+			s[i] = W::vxor(s[i], W::set1(rk[r][i]));
+	}
+	for(int i = 0; i < 8; i++)
+		h[i] = W::vxor(W::set1(rk[0][i]), W::vxor(s[i], m[i]));
+}
+
+/* row k of the W::N lanes of 8 words from 'hash', and back */
+template<class W>
+static inline void whirl_load(typename W::V *v, const uint64_t *hash)
+{
+	uint64_t t[8][W::N];
+	for(int j = 0; j < W::N; j++)
+	{
+		for(int k = 0; k < 8; k++)
+			t[k][j] = hash[j * 8 + k];
+	}
+	for(int k = 0; k < 8; k++)
+		v[k] = W::load(t[k]);
+}
+
+template<class W>
+static inline void whirl_store(uint64_t *hash, const typename W::V *v)
+{
+	uint64_t t[8][W::N];
+	for(int k = 0; k < 8; k++)
+		W::store(t[k], v[k]);
+	for(int j = 0; j < W::N; j++)
+	{
+		for(int k = 0; k < 8; k++)
+			hash[j * 8 + k] = t[k][j];
+	}
+}
+
+/*
+ * 64 bytes: the first block with the zero chaining value (rk0), then
+ * the padding block, 0x80 and the 512 bits length
+ */
+template<class W, int M>
+static inline void whirl_64_lanes(uint64_t *hash, const uint64_t (*rk0)[8])
+{
+	typename W::V m[8], h[8];
+
+	whirl_load<W>(m, hash);
+	whirl_compress_keys<W, M>(h, rk0, m);
+	for(int k = 0; k < 8; k++)
+		m[k] = W::set1(0);
+	m[0] = W::set1(0x80);
+	m[7] = W::set1(0x0002ULL << 48);
+	whirl_compress<W, M>(h, m);
+	whirl_store<W>(hash, h);
+}
+
+/*
+ * 80 bytes: the last 16 with the padding and the 640 bits length, the
+ * round keys (rk) come from the first 64 bytes
+ */
+template<class W, int M>
+static inline void whirl_80_lanes(uint64_t *hash, const uint64_t (*rk)[8], const uint32_t *endiandata, const uint32_t *nonce)
+{
+	typename W::V m[8], h[8];
+	uint64_t t[W::N];
+
+	for(int j = 0; j < W::N; j++)
+		t[j] = endiandata[18] | ((uint64_t)swab32(nonce[j]) << 32);
+	for(int k = 0; k < 8; k++)
+		m[k] = W::set1(0);
+	m[0] = W::set1(endiandata[16] | ((uint64_t)endiandata[17] << 32));
+	m[1] = W::load(t);
+	m[2] = W::set1(0x80);
+	m[7] = W::set1(0x8002ULL << 48);
+	whirl_compress_keys<W, M>(h, rk, m);
+	whirl_store<W>(hash, h);
+}
+
+template<int M>
+static void whirl_64(uint64_t *hash, uint32_t count)
+{
+	const uint64_t (*rk0)[8] = whirl_zero.rk[M];
+	uint32_t i = 0;
+
+	for(; i + whirl_wide::N <= count; i += whirl_wide::N)
+		whirl_64_lanes<whirl_wide, M>(&hash[i * 8], rk0);
+	if(count - i > 1)
+	{
+		// a partial vector is still faster than the lanes one by one
+		uint64_t t[whirl_wide::N * 8] = { 0 };
+		memcpy(t, &hash[i * 8], (count - i) * 64);
+		whirl_64_lanes<whirl_wide, M>(t, rk0);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		whirl_64_lanes<whirl_x1, M>(&hash[i * 8], rk0);
+}
+
+template<int M>
+static void whirl_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	uint64_t rk[WHIRL_ROUNDS + 1][8], h[8] = { 0 }, m[8];
+	uint32_t i = 0;
+
+	for(int k = 0; k < 8; k++)
+		m[k] = endiandata[2 * k] | ((uint64_t)endiandata[2 * k + 1] << 32);
+	whirl_compress<whirl_x1, M>(h, m);
+	whirl_keys<M>(rk, h);
+	for(; i + whirl_wide::N <= count; i += whirl_wide::N)
+		whirl_80_lanes<whirl_wide, M>(&hash[i * 8], rk, endiandata, &nonce[i]);
+	if(count - i > 1)
+	{
+		uint64_t t[whirl_wide::N * 8];
+		uint32_t n[whirl_wide::N] = { 0 };
+		memcpy(n, &nonce[i], (count - i) * sizeof(uint32_t));
+		whirl_80_lanes<whirl_wide, M>(t, rk, endiandata, n);
+		memcpy(&hash[i * 8], t, (count - i) * 64);
+	}
+	else if(i < count)
+		whirl_80_lanes<whirl_x1, M>(&hash[i * 8], rk, endiandata, &nonce[i]);
+}
+
+#if defined(CPU_BATCH_WHIRLPOOL)
+
+void avx_whirlpool_64(uint64_t *hash, uint32_t count)
+{
+	whirl_64<WHIRL_PLAIN>(hash, count);
+}
+
+void avx_whirlpool1_64(uint64_t *hash, uint32_t count)
+{
+	whirl_64<WHIRL_T>(hash, count);
+}
+
+void avx_whirlpool_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	whirl_80<WHIRL_PLAIN>(hash, endiandata, nonce, count);
+}
+
+void avx_whirlpool1_80(uint64_t *hash, const uint32_t *endiandata, const uint32_t *nonce, uint32_t count)
+{
+	whirl_80<WHIRL_T>(hash, endiandata, nonce, count);
+}
+
+#endif
+
+} // namespace CPU_ISA
@@ -20,6 +20,7 @@ using namespace std;
 #include "miner.h"
 
 #include "cuda_runtime.h"
+#include "mockdev.h"
 
 cudaDeviceProp device_props[MAX_GPUS];
 cudaStream_t gpustream[MAX_GPUS] = { 0 };
@@ -63,7 +64,8 @@ int cuda_version()
 void cuda_devicenames()
 {
 	cudaError_t err;
-	for(int i = 0; i < opt_n_threads; i++)
+	// not the cpu backend threads
+	for(int i = 0; i < opt_n_threads - cpu_miner_threads; i++)
 	{
 		char vendorname[32] = {0};
 		int dev_id = device_map[i];
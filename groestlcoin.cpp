@@ -11,6 +11,7 @@
 #include "cuda_groestlcoin.h"
 
 #include "miner.h"
+#include "scan.h"
 #include <cuda.h>
 #include <cuda_runtime.h>
 extern bool stop_mining;
@@ -47,11 +48,26 @@ void groestlhash(void *state, const void *input)
     memcpy(state, hashB, 32);
 }
 
+/* scanner of the cpu backend (cpu_groestlcoin.cpp), the GPU loop is below */
+static const struct scan_algo groestl_scan = {
+	"groestl",
+	groestlhash,
+	0x0000000f,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	groestl_cpu_hash,
+	NULL
+};
+
 extern cudaStream_t gpustream[MAX_GPUS];
 
 extern int scanhash_groestlcoin(int thr_id, uint32_t *pdata, uint32_t *ptarget,
     uint32_t max_nonce, uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &groestl_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *foundNounce = nullptr;
 
     uint32_t start_nonce = pdata[19];
@@ -0,0 +1,128 @@
+/**
+ * Hex encoding and decoding
+ *
+ * Table driven, with SSSE3 and AVX2 versions selected at build time
+ * (-march=native, see configure.sh): 16 or 32 hex digits are checked
+ * and converted per step. A block with a bad digit is redone by the
+ * table to stop on it exactly. hex2bin, bin2hex... of util.cpp use it.
+ */
+#include <string.h>
+
+#include "miner.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#endif
+
+static const signed char hex_val[256] = {
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	 0,  1,  2,  3,  4,  5,  6,  7,  8,  9, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, 10, 11, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+	-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1
+};
+
+static const char hex_digits[] = "0123456789abcdef";
+
+static size_t hex_decode_table(uchar *out, const uchar *h, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		int hi = hex_val[h[2 * i]], lo = hex_val[h[2 * i + 1]];
+		if((hi | lo) < 0)
+			return i;
+		out[i] = (uchar)((hi << 4) | lo);
+	}
+	return len;
+}
+
+#if defined(__SSSE3__)
+/* nibble values of 16 digits, 'bad' gets the invalid ones */
+static inline __m128i hex_nibbles_128(__m128i v, __m128i *bad)
+{
+	const __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+	const __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)), _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+	const __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)), _mm_cmplt_epi8(lower, _mm_set1_epi8('f' + 1)));
+	*bad = _mm_andnot_si128(_mm_or_si128(digit, alpha), _mm_set1_epi8(-1));
+	// '0'-'9' are 0x30-0x39, 'a'-'f' and 'A'-'F' end with 1-6
+	return _mm_add_epi8(_mm_and_si128(v, _mm_set1_epi8(0x0f)), _mm_and_si128(alpha, _mm_set1_epi8(9)));
+}
+#endif
+
+/**
+ * Decode 'len' bytes from the 2*len digits at 'hex' (no terminator
+ * needed), the number of bytes before the first invalid digit pair
+ */
+size_t hex_decode(uchar *out, const char *hex, size_t len)
+{
+	const uchar *h = (const uchar *)hex;
+	size_t i = 0;
+
+#if defined(__AVX2__)
+	for(; i + 16 <= len; i += 16)
+	{
+		const __m256i v = _mm256_loadu_si256((const __m256i *)(h + 2 * i));
+		const __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+		const __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+		const __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)), _mm256_cmpgt_epi8(_mm256_set1_epi8('f' + 1), lower));
+		if(_mm256_movemask_epi8(_mm256_or_si256(digit, alpha)) != -1)
+			break;
+		const __m256i n = _mm256_add_epi8(_mm256_and_si256(v, _mm256_set1_epi8(0x0f)), _mm256_and_si256(alpha, _mm256_set1_epi8(9)));
+		// hi * 16 + lo per digit pair, then the 16 bytes in order
+		const __m256i b = _mm256_packus_epi16(_mm256_maddubs_epi16(n, _mm256_set1_epi16(0x0110)), _mm256_setzero_si256());
+		_mm_storeu_si128((__m128i *)(out + i), _mm256_castsi256_si128(_mm256_permute4x64_epi64(b, 0x08)));
+	}
+#endif
+#if defined(__SSSE3__)
+	for(; i + 8 <= len; i += 8)
+	{
+		__m128i bad;
+		const __m128i n = hex_nibbles_128(_mm_loadu_si128((const __m128i *)(h + 2 * i)), &bad);
+		if(_mm_movemask_epi8(bad))
+			break;
+		const __m128i b = _mm_packus_epi16(_mm_maddubs_epi16(n, _mm_set1_epi16(0x0110)), _mm_setzero_si128());
+		_mm_storel_epi64((__m128i *)(out + i), b);
+	}
+#endif
+	return i + hex_decode_table(out + i, h + 2 * i, len - i);
+}
+
+/**
+ * Encode 'len' bytes to 2*len lowercase digits and a terminator
+ */
+void hex_encode(char *out, const void *in, size_t len)
+{
+	const uchar *p = (const uchar *)in;
+	size_t i = 0;
+
+#if defined(__SSSE3__)
+	const __m128i digits = _mm_loadu_si128((const __m128i *)hex_digits);
+	for(; i + 16 <= len; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i *)(p + i));
+		const __m128i hi = _mm_shuffle_epi8(digits, _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f)));
+		const __m128i lo = _mm_shuffle_epi8(digits, _mm_and_si128(v, _mm_set1_epi8(0x0f)));
+		_mm_storeu_si128((__m128i *)(out + 2 * i), _mm_unpacklo_epi8(hi, lo));
+		_mm_storeu_si128((__m128i *)(out + 2 * i + 16), _mm_unpackhi_epi8(hi, lo));
+	}
+#endif
+	for(; i < len; i++)
+	{
+		out[2 * i] = hex_digits[p[i] >> 4];
+		out[2 * i + 1] = hex_digits[p[i] & 15];
+	}
+	out[2 * len] = '\0';
+}
@@ -0,0 +1,459 @@
+/**
+ * Asynchronous log writer
+ *
+ * applog() callers format their message into a per-thread ring of
+ * fixed size records (single producer, single consumer, no lock).
+ * One background thread drains all rings in message order and writes
+ * them in batches to stderr (or syslog) and to an optional log file,
+ * so a slow terminal never stalls a mining thread.
+ *
+ * Messages logged before the writer is started, after it is stopped,
+ * or too long for a record are written synchronously as before. So are
+ * the errors: many of them precede an exit() which would lose them in
+ * the ring. The rings are also flushed at exit.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdarg>
+#include <ctime>
+#include <atomic>
+#include <algorithm>
+#include <sys/stat.h>
+
+#include "miner.h"
+
+#define LOG_RING_SLOTS 256
+#define LOG_MSG_SIZE   488
+#define LOG_MAX_RINGS  64
+#define LOG_OUTBUF_SZ  (64 * 1024)
+#define LOG_DRAIN_MSEC 20
+#define LOG_ROTATE_KEEP 3
+
+struct log_record
+{
+	uint64_t seq;
+	time_t tm;
+	int prio;
+	int len;
+	char msg[LOG_MSG_SIZE];
+};
+
+struct log_ring
+{
+	std::atomic<uint32_t> head; /* next slot to fill, producer only */
+	std::atomic<uint32_t> tail; /* next slot to drain, writer only */
+	struct log_record rec[LOG_RING_SLOTS];
+};
+
+char *opt_log_file = NULL;
+uint32_t opt_log_max_size = 0; /* MB, 0 = no rotation */
+
+static struct log_ring *rings[LOG_MAX_RINGS];
+static std::atomic<int> nrings(0);
+static std::atomic<uint64_t> log_seq(0);
+static std::atomic<uint32_t> log_dropped(0);
+static volatile bool writer_running = false;
+static volatile bool writer_stop = false;
+static pthread_t writer_pth;
+static pthread_mutex_t writer_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t writer_cond = PTHREAD_COND_INITIALIZER;
+static THREAD struct log_ring *my_ring = NULL;
+static THREAD bool my_ring_failed = false;
+
+static FILE *log_fp = NULL;
+static uint64_t log_fsize = 0;
+
+/* writer side only: timestamp prefix is reformatted once per second */
+static time_t stamp_time = 0;
+static char stamp[32];
+
+static const char *log_color(int prio)
+{
+	switch(prio)
+	{
+	case LOG_ERR:     return CL_RED;
+	case LOG_WARNING: return CL_YLW;
+	case LOG_NOTICE:  return CL_WHT;
+	case LOG_DEBUG:   return CL_GRY;
+	case LOG_BLUE:    return CL_CYN;
+	default:          return "";
+	}
+}
+
+static const char *log_stamp(time_t now)
+{
+	if(now != stamp_time)
+	{
+		struct tm tm;
+#ifdef _MSC_VER
+		localtime_s(&tm, &now);
+#else
+		localtime_r(&now, &tm);
+#endif
+		snprintf(stamp, sizeof(stamp), "[%d-%02d-%02d %02d:%02d:%02d]",
+			tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+			tm.tm_hour, tm.tm_min, tm.tm_sec);
+		stamp_time = now;
+	}
+	return stamp;
+}
+
+static void log_file_open(void)
+{
+	struct stat st;
+	if(!opt_log_file)
+		return;
+	log_fp = fopen(opt_log_file, "a");
+	if(!log_fp)
+	{
+		fprintf(stderr, "unable to open log file %s\n", opt_log_file);
+		return;
+	}
+	log_fsize = (stat(opt_log_file, &st) == 0) ? (uint64_t)st.st_size : 0;
+}
+
+static void log_file_rotate(void)
+{
+	char from[1024], to[1024];
+	fclose(log_fp);
+	log_fp = NULL;
+	for(int n = LOG_ROTATE_KEEP - 1; n > 0; n--)
+	{
+		snprintf(from, sizeof(from), "%s.%d", opt_log_file, n);
+		snprintf(to, sizeof(to), "%s.%d", opt_log_file, n + 1);
+		remove(to);
+		rename(from, to);
+	}
+	snprintf(to, sizeof(to), "%s.1", opt_log_file);
+	remove(to);
+	rename(opt_log_file, to);
+	log_file_open();
+}
+
+static void log_file_write(const char *buf, size_t len)
+{
+	if(!log_fp || !len)
+		return;
+	fwrite(buf, 1, len, log_fp);
+	fflush(log_fp);
+	log_fsize += len;
+	if(opt_log_max_size && log_fsize >= (uint64_t)opt_log_max_size * 1024 * 1024)
+		log_file_rotate();
+}
+
+/* append one formatted line to the console and file batches */
+static void log_format(char *con, size_t *conlen, char *file, size_t *filelen,
+	const struct log_record *r)
+{
+	const char *ts = log_stamp(r->tm);
+	const char *color = use_colors ? log_color(r->prio) : "";
+	int n;
+
+	if(!use_syslog)
+	{
+		n = snprintf(con + *conlen, LOG_OUTBUF_SZ - *conlen, "%s%s %s%s\n",
+			ts, color, r->msg, use_colors ? CL_N : "");
+		if(n > 0) *conlen += min((size_t)n, LOG_OUTBUF_SZ - *conlen - 1);
+	}
+#ifdef HAVE_SYSLOG_H
+	else
+	{
+		syslog(r->prio == LOG_BLUE ? LOG_NOTICE : r->prio, "%s", r->msg);
+	}
+#endif
+	if(log_fp)
+	{
+		n = snprintf(file + *filelen, LOG_OUTBUF_SZ - *filelen, "%s %s\n", ts, r->msg);
+		if(n > 0) *filelen += min((size_t)n, LOG_OUTBUF_SZ - *filelen - 1);
+	}
+}
+
+static bool rec_before(const struct log_record *a, const struct log_record *b)
+{
+	return a->seq < b->seq;
+}
+
+/**
+ * Write all pending records of all rings, in global message order
+ * @return number of records written
+ */
+static int log_drain(void)
+{
+	static char con[LOG_OUTBUF_SZ], file[LOG_OUTBUF_SZ];
+	static struct log_record *batch[LOG_MAX_RINGS * LOG_RING_SLOTS];
+	uint32_t heads[LOG_MAX_RINGS];
+	size_t conlen = 0, filelen = 0;
+	int count = 0;
+	int n = nrings.load(std::memory_order_acquire);
+
+	for(int i = 0; i < n; i++)
+	{
+		struct log_ring *ring = rings[i];
+		if(ring == NULL)
+		{
+			heads[i] = 0;
+			continue;
+		}
+		uint32_t tail = ring->tail.load(std::memory_order_relaxed);
+		heads[i] = ring->head.load(std::memory_order_acquire);
+		for(uint32_t p = tail; p != heads[i]; p++)
+			batch[count++] = &ring->rec[p % LOG_RING_SLOTS];
+	}
+	if(!count)
+		return 0;
+
+	std::sort(batch, batch + count, rec_before);
+
+	for(int i = 0; i < count; i++)
+	{
+		if(conlen + LOG_MSG_SIZE + 64 >= LOG_OUTBUF_SZ || filelen + LOG_MSG_SIZE + 64 >= LOG_OUTBUF_SZ)
+		{
+			fwrite(con, 1, conlen, stderr);
+			log_file_write(file, filelen);
+			conlen = filelen = 0;
+		}
+		log_format(con, &conlen, file, &filelen, batch[i]);
+	}
+	if(conlen)
+	{
+		fwrite(con, 1, conlen, stderr);
+		fflush(stderr);
+	}
+	log_file_write(file, filelen);
+
+	for(int i = 0; i < n; i++)
+		if(rings[i])
+			rings[i]->tail.store(heads[i], std::memory_order_release);
+
+	return count;
+}
+
+static void *log_writer_thread(void *userdata)
+{
+	while(!writer_stop)
+	{
+		struct timespec abstime;
+		struct timeval now;
+
+		pthread_mutex_lock(&applog_lock);
+		log_drain();
+
+		uint32_t dropped = log_dropped.exchange(0);
+		if(dropped)
+		{
+			struct log_record r;
+			r.seq = 0; r.tm = time(NULL); r.prio = LOG_WARNING;
+			r.len = snprintf(r.msg, sizeof(r.msg), "log: %u messages dropped (writer too slow)", dropped);
+			char con[LOG_MSG_SIZE + 64], file[LOG_MSG_SIZE + 64];
+			size_t conlen = 0, filelen = 0;
+			log_format(con, &conlen, file, &filelen, &r);
+			fwrite(con, 1, conlen, stderr);
+			log_file_write(file, filelen);
+		}
+		pthread_mutex_unlock(&applog_lock);
+
+		gettimeofday(&now, NULL);
+		abstime.tv_sec = now.tv_sec;
+		abstime.tv_nsec = (now.tv_usec + LOG_DRAIN_MSEC * 1000) * 1000;
+		if(abstime.tv_nsec >= 1000000000)
+		{
+			abstime.tv_sec++;
+			abstime.tv_nsec -= 1000000000;
+		}
+		pthread_mutex_lock(&writer_lock);
+		if(!writer_stop)
+			pthread_cond_timedwait(&writer_cond, &writer_lock, &abstime);
+		pthread_mutex_unlock(&writer_lock);
+	}
+	pthread_mutex_lock(&applog_lock);
+	log_drain();
+	pthread_mutex_unlock(&applog_lock);
+	return NULL;
+}
+
+static struct log_ring *log_get_ring(void)
+{
+	if(my_ring || my_ring_failed)
+		return my_ring;
+
+	int id = nrings.load();
+	do
+	{
+		if(id >= LOG_MAX_RINGS)
+		{
+			my_ring_failed = true;
+			return NULL;
+		}
+	} while(!nrings.compare_exchange_weak(id, id + 1));
+
+	struct log_ring *ring = (struct log_ring *)calloc(1, sizeof(struct log_ring));
+	if(ring == NULL)
+	{
+		/* keep the slot, with an empty ring the writer has nothing to do */
+		my_ring_failed = true;
+		return NULL;
+	}
+	ring->head.store(0);
+	ring->tail.store(0);
+	rings[id] = ring;
+	my_ring = ring;
+	return ring;
+}
+
+/**
+ * Queue a message for the writer thread
+ * @return false if the caller has to write it synchronously
+ */
+bool applog_queue(int prio, const char *fmt, va_list ap)
+{
+	if(!writer_running || prio <= LOG_ERR)
+		return false;
+
+	struct log_ring *ring = log_get_ring();
+	if(!ring)
+		return false;
+
+	uint32_t head = ring->head.load(std::memory_order_relaxed);
+	if(head - ring->tail.load(std::memory_order_acquire) >= LOG_RING_SLOTS)
+	{
+		log_dropped++;
+		return true;
+	}
+
+	struct log_record *r = &ring->rec[head % LOG_RING_SLOTS];
+	va_list ap2;
+	va_copy(ap2, ap);
+	r->len = vsnprintf(r->msg, LOG_MSG_SIZE, fmt, ap2);
+	va_end(ap2);
+	if(r->len < 0 || r->len >= LOG_MSG_SIZE)
+		return false;
+
+	r->prio = prio;
+	r->tm = time(NULL);
+	r->seq = ++log_seq;
+	ring->head.store(head + 1, std::memory_order_release);
+
+	/* warnings are shown at once, others wait for the next batch */
+	if(prio <= LOG_WARNING || head - ring->tail.load(std::memory_order_relaxed) >= LOG_RING_SLOTS / 2)
+		pthread_cond_signal(&writer_cond);
+
+	return true;
+}
+
+/**
+ * Write a message immediately (used before the writer runs)
+ */
+void applog_sync(int prio, const char *fmt, va_list ap)
+{
+	struct log_record r;
+	va_list ap2;
+
+	va_copy(ap2, ap);
+	r.len = vsnprintf(r.msg, sizeof(r.msg), fmt, ap2);
+	va_end(ap2);
+	if(r.len >= (int)sizeof(r.msg))
+	{
+		/* long protocol dumps, keep them complete */
+		char *buf = (char*)malloc(r.len + 1);
+		if(buf)
+		{
+			vsnprintf(buf, r.len + 1, fmt, ap);
+			pthread_mutex_lock(&applog_lock);
+			log_drain();
+			if(use_syslog)
+			{
+#ifdef HAVE_SYSLOG_H
+				syslog(prio == LOG_BLUE ? LOG_NOTICE : prio, "%s", buf);
+#endif
+			}
+			else
+			{
+				const char *color = use_colors ? log_color(prio) : "";
+				fprintf(stderr, "%s%s %s%s\n", log_stamp(time(NULL)), color, buf, use_colors ? CL_N : "");
+				fflush(stderr);
+			}
+			if(log_fp)
+			{
+				/* one write, counted for --log-max-size */
+				const char *ts = log_stamp(time(NULL));
+				size_t size = strlen(ts) + r.len + 3;
+				char *line = (char*)malloc(size);
+				if(line)
+				{
+					int n = snprintf(line, size, "%s %s\n", ts, buf);
+					log_file_write(line, n > 0 ? min((size_t)n, size - 1) : 0);
+					free(line);
+				}
+			}
+			pthread_mutex_unlock(&applog_lock);
+			free(buf);
+			return;
+		}
+	}
+	r.prio = prio;
+	r.tm = time(NULL);
+	r.seq = 0;
+
+	char con[LOG_MSG_SIZE + 64], file[LOG_MSG_SIZE + 64];
+	size_t conlen = 0, filelen = 0;
+	pthread_mutex_lock(&applog_lock);
+	/* keep the order with already queued messages */
+	log_drain();
+	log_format(con, &conlen, file, &filelen, &r);
+	fwrite(con, 1, conlen, stderr);
+	fflush(stderr);
+	log_file_write(file, filelen);
+	pthread_mutex_unlock(&applog_lock);
+}
+
+/* exit() without applog_stop(), write what the writer did not */
+static void applog_exit_flush(void)
+{
+	pthread_mutex_lock(&applog_lock);
+	log_drain();
+	if(log_fp)
+		fflush(log_fp);
+	pthread_mutex_unlock(&applog_lock);
+}
+
+/**
+ * Start the background writer (after the options are parsed)
+ */
+void applog_start(void)
+{
+	static bool exit_flush = false;
+
+	if(writer_running)
+		return;
+	if(!exit_flush)
+	{
+		atexit(applog_exit_flush);
+		exit_flush = true;
+	}
+	log_file_open();
+	writer_stop = false;
+	if(pthread_create(&writer_pth, NULL, log_writer_thread, NULL))
+	{
+		fprintf(stderr, "log writer thread create failed\n");
+		return;
+	}
+	writer_running = true;
+}
+
+/**
+ * Flush pending messages and return to synchronous writes
+ */
+void applog_stop(void)
+{
+	if(!writer_running)
+		return;
+	writer_running = false;
+	pthread_mutex_lock(&writer_lock);
+	writer_stop = true;
+	pthread_cond_signal(&writer_cond);
+	pthread_mutex_unlock(&writer_lock);
+	pthread_join(writer_pth, NULL);
+	if(log_fp)
+		fflush(log_fp);
+}
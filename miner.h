@@ -264,6 +264,9 @@ extern "C" {
 	void sha256_init(uint32_t *state);
 	void sha256_transform(uint32_t *state, const uint32_t *block, int swap);
 	void sha256d(unsigned char *hash, const unsigned char *data, int len);
+	void sha256_midstate(uint32_t *state, const unsigned char *data, int len);
+	void sha256_tail(unsigned char *hash, const uint32_t *midstate, int done,
+		const unsigned char *data, int len, int twice);
 
 #ifdef __cplusplus
 }
@@ -461,6 +464,58 @@ struct stats_data {
 	uint8_t ignored;
 };
 
+struct share_data {
+	uint32_t tm_result;
+	uint32_t height;
+	uint32_t njobid;
+	uint32_t nonce;
+	uint32_t answer_msec;
+	uint32_t job_age_msec; /* job received to nonce found */
+	uint32_t queue_msec;   /* nonce found to submit sent */
+	uint8_t thr_id;  /* 0xff if unknown */
+	uint8_t gpu_id;
+	uint8_t result;  /* 1 = accepted */
+	uint8_t reason;  /* SHARE_ outcome */
+	double difficulty; /* pool share target */
+	double sharediff;
+};
+
+enum share_outcome {
+	SHARE_ACCEPTED = 0,
+	SHARE_STALE,      /* discarded, the job changed before the submit */
+	SHARE_POOL_STALE, /* job unknown to the pool */
+	SHARE_DUPLICATE,
+	SHARE_LOWDIFF,
+	SHARE_REJECTED,   /* other pool reject reasons */
+	SHARE_OUTCOMES
+};
+
+struct pool_share_stats {
+	char url[128];
+	uint32_t outcome[SHARE_OUTCOMES];
+	/* 50, 90 and 99th percentiles in ms */
+	uint32_t job_age[3];
+	uint32_t queue[3];
+	uint32_t answer[3];
+	uint32_t inflight; /* submits waiting for an answer */
+};
+
+#define SHARES_WINDOWS 3
+struct share_stats {
+	int window;          /* seconds */
+	double elapsed;      /* part of the window already mined */
+	uint32_t accepted;
+	uint32_t rejected;
+	double accepted_weight;  /* hashes */
+	double submitted_weight;
+	double hashrate;     /* pool side, from the accepted shares */
+	double hashrate_lo;  /* 95% confidence interval */
+	double hashrate_hi;
+	double reported;     /* gpu threads */
+	double luck;         /* 1.0 = expected */
+	double zscore;
+};
+
 struct hashlog_data {
 	uint32_t tm_sent;
 	uint32_t height;
@@ -495,6 +550,7 @@ extern bool opt_tracegpu;
 extern int opt_n_threads;
 extern int num_cpus;
 extern int active_gpus;
+extern int cpu_miner_threads;
 extern int opt_timeout;
 extern bool want_longpoll;
 extern bool have_longpoll;
@@ -558,10 +614,30 @@ extern void gpulog(int prio, int thr_id, const char *fmt, ...);
 
 void format_hashrate(double hashrate, char *output);
 void applog(int prio, const char *fmt, ...);
+bool applog_queue(int prio, const char *fmt, va_list ap);
+void applog_sync(int prio, const char *fmt, va_list ap);
+void applog_start(void);
+void applog_stop(void);
+extern char *opt_log_file;
+extern uint32_t opt_log_max_size;
 json_t *json_rpc_call(CURL *curl, const char *url, const char *userpass, const char *rpc_req, bool, bool, int *);
+
+#define RPC_MAX_REQUESTS 4
+
+/* one of the requests of json_rpc_call_multi() */
+struct rpc_request {
+	CURL *curl;
+	const char *rpc_req;
+	int *curl_err;      /* as for json_rpc_call(), can be NULL */
+	json_t *val;
+};
+
+void json_rpc_call_multi(CURLM *multi, const char *url, const char *userpass, struct rpc_request *r, int count, bool longpoll_scan);
 void cbin2hex(char *out, const char *in, size_t len);
 char *bin2hex(const unsigned char *in, size_t len);
 bool hex2bin(unsigned char *p, const char *hexstr, size_t len);
+void hex_encode(char *out, const void *in, size_t len);
+size_t hex_decode(unsigned char *out, const char *hex, size_t len);
 int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y);
 void diff_to_target(uint32_t *target, double diff);
 void get_currentalgo(char* buf, int sz);
@@ -573,6 +649,8 @@ struct stratum_job {
 	size_t coinbase_size;
 	unsigned char *coinbase;
 	unsigned char *xnonce2;
+	uint32_t coinbase_midstate[8]; /* sha256 state of the first coinbase_midlen bytes */
+	size_t coinbase_midlen;
 	int merkle_count;
 	unsigned char **merkle;
 	unsigned char version[4];
@@ -582,6 +660,7 @@ struct stratum_job {
 	unsigned char nreward[2];
 	uint32_t height;
 	double diff;
+	struct timeval tv_received;
 };
 
 struct stratum_ctx {
@@ -603,7 +682,6 @@ struct stratum_ctx {
 	struct stratum_job job;
 	pthread_mutex_t work_lock;
 
-	struct timeval tv_submit;
 	uint32_t answer_msec;
 	uint32_t disconnects;
 	time_t tm_connected;
@@ -631,6 +709,10 @@ struct work {
 
 	uint32_t scanned_from;
 	uint32_t scanned_to;
+
+	int thr_id;               /* thread which found the nonce */
+	struct timeval tv_job;    /* job received */
+	struct timeval tv_found;  /* nonce found */
 };
 
 enum sha_algos
@@ -678,6 +760,36 @@ bool stratum_subscribe(struct stratum_ctx *sctx);
 bool stratum_authorize(struct stratum_ctx *sctx, const char *user, const char *pass,bool extranonce);
 bool stratum_handle_method(struct stratum_ctx *sctx, const char *s);
 
+/* a value in a stratum line, not terminated, s is NULL if missing */
+struct json_span {
+	const char *s;
+	size_t len;
+};
+
+struct stratum_line {
+	struct json_span method; /* without the quotes */
+	struct json_span params, id, result, error;
+};
+
+#define STRATUM_MAX_MERKLE 64
+
+/* the params of mining.notify, the strings without their quotes */
+struct stratum_notify_msg {
+	struct json_span job_id, prevhash, coinb1, coinb2;
+	struct json_span merkle[STRATUM_MAX_MERKLE];
+	int merkle_count;
+	struct json_span version, nbits, ntime, nreward;
+	bool clean;
+};
+
+bool stratum_parse_line(const char *s, struct stratum_line *m);
+bool stratum_method_is(const struct stratum_line *m, const char *method);
+bool stratum_parse_notify(const struct json_span *params, struct stratum_notify_msg *n);
+bool json_span_null(const struct json_span *v);
+bool json_span_int(const struct json_span *v, int64_t *n);
+bool json_span_number(const struct json_span *v, double *d);
+bool json_span_hex(unsigned char *p, const struct json_span *v, size_t len);
+
 void hashlog_remember_submit(struct work* work, uint32_t nonce);
 void hashlog_remember_scan_range(struct work* work);
 uint32_t hashlog_already_submittted(char* jobid, uint32_t nounce);
@@ -697,6 +809,33 @@ void stats_purge_old(void);
 void stats_purge_all(void);
 void stats_getmeminfo(uint64_t *mem, uint32_t *records);
 
+extern const int shares_windows[SHARES_WINDOWS];
+double target_to_hashes(const uint32_t *target);
+extern const char *share_outcome_names[SHARE_OUTCOMES];
+void shares_init(const char *pool);
+uint32_t shares_submitted(const struct work *work, uint32_t nonce);
+void shares_cancel(uint32_t id);
+void shares_discarded(const struct work *work, uint32_t nonce, int outcome);
+int  shares_result(uint32_t id, int accepted, const char *reason, struct share_data *out);
+void shares_drop_pending(void);
+int  shares_get_pools(struct pool_share_stats *st, int max_pools);
+void shares_get_stats(int window, double reported, struct share_stats *st);
+
+bool nonce_sched_next(int thr_id, const uint32_t *key, double seconds, uint32_t *start, uint32_t *end);
+void nonce_sched_set_align(int thr_id, uint32_t align);
+void nonce_sched_done(int thr_id, const uint32_t *key, uint32_t start, uint32_t hashes, double seconds);
+
+extern char *opt_stats_file;
+extern uint32_t opt_stats_records;
+bool statsfile_open(void);
+void statsfile_close(void);
+bool statsfile_active(void);
+void statsfile_add_scan(const struct stats_data *data);
+void statsfile_add_share(const struct share_data *data);
+int  statsfile_get_history(int gpu_id, struct stats_data *data, int max_records);
+void statsfile_getmeminfo(uint64_t *mem, uint32_t *records);
+void statsfile_dump(const char *filename);
+
 struct thread_q;
 
 extern struct thread_q *tq_new(void);
@@ -718,6 +857,8 @@ void applog_compare_hash(unsigned char *hash, unsigned char *hash2);
 void print_hash_tests(void);
 
 void blake256hash(void *output, const void *input, int8_t rounds);
+void blake256hash_8(void *output, const void *input);
+void blake256hash_14(void *output, const void *input);
 void deephash(void *state, const void *input);
 void doomhash(void *state, const void *input);
 void fresh_hash(void *state, const void *input);
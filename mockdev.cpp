@@ -0,0 +1,164 @@
+/**
+ * Simulated devices (see mockdev.h), they scan with the mock backend
+ * of scan_mock.cpp
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "miner.h"
+#include "scan.h"
+#include "mockdev.h"
+
+#define MOCKDEV_NAME "Mock device"
+#define MOCK_BENCH_TARGET 0xffff
+
+extern enum sha_algos opt_algo;
+extern "C" void whirlxHash(void *state, const void *input);
+extern "C" void c11hash(void *output, const void *input);
+
+int opt_mock_devices = 1;
+
+cudaError_t mockdev_driver_version(int *version)
+{
+	*version = CUDART_VERSION;
+	return cudaSuccess;
+}
+
+cudaError_t mockdev_device_count(int *count)
+{
+	*count = opt_mock_devices;
+	return cudaSuccess;
+}
+
+cudaError_t mockdev_properties(cudaDeviceProp *props, int dev_id)
+{
+	if(dev_id < 0 || dev_id >= opt_mock_devices)
+		return cudaErrorInvalidDevice;
+	memset(props, 0, sizeof(*props));
+	strcpy(props->name, MOCKDEV_NAME);
+	props->major = 6;
+	props->minor = 1;
+	props->clockRate = 1000000;
+	props->memoryClockRate = 1000000;
+	props->multiProcessorCount = 1;
+	props->pciBusID = dev_id + 1;
+	props->totalGlobalMem = 1ULL << 30;
+	return cudaSuccess;
+}
+
+cudaError_t mockdev_set_device(int dev_id)
+{
+	return (dev_id >= 0 && dev_id < opt_mock_devices) ? cudaSuccess : cudaErrorInvalidDevice;
+}
+
+cudaError_t mockdev_device_reset(void)
+{
+	return cudaSuccess;
+}
+
+cudaError_t mockdev_device_synchronize(void)
+{
+	return cudaSuccess;
+}
+
+/* reference hashes of the algos with a standard 80-byte header */
+
+static void jackpothash_ref(void *state, const void *input)
+{
+	jackpothash(state, input);
+}
+
+static const struct {
+	enum sha_algos algo;
+	cpu_ref_hash_fn hash;
+	cpu_batch_hash_fn cpu_hash;
+	cpu_precalc_fn cpu_precalc;
+} mock_algos[] = {
+	{ ALGO_BLAKE, blake256hash_14, blake256_14_cpu_hash, blake256_14_cpu_precalc },
+	{ ALGO_BLAKECOIN, blake256hash_8, blake256_8_cpu_hash, blake256_8_cpu_precalc },
+	{ ALGO_C11, c11hash, c11_cpu_hash, NULL },
+	{ ALGO_DEEP, deephash, deep_cpu_hash, NULL },
+	{ ALGO_DMD_GR, groestlhash, groestl_cpu_hash, NULL },
+	{ ALGO_DOOM, doomhash, doom_cpu_hash, NULL },
+	{ ALGO_FRESH, fresh_hash, NULL, NULL },
+	{ ALGO_GROESTL, groestlhash, groestl_cpu_hash, NULL },
+	{ ALGO_KECCAK, keccak256_hash, keccak256_cpu_hash, NULL },
+	{ ALGO_JACKPOT, jackpothash_ref, jackpot_cpu_hash, NULL },
+	{ ALGO_LUFFA_DOOM, doomhash, doom_cpu_hash, NULL },
+	{ ALGO_MYR_GR, myriadhash, myriad_cpu_hash, NULL },
+	{ ALGO_NIST5, nist5hash, NULL, NULL },
+	{ ALGO_PENTABLAKE, pentablakehash, NULL, NULL },
+	{ ALGO_QUARK, quarkhash, quark_cpu_hash, NULL },
+	{ ALGO_QUBIT, qubithash, qubit_cpu_hash, NULL },
+	{ ALGO_SKEIN, skeincoinhash, skein_cpu_hash, skein_cpu_precalc },
+	{ ALGO_S3, s3hash, NULL, NULL },
+	{ ALGO_WHC, wcoinhash, whc_cpu_hash, NULL },
+	{ ALGO_WHCX, whirlxHash, whirlpoolx_cpu_hash, NULL },
+	{ ALGO_VANILLA, blake256hash_8, blake256_8_cpu_hash, blake256_8_cpu_precalc },
+	{ ALGO_X11, x11hash, x11_cpu_hash, NULL },
+	{ ALGO_X13, x13hash, x13_cpu_hash, NULL },
+	{ ALGO_X14, x14hash, NULL, NULL },
+	{ ALGO_X15, x15hash, x15_cpu_hash, NULL },
+	{ ALGO_X17, x17hash, x17_cpu_hash, NULL },
+	{ ALGO_INVALID, NULL, NULL, NULL }
+};
+
+static struct scan_algo mock_scan = {
+	"mock",
+	NULL,
+	MOCK_BENCH_TARGET,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	NULL, NULL
+};
+
+/**
+ * Called once the command line is parsed
+ */
+void mockdev_init(void)
+{
+	int i;
+	for(i = 0; mock_algos[i].algo != ALGO_INVALID; i++)
+	{
+		if(mock_algos[i].algo == opt_algo)
+			break;
+	}
+	mock_scan.hash = mock_algos[i].hash;
+	mock_scan.cpu_hash = mock_algos[i].cpu_hash;
+	mock_scan.cpu_precalc = mock_algos[i].cpu_precalc;
+
+	if(opt_mock_hashrate <= 0. && !mock_scan.hash)
+	{
+		applog(LOG_ERR, "mock: no cpu hash for this algo, use --mock-hashrate");
+		exit(1);
+	}
+	if(opt_mock_hashrate > 0. && opt_verify)
+	{
+		applog(LOG_INFO, "mock: synthetic nonces, cpu verification disabled");
+		opt_verify = false;
+	}
+
+	active_gpus = opt_mock_devices;
+	for(i = 0; i < active_gpus; i++)
+	{
+		if(!device_name[i])
+			device_name[i] = strdup(MOCKDEV_NAME);
+	}
+	// the cpu threads of --backend get their backend after
+	for(i = 0; i < MAX_GPUS; i++)
+		scan_backend_set(i, &scan_backend_mock);
+
+	if(opt_mock_hashrate > 0.)
+		applog(LOG_INFO, "mock: %d simulated devices at %.2f kH/s, %d ms latency",
+			opt_mock_devices, opt_mock_hashrate / 1000., opt_mock_latency);
+	else
+		applog(LOG_INFO, "mock: %d simulated devices hashing on the cpu, %d ms latency",
+			opt_mock_devices, opt_mock_latency);
+}
+
+int scanhash_mock(int thr_id, uint32_t *pdata, uint32_t *ptarget,
+	uint32_t max_nonce, uint32_t *hashes_done)
+{
+	return scanhash_generic(thr_id, &mock_scan, pdata, ptarget, max_nonce, hashes_done);
+}
@@ -0,0 +1,42 @@
+#ifndef MOCKDEV_H
+#define MOCKDEV_H
+
+/**
+ * Simulated devices (./configure --enable-mockdev)
+ *
+ * The device management calls of the host code are redirected to
+ * mockdev.cpp, which reports --mock-devices fake GPUs, and every algo
+ * is scanned by the mock backend of the scan driver. The kernels are
+ * still linked but never launched, so the whole stratum, work, scan
+ * and submit pipeline runs on a machine without any CUDA device.
+ *
+ * Include it after the cuda runtime headers.
+ */
+
+#ifdef USE_MOCKDEV
+
+#include "cuda_runtime_api.h"
+
+extern int opt_mock_devices;
+
+void mockdev_init(void);
+int scanhash_mock(int thr_id, uint32_t *pdata, uint32_t *ptarget,
+	uint32_t max_nonce, uint32_t *hashes_done);
+
+cudaError_t mockdev_driver_version(int *version);
+cudaError_t mockdev_device_count(int *count);
+cudaError_t mockdev_properties(cudaDeviceProp *props, int dev_id);
+cudaError_t mockdev_set_device(int dev_id);
+cudaError_t mockdev_device_reset(void);
+cudaError_t mockdev_device_synchronize(void);
+
+#define cudaDriverGetVersion mockdev_driver_version
+#define cudaGetDeviceCount mockdev_device_count
+#define cudaGetDeviceProperties mockdev_properties
+#define cudaSetDevice mockdev_set_device
+#define cudaDeviceReset mockdev_device_reset
+#define cudaDeviceSynchronize mockdev_device_synchronize
+
+#endif /* USE_MOCKDEV */
+
+#endif
@@ -9,6 +9,7 @@
 #include "sph/sph_groestl.h"
 
 #include "miner.h"
+#include "scan.h"
 #include <cuda_runtime.h>
 extern bool stop_mining;
 extern volatile bool mining_has_stopped[MAX_GPUS];
@@ -34,9 +35,24 @@ void myriadhash(void *state, const void *input)
 	memcpy(state, hashB, 32);
 }
 
+/* scanner of the cpu backend (cpu_groestlcoin.cpp), the GPU loop is below */
+static const struct scan_algo myriad_scan = {
+	"myr-gr",
+	myriadhash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	myriad_cpu_hash,
+	NULL
+};
+
 extern int scanhash_myriad(int thr_id, uint32_t *pdata, uint32_t *ptarget,
 	uint32_t max_nonce, uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &myriad_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *h_found = nullptr;
 
 	uint32_t start_nonce = pdata[19];
@@ -0,0 +1,258 @@
+/**
+ * Nonce range scheduler
+ *
+ * The 32-bit nonce space of a work is shared by all the miner threads
+ * mining it. A thread takes a slab of free nonces and scans it by chunks,
+ * each sized to its measured rate and the target scan time, so every
+ * scan takes about the same time on fast and slow devices. When the free
+ * space is empty, an idle thread steals the upper half of the unscanned
+ * part of the slab which would take the longest to finish (the slowest
+ * device with the most work left). Only when nothing is left to steal,
+ * the space is exhausted and the caller generates new work (next
+ * extranonce2 with stratum).
+ *
+ * The work is identified by its header without the nonce. The threads
+ * mining the same header share its space, the ones with their own header
+ * (extranonce2 of the worker) get a space of their own and never meet.
+ *
+ * A scan only hashes whole batches of its algo (throughput_mask of the
+ * scan driver), so the edges of the slabs and chunks, and the end of the
+ * space, are multiples of the batch granularity of the thread. A range
+ * smaller than one batch would never be scanned, nor leave the slab.
+ * The CUDA scanhash loops which don't set it hash multiples of 1024
+ * nonces, the default.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "miner.h"
+
+#define SCHED_FIRST_CHUNK (1U << 22) /* until the rate is measured */
+#define SCHED_MIN_CHUNK (1U << 20)   /* never less, except at the end of the space */
+#define SCHED_SLAB_CHUNKS 4          /* chunks in a new slab */
+#define SCHED_SPACE_END 0xffffffffULL
+#define SCHED_DEFAULT_ALIGN 1024     /* until nonce_sched_set_align() */
+
+struct sched_space {
+	uint32_t key[20];
+	uint64_t free;      /* first nonce never handed out */
+};
+
+struct sched_thread {
+	int space;          /* index in sched_spaces, -1 if none */
+	uint64_t next;      /* first nonce not scanned yet */
+	uint64_t busy_end;  /* end of the chunk being scanned */
+	uint64_t end;       /* end of the slab */
+	double rate;        /* nonces per second */
+	uint32_t align;     /* batch granularity, a power of 2 (0 for the default) */
+};
+
+static pthread_mutex_t sched_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct sched_space sched_spaces[MAX_GPUS];
+static struct sched_thread sched_threads[MAX_GPUS];
+static bool sched_init_done = false;
+
+static inline uint64_t sched_align(const struct sched_thread *t)
+{
+	return t->align ? t->align : SCHED_DEFAULT_ALIGN;
+}
+
+static inline uint64_t sched_down(uint64_t n, uint64_t align)
+{
+	return n & ~(align - 1);
+}
+
+static inline uint64_t sched_up(uint64_t n, uint64_t align)
+{
+	return sched_down(n + align - 1, align);
+}
+
+/* end of the nonce space for the thread, the last batch must be whole */
+static uint64_t sched_space_end(const struct sched_thread *t)
+{
+	return sched_down(SCHED_SPACE_END, sched_align(t));
+}
+
+static uint64_t sched_chunk(const struct sched_thread *t, double seconds)
+{
+	const uint64_t align = sched_align(t);
+	uint64_t chunk;
+	if(t->rate <= 0.)
+		chunk = SCHED_FIRST_CHUNK;
+	else if(t->rate * seconds > (double)SCHED_SPACE_END)
+		chunk = SCHED_SPACE_END;
+	else
+		chunk = max((uint64_t)(t->rate * seconds), (uint64_t)SCHED_MIN_CHUNK);
+	return max(sched_down(chunk, align), align);
+}
+
+static bool sched_space_used(int space)
+{
+	for(int i = 0; i < MAX_GPUS; i++)
+	{
+		if(sched_threads[i].space == space)
+			return true;
+	}
+	return false;
+}
+
+/* join the space of 'key', a new one if no thread mines it */
+static void sched_join(int thr_id, const uint32_t *key)
+{
+	struct sched_thread *me = &sched_threads[thr_id];
+	int space = -1;
+
+	me->space = -1;
+	me->next = me->busy_end = me->end = 0;
+	for(int i = 0; i < MAX_GPUS && space < 0; i++)
+	{
+		if(!memcmp(sched_spaces[i].key, key, sizeof(sched_spaces[i].key)) && sched_space_used(i))
+			space = i;
+	}
+	for(int i = 0; i < MAX_GPUS && space < 0; i++)
+	{
+		if(!sched_space_used(i))
+		{
+			space = i;
+			memcpy(sched_spaces[i].key, key, sizeof(sched_spaces[i].key));
+			sched_spaces[i].free = 0;
+		}
+	}
+	me->space = space;
+}
+
+/* unscanned nonces of a slab which are not in the running chunk */
+static uint64_t sched_stealable(const struct sched_thread *t)
+{
+	uint64_t from = max(t->next, t->busy_end);
+	return t->end > from ? t->end - from : 0;
+}
+
+static bool sched_steal(int thr_id)
+{
+	struct sched_thread *me = &sched_threads[thr_id];
+	int victim = -1;
+	double longest = 0.;
+
+	for(int i = 0; i < opt_n_threads; i++)
+	{
+		const struct sched_thread *t = &sched_threads[i];
+		uint64_t left = sched_stealable(t);
+		if(i == thr_id || t->space != me->space || left < 2 * SCHED_MIN_CHUNK)
+			continue;
+		// time to finish it, the unmeasured threads count as slow
+		double tm = t->rate > 0. ? left / t->rate : 1e9 + left;
+		if(tm > longest)
+		{
+			longest = tm;
+			victim = i;
+		}
+	}
+	if(victim < 0)
+		return false;
+
+	struct sched_thread *t = &sched_threads[victim];
+	uint64_t from = max(t->next, t->busy_end);
+	uint64_t mid = from + sched_down((t->end - from) / 2, sched_align(me));
+	me->next = me->busy_end = mid;
+	me->end = t->end;
+	t->end = mid;
+	if(opt_debug)
+		applog(LOG_DEBUG, "GPU #%d: stole %08x-%08x from GPU #%d", device_map[thr_id],
+			(uint32_t)mid, (uint32_t)(me->end - 1), device_map[victim]);
+	return true;
+}
+
+/**
+ * Next range [*start, *end) of the work 'key' (the 80-byte header with
+ * a null nonce) for a scan of about 'seconds', false if the whole space
+ * is scanned or being scanned.
+ */
+bool nonce_sched_next(int thr_id, const uint32_t *key, double seconds, uint32_t *start, uint32_t *end)
+{
+	struct sched_thread *me = &sched_threads[thr_id];
+	bool ok = true;
+
+	pthread_mutex_lock(&sched_lock);
+	if(!sched_init_done)
+	{
+		for(int i = 0; i < MAX_GPUS; i++)
+			sched_threads[i].space = -1;
+		sched_init_done = true;
+	}
+	if(me->space < 0 || memcmp(sched_spaces[me->space].key, key, sizeof(sched_spaces[me->space].key)))
+		sched_join(thr_id, key);
+	struct sched_space *sp = &sched_spaces[me->space];
+
+	// a slab taken before the granularity was known, or the rest of a
+	// scan which stopped on a found nonce, may not be aligned
+	const uint64_t align = sched_align(me);
+	const uint64_t space_end = sched_space_end(me);
+	const uint64_t chunk = sched_chunk(me, seconds);
+	me->next = sched_up(me->next, align);
+	me->end = sched_down(min(me->end, space_end), align);
+	if(me->next >= me->end)
+	{
+		uint64_t from = sched_up(sp->free, align);
+		if(from < space_end)
+		{
+			me->next = from;
+			me->end = min(from + chunk * SCHED_SLAB_CHUNKS, space_end);
+			// no small slab at the end of the space
+			if(space_end - me->end < chunk)
+				me->end = space_end;
+			sp->free = me->end;
+		}
+		else
+			ok = sched_steal(thr_id);
+	}
+	// a stolen end is the one of a thread which may have had a finer granularity
+	me->end = sched_down(min(me->end, space_end), align);
+	if(ok && me->next >= me->end)
+		ok = false;
+	if(ok)
+	{
+		uint64_t e = min(me->next + chunk, me->end);
+		// no small chunk at the end of the slab either
+		if(me->end - e < SCHED_MIN_CHUNK)
+			e = me->end;
+		*start = (uint32_t)me->next;
+		*end = (uint32_t)e;
+		me->busy_end = e;
+	}
+	pthread_mutex_unlock(&sched_lock);
+	return ok;
+}
+
+/**
+ * Batch granularity of the scans of the thread, a power of 2: its ranges
+ * are rounded to it from the next call of nonce_sched_next().
+ */
+void nonce_sched_set_align(int thr_id, uint32_t align)
+{
+	pthread_mutex_lock(&sched_lock);
+	sched_threads[thr_id].align = align;
+	pthread_mutex_unlock(&sched_lock);
+}
+
+/**
+ * Report a scan: 'hashes' nonces from 'start' in 'seconds'. The rest of
+ * the chunk (a nonce was found or the job changed) stays in the slab.
+ */
+void nonce_sched_done(int thr_id, const uint32_t *key, uint32_t start, uint32_t hashes, double seconds)
+{
+	struct sched_thread *me = &sched_threads[thr_id];
+
+	pthread_mutex_lock(&sched_lock);
+	if(seconds > 0.002 && hashes)
+	{
+		double rate = hashes / seconds;
+		me->rate = me->rate > 0. ? 0.7 * me->rate + 0.3 * rate : rate;
+	}
+	if(me->space >= 0 && !memcmp(sched_spaces[me->space].key, key, sizeof(sched_spaces[me->space].key)))
+	{
+		me->next = max(me->next, (uint64_t)start + hashes);
+		me->busy_end = me->next;
+	}
+	pthread_mutex_unlock(&sched_lock);
+}
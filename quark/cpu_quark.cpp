@@ -0,0 +1,28 @@
+/**
+ * Quark on the cpu, batched with branch compaction
+ *
+ * Same stages as quarkhash(), the three "hash[0] & 0x8" branches
+ * partition the lanes instead of masking them.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void quark_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.blake512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.bmw512(l->hash, l->count);
+
+	cpu_lanes_branch(l, 0, 0x8, cpu_hash.groestl512, cpu_hash.skein512);
+
+	cpu_hash.groestl512(l->hash, l->count);
+	cpu_hash.jh512(l->hash, l->count);
+
+	cpu_lanes_branch(l, 0, 0x8, cpu_hash.blake512, cpu_hash.bmw512);
+
+	cpu_hash.keccak512(l->hash, l->count);
+	cpu_hash.skein512(l->hash, l->count);
+
+	cpu_lanes_branch(l, 0, 0x8, cpu_hash.keccak512, cpu_hash.jh512);
+}
@@ -0,0 +1,34 @@
+/**
+ * Qubit, Deep and Doom on the cpu, batched
+ *
+ * All three start with Luffa-512 of the header: qubithash() then runs
+ * cubehash512, shavite512, simd512 and echo512, deephash() cubehash512
+ * and echo512, doomhash() nothing more.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void qubit_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.luffa_cubehash512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.shavite512(l->hash, l->count);
+	cpu_hash.simd512(l->hash, l->count);
+	cpu_hash.echo512(l->hash, l->count);
+}
+
+void deep_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.luffa_cubehash512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.echo512(l->hash, l->count);
+}
+
+void doom_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.luffa512_80(l->hash, endiandata, l->nonce, l->count);
+}
@@ -11,6 +11,7 @@ extern "C" {
 }
 
 #include "miner.h"
+#include "scan.h"
 
 #include "cuda_helper.h"
 
@@ -50,10 +51,25 @@ void deephash(void *state, const void *input)
 	memcpy(state, hash, 32);
 }
 
+/* scanner of the cpu backend (qubit/cpu_qubit.cpp), the GPU loop is below */
+static const struct scan_algo deep_scan = {
+	"deep",
+	deephash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	deep_cpu_hash,
+	NULL
+};
+
 extern int scanhash_deep(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &deep_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *d_hash = nullptr;
 	static THREAD uint32_t *h_found = nullptr;
 
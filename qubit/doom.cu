@@ -7,6 +7,7 @@ extern "C" {
 }
 
 #include "miner.h"
+#include "scan.h"
 
 #include "cuda_helper.h"
 
@@ -30,10 +31,25 @@ extern void doomhash(void *state, const void *input)
 	memcpy(state, hash, 32);
 }
 
+/* scanner of the cpu backend (qubit/cpu_qubit.cpp), the GPU loop is below */
+static const struct scan_algo doom_scan = {
+	"doom",
+	doomhash,
+	0x0000000f,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	doom_cpu_hash,
+	NULL
+};
+
 extern int scanhash_doom(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &doom_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *d_hash = nullptr;
 
 	const uint32_t first_nonce = pdata[19];
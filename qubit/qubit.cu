@@ -11,6 +11,7 @@ extern "C" {
 }
 
 #include "miner.h"
+#include "scan.h"
 #include "cuda_helper.h"
 
 extern void qubit_luffa512_cpu_init(int thr_id, uint32_t threads);
@@ -67,10 +68,25 @@ void qubithash(void *state, const void *input)
 	memcpy(state, hash, 32);
 }
 
+/* scanner of the cpu backend (qubit/cpu_qubit.cpp), the GPU loop is below */
+static const struct scan_algo qubit_scan = {
+	"qubit",
+	qubithash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	qubit_cpu_hash,
+	NULL
+};
+
 extern int scanhash_qubit(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &qubit_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *d_hash = nullptr;
 	static THREAD uint32_t *h_found = nullptr;
 
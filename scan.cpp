@@ -0,0 +1,342 @@
+/**
+ * Generic scanhash driver and cpu backend (see scan.h)
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "miner.h"
+#include "scan.h"
+
+#define SCAN_CPU_BATCH 4096
+
+extern bool stop_mining;
+extern volatile bool mining_has_stopped[MAX_GPUS];
+
+static struct scan_ctx scan_ctxs[MAX_GPUS];
+static const struct scan_backend *scan_thread_backends[MAX_GPUS];
+
+static const struct scan_backend *scan_backends[] = {
+	&scan_backend_cuda,
+	&scan_backend_cpu,
+	NULL
+};
+
+const struct scan_backend *scan_backend_find(const char *name)
+{
+	for(int i = 0; scan_backends[i]; i++)
+	{
+		if(!strcasecmp(scan_backends[i]->name, name))
+			return scan_backends[i];
+	}
+	return NULL;
+}
+
+const struct scan_backend *scan_backend_get(int thr_id)
+{
+	return scan_thread_backends[thr_id] ? scan_thread_backends[thr_id] : &scan_backend_cuda;
+}
+
+void scan_backend_set(int thr_id, const struct scan_backend *backend)
+{
+	scan_thread_backends[thr_id] = backend;
+}
+
+const char *scan_device_type(const struct scan_backend *backend)
+{
+	return backend == &scan_backend_cpu ? "CPU" : "GPU";
+}
+
+uint32_t scan_default_intensity(const struct scan_intensity *table, const char *devname)
+{
+	for(; table->name; table++)
+	{
+		if(strstr(devname, table->name))
+			break;
+	}
+	return table->throughput;
+}
+
+/* cpu backend, batches of cpu_lanes split between ctx->threads workers */
+
+struct cpu_scan;
+
+struct cpu_worker {
+	struct cpu_scan *s;
+	int id;
+	pthread_t thread;
+	bool started;
+	struct cpu_lanes lanes;
+};
+
+struct cpu_scan {
+	struct scan_ctx *ctx;
+	struct cpu_worker workers[SCAN_CPU_MAX_THREADS];
+	pthread_mutex_t lock;
+	pthread_cond_t start, done;
+	uint32_t generation;
+	int pending;
+	uint32_t first_nonce, count;
+	bool quit;
+	uint32_t precalc[CPU_PRECALC_WORDS];
+};
+
+static void cpu_hash_chunk(struct scan_ctx *ctx, struct cpu_lanes *l, uint32_t first_nonce, uint32_t count)
+{
+	if(ctx->algo->cpu_hash)
+	{
+		ctx->algo->cpu_hash(l, ctx->endiandata, first_nonce, count);
+		return;
+	}
+	uint32_t data[20];
+	memcpy(data, ctx->endiandata, sizeof(data));
+	cpu_lanes_set_nonces(l, first_nonce, count);
+	for(uint32_t i = 0; i < l->count; i++)
+	{
+		be32enc(&data[19], l->nonce[i]);
+		ctx->algo->hash(&l->hash[i * 8], data);
+	}
+}
+
+/* nonces [first_nonce, first_nonce + count) of the worker 'id' */
+static void cpu_worker_hash(struct cpu_scan *s, int id)
+{
+	const uint32_t chunk = (s->count + s->ctx->threads - 1) / s->ctx->threads;
+	const uint32_t start = min(s->count, chunk * id);
+	cpu_hash_chunk(s->ctx, &s->workers[id].lanes, s->first_nonce + start, min(chunk, s->count - start));
+}
+
+static void *cpu_worker_thread(void *userdata)
+{
+	struct cpu_worker *w = (struct cpu_worker *)userdata;
+	struct cpu_scan *s = w->s;
+	uint32_t generation = 0;
+
+	pthread_mutex_lock(&s->lock);
+	for(;;)
+	{
+		while(!s->quit && s->generation == generation)
+			pthread_cond_wait(&s->start, &s->lock);
+		if(s->quit)
+			break;
+		generation = s->generation;
+		pthread_mutex_unlock(&s->lock);
+
+		cpu_worker_hash(s, w->id);
+
+		pthread_mutex_lock(&s->lock);
+		if(--s->pending == 0)
+			pthread_cond_signal(&s->done);
+	}
+	pthread_mutex_unlock(&s->lock);
+	return NULL;
+}
+
+static void cpu_release(struct scan_ctx *ctx)
+{
+	struct cpu_scan *s = (struct cpu_scan *)ctx->priv;
+	if(s)
+	{
+		pthread_mutex_lock(&s->lock);
+		s->quit = true;
+		pthread_cond_broadcast(&s->start);
+		pthread_mutex_unlock(&s->lock);
+		for(int i = 0; i < SCAN_CPU_MAX_THREADS; i++)
+		{
+			if(s->workers[i].started)
+				pthread_join(s->workers[i].thread, NULL);
+			cpu_lanes_free(&s->workers[i].lanes);
+		}
+		pthread_mutex_destroy(&s->lock);
+		pthread_cond_destroy(&s->start);
+		pthread_cond_destroy(&s->done);
+		free(s);
+	}
+	ctx->priv = NULL;
+}
+
+static bool cpu_init(struct scan_ctx *ctx)
+{
+	struct cpu_scan *s = (struct cpu_scan *)calloc(1, sizeof(*s));
+	if(!s)
+		return false;
+	pthread_mutex_init(&s->lock, NULL);
+	pthread_cond_init(&s->start, NULL);
+	pthread_cond_init(&s->done, NULL);
+	s->ctx = ctx;
+	ctx->priv = s;
+	cpu_batch_init();
+	if(!ctx->throughput)
+		ctx->throughput = SCAN_CPU_BATCH;
+	ctx->threads = max(1, min(ctx->threads, SCAN_CPU_MAX_THREADS));
+
+	const uint32_t chunk = (ctx->throughput + ctx->threads - 1) / ctx->threads;
+	for(int i = 0; i < ctx->threads; i++)
+	{
+		struct cpu_worker *w = &s->workers[i];
+		w->s = s;
+		w->id = i;
+		if(!cpu_lanes_alloc(&w->lanes, chunk))
+			return false;
+		// the first chunk is hashed by the miner thread
+		if(i > 0)
+		{
+			if(pthread_create(&w->thread, NULL, cpu_worker_thread, w))
+				return false;
+			w->started = true;
+		}
+	}
+	return true;
+}
+
+static void cpu_set_block(struct scan_ctx *ctx)
+{
+	struct cpu_scan *s = (struct cpu_scan *)ctx->priv;
+	if(!ctx->algo->cpu_precalc)
+		return;
+	// the workers are idle between two batches
+	ctx->algo->cpu_precalc(s->precalc, ctx->endiandata);
+	for(int i = 0; i < ctx->threads; i++)
+		s->workers[i].lanes.precalc = s->precalc;
+}
+
+static void cpu_hash_batch(struct scan_ctx *ctx, uint32_t first_nonce, uint32_t count)
+{
+	struct cpu_scan *s = (struct cpu_scan *)ctx->priv;
+	s->first_nonce = first_nonce;
+	s->count = count;
+	if(ctx->threads > 1)
+	{
+		pthread_mutex_lock(&s->lock);
+		s->pending = ctx->threads - 1;
+		s->generation++;
+		pthread_cond_broadcast(&s->start);
+		pthread_mutex_unlock(&s->lock);
+	}
+	cpu_worker_hash(s, 0);
+	if(ctx->threads > 1)
+	{
+		pthread_mutex_lock(&s->lock);
+		while(s->pending > 0)
+			pthread_cond_wait(&s->done, &s->lock);
+		pthread_mutex_unlock(&s->lock);
+	}
+}
+
+static int cpu_collect_candidates(struct scan_ctx *ctx, uint32_t *nonces, int max)
+{
+	struct cpu_scan *s = (struct cpu_scan *)ctx->priv;
+	int n = 0;
+	for(int i = 0; i < ctx->threads && n < max; i++)
+		n += cpu_lanes_check(&s->workers[i].lanes, ctx->target, nonces + n, max - n);
+	return n;
+}
+
+const struct scan_backend scan_backend_cpu = {
+	"cpu",
+	cpu_init,
+	cpu_set_block,
+	cpu_hash_batch,
+	cpu_collect_candidates,
+	cpu_release
+};
+
+/* driver */
+
+static bool scan_verify(struct scan_ctx *ctx, uint32_t nonce)
+{
+	uint32_t vhash[8] = { 0 };
+	if(opt_verify)
+	{
+		uint32_t data[20];
+		memcpy(data, ctx->endiandata, sizeof(data));
+		be32enc(&data[19], nonce);
+		ctx->algo->hash(vhash, data);
+	}
+	if(vhash[7] <= ctx->target[7] && fulltest(vhash, ctx->target))
+		return true;
+	if(vhash[7] != ctx->target[7]) // don't show message if it is equal but fails fulltest
+		applog(LOG_WARNING, "%s #%d: result for %08x does not validate on CPU!",
+			scan_device_type(scan_backend_get(ctx->thr_id)), device_map[ctx->thr_id], nonce);
+	return false;
+}
+
+int scanhash_generic(int thr_id, const struct scan_algo *algo, uint32_t *pdata,
+	uint32_t *ptarget, uint32_t max_nonce, uint32_t *hashes_done)
+{
+	struct scan_ctx *ctx = &scan_ctxs[thr_id];
+	const struct scan_backend *backend = scan_backend_get(thr_id);
+	const uint32_t first_nonce = pdata[19];
+	uint32_t found[SCAN_MAX_FOUND], valid[SCAN_MAX_FOUND];
+
+	if(opt_benchmark)
+		ptarget[7] = algo->bench_target;
+
+	if(ctx->algo != algo)
+	{
+		if(ctx->algo)
+			backend->release(ctx);
+		memset(ctx, 0, sizeof(*ctx));
+		ctx->thr_id = thr_id;
+		ctx->algo = algo;
+		// the ranges of the scheduler must be whole batches
+		nonce_sched_set_align(thr_id, ~algo->throughput_mask + 1);
+		scan_tune_setup(ctx, backend);
+		if(!backend->init(ctx))
+		{
+			applog(LOG_ERR, "%s #%d: %s backend init failed for %s", scan_device_type(backend), device_map[thr_id],
+				backend->name, algo->name);
+			mining_has_stopped[thr_id] = true;
+			proper_exit(EXIT_FAILURE);
+		}
+		mining_has_stopped[thr_id] = false;
+	}
+
+	uint32_t throughput = min(ctx->throughput, max_nonce - first_nonce) & algo->throughput_mask;
+	if(!throughput)
+	{
+		*hashes_done = 0;
+		return 0;
+	}
+
+	for(int k = 0; k < 20; k++)
+		be32enc(&ctx->endiandata[k], pdata[k]);
+	memcpy(ctx->target, ptarget, sizeof(ctx->target));
+	backend->set_block(ctx);
+
+	do
+	{
+		backend->hash_batch(ctx, pdata[19], throughput);
+		int n = backend->collect_candidates(ctx, found, SCAN_MAX_FOUND);
+		if(stop_mining)
+		{
+			backend->release(ctx);
+			ctx->algo = NULL;
+			mining_has_stopped[thr_id] = true;
+			pthread_exit(nullptr);
+		}
+
+		int res = 0;
+		for(int i = 0; i < n; i++)
+		{
+			if(scan_verify(ctx, found[i]))
+				valid[res++] = found[i];
+		}
+		if(res)
+		{
+			*hashes_done = pdata[19] - first_nonce + throughput;
+			if(res > 1)
+				pdata[21] = valid[1];
+			pdata[19] = valid[0];
+			if(opt_benchmark)
+			{
+				for(int i = 0; i < res; i++)
+					applog(LOG_INFO, "%s #%d: Found nonce %08x", scan_device_type(backend), device_map[thr_id], valid[i]);
+			}
+			return res;
+		}
+		pdata[19] += throughput;
+	} while(!work_restart[thr_id].restart && ((uint64_t)max_nonce > ((uint64_t)(pdata[19]) + (uint64_t)throughput)));
+
+	*hashes_done = pdata[19] - first_nonce;
+	return 0;
+}
@@ -0,0 +1,99 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+/**
+ * Generic scanhash driver
+ *
+ * The driver owns the loop which was copied in every algo: the device
+ * init, the default intensity, the nonce range, the verification of the
+ * candidates on the cpu and the pdata[19]/pdata[21] bookkeeping. It runs
+ * on a backend (the CUDA devices or the cpu), so an algo only describes
+ * its GPU stage list and its reference hash.
+ *
+ * The throughput of each device and algo can be tuned (--autotune), the
+ * results are kept in a json file which is loaded at startup.
+ */
+
+#include <stdint.h>
+#include "cpu_batch.h"
+
+#define SCAN_MAX_FOUND 2
+#define SCAN_CPU_MAX_THREADS 16
+
+/* one step of the GPU pipeline, in place on the 64-byte hashes of d_hash */
+typedef void (*scan_gpu_stage_fn)(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash);
+/* last step, stores up to 2 nonces below the target in h_found (0xffffffff if none) */
+typedef void (*scan_gpu_final_fn)(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash, uint32_t target, uint32_t *h_found);
+
+/* default throughput of the devices whose name contains 'name', the NULL entry is the default */
+struct scan_intensity {
+	const char *name;
+	uint32_t throughput;
+};
+
+struct scan_algo {
+	const char *name;
+	cpu_ref_hash_fn hash;           /* reference hash, verifies the candidates */
+	uint32_t bench_target;          /* ptarget[7] with --benchmark */
+	uint32_t throughput_mask;       /* granularity of the batches */
+	const struct scan_intensity *intensity;
+	/* CUDA */
+	void (*gpu_init)(int thr_id, uint32_t throughput);
+	void (*gpu_set_block)(int thr_id, uint32_t *endiandata);
+	const scan_gpu_stage_fn *gpu_stages; /* NULL terminated */
+	scan_gpu_final_fn gpu_final;
+	/* cpu, NULL to use the reference hash for each nonce */
+	cpu_batch_hash_fn cpu_hash;
+	cpu_precalc_fn cpu_precalc;     /* optional, given to cpu_hash in cpu_lanes.precalc */
+};
+
+struct scan_ctx {
+	int thr_id;
+	const struct scan_algo *algo;
+	uint32_t throughput;            /* max nonces per batch, 0 for the default of init() */
+	int threads;                    /* cpu backend workers, 0 for the default of init() */
+	uint32_t endiandata[20];
+	uint32_t target[8];
+	void *priv;                     /* backend buffers */
+};
+
+struct scan_backend {
+	const char *name;
+	/* allocate the buffers of ctx->algo and set ctx->throughput (and threads) */
+	bool (*init)(struct scan_ctx *ctx);
+	/* new header (ctx->endiandata) and target */
+	void (*set_block)(struct scan_ctx *ctx);
+	/* hash the nonces [first_nonce, first_nonce + count) */
+	void (*hash_batch)(struct scan_ctx *ctx, uint32_t first_nonce, uint32_t count);
+	/* nonces of the last batch which may meet the target */
+	int (*collect_candidates)(struct scan_ctx *ctx, uint32_t *nonces, int max);
+	void (*release)(struct scan_ctx *ctx);
+};
+
+extern const struct scan_backend scan_backend_cuda;
+extern const struct scan_backend scan_backend_cpu;
+/* simulated: the cpu backend, or random nonces at opt_mock_hashrate H/s (scan_mock.cpp) */
+extern const struct scan_backend scan_backend_mock;
+extern double opt_mock_hashrate;
+extern int opt_mock_latency;
+
+const struct scan_backend *scan_backend_find(const char *name);
+/* backend of a miner thread, cuda unless set */
+const struct scan_backend *scan_backend_get(int thr_id);
+void scan_backend_set(int thr_id, const struct scan_backend *backend);
+/* "CPU" or "GPU", the device of the log messages */
+const char *scan_device_type(const struct scan_backend *backend);
+int scan_cuda_driver_version(void);
+uint32_t scan_default_intensity(const struct scan_intensity *table, const char *devname);
+int scanhash_generic(int thr_id, const struct scan_algo *algo, uint32_t *pdata,
+	uint32_t *ptarget, uint32_t max_nonce, uint32_t *hashes_done);
+
+/* autotuner (scan_tune.cpp) */
+extern bool opt_autotune;
+extern char *opt_tune_file;
+extern int opt_tune_latency;
+
+void scan_tune_load(void);
+void scan_tune_setup(struct scan_ctx *ctx, const struct scan_backend *backend);
+
+#endif
@@ -0,0 +1,149 @@
+/**
+ * CUDA backend of the scanhash driver (see scan.h)
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "miner.h"
+#include "scan.h"
+
+#include "cuda_runtime.h"
+
+/* the final stages may fill 2 nonces for each of their branches */
+#define SCAN_GPU_FOUND_WORDS 4
+
+extern cudaStream_t gpustream[MAX_GPUS];
+extern void cudaReportHardwareFailure(int thr_id, cudaError_t err, const char* func);
+
+struct cuda_scan_buffers {
+	uint32_t *d_hash;
+	uint32_t *h_found;
+};
+
+static bool cuda_ok(int thr_id, cudaError_t err, const char *call)
+{
+	if(err == cudaSuccess)
+		return true;
+	applog(LOG_ERR, "GPU #%d: %s %s", device_map[thr_id], call, cudaGetErrorString(err));
+	return false;
+}
+
+static bool cuda_init(struct scan_ctx *ctx)
+{
+	const int thr_id = ctx->thr_id;
+	const int dev_id = device_map[thr_id];
+	const struct scan_algo *algo = ctx->algo;
+	struct cuda_scan_buffers *b;
+	cudaDeviceProp props;
+
+	if(!cuda_ok(thr_id, cudaGetDeviceProperties(&props, dev_id), "cudaGetDeviceProperties") ||
+		!cuda_ok(thr_id, cudaSetDevice(dev_id), "cudaSetDevice") ||
+		!cuda_ok(thr_id, cudaDeviceReset(), "cudaDeviceReset") ||
+		!cuda_ok(thr_id, cudaSetDeviceFlags(cudaDeviceScheduleBlockingSync), "cudaSetDeviceFlags") ||
+		!cuda_ok(thr_id, cudaDeviceSetCacheConfig(cudaFuncCachePreferL1), "cudaDeviceSetCacheConfig") ||
+		!cuda_ok(thr_id, cudaStreamCreate(&gpustream[thr_id]), "cudaStreamCreate"))
+		return false;
+
+	const bool tuned = ctx->throughput != 0;
+	uint32_t intensity = tuned ? ctx->throughput : scan_default_intensity(algo->intensity, props.name);
+	ctx->throughput = device_intensity(dev_id, algo->name, intensity);
+	if(ctx->throughput == intensity)
+		applog(LOG_INFO, "GPU #%d: using %s intensity %.3f", dev_id, tuned ? "tuned" : "default", throughput2intensity(ctx->throughput));
+	ctx->threads = 1;
+
+	// keep some room for the buffers of the algo, cudaMalloc errors are fatal there
+	size_t mem_free, mem_total;
+	if(cudaMemGetInfo(&mem_free, &mem_total) == cudaSuccess && 128ULL * ctx->throughput > mem_free)
+	{
+		applog(LOG_ERR, "GPU #%d: not enough memory for intensity %.3f", dev_id, throughput2intensity(ctx->throughput));
+		return false;
+	}
+#if defined WIN32 && !defined _WIN64
+	// 2GB limit for cudaMalloc
+	if(ctx->throughput > 0x7fffffffULL / 64)
+	{
+		applog(LOG_ERR, "intensity too high");
+		cudaStreamDestroy(gpustream[thr_id]);
+		return false;
+	}
+#endif
+
+	b = (struct cuda_scan_buffers *)calloc(1, sizeof(*b));
+	if(!b)
+		return false;
+	ctx->priv = b;
+	if(!cuda_ok(thr_id, cudaMalloc(&b->d_hash, 64ULL * ctx->throughput), "cudaMalloc") ||
+		!cuda_ok(thr_id, cudaMallocHost(&b->h_found, SCAN_GPU_FOUND_WORDS * sizeof(uint32_t)), "cudaMallocHost"))
+		return false;
+
+	algo->gpu_init(thr_id, ctx->throughput);
+	return cuda_ok(thr_id, cudaGetLastError(), algo->name);
+}
+
+static void cuda_set_block(struct scan_ctx *ctx)
+{
+	ctx->algo->gpu_set_block(ctx->thr_id, ctx->endiandata);
+}
+
+static void cuda_hash_batch(struct scan_ctx *ctx, uint32_t first_nonce, uint32_t count)
+{
+	struct cuda_scan_buffers *b = (struct cuda_scan_buffers *)ctx->priv;
+	const struct scan_algo *algo = ctx->algo;
+
+	for(const scan_gpu_stage_fn *stage = algo->gpu_stages; *stage; stage++)
+		(*stage)(ctx->thr_id, count, first_nonce, b->d_hash);
+	algo->gpu_final(ctx->thr_id, count, first_nonce, b->d_hash, ctx->target[7], b->h_found);
+}
+
+static int cuda_collect_candidates(struct scan_ctx *ctx, uint32_t *nonces, int max)
+{
+	struct cuda_scan_buffers *b = (struct cuda_scan_buffers *)ctx->priv;
+	const int thr_id = ctx->thr_id;
+	cudaError_t err;
+	int n = 0;
+
+	err = cudaStreamSynchronize(gpustream[thr_id]);
+	if(err == cudaSuccess)
+		err = cudaGetLastError();
+	if(err != cudaSuccess)
+	{
+		cudaReportHardwareFailure(thr_id, err, __func__);
+		return 0;
+	}
+	for(int i = 0; i < SCAN_MAX_FOUND && n < max; i++)
+	{
+		if(b->h_found[i] != UINT32_MAX)
+			nonces[n++] = b->h_found[i];
+	}
+	return n;
+}
+
+static void cuda_release(struct scan_ctx *ctx)
+{
+	struct cuda_scan_buffers *b = (struct cuda_scan_buffers *)ctx->priv;
+	if(b)
+	{
+		if(b->d_hash) cudaFree(b->d_hash);
+		if(b->h_found) cudaFreeHost(b->h_found);
+		free(b);
+	}
+	ctx->priv = NULL;
+	cudaStreamDestroy(gpustream[ctx->thr_id]);
+}
+
+/* of the tune results */
+int scan_cuda_driver_version(void)
+{
+	int version = 0;
+	cudaDriverGetVersion(&version);
+	return version;
+}
+
+const struct scan_backend scan_backend_cuda = {
+	"cuda",
+	cuda_init,
+	cuda_set_block,
+	cuda_hash_batch,
+	cuda_collect_candidates,
+	cuda_release
+};
@@ -0,0 +1,121 @@
+/**
+ * Mock backend of the scanhash driver (see scan.h)
+ *
+ * By default it hashes on the cpu backend with the cpu or reference
+ * functions of the algo, so the found nonces are real shares. With
+ * --mock-hashrate nothing is hashed: each batch sleeps for the time the
+ * given hashrate needs and returns random nonces, drawn with the
+ * probability of the current target, which the pool sees as low
+ * difficulty shares. No CUDA is needed, the simulated devices of
+ * mockdev.cpp and the tests use it.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#ifndef WIN32
+#include <unistd.h>
+#endif
+
+#include "miner.h"
+#include "scan.h"
+
+#define MOCK_BATCH_MS 100
+
+double opt_mock_hashrate = 0.; /* per device, 0 = hash on the cpu */
+int opt_mock_latency = 0; /* ms added to each batch */
+
+struct mock_state {
+	uint64_t rnd;
+	int nfound;
+	uint32_t found[SCAN_MAX_FOUND];
+};
+
+static uint32_t mock_rand(struct mock_state *m)
+{
+	// xorshift64*
+	m->rnd ^= m->rnd >> 12;
+	m->rnd ^= m->rnd << 25;
+	m->rnd ^= m->rnd >> 27;
+	return (uint32_t)((m->rnd * 2685821657736338717ULL) >> 32);
+}
+
+static bool mock_init(struct scan_ctx *ctx)
+{
+	if(opt_mock_hashrate <= 0.)
+		return scan_backend_cpu.init(ctx);
+
+	struct mock_state *m = (struct mock_state *)calloc(1, sizeof(*m));
+	if(!m)
+		return false;
+	m->rnd = ((uint64_t)time(NULL) << 8) ^ (0x9E3779B97F4A7C15ULL * (uint64_t)(ctx->thr_id + 1));
+	ctx->priv = m;
+	ctx->throughput = (uint32_t)max(1., min(opt_mock_hashrate * MOCK_BATCH_MS / 1000., (double)UINT32_MAX));
+	return true;
+}
+
+static void mock_set_block(struct scan_ctx *ctx)
+{
+	if(opt_mock_hashrate <= 0.)
+		scan_backend_cpu.set_block(ctx);
+}
+
+static void mock_hash_batch(struct scan_ctx *ctx, uint32_t first_nonce, uint32_t count)
+{
+	if(opt_mock_hashrate <= 0.)
+		scan_backend_cpu.hash_batch(ctx, first_nonce, count);
+	else
+	{
+		struct mock_state *m = (struct mock_state *)ctx->priv;
+
+		// number of shares in the batch, poisson distributed
+		double expected = (double)count / target_to_hashes(ctx->target);
+		double p = exp(-expected), cdf = p;
+		double u = (mock_rand(m) + 0.5) / 4294967296.0;
+		int k = 0;
+		while(u > cdf && k < SCAN_MAX_FOUND)
+		{
+			k++;
+			p *= expected / k;
+			cdf += p;
+		}
+		m->nfound = k;
+		for(int i = 0; i < k; i++)
+			m->found[i] = first_nonce + mock_rand(m) % count;
+
+		usleep((useconds_t)(count * 1e6 / opt_mock_hashrate));
+	}
+	if(opt_mock_latency > 0)
+		usleep((useconds_t)opt_mock_latency * 1000);
+}
+
+static int mock_collect_candidates(struct scan_ctx *ctx, uint32_t *nonces, int max)
+{
+	if(opt_mock_hashrate <= 0.)
+		return scan_backend_cpu.collect_candidates(ctx, nonces, max);
+
+	struct mock_state *m = (struct mock_state *)ctx->priv;
+	int n = min(m->nfound, max);
+	memcpy(nonces, m->found, n * sizeof(uint32_t));
+	return n;
+}
+
+static void mock_release(struct scan_ctx *ctx)
+{
+	if(opt_mock_hashrate <= 0.)
+		scan_backend_cpu.release(ctx);
+	else
+	{
+		free(ctx->priv);
+		ctx->priv = NULL;
+	}
+}
+
+const struct scan_backend scan_backend_mock = {
+	"mock",
+	mock_init,
+	mock_set_block,
+	mock_hash_batch,
+	mock_collect_candidates,
+	mock_release
+};
@@ -0,0 +1,292 @@
+/**
+ * Throughput autotuner of the scanhash driver (see scan.h)
+ *
+ * The first time an algo runs on a device, --autotune measures the
+ * backend at a range of batch sizes (and worker threads for the cpu):
+ * the steady hashrate and the time of one batch. A batch is not
+ * interrupted by a new job, so the result is the fastest point whose
+ * batch time fits in --tune-latency, or the smallest one which is
+ * nearly as fast. The results are kept in --tune-file by device name,
+ * algo, backend and driver version, and reused at the next start.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include <vector>
+
+#include "miner.h"
+#include "scan.h"
+
+#define TUNE_FILE_VERSION 1
+#define TUNE_MIN_MS 300        /* measure each point for at least this time */
+#define TUNE_MIN_BATCHES 3
+#define TUNE_KNEE 0.98         /* prefer a smaller batch within 2% of the best */
+
+extern bool stop_mining;
+
+bool opt_autotune = false;
+char *opt_tune_file = NULL;
+int opt_tune_latency = 100;
+
+static json_t *tune_results = NULL;
+static pthread_mutex_t tune_lock = PTHREAD_MUTEX_INITIALIZER;
+
+struct tune_point {
+	uint32_t throughput;
+	int threads;
+	double hashrate;
+	double latency; /* ms per batch */
+};
+
+static const char *tune_filename(void)
+{
+	return opt_tune_file ? opt_tune_file : "ccminer-tune.json";
+}
+
+static int tune_driver_version(const struct scan_backend *backend)
+{
+	return backend == &scan_backend_cuda ? scan_cuda_driver_version() : 0;
+}
+
+static const char *tune_device(int thr_id, const struct scan_backend *backend)
+{
+	if(backend == &scan_backend_cpu || !device_name[device_map[thr_id]])
+		return "cpu";
+	return device_name[device_map[thr_id]];
+}
+
+/**
+ * Load the results at startup, a missing file is not an error
+ */
+void scan_tune_load(void)
+{
+	json_error_t err;
+	json_t *root;
+
+	pthread_mutex_lock(&tune_lock);
+	if(tune_results)
+		json_decref(tune_results);
+	tune_results = json_array();
+	FILE *f = fopen(tune_filename(), "r");
+	if(f)
+	{
+		fclose(f);
+#if JANSSON_VERSION_HEX >= 0x020000
+		root = json_load_file(tune_filename(), 0, &err);
+#else
+		root = json_load_file(tune_filename(), &err);
+#endif
+		json_t *results = json_object_get(root, "results");
+		if(!json_is_array(results) || json_integer_value(json_object_get(root, "version")) != TUNE_FILE_VERSION)
+			applog(LOG_WARNING, "tune: ignoring invalid file %s", tune_filename());
+		else
+		{
+			json_array_extend(tune_results, results);
+			applog(LOG_INFO, "tune: %d results loaded from %s", (int)json_array_size(tune_results), tune_filename());
+		}
+		if(root)
+			json_decref(root);
+	}
+	pthread_mutex_unlock(&tune_lock);
+}
+
+static void tune_save(void)
+{
+	json_t *root = json_pack("{s:i, s:O}", "version", TUNE_FILE_VERSION, "results", tune_results);
+	if(json_dump_file(root, tune_filename(), JSON_INDENT(1)) < 0)
+		applog(LOG_WARNING, "tune: unable to write %s", tune_filename());
+	json_decref(root);
+}
+
+static json_t *tune_find(const char *device, const char *algo, const char *backend, int driver)
+{
+	for(size_t i = 0; i < json_array_size(tune_results); i++)
+	{
+		json_t *r = json_array_get(tune_results, i);
+		const char *d = json_string_value(json_object_get(r, "device"));
+		const char *a = json_string_value(json_object_get(r, "algo"));
+		const char *b = json_string_value(json_object_get(r, "backend"));
+		if(d && a && b && !strcmp(d, device) && !strcmp(a, algo) && !strcmp(b, backend) &&
+			json_integer_value(json_object_get(r, "driver")) == driver)
+			return r;
+	}
+	return NULL;
+}
+
+/* hash with a random header and a null target for a while */
+static bool tune_measure(struct scan_ctx *ctx, const struct scan_backend *backend, struct tune_point *p)
+{
+	const struct scan_algo *algo = ctx->algo;
+	uint32_t found[SCAN_MAX_FOUND];
+	struct timeval tv_start, tv_batch, tv_end, diff;
+	double elapsed = 0., worst = 0.;
+	uint32_t nonce = 0;
+	int batches = 0;
+
+	ctx->throughput = p->throughput;
+	ctx->threads = p->threads;
+	if(!backend->init(ctx))
+	{
+		backend->release(ctx);
+		return false;
+	}
+	uint32_t count = ctx->throughput & algo->throughput_mask;
+	if(!count)
+	{
+		backend->release(ctx);
+		return false;
+	}
+	for(int k = 0; k < 20; k++)
+		ctx->endiandata[k] = (uint32_t)rand() * 65537U;
+	memset(ctx->target, 0, sizeof(ctx->target));
+	backend->set_block(ctx);
+
+	// first batch is the warm up
+	backend->hash_batch(ctx, nonce, count);
+	backend->collect_candidates(ctx, found, SCAN_MAX_FOUND);
+	nonce += count;
+
+	gettimeofday(&tv_start, NULL);
+	do
+	{
+		gettimeofday(&tv_batch, NULL);
+		backend->hash_batch(ctx, nonce, count);
+		backend->collect_candidates(ctx, found, SCAN_MAX_FOUND);
+		gettimeofday(&tv_end, NULL);
+		timeval_subtract(&diff, &tv_end, &tv_batch);
+		worst = max(worst, diff.tv_sec * 1e3 + diff.tv_usec * 1e-3);
+		timeval_subtract(&diff, &tv_end, &tv_start);
+		elapsed = diff.tv_sec * 1e3 + diff.tv_usec * 1e-3;
+		nonce += count;
+		batches++;
+	} while(!stop_mining && (elapsed < TUNE_MIN_MS || batches < TUNE_MIN_BATCHES));
+	backend->release(ctx);
+
+	p->throughput = count;
+	p->threads = ctx->threads;
+	p->hashrate = elapsed > 0. ? (double)count * batches * 1e3 / elapsed : 0.;
+	p->latency = elapsed / batches;
+	if(opt_debug)
+		applog(LOG_DEBUG, "%s #%d: tune %s %u x %d: %.2f kH/s, %.1f ms per batch (max %.1f)", scan_device_type(backend),
+			device_map[ctx->thr_id], algo->name, count, p->threads, p->hashrate / 1e3, p->latency, worst);
+	return true;
+}
+
+static bool tune_better(const struct tune_point *p, const struct tune_point *best)
+{
+	const double budget = opt_tune_latency;
+	if(!best->hashrate)
+		return true;
+	if((p->latency <= budget) != (best->latency <= budget))
+		return p->latency <= budget;
+	if(best->latency > budget)
+		return p->latency < best->latency;
+	return p->hashrate > best->hashrate;
+}
+
+/* sweep the batch sizes from 1/8 to 8 times the default, for each thread count */
+static void tune_run(struct scan_ctx *ctx, const struct scan_backend *backend, struct tune_point *best)
+{
+	const struct scan_algo *algo = ctx->algo;
+	std::vector<struct tune_point> points;
+	struct tune_point p;
+	int max_threads = 1;
+
+	memset(best, 0, sizeof(*best));
+	ctx->throughput = 0;
+	ctx->threads = 0;
+	if(!backend->init(ctx))
+	{
+		backend->release(ctx);
+		return;
+	}
+	const uint64_t def = ctx->throughput;
+	backend->release(ctx);
+	if(backend == &scan_backend_cpu)
+		max_threads = min(num_cpus, SCAN_CPU_MAX_THREADS);
+
+	for(int threads = 1; threads <= max_threads && !stop_mining; threads *= 2)
+	{
+		for(uint64_t t = max(def >> 3, (uint64_t)(~algo->throughput_mask + 1)); t <= min(def << 3, 0x80000000ULL) && !stop_mining; t <<= 1)
+		{
+			p.throughput = (uint32_t)t;
+			p.threads = threads;
+			if(!tune_measure(ctx, backend, &p))
+				break;
+			points.push_back(p);
+			// the next ones are even slower to switch jobs
+			if(p.latency > opt_tune_latency)
+				break;
+		}
+	}
+
+	for(size_t i = 0; i < points.size(); i++)
+	{
+		if(tune_better(&points[i], best))
+			*best = points[i];
+	}
+	// the points are by threads then batch size, take the first one close to the best
+	for(size_t i = 0; i < points.size(); i++)
+	{
+		const struct tune_point *q = &points[i];
+		if(q->hashrate >= best->hashrate * TUNE_KNEE && q->latency <= max((double)opt_tune_latency, best->latency))
+		{
+			*best = *q;
+			break;
+		}
+	}
+	if(best->hashrate && best->latency > opt_tune_latency)
+		applog(LOG_WARNING, "%s #%d: no %s batch fits in %d ms, the shortest takes %.1f ms", scan_device_type(backend),
+			device_map[ctx->thr_id], algo->name, opt_tune_latency, best->latency);
+}
+
+/**
+ * Set ctx->throughput and ctx->threads before the backend init,
+ * from the tune file or by tuning now with --autotune
+ */
+void scan_tune_setup(struct scan_ctx *ctx, const struct scan_backend *backend)
+{
+	const int thr_id = ctx->thr_id;
+	const char *device = tune_device(thr_id, backend);
+	const int driver = tune_driver_version(backend);
+	const char *algo = ctx->algo->name;
+
+	if(gpus_intensity[device_map[thr_id]])
+		return;
+
+	pthread_mutex_lock(&tune_lock);
+	if(!tune_results)
+		tune_results = json_array();
+	json_t *r = tune_find(device, algo, backend->name, driver);
+	if(!r && opt_autotune)
+	{
+		struct tune_point best;
+		applog(LOG_INFO, "%s #%d: tuning %s on the %s backend, max %d ms per batch", scan_device_type(backend),
+			device_map[thr_id], algo, backend->name, opt_tune_latency);
+		// one device at a time, the cpu measures would disturb each other
+		tune_run(ctx, backend, &best);
+		if(best.hashrate > 0. && !stop_mining)
+		{
+			r = json_pack("{s:s, s:s, s:s, s:i, s:I, s:i, s:f, s:f}", "device", device, "algo", algo,
+				"backend", backend->name, "driver", driver, "throughput", (json_int_t)best.throughput,
+				"threads", best.threads, "hashrate", floor(best.hashrate), "latency", floor(best.latency * 10.) / 10.);
+			json_array_append_new(tune_results, r);
+			tune_save();
+		}
+	}
+	if(r)
+	{
+		ctx->throughput = (uint32_t)json_integer_value(json_object_get(r, "throughput"));
+		ctx->threads = (int)json_integer_value(json_object_get(r, "threads"));
+		applog(LOG_INFO, "%s #%d: %s tuned to %u nonces per batch (%d threads), %.2f kH/s, %.1f ms per batch",
+			scan_device_type(backend), device_map[thr_id], algo, ctx->throughput, ctx->threads,
+			json_number_value(json_object_get(r, "hashrate")) / 1e3, json_number_value(json_object_get(r, "latency")));
+	}
+	else
+	{
+		ctx->throughput = 0;
+		ctx->threads = 0;
+	}
+	pthread_mutex_unlock(&tune_lock);
+}
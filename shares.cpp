@@ -0,0 +1,421 @@
+/**
+ * Share statistics
+ *
+ * Each share is weighted by the work needed to find it on average
+ * (2^256 / target), so the accepted shares give the hashrate seen by
+ * the pool, independent of the algo, the vardiff and --diff-factor.
+ * This one is compared to the hashrate reported by the GPU threads.
+ *
+ * The submits are also tagged with the job age when the nonce was
+ * found, the time spent in the workio queue and the pool answer time,
+ * with a latency histogram and outcome counters per pool. Submits are
+ * tracked by their json-rpc request id until the pool answers them.
+ *
+ * Note: this source is C++ (requires std::deque and std::map)
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <memory.h>
+#include <math.h>
+#include <deque>
+#include <map>
+#include <string>
+
+#include "miner.h"
+
+#define SHARES_WINDOW_MAX (60*60) /* keep one hour of events */
+#define SHARES_Z95 1.96
+#define SHARES_INFLIGHT_TIMEOUT (5*60) /* forget unanswered submits */
+#define SHARES_FIRST_ID 4 /* lower ids are used by subscribe/authorize */
+
+/* log-linear latency buckets in ms, 8 per power of two, up to 2^32 */
+#define LAT_SUB 8
+#define LAT_BUCKETS (LAT_SUB + 29 * LAT_SUB)
+
+struct share_event {
+	time_t tm;
+	double weight;
+	uint8_t accepted;
+};
+
+struct share_pending {
+	double weight;
+	struct timeval tv_sent;
+	struct share_data sd;
+};
+
+struct lat_histo {
+	uint32_t count[LAT_BUCKETS];
+	uint32_t total;
+};
+
+struct pool_shares {
+	uint32_t outcome[SHARE_OUTCOMES];
+	struct lat_histo job_age;
+	struct lat_histo queue;
+	struct lat_histo answer;
+};
+
+static std::deque<share_event> tevents;
+static std::map<uint32_t, share_pending> tinflight; /* request id -> submitted share */
+static uint32_t next_id = SHARES_FIRST_ID;
+static std::map<std::string, pool_shares> tpools;
+static pool_shares *cur_pool = NULL;
+static double last_weight = 0.;
+static time_t tm_start = 0;
+static pthread_mutex_t shares_lock = PTHREAD_MUTEX_INITIALIZER;
+
+const int shares_windows[SHARES_WINDOWS] = { 5*60, 15*60, 60*60 };
+
+const char *share_outcome_names[SHARE_OUTCOMES] = {
+	"ACC", "STALE", "PSTALE", "DUP", "LOWDIFF", "REJ"
+};
+
+/**
+ * Average number of hashes needed to find a share of this target
+ */
+double target_to_hashes(const uint32_t *target)
+{
+	double t = 0.;
+	for(int i = 0; i < 8; i++)
+		t += ldexp((double)target[i], 32 * i - 256);
+	return (t > 0.) ? 1.0 / t : 0.;
+}
+
+static uint32_t tv_msec(const struct timeval *to, const struct timeval *from)
+{
+	struct timeval diff;
+	if(!from->tv_sec || !to->tv_sec)
+		return 0;
+	if(timeval_subtract(&diff, (struct timeval *)to, (struct timeval *)from))
+		return 0; /* negative */
+	return (uint32_t)(1000 * diff.tv_sec) + (uint32_t)(diff.tv_usec / 1000);
+}
+
+static int lat_bucket(uint32_t ms)
+{
+	if(ms < LAT_SUB)
+		return (int)ms;
+	int e = 31;
+	while(!(ms >> e)) e--;
+	return LAT_SUB + (e - 3) * LAT_SUB + (int)((ms >> (e - 3)) & (LAT_SUB - 1));
+}
+
+/* lower bound (ms) of a bucket */
+static double lat_bucket_min(int b)
+{
+	if(b < LAT_SUB)
+		return (double)b;
+	int e = (b - LAT_SUB) / LAT_SUB + 3;
+	return ldexp((double)(LAT_SUB + (b % LAT_SUB)), e - 3);
+}
+
+static void lat_add(struct lat_histo *h, uint32_t ms)
+{
+	h->count[lat_bucket(ms)]++;
+	h->total++;
+}
+
+/* value at percentile p (0..1), interpolated in its bucket */
+static uint32_t lat_percentile(const struct lat_histo *h, double p)
+{
+	uint32_t rank, seen = 0;
+	if(!h->total)
+		return 0;
+	rank = (uint32_t)ceil(p * h->total);
+	if(rank < 1) rank = 1;
+	for(int b = 0; b < LAT_BUCKETS; b++)
+	{
+		if(!h->count[b])
+			continue;
+		if(seen + h->count[b] >= rank)
+		{
+			double lo = lat_bucket_min(b);
+			double hi = (b + 1 < LAT_BUCKETS) ? lat_bucket_min(b + 1) : lo * 2.;
+			double f = (double)(rank - seen) / h->count[b];
+			return (uint32_t)(lo + (hi - lo) * f);
+		}
+		seen += h->count[b];
+	}
+	return 0;
+}
+
+/* classify a pool reject reason */
+static int reject_outcome(const char *reason)
+{
+	char s[64] = { 0 };
+	if(!reason)
+		return SHARE_REJECTED;
+	for(int i = 0; reason[i] && i < (int)sizeof(s) - 1; i++)
+		s[i] = (char)tolower((unsigned char)reason[i]);
+	if(strstr(s, "duplicate"))
+		return SHARE_DUPLICATE;
+	if(strstr(s, "low diff") || strstr(s, "low-diff") || strstr(s, "above target") || strstr(s, "high-hash"))
+		return SHARE_LOWDIFF;
+	if(strstr(s, "stale") || strstr(s, "job not found") || strstr(s, "unknown job") || strstr(s, "old job"))
+		return SHARE_POOL_STALE;
+	return SHARE_REJECTED;
+}
+
+static void share_tag(struct share_data *sd, const struct work *work, uint32_t nonce)
+{
+	memset(sd, 0, sizeof(*sd));
+	sd->height = work->height;
+	sd->njobid = (uint32_t)strtoul(work->job_id + 8, NULL, 16);
+	sd->nonce = nonce;
+	sd->thr_id = (uint8_t)work->thr_id;
+	sd->gpu_id = (work->thr_id >= 0 && work->thr_id < MAX_GPUS) ? (uint8_t)device_map[work->thr_id] : 0xff;
+	sd->difficulty = work->difficulty;
+	sd->job_age_msec = tv_msec(&work->tv_found, &work->tv_job);
+}
+
+void shares_init(const char *pool)
+{
+	pthread_mutex_lock(&shares_lock);
+	tevents.clear();
+	tinflight.clear();
+	tm_start = time(NULL);
+	cur_pool = &tpools[pool ? pool : ""];
+	pthread_mutex_unlock(&shares_lock);
+}
+
+static void shares_purge(time_t now)
+{
+	while(!tevents.empty() && (now - tevents.front().tm) > SHARES_WINDOW_MAX)
+		tevents.pop_front();
+
+	std::map<uint32_t, share_pending>::iterator i = tinflight.begin();
+	while(i != tinflight.end())
+	{
+		if((now - i->second.tv_sent.tv_sec) > SHARES_INFLIGHT_TIMEOUT)
+		{
+			if(opt_debug)
+				applog(LOG_DEBUG, "submit %u was never answered", i->first);
+			tinflight.erase(i++);
+		}
+		else ++i;
+	}
+}
+
+/**
+ * Register a share about to be sent to the pool
+ * @return the json-rpc request id to use
+ */
+uint32_t shares_submitted(const struct work *work, uint32_t nonce)
+{
+	share_pending sp;
+	uint32_t id;
+	gettimeofday(&sp.tv_sent, NULL);
+	share_tag(&sp.sd, work, nonce);
+	sp.sd.queue_msec = tv_msec(&sp.tv_sent, &work->tv_found);
+
+	pthread_mutex_lock(&shares_lock);
+	id = next_id++;
+	if(next_id < SHARES_FIRST_ID)
+		next_id = SHARES_FIRST_ID;
+	last_weight = sp.weight = target_to_hashes(work->target);
+	sp.sd.sharediff = sp.weight / 4294967296.0;
+	tinflight[id] = sp;
+	shares_purge(sp.tv_sent.tv_sec);
+	pthread_mutex_unlock(&shares_lock);
+	return id;
+}
+
+/**
+ * The share could not be sent
+ */
+void shares_cancel(uint32_t id)
+{
+	pthread_mutex_lock(&shares_lock);
+	tinflight.erase(id);
+	pthread_mutex_unlock(&shares_lock);
+}
+
+/**
+ * A share was not sent: stale job or duplicate nonce
+ */
+void shares_discarded(const struct work *work, uint32_t nonce, int outcome)
+{
+	struct share_data sd;
+	struct timeval now;
+	gettimeofday(&now, NULL);
+	share_tag(&sd, work, nonce);
+	sd.tm_result = (uint32_t)now.tv_sec;
+	sd.queue_msec = tv_msec(&now, &work->tv_found);
+	sd.result = 0;
+	sd.reason = (uint8_t)outcome;
+
+	pthread_mutex_lock(&shares_lock);
+	if(cur_pool)
+	{
+		cur_pool->outcome[outcome]++;
+		lat_add(&cur_pool->job_age, sd.job_age_msec);
+		lat_add(&cur_pool->queue, sd.queue_msec);
+	}
+	pthread_mutex_unlock(&shares_lock);
+
+	if(opt_debug)
+		applog(LOG_DEBUG, "share %s discarded: job age %u ms, queued %u ms",
+			share_outcome_names[outcome], sd.job_age_msec, sd.queue_msec);
+	statsfile_add_share(&sd);
+}
+
+/**
+ * Forget the submitted shares which will never be answered (disconnect)
+ */
+void shares_drop_pending(void)
+{
+	pthread_mutex_lock(&shares_lock);
+	tinflight.clear();
+	pthread_mutex_unlock(&shares_lock);
+}
+
+/**
+ * The pool answered to the request id
+ * @param out optional, details of the share (thr_id 0xff if unknown)
+ * @return the share outcome
+ */
+int shares_result(uint32_t id, int accepted, const char *reason, struct share_data *out)
+{
+	share_event ev;
+	struct share_data sd;
+	struct timeval now;
+	int outcome = accepted ? SHARE_ACCEPTED : reject_outcome(reason);
+	bool known = false;
+
+	gettimeofday(&now, NULL);
+	pthread_mutex_lock(&shares_lock);
+	if(tm_start == 0)
+		tm_start = now.tv_sec;
+	ev.tm = now.tv_sec;
+	ev.accepted = accepted ? 1 : 0;
+	ev.weight = 0.;
+	std::map<uint32_t, share_pending>::iterator i = tinflight.find(id);
+	if(i != tinflight.end())
+	{
+		ev.weight = i->second.weight;
+		sd = i->second.sd;
+		sd.answer_msec = tv_msec(&now, &i->second.tv_sent);
+		tinflight.erase(i);
+		known = true;
+	}
+	tevents.push_back(ev);
+	shares_purge(now.tv_sec);
+	if(cur_pool)
+	{
+		cur_pool->outcome[outcome]++;
+		if(known)
+		{
+			lat_add(&cur_pool->job_age, sd.job_age_msec);
+			lat_add(&cur_pool->queue, sd.queue_msec);
+			lat_add(&cur_pool->answer, sd.answer_msec);
+		}
+	}
+	pthread_mutex_unlock(&shares_lock);
+
+	if(!known)
+	{
+		memset(&sd, 0, sizeof(sd));
+		sd.thr_id = sd.gpu_id = 0xff;
+	}
+	else if(opt_debug)
+	{
+		applog(LOG_DEBUG, "submit %u GPU #%d %s: job age %u ms, queued %u ms, answer %u ms",
+			id, (int)sd.gpu_id, share_outcome_names[outcome], sd.job_age_msec, sd.queue_msec, sd.answer_msec);
+	}
+	sd.tm_result = (uint32_t)now.tv_sec;
+	sd.result = accepted ? 1 : 0;
+	sd.reason = (uint8_t)outcome;
+	statsfile_add_share(&sd);
+	if(out)
+		memcpy(out, &sd, sizeof(sd));
+	return outcome;
+}
+
+/**
+ * Outcome counters and latency percentiles of each pool
+ * @return number of pools stored in st[]
+ */
+int shares_get_pools(struct pool_share_stats *st, int max_pools)
+{
+	static const double pct[3] = { 0.50, 0.90, 0.99 };
+	int n = 0;
+	pthread_mutex_lock(&shares_lock);
+	for(std::map<std::string, pool_shares>::iterator i = tpools.begin(); i != tpools.end() && n < max_pools; ++i, n++)
+	{
+		memset(&st[n], 0, sizeof(st[n]));
+		snprintf(st[n].url, sizeof(st[n].url), "%s", i->first.c_str());
+		memcpy(st[n].outcome, i->second.outcome, sizeof(st[n].outcome));
+		if(&i->second == cur_pool)
+			st[n].inflight = (uint32_t)tinflight.size();
+		for(int p = 0; p < 3; p++)
+		{
+			st[n].job_age[p] = lat_percentile(&i->second.job_age, pct[p]);
+			st[n].queue[p] = lat_percentile(&i->second.queue, pct[p]);
+			st[n].answer[p] = lat_percentile(&i->second.answer, pct[p]);
+		}
+	}
+	pthread_mutex_unlock(&shares_lock);
+	return n;
+}
+
+/**
+ * Compute the pool side hashrate of the last 'window' seconds
+ * @param reported double hashrate of the gpu threads (H/s)
+ */
+void shares_get_stats(int window, double reported, struct share_stats *st)
+{
+	double mean;
+	time_t now = time(NULL);
+
+	memset(st, 0, sizeof(*st));
+	st->window = window;
+
+	pthread_mutex_lock(&shares_lock);
+	shares_purge(now);
+	mean = last_weight;
+	st->elapsed = (tm_start && now > tm_start) ? min((double)(now - tm_start), (double)window) : 0.;
+	for(std::deque<share_event>::reverse_iterator i = tevents.rbegin(); i != tevents.rend(); ++i)
+	{
+		if((now - i->tm) > window)
+			break;
+		st->submitted_weight += i->weight;
+		if(i->accepted)
+		{
+			st->accepted++;
+			st->accepted_weight += i->weight;
+		}
+		else
+			st->rejected++;
+	}
+	pthread_mutex_unlock(&shares_lock);
+
+	st->reported = reported;
+	if(st->elapsed < 1.)
+		return;
+
+	st->hashrate = st->accepted_weight / st->elapsed;
+
+	/* poisson confidence interval (Wilson-Hilferty) on the share count */
+	double n = (double)st->accepted;
+	if(n > 0.)
+	{
+		mean = st->accepted_weight / n;
+		double lo = n * pow(1. - 1. / (9. * n) - SHARES_Z95 / (3. * sqrt(n)), 3);
+		st->hashrate_lo = max(lo, 0.) * mean / st->elapsed;
+	}
+	double n1 = n + 1.;
+	double hi = n1 * pow(1. - 1. / (9. * n1) + SHARES_Z95 / (3. * sqrt(n1)), 3);
+	st->hashrate_hi = hi * mean / st->elapsed;
+
+	/* luck: accepted work vs the work expected at the reported rate */
+	double expected = reported * st->elapsed;
+	if(expected > 0. && mean > 0.)
+	{
+		st->luck = st->accepted_weight / expected;
+		/* deviation in sigma, the share count is poisson(expected / mean) */
+		st->zscore = (st->accepted_weight - expected) / sqrt(expected * mean);
+	}
+}
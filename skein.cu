@@ -9,6 +9,7 @@ extern "C" {
 }
 
 #include "miner.h"
+#include "scan.h"
 #include "cuda_helper.h"
 #include <openssl/sha.h>
 
@@ -39,10 +40,25 @@ static __inline uint32_t swab32_if(uint32_t val, bool iftrue)
 	return iftrue ? swab32(val) : val;
 }
 
+/* scanner of the cpu backend (cpu_skeincoin.cpp), the GPU loop is below */
+static const struct scan_algo skein_scan = {
+	"skein",
+	skeincoinhash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	skein_cpu_hash,
+	skein_cpu_precalc
+};
+
 int scanhash_skeincoin(int thr_id, uint32_t *pdata,
 								  uint32_t *ptarget, uint32_t max_nonce,
 								  uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &skein_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *foundnonces = nullptr;
 
 	const uint32_t first_nonce = pdata[19];
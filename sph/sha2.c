@@ -195,12 +195,31 @@ static void sha256d_80_swap(uint32_t *hash, const uint32_t *data)
 		hash[i] = swab32(hash[i]);
 }
 
-void sha256d(unsigned char *hash, const unsigned char *data, int len)
+/* state of the whole 64-byte blocks of data, len is a multiple of 64 */
+void sha256_midstate(uint32_t *state, const unsigned char *data, int len)
+{
+	uint32_t T[16];
+	int i, r;
+
+	sha256_init(state);
+	for (r = 0; r + 64 <= len; r += 64) {
+		for (i = 0; i < 16; i++)
+			T[i] = be32dec(data + r + 4 * i);
+		sha256_transform(state, T, 0);
+	}
+}
+
+/*
+ * sha256 (twice: sha256d) of a message whose first 'done' bytes are in
+ * the midstate, 'data' is the rest of it
+ */
+void sha256_tail(unsigned char *hash, const uint32_t *midstate, int done,
+	const unsigned char *data, int len, int twice)
 {
 	uint32_t S[16], T[16];
 	int i, r;
 
-	sha256_init(S);
+	memcpy(S, midstate, 32);
 	for (r = len; r > -9; r -= 64) {
 		if (r < 64)
 			memset(T, 0, 64);
@@ -210,14 +229,25 @@ void sha256d(unsigned char *hash, const unsigned char *data, int len)
 		for (i = 0; i < 16; i++)
 			T[i] = be32dec(T + i);
 		if (r < 56)
-			T[15] = 8 * len;
+			T[15] = 8 * (done + len);
 		sha256_transform(S, T, 0);
 	}
-	memcpy(S + 8, sha256d_hash1 + 8, 32);
-	sha256_init(T);
-	sha256_transform(T, S, 0);
+	if (twice) {
+		memcpy(S + 8, sha256d_hash1 + 8, 32);
+		sha256_init(T);
+		sha256_transform(T, S, 0);
+		memcpy(S, T, 32);
+	}
 	for (i = 0; i < 8; i++)
-		be32enc((uint32_t *)hash + i, T[i]);
+		be32enc((uint32_t *)hash + i, S[i]);
+}
+
+void sha256d(unsigned char *hash, const unsigned char *data, int len)
+{
+	uint32_t S[8];
+
+	sha256_init(S);
+	sha256_tail(hash, S, 0, data, len, 1);
 }
 
 static inline void sha256d_preextend(uint32_t *W)
@@ -938,8 +938,9 @@ typedef long long sph_s64;
 #define SPH_ROTL32(x, n) _rotl(x, n)
 #define SPH_ROTR32(x, n) _rotr(x, n)
 #else
-#define SPH_ROTL32(x, n) ((x) << (n)) | ((x) >> (32 - (n)))
-#define SPH_ROTR32(x, n) ((x) >> (n)) | ((x) << (32 - (n)))
+/* a whole expression, sph/luffa.c xors the result (--cputest checks it) */
+#define SPH_ROTL32(x, n) (((x) << (n)) | ((x) >> (32 - (n))))
+#define SPH_ROTR32(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
 #endif
 
 #if SPH_64
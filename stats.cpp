@@ -53,6 +53,7 @@ void stats_remember_speed(int thr_id, uint32_t hashcount, double hashrate, uint8
 			data.ignored = 1;
 	}
 	tlastscans[key] = data;
+	statsfile_add_scan(&data);
 }
 
 /**
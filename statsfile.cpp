@@ -0,0 +1,356 @@
+/**
+ * Persistent stats history (optional, --stats-file)
+ *
+ * A memory mapped ring of fixed size records, shared by the scan
+ * stats and the share results, which survives miner restarts.
+ *
+ * A record is only valid if its crc matches, the crc is written last
+ * so a record torn by a crash or a power loss is simply ignored. The
+ * write position is recovered from the highest valid sequence number.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <atomic>
+#ifdef WIN32
+#include <windows.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#include "miner.h"
+
+#define STATSFILE_MAGIC   "CCSTATS1"
+#define STATSFILE_VERSION 2
+#define STATSFILE_DEFAULT_RECORDS 65536 /* 4 MB */
+#define STATSFILE_SYNC_MASK 63 /* async flush each 64 records */
+
+enum {
+	STATS_REC_FREE = 0,
+	STATS_REC_SCAN = 1,
+	STATS_REC_SHARE = 2
+};
+
+struct statsfile_hdr {
+	char magic[8];
+	uint32_t version;
+	uint32_t recsize;
+	uint32_t nrecs;
+	uint32_t reserved;
+	uint64_t next_seq; /* hint only, the records are authoritative */
+	uint8_t pad[32];
+};
+
+struct statsfile_rec {
+	uint32_t crc;
+	uint16_t type;
+	uint16_t len;
+	uint64_t seq;
+	union {
+		struct stats_data scan;
+		struct share_data share;
+		uint8_t raw[48];
+	} u;
+};
+
+extern "C" uint32_t crc32(uint32_t crc, const void *buf, size_t size);
+
+char *opt_stats_file = NULL;
+uint32_t opt_stats_records = STATSFILE_DEFAULT_RECORDS;
+
+static struct statsfile_hdr *hdr = NULL;
+static struct statsfile_rec *recs = NULL;
+static size_t map_size = 0;
+static uint64_t next_seq = 1;
+static pthread_mutex_t statsfile_lock = PTHREAD_MUTEX_INITIALIZER;
+#ifdef WIN32
+static HANDLE hfile = INVALID_HANDLE_VALUE, hmap = NULL;
+#endif
+
+static uint32_t rec_crc(const struct statsfile_rec *r)
+{
+	return crc32(0, &r->type, sizeof(*r) - sizeof(r->crc));
+}
+
+static bool rec_valid(const struct statsfile_rec *r)
+{
+	return r->type != STATS_REC_FREE && r->crc == rec_crc(r);
+}
+
+static void *map_file(const char *filename, size_t size, bool readonly)
+{
+	void *p;
+#ifdef WIN32
+	hfile = CreateFileA(filename, readonly ? GENERIC_READ : (GENERIC_READ | GENERIC_WRITE),
+		FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, readonly ? OPEN_EXISTING : OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL, NULL);
+	if(hfile == INVALID_HANDLE_VALUE)
+		return NULL;
+	hmap = CreateFileMappingA(hfile, NULL, readonly ? PAGE_READONLY : PAGE_READWRITE,
+		(DWORD)((uint64_t)size >> 32), (DWORD)size, NULL);
+	if(hmap == NULL)
+	{
+		CloseHandle(hfile);
+		return NULL;
+	}
+	p = MapViewOfFile(hmap, readonly ? FILE_MAP_READ : FILE_MAP_WRITE, 0, 0, size);
+#else
+	int fd = open(filename, readonly ? O_RDONLY : (O_RDWR | O_CREAT), 0644);
+	if(fd < 0)
+		return NULL;
+	if(!readonly && ftruncate(fd, (off_t)size) != 0)
+	{
+		close(fd);
+		return NULL;
+	}
+	p = mmap(NULL, size, readonly ? PROT_READ : (PROT_READ | PROT_WRITE), MAP_SHARED, fd, 0);
+	close(fd);
+	if(p == MAP_FAILED)
+		p = NULL;
+#endif
+	return p;
+}
+
+static void unmap_file(void)
+{
+	if(!hdr)
+		return;
+#ifdef WIN32
+	FlushViewOfFile(hdr, 0);
+	UnmapViewOfFile(hdr);
+	CloseHandle(hmap);
+	CloseHandle(hfile);
+#else
+	msync(hdr, map_size, MS_SYNC);
+	munmap(hdr, map_size);
+#endif
+	hdr = NULL;
+	recs = NULL;
+}
+
+static int64_t file_size(const char *filename)
+{
+	struct stat st;
+	if(stat(filename, &st) != 0)
+		return -1;
+	return (int64_t)st.st_size;
+}
+
+static bool check_header(const char *filename)
+{
+	if(memcmp(hdr->magic, STATSFILE_MAGIC, 8) || hdr->version != STATSFILE_VERSION ||
+		hdr->recsize != sizeof(struct statsfile_rec) || !hdr->nrecs ||
+		sizeof(*hdr) + (size_t)hdr->nrecs * sizeof(struct statsfile_rec) > map_size)
+	{
+		applog(LOG_ERR, "stats: %s is not a valid stats file", filename);
+		return false;
+	}
+	return true;
+}
+
+/* highest valid sequence, the oldest records are overwritten first */
+static uint64_t last_seq(void)
+{
+	uint64_t seq = 0;
+	for(uint32_t n = 0; n < hdr->nrecs; n++)
+	{
+		if(rec_valid(&recs[n]) && recs[n].seq > seq)
+			seq = recs[n].seq;
+	}
+	return seq;
+}
+
+/**
+ * Open (or create) the stats file given by --stats-file
+ */
+bool statsfile_open(void)
+{
+	const char *filename = opt_stats_file;
+	int64_t fsize;
+	bool created;
+
+	if(!filename || hdr)
+		return false;
+
+	fsize = file_size(filename);
+	created = (fsize < (int64_t)sizeof(struct statsfile_hdr));
+	if(created)
+		map_size = sizeof(struct statsfile_hdr) + (size_t)opt_stats_records * sizeof(struct statsfile_rec);
+	else
+		map_size = (size_t)fsize; /* keep the existing ring size */
+
+	hdr = (struct statsfile_hdr *)map_file(filename, map_size, false);
+	if(!hdr)
+	{
+		applog(LOG_ERR, "stats: unable to map %s", filename);
+		return false;
+	}
+	recs = (struct statsfile_rec *)(hdr + 1);
+
+	if(created)
+	{
+		memset(hdr, 0, sizeof(*hdr));
+		hdr->version = STATSFILE_VERSION;
+		hdr->recsize = sizeof(struct statsfile_rec);
+		hdr->nrecs = opt_stats_records;
+		memcpy(hdr->magic, STATSFILE_MAGIC, 8);
+	}
+	else if(!check_header(filename))
+	{
+		unmap_file();
+		return false;
+	}
+
+	next_seq = last_seq() + 1;
+	hdr->next_seq = next_seq;
+	if(!opt_quiet)
+		applog(LOG_INFO, "stats: %s, %u records, %llu in history", filename,
+			hdr->nrecs, (unsigned long long)min(next_seq - 1, (uint64_t)hdr->nrecs));
+	return true;
+}
+
+void statsfile_close(void)
+{
+	pthread_mutex_lock(&statsfile_lock);
+	unmap_file();
+	pthread_mutex_unlock(&statsfile_lock);
+}
+
+bool statsfile_active(void)
+{
+	return hdr != NULL;
+}
+
+static void statsfile_append(uint16_t type, const void *data, size_t len)
+{
+	pthread_mutex_lock(&statsfile_lock);
+	if(!hdr)
+	{
+		pthread_mutex_unlock(&statsfile_lock);
+		return;
+	}
+	struct statsfile_rec *r = &recs[next_seq % hdr->nrecs];
+
+	/* invalidate the slot first, a torn record must never match its crc */
+	r->crc = ~rec_crc(r);
+	r->type = STATS_REC_FREE;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+
+	memset(&r->u, 0, sizeof(r->u));
+	memcpy(&r->u, data, len);
+	r->len = (uint16_t)len;
+	r->seq = next_seq;
+	r->type = type;
+	std::atomic_thread_fence(std::memory_order_seq_cst);
+	r->crc = rec_crc(r);
+
+	hdr->next_seq = ++next_seq;
+#ifndef WIN32
+	if((next_seq & STATSFILE_SYNC_MASK) == 0)
+		msync(hdr, map_size, MS_ASYNC);
+#endif
+	pthread_mutex_unlock(&statsfile_lock);
+}
+
+void statsfile_add_scan(const struct stats_data *data)
+{
+	statsfile_append(STATS_REC_SCAN, data, sizeof(*data));
+}
+
+void statsfile_add_share(const struct share_data *data)
+{
+	statsfile_append(STATS_REC_SHARE, data, sizeof(*data));
+}
+
+/**
+ * Export the last scan records, newest first
+ * @param gpu_id int (-1 for all)
+ * @return number of records copied in data[]
+ */
+int statsfile_get_history(int gpu_id, struct stats_data *data, int max_records)
+{
+	int records = 0;
+	pthread_mutex_lock(&statsfile_lock);
+	if(!hdr)
+	{
+		pthread_mutex_unlock(&statsfile_lock);
+		return 0;
+	}
+	uint64_t seq = next_seq;
+	uint64_t oldest = (seq > hdr->nrecs) ? (seq - hdr->nrecs) : 1;
+	while(--seq >= oldest && records < max_records)
+	{
+		const struct statsfile_rec *r = &recs[seq % hdr->nrecs];
+		if(r->seq != seq || r->type != STATS_REC_SCAN || !rec_valid(r))
+			continue;
+		if(r->u.scan.ignored)
+			continue;
+		if(gpu_id == -1 || r->u.scan.gpu_id == gpu_id)
+			memcpy(&data[records++], &r->u.scan, sizeof(struct stats_data));
+	}
+	pthread_mutex_unlock(&statsfile_lock);
+	return records;
+}
+
+void statsfile_getmeminfo(uint64_t *mem, uint32_t *records)
+{
+	pthread_mutex_lock(&statsfile_lock);
+	(*records) = hdr ? (uint32_t)min(next_seq - 1, (uint64_t)hdr->nrecs) : 0;
+	(*mem) = hdr ? (uint64_t)map_size : 0;
+	pthread_mutex_unlock(&statsfile_lock);
+}
+
+/**
+ * Offline dump of a stats file (--stats-dump), oldest first
+ */
+void statsfile_dump(const char *filename)
+{
+	int64_t fsize = file_size(filename);
+	if(fsize < (int64_t)sizeof(struct statsfile_hdr))
+	{
+		applog(LOG_ERR, "stats: unable to read %s", filename);
+		return;
+	}
+	map_size = (size_t)fsize;
+	hdr = (struct statsfile_hdr *)map_file(filename, map_size, true);
+	if(!hdr)
+	{
+		applog(LOG_ERR, "stats: unable to map %s", filename);
+		return;
+	}
+	recs = (struct statsfile_rec *)(hdr + 1);
+	if(!check_header(filename))
+	{
+		hdr = NULL;
+		return;
+	}
+
+	uint64_t last = last_seq();
+	uint64_t seq = (last > hdr->nrecs) ? (last - hdr->nrecs + 1) : 1;
+	for(; seq && seq <= last; seq++)
+	{
+		const struct statsfile_rec *r = &recs[seq % hdr->nrecs];
+		if(r->seq != seq || !rec_valid(r))
+			continue;
+		if(r->type == STATS_REC_SCAN)
+		{
+			const struct stats_data *d = &r->u.scan;
+			printf("SCAN;TS=%u;GPU=%d;THR=%d;H=%u;KHS=%.2f;DIFF=%.6f;COUNT=%u;FOUND=%u;IGN=%u\n",
+				d->tm_stat, d->gpu_id, d->thr_id, d->height, d->hashrate / 1000.0,
+				d->difficulty, d->hashcount, d->hashfound, d->ignored);
+		}
+		else if(r->type == STATS_REC_SHARE)
+		{
+			const struct share_data *d = &r->u.share;
+			printf("SHARE;TS=%u;GPU=%d;THR=%d;H=%u;JOB=%x;NONCE=%08x;DIFF=%.6f;SDIFF=%.6f;"
+				"AGE=%u;QUEUE=%u;LAT=%u;ACC=%u;RES=%s\n",
+				d->tm_result, (int)(int8_t)d->gpu_id, (int)(int8_t)d->thr_id, d->height, d->njobid,
+				d->nonce, d->difficulty, d->sharediff, d->job_age_msec, d->queue_msec, d->answer_msec,
+				d->result, d->reason < SHARE_OUTCOMES ? share_outcome_names[d->reason] : "?");
+		}
+	}
+}
@@ -0,0 +1,290 @@
+/**
+ * Fast parser of the frequent stratum lines
+ *
+ * mining.notify, mining.set_difficulty and the submit answers are read
+ * in place, in one pass over the line: no jansson tree, the values are
+ * spans of the line which are checked and decoded by the caller. A line
+ * which does not fit (escaped strings, unexpected types) is left to
+ * jansson, so the fast path only has to be right on the common case.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "miner.h"
+
+static inline const char *json_ws(const char *p)
+{
+	while(*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')
+		p++;
+	return p;
+}
+
+/* p on the opening quote, span of the raw content, false if escaped */
+static const char *json_string(const char *p, struct json_span *v, bool *escaped)
+{
+	const char *s = ++p;
+	*escaped = false;
+	for(;;)
+	{
+		p += strcspn(p, "\"\\");
+		if(*p == '"')
+			break;
+		if(!*p || !p[1])
+			return NULL;
+		*escaped = true;
+		p += 2;
+	}
+	v->s = s;
+	v->len = p - s;
+	return p + 1;
+}
+
+static const char *json_value(const char *p, int depth)
+{
+	struct json_span v;
+	bool escaped;
+
+	if(depth > 32)
+		return NULL;
+	switch(*p)
+	{
+		case '"':
+			return json_string(p, &v, &escaped);
+		case '{':
+		case '[':
+		{
+			const char close = *p == '{' ? '}' : ']';
+			p = json_ws(p + 1);
+			if(*p == close)
+				return p + 1;
+			for(;;)
+			{
+				if(close == '}')
+				{
+					if(*p != '"' || !(p = json_string(p, &v, &escaped)))
+						return NULL;
+					p = json_ws(p);
+					if(*p != ':')
+						return NULL;
+					p = json_ws(p + 1);
+				}
+				if(!(p = json_value(p, depth + 1)))
+					return NULL;
+				p = json_ws(p);
+				if(*p == close)
+					return p + 1;
+				if(*p != ',')
+					return NULL;
+				p = json_ws(p + 1);
+			}
+		}
+		default:
+		{
+			// number or literal
+			const char *s = p;
+			while((*p >= '0' && *p <= '9') || (*p >= 'a' && *p <= 'z') || *p == '-' || *p == '+' || *p == '.' || *p == 'E')
+				p++;
+			return p > s ? p : NULL;
+		}
+	}
+}
+
+static inline bool json_is(const struct json_span *v, const char *lit)
+{
+	return v->s && v->len == strlen(lit) && !memcmp(v->s, lit, v->len);
+}
+
+/**
+ * Members of the top level object of a line, the string values without
+ * their quotes, the others raw. False if it is not a valid object.
+ */
+bool stratum_parse_line(const char *s, struct stratum_line *m)
+{
+	const char *p = json_ws(s);
+
+	memset(m, 0, sizeof(*m));
+	if(*p != '{')
+		return false;
+	p = json_ws(p + 1);
+	if(*p == '}')
+		return !*json_ws(p + 1);
+	for(;;)
+	{
+		struct json_span key, val;
+		bool escaped;
+
+		if(*p != '"' || !(p = json_string(p, &key, &escaped)))
+			return false;
+		p = json_ws(p);
+		if(*p != ':')
+			return false;
+		p = json_ws(p + 1);
+		const char *e = json_value(p, 0);
+		if(!e)
+			return false;
+		val.s = p;
+		val.len = e - p;
+		if(json_is(&key, "method"))
+		{
+			// a string method only, it is compared raw
+			if(*p == '"' && json_string(p, &m->method, &escaped) && escaped)
+				return false;
+		}
+		else if(json_is(&key, "params"))
+			m->params = val;
+		else if(json_is(&key, "id"))
+			m->id = val;
+		else if(json_is(&key, "result"))
+			m->result = val;
+		else if(json_is(&key, "error"))
+			m->error = val;
+		p = json_ws(e);
+		if(*p == '}')
+			return !*json_ws(p + 1);
+		if(*p != ',')
+			return false;
+		p = json_ws(p + 1);
+	}
+}
+
+bool stratum_method_is(const struct stratum_line *m, const char *method)
+{
+	return m->method.s && m->method.len == strlen(method) && !strncasecmp(m->method.s, method, m->method.len);
+}
+
+/* a raw null or missing value */
+bool json_span_null(const struct json_span *v)
+{
+	return !v->s || json_is(v, "null");
+}
+
+/* json number chars only, strto* would take more */
+static bool json_span_numeric(const struct json_span *v)
+{
+	if(!v->s || !v->len || !((*v->s >= '0' && *v->s <= '9') || *v->s == '-'))
+		return false;
+	for(size_t i = 0; i < v->len; i++)
+	{
+		if(!strchr("0123456789+-.eE", v->s[i]))
+			return false;
+	}
+	return true;
+}
+
+bool json_span_int(const struct json_span *v, int64_t *n)
+{
+	char *ep;
+
+	if(!json_span_numeric(v))
+		return false;
+	*n = strtoll(v->s, &ep, 10);
+	return ep == v->s + v->len;
+}
+
+bool json_span_number(const struct json_span *v, double *d)
+{
+	char *ep;
+
+	if(!json_span_numeric(v))
+		return false;
+	*d = strtod(v->s, &ep);
+	return ep == v->s + v->len;
+}
+
+/**
+ * Decode the first 'len' bytes of a hex span, like hex2bin: true only if
+ * the span is exactly 2*len valid hex digits
+ */
+bool json_span_hex(uchar *p, const struct json_span *v, size_t len)
+{
+	size_t n = min(len, v->len / 2);
+
+	return hex_decode(p, v->s, n) == len && v->len == 2 * len;
+}
+
+/* next element of an array, p after the '[' or the previous value */
+static const char *json_next(const char *p, const char *end, bool first)
+{
+	p = json_ws(p);
+	if(!first)
+	{
+		if(p >= end || *p != ',')
+			return NULL;
+		p = json_ws(p + 1);
+	}
+	return p < end && *p != ']' ? p : NULL;
+}
+
+/* a string element with no escape */
+static const char *json_next_string(const char *p, const char *end, bool first, struct json_span *v)
+{
+	bool escaped;
+
+	if(!(p = json_next(p, end, first)) || *p != '"' || !(p = json_string(p, v, &escaped)) || escaped)
+		return NULL;
+	return p;
+}
+
+/**
+ * The params of mining.notify: [job_id, prevhash, coinb1, coinb2,
+ * [merkle...], version, nbits, ntime, clean, nreward (optional)]
+ */
+bool stratum_parse_notify(const struct json_span *params, struct stratum_notify_msg *n)
+{
+	const char *p = params->s, *end = params->s + params->len;
+	struct json_span *str[4] = { &n->job_id, &n->prevhash, &n->coinb1, &n->coinb2 };
+	struct json_span *str2[3] = { &n->version, &n->nbits, &n->ntime };
+
+	memset(n, 0, sizeof(*n));
+	if(!p || *p != '[')
+		return false;
+	p++;
+	for(int i = 0; i < 4; i++)
+	{
+		if(!(p = json_next_string(p, end, !i, str[i])))
+			return false;
+	}
+
+	if(!(p = json_next(p, end, false)) || *p != '[')
+		return false;
+	p = json_ws(p + 1);
+	if(*p == ']')
+		p++;
+	else
+	{
+		for(int i = 0; ; i++)
+		{
+			if(i == STRATUM_MAX_MERKLE || !(p = json_next_string(p, end, !i, &n->merkle[i])))
+				return false;
+			n->merkle_count++;
+			p = json_ws(p);
+			if(*p == ']')
+			{
+				p++;
+				break;
+			}
+		}
+	}
+
+	for(int i = 0; i < 3; i++)
+	{
+		if(!(p = json_next_string(p, end, false, str2[i])))
+			return false;
+	}
+	if(!(p = json_next(p, end, false)))
+		return false;
+	const char *e = json_value(p, 0);
+	if(!e)
+		return false;
+	n->clean = (e - p == 4 && !memcmp(p, "true", 4));
+	p = json_ws(e);
+	if(*p == ',')
+	{
+		if(!(p = json_next_string(p, end, false, &n->nreward)))
+			return false;
+		p = json_ws(p);
+	}
+	// more params are possible but unused, keep them to jansson
+	return *p == ']' && p + 1 == end;
+}
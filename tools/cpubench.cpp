@@ -0,0 +1,332 @@
+/**
+ * Benchmark of the cpu batch kernels (make cpubench)
+ *
+ * Times each 64-byte stage kernel selected by cpu_batch_init() against
+ * the sph one, then the chains with the sph and the new version of one
+ * stage: luffa_cubehash512 and simd512 in x11, hamsi512 in x13,
+ * whirlpool in x15, x17 and whirlcoin, groestl512 in groestlcoin and
+ * sha256 in myriad-groestl. In a chain the other stages evict the tables
+ * of sph from L1 (16 KB for Whirlpool, 128 KB for the Hamsi expansion)
+ * and the lanes are reloaded by each stage, so the time of the stage is
+ * given per hash in the chain and alone, with one lane per call (as
+ * x13hash or x15hash) and with a full batch. The selected kernels are
+ * checked against sph first.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <getopt.h>
+
+#include "miner.h"
+#include "cpu_batch.h"
+
+static double opt_seconds = 0.3;
+static uint32_t opt_batch = 256;
+
+static const char usage[] = "\
+Usage: cpubench [OPTIONS]\n\
+Options:\n\
+  -b, --batch=N         lanes per call of the batched measures (default: 256)\n\
+  -t, --time=S          seconds per measure (default: 0.3)\n\
+  -h, --help            display this help text and exit\n";
+
+static struct option const options[] = {
+	{ "batch", 1, NULL, 'b' },
+	{ "help", 0, NULL, 'h' },
+	{ "time", 1, NULL, 't' },
+	{ 0, 0, 0, 0 }
+};
+
+/* sph/blake.c reads the round count of blake256.cu */
+extern "C" { int blake256_rounds = 14; }
+
+/* the few helpers of util.cpp used by cpu_batch.cpp */
+
+void applog(int prio, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vfprintf(stderr, fmt, ap);
+	fputc('\n', stderr);
+	va_end(ap);
+}
+
+void *aligned_calloc(int size)
+{
+	void *p = NULL;
+	if(posix_memalign(&p, 64, size))
+		return NULL;
+	memset(p, 0, size);
+	return p;
+}
+
+void aligned_free(void *ptr)
+{
+	free(ptr);
+}
+
+bool fulltest(const uint32_t *hash, const uint32_t *target)
+{
+	for(int i = 7; i >= 0; i--)
+	{
+		if(hash[i] != target[i])
+			return hash[i] < target[i];
+	}
+	return true;
+}
+
+#define KERNEL(n) { #n, offsetof(struct cpu_hash_kernels, n) }
+
+static const struct {
+	const char *name;
+	size_t off;
+} kernels[] = {
+	KERNEL(blake512), KERNEL(bmw512), KERNEL(groestl512), KERNEL(skein512),
+	KERNEL(jh512), KERNEL(keccak512), KERNEL(luffa512), KERNEL(cubehash512),
+	KERNEL(luffa_cubehash512), KERNEL(shavite512), KERNEL(simd512), KERNEL(echo512),
+	KERNEL(hamsi512), KERNEL(fugue512), KERNEL(shabal512), KERNEL(whirlpool),
+	KERNEL(whirlpool1), KERNEL(sha512), KERNEL(haval256_5), KERNEL(sha256)
+};
+#define NKERNELS (sizeof(kernels) / sizeof(kernels[0]))
+
+#define MAX_STAGES 20
+
+static const struct {
+	const char *name;
+	const char *stage;   /* compared with its sph version */
+	size_t first;        /* cpu_hash80_fn */
+	const char *stages[MAX_STAGES];
+} chains[] = {
+	{ "x11", "luffa_cubehash512", offsetof(struct cpu_hash_kernels, blake512_80), {
+		"bmw512", "groestl512", "skein512", "jh512", "keccak512", "luffa_cubehash512",
+		"shavite512", "simd512", "echo512", NULL } },
+	{ "x11", "simd512", offsetof(struct cpu_hash_kernels, blake512_80), {
+		"bmw512", "groestl512", "skein512", "jh512", "keccak512", "luffa_cubehash512",
+		"shavite512", "simd512", "echo512", NULL } },
+	{ "x13", "hamsi512", offsetof(struct cpu_hash_kernels, blake512_80), {
+		"bmw512", "groestl512", "skein512", "jh512", "keccak512", "luffa_cubehash512",
+		"shavite512", "simd512", "echo512", "hamsi512", "fugue512", NULL } },
+	{ "x15", "whirlpool", offsetof(struct cpu_hash_kernels, blake512_80), {
+		"bmw512", "groestl512", "skein512", "jh512", "keccak512", "luffa_cubehash512",
+		"shavite512", "simd512", "echo512", "hamsi512", "fugue512", "shabal512", "whirlpool", NULL } },
+	{ "x17", "whirlpool", offsetof(struct cpu_hash_kernels, blake512_80), {
+		"bmw512", "groestl512", "skein512", "jh512", "keccak512", "luffa_cubehash512",
+		"shavite512", "simd512", "echo512", "hamsi512", "fugue512", "shabal512", "whirlpool",
+		"sha512", "haval256_5", NULL } },
+	{ "whirl", "whirlpool1", offsetof(struct cpu_hash_kernels, whirlpool1_80), {
+		"whirlpool1", "whirlpool1", "whirlpool1", NULL } },
+	{ "groestl", "groestl512", offsetof(struct cpu_hash_kernels, groestl512_80), {
+		"groestl512", NULL } },
+	{ "myr-gr", "sha256", offsetof(struct cpu_hash_kernels, groestl512_80), {
+		"sha256", NULL } }
+};
+
+static struct cpu_hash_kernels k_sph, k_new;
+
+static cpu_hash64_fn kernel64(const struct cpu_hash_kernels *k, size_t off)
+{
+	return *(const cpu_hash64_fn *)((const char *)k + off);
+}
+
+static cpu_hash80_fn kernel80(const struct cpu_hash_kernels *k, size_t off)
+{
+	return *(const cpu_hash80_fn *)((const char *)k + off);
+}
+
+static size_t kernel_off(const char *name)
+{
+	for(size_t i = 0; i < NKERNELS; i++)
+	{
+		if(!strcmp(kernels[i].name, name))
+			return kernels[i].off;
+	}
+	fprintf(stderr, "cpubench: unknown kernel %s\n", name);
+	exit(1);
+}
+
+static double now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+static void fill(uint64_t *hash, uint32_t count)
+{
+	for(uint32_t i = 0; i < count * 8; i++)
+		hash[i] = 0x9e3779b97f4a7c15ULL * (i + 1);
+}
+
+/* ns per hash of a kernel alone, 'batch' lanes per call */
+static double bench_kernel(cpu_hash64_fn fn, uint64_t *hash, uint32_t batch)
+{
+	uint64_t n = 0;
+	double start = now(), t;
+
+	fill(hash, batch);
+	do
+	{
+		for(int k = 0; k < 16; k++, n += batch)
+			fn(hash, batch);
+	} while((t = now() - start) < opt_seconds);
+	return t * 1e9 / n;
+}
+
+/**
+ * Full chain, 'batch' lanes per call
+ * @return ns per hash of the chain, *stage_ns the part of the compared stage
+ */
+static double bench_chain(int c, const struct cpu_hash_kernels *k, uint64_t *hash, uint32_t batch, double *stage_ns)
+{
+	const size_t stage = kernel_off(chains[c].stage);
+	cpu_hash64_fn fn[MAX_STAGES];
+	bool timed[MAX_STAGES];
+	uint32_t endiandata[20], nonce[1024];
+	uint64_t n = 0;
+	double stage_t = 0., start = now(), t;
+	int nstages = 0;
+
+	for(int i = 0; i < 20; i++)
+		endiandata[i] = 0x01010101U * (uint32_t)i;
+	for(; chains[c].stages[nstages]; nstages++)
+	{
+		size_t off = kernel_off(chains[c].stages[nstages]);
+		fn[nstages] = kernel64(k, off);
+		timed[nstages] = (off == stage);
+	}
+	cpu_hash80_fn first = kernel80(k, chains[c].first);
+	do
+	{
+		for(uint32_t i = 0; i < batch; i++)
+			nonce[i] = (uint32_t)n + i;
+		first(hash, endiandata, nonce, batch);
+		double t1 = now();
+		for(int s = 0; s < nstages; s++)
+		{
+			fn[s](hash, batch);
+			if(timed[s])
+			{
+				double t2 = now();
+				stage_t += t2 - t1;
+				t1 = t2;
+			}
+			else
+				t1 = now();
+		}
+		n += batch;
+	} while((t = now() - start) < opt_seconds);
+	*stage_ns = stage_t * 1e9 / n;
+	return t * 1e9 / n;
+}
+
+static bool check(uint64_t *hash, uint64_t *ref)
+{
+	bool ok = true;
+	for(size_t i = 0; i < NKERNELS; i++)
+	{
+		cpu_hash64_fn fn = kernel64(&k_new, kernels[i].off), fref = kernel64(&k_sph, kernels[i].off);
+		if(fn == fref)
+			continue;
+		for(uint32_t count = 1; count <= 19; count += 6)
+		{
+			fill(hash, count);
+			fill(ref, count);
+			fn(hash, count);
+			fref(ref, count);
+			if(memcmp(hash, ref, count * 64))
+			{
+				fprintf(stderr, "cpubench: %s differs from sph with %u lanes\n", kernels[i].name, count);
+				ok = false;
+			}
+		}
+	}
+	return ok;
+}
+
+int main(int argc, char *argv[])
+{
+	int key;
+
+	while((key = getopt_long(argc, argv, "b:ht:", options, NULL)) != -1)
+	{
+		switch(key)
+		{
+		case 'b':
+			opt_batch = (uint32_t)atoi(optarg);
+			if(opt_batch < 1 || opt_batch > 1024)
+			{
+				fprintf(stderr, "cpubench: the batch is 1 to 1024 lanes\n");
+				return 1;
+			}
+			break;
+		case 't': opt_seconds = atof(optarg); break;
+		default:
+			printf("%s", usage);
+			exit(key == 'h' ? 0 : 1);
+		}
+	}
+
+	memcpy(&k_sph, &cpu_hash, sizeof(k_sph));
+	cpu_batch_init();
+	memcpy(&k_new, &cpu_hash, sizeof(k_new));
+	printf("kernels: %s\n", cpu_batch_level());
+
+	uint64_t *hash = (uint64_t *)aligned_calloc(1024 * 64);
+	uint64_t *ref = (uint64_t *)aligned_calloc(1024 * 64);
+	if(!hash || !ref)
+		return 1;
+	if(!check(hash, ref))
+		return 1;
+
+	printf("stage kernels, ns per hash with %u lanes per call\n", opt_batch);
+	for(size_t i = 0; i < NKERNELS; i++)
+	{
+		cpu_hash64_fn fn = kernel64(&k_new, kernels[i].off), fref = kernel64(&k_sph, kernels[i].off);
+		double t_sph = bench_kernel(fref, hash, opt_batch);
+		if(fn == fref)
+		{
+			printf("%17s %9.1f (sph)\n", kernels[i].name, t_sph);
+			continue;
+		}
+		double t_new = bench_kernel(fn, hash, opt_batch);
+		printf("%17s %9.1f -> %9.1f (x%4.1f)\n", kernels[i].name, t_sph, t_new, t_sph / t_new);
+	}
+
+	for(size_t c = 0; c < sizeof(chains) / sizeof(chains[0]); c++)
+	{
+		const uint32_t batches[2] = { 1, opt_batch };
+		const size_t stage = kernel_off(chains[c].stage);
+		// the selected kernels with the sph version of the stage, then the new one
+		struct cpu_hash_kernels k_mix;
+		memcpy(&k_mix, &k_new, sizeof(k_mix));
+		*(cpu_hash64_fn *)((char *)&k_mix + stage) = kernel64(&k_sph, stage);
+		if(kernel64(&k_new, stage) == kernel64(&k_sph, stage))
+			continue;
+
+		for(int b = 0; b < 2; b++)
+		{
+			printf("\n%s, %u lane%s per call, ns per hash\n", chains[c].name, batches[b], batches[b] > 1 ? "s" : "");
+			for(int v = 0; v < 2; v++)
+			{
+				const struct cpu_hash_kernels *k = v ? &k_new : &k_mix;
+				double stage_ns, alone = 0.;
+				double total = bench_chain((int)c, k, hash, batches[b], &stage_ns);
+				// same stages with the tables kept in cache
+				for(int s = 0; chains[c].stages[s]; s++)
+				{
+					if(kernel_off(chains[c].stages[s]) == stage)
+						alone += bench_kernel(kernel64(k, stage), hash, batches[b]);
+				}
+				printf("  %s %-10s: chain %9.1f, stage %8.1f in the chain, %8.1f alone\n",
+					v ? "new" : "sph", chains[c].stage, total, stage_ns, alone);
+			}
+		}
+	}
+	aligned_free(hash);
+	aligned_free(ref);
+	return 0;
+}
@@ -0,0 +1,174 @@
+/**
+ * Benchmark of the hex codec (make hexbench)
+ *
+ * Times hex_encode and hex_decode of hexcodec.cpp against the former
+ * sprintf/strtol code of util.cpp, on the sizes of the miner: a nonce,
+ * a merkle branch, a getwork header and a large coinbase. The results
+ * are checked against the former code first, also with bad digits.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <ctype.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <vector>
+
+#include "miner.h"
+
+static double opt_seconds = 0.5;
+
+static const char usage[] = "\
+Usage: hexbench [OPTIONS]\n\
+Options:\n\
+  -t, --time=S          seconds per measure (default: 0.5)\n\
+  -h, --help            display this help text and exit\n";
+
+static struct option const options[] = {
+	{ "help", 0, NULL, 'h' },
+	{ "time", 1, NULL, 't' },
+	{ 0, 0, 0, 0 }
+};
+
+/* cbin2hex of util.cpp */
+static void encode_ref(char *out, const uchar *in, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+		sprintf(out + (i * 2), "%02x", in[i]);
+}
+
+/* hex2bin of util.cpp without the log, the bytes decoded */
+static size_t decode_ref(uchar *p, const char *hexstr, size_t len)
+{
+	char hex_byte[3];
+	char *ep;
+	size_t n = 0;
+
+	hex_byte[2] = '\0';
+	while(*hexstr && len)
+	{
+		if(!hexstr[1])
+			break;
+		hex_byte[0] = hexstr[0];
+		hex_byte[1] = hexstr[1];
+		p[n] = (uchar)strtol(hex_byte, &ep, 16);
+		if(*ep)
+			break;
+		n++;
+		hexstr += 2;
+		len--;
+	}
+	return n;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static bool check(size_t len)
+{
+	std::vector<uchar> bin(len), a(len + 1), b(len + 1);
+	std::vector<char> hex(2 * len + 1), ref(2 * len + 1);
+
+	for(size_t i = 0; i < len; i++)
+		bin[i] = (uchar)rand();
+	hex_encode(hex.data(), bin.data(), len);
+	encode_ref(ref.data(), bin.data(), len);
+	if(len && memcmp(hex.data(), ref.data(), 2 * len + 1))
+		return false;
+	// upper case is valid too
+	for(size_t i = 0; i < 2 * len; i += 3)
+		hex[i] = (char)toupper(hex[i]);
+	if(hex_decode(a.data(), hex.data(), len) != len || memcmp(a.data(), bin.data(), len))
+		return false;
+	// a bad digit anywhere stops both at the same byte
+	for(int k = 0; k < 8 && len; k++)
+	{
+		const char bad[] = "g/:@G`\x80 ";
+		std::vector<char> h2(hex);
+		size_t pos = rand() % (2 * len);
+		h2[pos] = bad[k];
+		size_t na = hex_decode(a.data(), h2.data(), len), nb = decode_ref(b.data(), h2.data(), len);
+		// strtol takes a leading space, the codec does not
+		if(bad[k] == ' ' && pos % 2 == 0)
+			nb = pos / 2;
+		if(na != nb || na != pos / 2 || memcmp(a.data(), b.data(), na))
+			return false;
+	}
+	return true;
+}
+
+static void bench(size_t len)
+{
+	std::vector<uchar> bin(len), out(len);
+	std::vector<char> hex(2 * len + 1);
+	double t_enc[2], t_dec[2];
+	volatile size_t sink = 0;
+
+	for(size_t i = 0; i < len; i++)
+		bin[i] = (uchar)rand();
+	for(int impl = 0; impl < 2; impl++)
+	{
+		uint64_t n = 0;
+		double start = now(), t;
+		do
+		{
+			for(int k = 0; k < 64; k++, n++)
+			{
+				if(impl)
+					hex_encode(hex.data(), bin.data(), len);
+				else
+					encode_ref(hex.data(), bin.data(), len);
+			}
+		} while((t = now() - start) < opt_seconds);
+		t_enc[impl] = t / n;
+
+		n = 0;
+		start = now();
+		do
+		{
+			for(int k = 0; k < 64; k++, n++)
+				sink += impl ? hex_decode(out.data(), hex.data(), len) : decode_ref(out.data(), hex.data(), len);
+		} while((t = now() - start) < opt_seconds);
+		t_dec[impl] = t / n;
+	}
+	printf("%6u bytes  encode %10.1f -> %8.1f ns (x%5.1f)  decode %10.1f -> %8.1f ns (x%5.1f)\n", (unsigned)len,
+		t_enc[0] * 1e9, t_enc[1] * 1e9, t_enc[0] / t_enc[1], t_dec[0] * 1e9, t_dec[1] * 1e9, t_dec[0] / t_dec[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t sizes[] = { 4, 32, 128, 16384 };
+	int key;
+
+	while((key = getopt_long(argc, argv, "ht:", options, NULL)) != -1)
+	{
+		switch(key)
+		{
+		case 't': opt_seconds = atof(optarg); break;
+		default:
+			printf("%s", usage);
+			exit(key == 'h' ? 0 : 1);
+		}
+	}
+
+	srand((unsigned)time(NULL));
+	for(size_t len = 0; len < 300; len++)
+	{
+		if(!check(len))
+		{
+			fprintf(stderr, "hexbench: wrong result at %u bytes\n", (unsigned)len);
+			return 1;
+		}
+	}
+	printf("former code -> hexcodec.cpp, per call\n");
+	for(size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++)
+		bench(sizes[i]);
+	return 0;
+}
@@ -0,0 +1,224 @@
+/**
+ * Benchmark of the mining.notify parsing (make notifybench)
+ *
+ * Builds a notify line with a large coinbase and a long merkle branch,
+ * then decodes it many times with jansson (tree, string lookups and the
+ * per byte hex2bin of util.cpp) and with the fast parser of
+ * stratum_parse.cpp, checks both give the same bytes and prints the
+ * time per line of each.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <getopt.h>
+#include <sys/time.h>
+
+#include <string>
+#include <vector>
+
+#include "miner.h"
+
+static int opt_coinbase = 16384;
+static int opt_merkle = 16;
+static int opt_count = 2000;
+
+static const char usage[] = "\
+Usage: notifybench [OPTIONS]\n\
+Options:\n\
+  -c, --coinbase=N      coinb2 size in bytes (default: 16384)\n\
+  -m, --merkle=N        merkle branch length (default: 16)\n\
+  -n, --count=N         lines to parse with each parser (default: 2000)\n\
+  -h, --help            display this help text and exit\n";
+
+static struct option const options[] = {
+	{ "coinbase", 1, NULL, 'c' },
+	{ "count", 1, NULL, 'n' },
+	{ "help", 0, NULL, 'h' },
+	{ "merkle", 1, NULL, 'm' },
+	{ 0, 0, 0, 0 }
+};
+
+/* the decoded job, to compare both parsers */
+struct bench_job {
+	std::string job_id;
+	uchar prevhash[32];
+	std::vector<uchar> coinb1, coinb2;
+	std::vector<uchar> merkle;
+	uchar version[4], nbits[4], ntime[4];
+	bool clean;
+};
+
+/* hex2bin of util.cpp */
+static bool hex2bin_ref(uchar *p, const char *hexstr, size_t len)
+{
+	char hex_byte[3];
+	char *ep;
+
+	hex_byte[2] = '\0';
+	while(*hexstr && len)
+	{
+		if(!hexstr[1])
+			return false;
+		hex_byte[0] = hexstr[0];
+		hex_byte[1] = hexstr[1];
+		*p = (uchar)strtol(hex_byte, &ep, 16);
+		if(*ep)
+			return false;
+		p++;
+		hexstr += 2;
+		len--;
+	}
+	return (len == 0 && *hexstr == 0) ? true : false;
+}
+
+static std::string random_hex(size_t bytes)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string s(bytes * 2, '0');
+	for(size_t i = 0; i < s.size(); i++)
+		s[i] = digits[rand() & 15];
+	return s;
+}
+
+static std::string notify_line(void)
+{
+	std::string s = "{\"id\":null,\"method\":\"mining.notify\",\"params\":[\"1f2e3d\",\"" + random_hex(32) +
+		"\",\"" + random_hex(42) + "\",\"" + random_hex(opt_coinbase) + "\",[";
+	for(int i = 0; i < opt_merkle; i++)
+		s += (i ? ",\"" : "\"") + random_hex(32) + "\"";
+	return s + "],\"20000000\",\"1b00ffff\",\"5a1b2c3d\",true]}";
+}
+
+static bool parse_jansson(const char *line, struct bench_job *job)
+{
+	json_error_t err;
+	json_t *val = JSON_LOADS(line, &err);
+	bool ret = false;
+	if(!val)
+		return false;
+	json_t *params = json_object_get(val, "params");
+	const char *method = json_string_value(json_object_get(val, "method"));
+	const char *job_id = json_string_value(json_array_get(params, 0));
+	const char *prevhash = json_string_value(json_array_get(params, 1));
+	const char *coinb1 = json_string_value(json_array_get(params, 2));
+	const char *coinb2 = json_string_value(json_array_get(params, 3));
+	json_t *merkle_arr = json_array_get(params, 4);
+	const char *version = json_string_value(json_array_get(params, 5));
+	const char *nbits = json_string_value(json_array_get(params, 6));
+	const char *ntime = json_string_value(json_array_get(params, 7));
+	if(method && !strcasecmp(method, "mining.notify") && job_id && prevhash && coinb1 && coinb2 &&
+		json_is_array(merkle_arr) && version && nbits && ntime &&
+		strlen(prevhash) == 64 && strlen(version) == 8 && strlen(nbits) == 8 && strlen(ntime) == 8)
+	{
+		size_t count = json_array_size(merkle_arr);
+		job->job_id = job_id;
+		job->coinb1.resize(strlen(coinb1) / 2);
+		job->coinb2.resize(strlen(coinb2) / 2);
+		job->merkle.resize(32 * count);
+		ret = hex2bin_ref(job->prevhash, prevhash, 32) &&
+			hex2bin_ref(job->coinb1.data(), coinb1, job->coinb1.size()) &&
+			hex2bin_ref(job->coinb2.data(), coinb2, job->coinb2.size());
+		for(size_t i = 0; i < count && ret; i++)
+		{
+			const char *s = json_string_value(json_array_get(merkle_arr, i));
+			ret = s && strlen(s) == 64 && hex2bin_ref(&job->merkle[32 * i], s, 32);
+		}
+		ret = ret && hex2bin_ref(job->version, version, 4) && hex2bin_ref(job->nbits, nbits, 4) &&
+			hex2bin_ref(job->ntime, ntime, 4);
+		job->clean = json_is_true(json_array_get(params, 8));
+	}
+	json_decref(val);
+	return ret;
+}
+
+static bool parse_fast(const char *line, struct bench_job *job)
+{
+	struct stratum_line m;
+	struct stratum_notify_msg n;
+
+	if(!stratum_parse_line(line, &m) || !stratum_method_is(&m, "mining.notify") || !stratum_parse_notify(&m.params, &n))
+		return false;
+	if(n.prevhash.len != 64 || n.version.len != 8 || n.nbits.len != 8 || n.ntime.len != 8)
+		return false;
+	job->job_id.assign(n.job_id.s, n.job_id.len);
+	job->coinb1.resize(n.coinb1.len / 2);
+	job->coinb2.resize(n.coinb2.len / 2);
+	job->merkle.resize(32 * n.merkle_count);
+	bool ret = json_span_hex(job->prevhash, &n.prevhash, 32) &&
+		json_span_hex(job->coinb1.data(), &n.coinb1, job->coinb1.size()) &&
+		json_span_hex(job->coinb2.data(), &n.coinb2, job->coinb2.size());
+	for(int i = 0; i < n.merkle_count && ret; i++)
+		ret = n.merkle[i].len == 64 && json_span_hex(&job->merkle[32 * i], &n.merkle[i], 32);
+	job->clean = n.clean;
+	return ret && json_span_hex(job->version, &n.version, 4) && json_span_hex(job->nbits, &n.nbits, 4) &&
+		json_span_hex(job->ntime, &n.ntime, 4);
+}
+
+static bool same_job(const struct bench_job *a, const struct bench_job *b)
+{
+	return a->job_id == b->job_id && !memcmp(a->prevhash, b->prevhash, 32) && a->coinb1 == b->coinb1 &&
+		a->coinb2 == b->coinb2 && a->merkle == b->merkle && !memcmp(a->version, b->version, 4) &&
+		!memcmp(a->nbits, b->nbits, 4) && !memcmp(a->ntime, b->ntime, 4) && a->clean == b->clean;
+}
+
+static double now(void)
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec * 1e-6;
+}
+
+static double bench(bool (*parse)(const char *, struct bench_job *), const std::string &line)
+{
+	struct bench_job job;
+	double start = now();
+	for(int i = 0; i < opt_count; i++)
+	{
+		if(!parse(line.c_str(), &job))
+		{
+			fprintf(stderr, "notifybench: parse failed\n");
+			exit(1);
+		}
+	}
+	return (now() - start) / opt_count;
+}
+
+int main(int argc, char *argv[])
+{
+	int key;
+	while((key = getopt_long(argc, argv, "c:hm:n:", options, NULL)) != -1)
+	{
+		switch(key)
+		{
+		case 'c': opt_coinbase = atoi(optarg); break;
+		case 'm': opt_merkle = atoi(optarg); break;
+		case 'n': opt_count = atoi(optarg); break;
+		default:
+			printf("%s", usage);
+			exit(key == 'h' ? 0 : 1);
+		}
+	}
+	if(opt_coinbase < 0 || opt_merkle < 0 || opt_merkle > STRATUM_MAX_MERKLE || opt_count <= 0)
+	{
+		fprintf(stderr, "%s", usage);
+		return 1;
+	}
+
+	srand((unsigned)time(NULL));
+	std::string line = notify_line();
+	struct bench_job a, b;
+	if(!parse_jansson(line.c_str(), &a) || !parse_fast(line.c_str(), &b) || !same_job(&a, &b))
+	{
+		fprintf(stderr, "notifybench: the parsers disagree\n");
+		return 1;
+	}
+
+	double tj = bench(parse_jansson, line);
+	double tf = bench(parse_fast, line);
+	printf("notify line of %u bytes, %d merkle branches, %d runs\n", (unsigned)line.size(), opt_merkle, opt_count);
+	printf("jansson: %9.2f us/line %8.1f MB/s\n", tj * 1e6, line.size() / tj / 1e6);
+	printf("fast:    %9.2f us/line %8.1f MB/s (x%.1f)\n", tf * 1e6, line.size() / tf / 1e6, tj / tf);
+	return 0;
+}
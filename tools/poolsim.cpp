@@ -0,0 +1,865 @@
+/**
+ * Stratum pool simulator (make poolsim)
+ *
+ * A local stratum server to test the network path of the miner without
+ * a live pool. It sends jobs at a fixed rate, with a share of clean jobs
+ * (new blocks) and long merkle branches, and can change the difficulty
+ * (vardiff), the extranonce, or drop and redirect its clients.
+ *
+ * The submitted shares are rebuilt from the job like the miner does
+ * (coinbase, merkle root, header) and hashed on the cpu, so the pool
+ * answers are real: accepted, stale, duplicate or low difficulty. The
+ * job age of the shares and the delay of the stale ones after a clean
+ * job (the job switch latency of the miner) are printed periodically.
+ *
+ * Linux only, single thread, poll() based.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#include <algorithm>
+#include <deque>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <openssl/sha.h>
+#include <jansson.h>
+
+extern "C"
+{
+#include "sph/sph_blake.h"
+#include "sph/sph_bmw.h"
+#include "sph/sph_groestl.h"
+#include "sph/sph_skein.h"
+#include "sph/sph_jh.h"
+#include "sph/sph_keccak.h"
+#include "sph/sph_luffa.h"
+#include "sph/sph_cubehash.h"
+#include "sph/sph_shavite.h"
+#include "sph/sph_simd.h"
+#include "sph/sph_echo.h"
+#include "sph/sph_hamsi.h"
+#include "sph/sph_fugue.h"
+#include "sph/sph_shabal.h"
+#include "sph/sph_whirlpool.h"
+}
+
+#define SIM_JOBS 16            /* jobs kept for the shares */
+#define SIM_XNONCE1_SIZE 4
+#define SIM_VARDIFF_SHARES 4   /* shares per vardiff window */
+#define SIM_MAX_LINE 16384
+
+/* defined by the blake256 kernel in the miner, used by sph_blake */
+extern "C" { int blake256_rounds = 14; }
+
+/* 512-bit hash chains, same order as the miner cpu hashes */
+
+struct sim_hash512 {
+	void (*init)(void *cc);
+	void (*update)(void *cc, const void *data, size_t len);
+	void (*close)(void *cc, void *dst);
+};
+
+#define SIM_HASH512(name) \
+	{ sph_##name##_init, sph_##name, sph_##name##_close }
+
+enum {
+	H_BLAKE, H_BMW, H_GROESTL, H_SKEIN, H_JH, H_KECCAK, H_LUFFA, H_CUBEHASH,
+	H_SHAVITE, H_SIMD, H_ECHO, H_HAMSI, H_FUGUE, H_SHABAL, H_WHIRLPOOL, H_END = -1
+};
+
+static const struct sim_hash512 sim_hashes[] = {
+	SIM_HASH512(blake512),
+	SIM_HASH512(bmw512),
+	SIM_HASH512(groestl512),
+	SIM_HASH512(skein512),
+	SIM_HASH512(jh512),
+	SIM_HASH512(keccak512),
+	SIM_HASH512(luffa512),
+	SIM_HASH512(cubehash512),
+	SIM_HASH512(shavite512),
+	SIM_HASH512(simd512),
+	SIM_HASH512(echo512),
+	SIM_HASH512(hamsi512),
+	SIM_HASH512(fugue512),
+	SIM_HASH512(shabal512),
+	SIM_HASH512(whirlpool)
+};
+
+static void hash512(int h, uint8_t *hash, const void *data, size_t len)
+{
+	uint64_t ctx[1024]; /* larger than any sph context */
+	sim_hashes[h].init(ctx);
+	sim_hashes[h].update(ctx, data, len);
+	sim_hashes[h].close(ctx, hash);
+}
+
+static void chain_hash(const int *chain, uint8_t *out, const uint8_t *header)
+{
+	uint8_t hash[64];
+	hash512(chain[0], hash, header, 80);
+	for(int i = 1; chain[i] != H_END; i++)
+		hash512(chain[i], hash, hash, 64);
+	memcpy(out, hash, 32);
+}
+
+static const int chain_x11[] = { H_BLAKE, H_BMW, H_GROESTL, H_SKEIN, H_JH, H_KECCAK,
+	H_LUFFA, H_CUBEHASH, H_SHAVITE, H_SIMD, H_ECHO, H_END };
+static const int chain_x13[] = { H_BLAKE, H_BMW, H_GROESTL, H_SKEIN, H_JH, H_KECCAK,
+	H_LUFFA, H_CUBEHASH, H_SHAVITE, H_SIMD, H_ECHO, H_HAMSI, H_FUGUE, H_END };
+static const int chain_x14[] = { H_BLAKE, H_BMW, H_GROESTL, H_SKEIN, H_JH, H_KECCAK,
+	H_LUFFA, H_CUBEHASH, H_SHAVITE, H_SIMD, H_ECHO, H_HAMSI, H_FUGUE, H_SHABAL, H_END };
+static const int chain_x15[] = { H_BLAKE, H_BMW, H_GROESTL, H_SKEIN, H_JH, H_KECCAK,
+	H_LUFFA, H_CUBEHASH, H_SHAVITE, H_SIMD, H_ECHO, H_HAMSI, H_FUGUE, H_SHABAL, H_WHIRLPOOL, H_END };
+static const int chain_nist5[] = { H_BLAKE, H_GROESTL, H_JH, H_KECCAK, H_SKEIN, H_END };
+static const int chain_qubit[] = { H_LUFFA, H_CUBEHASH, H_SHAVITE, H_SIMD, H_ECHO, H_END };
+
+static void quark_hash(uint8_t *out, const uint8_t *header)
+{
+	uint8_t hash[64];
+	hash512(H_BLAKE, hash, header, 80);
+	hash512(H_BMW, hash, hash, 64);
+	hash512((hash[0] & 8) ? H_GROESTL : H_SKEIN, hash, hash, 64);
+	hash512(H_GROESTL, hash, hash, 64);
+	hash512(H_JH, hash, hash, 64);
+	hash512((hash[0] & 8) ? H_BLAKE : H_BMW, hash, hash, 64);
+	hash512(H_KECCAK, hash, hash, 64);
+	hash512(H_SKEIN, hash, hash, 64);
+	hash512((hash[0] & 8) ? H_KECCAK : H_JH, hash, hash, 64);
+	memcpy(out, hash, 32);
+}
+
+struct sim_algo {
+	const char *name;
+	const int *chain;
+	void (*hash)(uint8_t *out, const uint8_t *header);
+};
+
+static const struct sim_algo sim_algos[] = {
+	{ "none", NULL, NULL }, /* accept all the shares */
+	{ "nist5", chain_nist5, NULL },
+	{ "quark", NULL, quark_hash },
+	{ "qubit", chain_qubit, NULL },
+	{ "x11", chain_x11, NULL },
+	{ "x13", chain_x13, NULL },
+	{ "x14", chain_x14, NULL },
+	{ "x15", chain_x15, NULL },
+	{ NULL, NULL, NULL }
+};
+
+/* options */
+
+static int opt_port = 3333;
+static const char *opt_host = "127.0.0.1";
+static const struct sim_algo *opt_algo = &sim_algos[0];
+static double opt_diff = 1.0;
+static int opt_job_ms = 30000;
+static double opt_clean = 0.2;
+static int opt_merkle = 10;
+static int opt_xn2size = 4;
+static int opt_vardiff = 0;
+static int opt_reconnect = 0;
+static int opt_storm = 0;
+static int opt_extranonce = 0;
+static int opt_delay = 0;
+static int opt_stats = 30;
+
+static const char usage[] = "\
+Usage: poolsim [OPTIONS]\n\
+Options:\n\
+  -p, --port=N          listen port (default: 3333)\n\
+  -H, --host=ADDR       address given in client.reconnect (default: 127.0.0.1)\n\
+  -a, --algo=ALGO       hash of the shares: none (accept all), nist5, quark, qubit,\n\
+                        x11, x13, x14, x15 (default: none)\n\
+  -d, --diff=D          initial share difficulty (default: 1)\n\
+  -j, --job-ms=N        send a new job every N ms (default: 30000)\n\
+  -c, --clean=P         probability of a clean job (new block) (default: 0.2)\n\
+  -m, --merkle=N        merkle branch length (default: 10)\n\
+  -x, --xn2size=N       extranonce2 size (default: 4)\n\
+  -v, --vardiff=S       retarget the difficulty to one share each S seconds\n\
+  -r, --reconnect=S     send client.reconnect each S seconds\n\
+  -s, --storm=S         drop all the connections each S seconds\n\
+  -e, --extranonce=S    send mining.set_extranonce each S seconds\n\
+  -l, --delay=N         answer the submits after N ms\n\
+  -t, --stats=S         print the statistics each S seconds (default: 30)\n\
+  -h, --help            display this help text and exit\n";
+
+static struct option const options[] = {
+	{ "algo", 1, NULL, 'a' },
+	{ "clean", 1, NULL, 'c' },
+	{ "delay", 1, NULL, 'l' },
+	{ "diff", 1, NULL, 'd' },
+	{ "extranonce", 1, NULL, 'e' },
+	{ "help", 0, NULL, 'h' },
+	{ "host", 1, NULL, 'H' },
+	{ "job-ms", 1, NULL, 'j' },
+	{ "merkle", 1, NULL, 'm' },
+	{ "port", 1, NULL, 'p' },
+	{ "reconnect", 1, NULL, 'r' },
+	{ "stats", 1, NULL, 't' },
+	{ "storm", 1, NULL, 's' },
+	{ "vardiff", 1, NULL, 'v' },
+	{ "xn2size", 1, NULL, 'x' },
+	{ 0, 0, 0, 0 }
+};
+
+/* state */
+
+struct sim_job {
+	uint32_t id;
+	bool clean;
+	uint32_t height;
+	uint64_t t_sent;
+	uint64_t t_obsolete;     /* replaced by a clean job, 0 if still valid */
+	std::string prevhash, coinb1, coinb2, version, nbits, ntime;
+	std::vector<std::string> merkle;
+	std::set<std::string> shares;
+};
+
+struct sim_sent_job {
+	uint32_t id;
+	double diff;
+	char xnonce1[2 * SIM_XNONCE1_SIZE + 1];
+};
+
+struct sim_client {
+	int fd;
+	uint32_t id;
+	char addr[32];
+	char xnonce1[2 * SIM_XNONCE1_SIZE + 1];
+	bool authorized;
+	bool extranonce;
+	double diff;
+	uint64_t vardiff_start;
+	int vardiff_shares;
+	std::string in, out;
+	std::deque<struct sim_sent_job> jobs;
+	bool closing;
+};
+
+struct sim_answer {
+	uint64_t due;
+	uint32_t client;
+	std::string line;
+};
+
+enum {
+	SIM_ACCEPTED, SIM_STALE, SIM_NOTFOUND, SIM_DUPLICATE, SIM_LOWDIFF, SIM_INVALID, SIM_OUTCOMES
+};
+static const char *sim_outcome_names[SIM_OUTCOMES] = { "accepted", "stale", "notfound", "duplicate", "lowdiff", "invalid" };
+
+static std::deque<struct sim_job> jobs;
+static std::vector<struct sim_client *> clients;
+static std::deque<struct sim_answer> answers;
+static uint32_t next_job_id = 1, next_client_id = 1, next_xnonce1 = 1;
+static uint32_t height = 100000;
+static uint64_t t_start;
+
+static uint64_t outcomes[SIM_OUTCOMES];
+static double accepted_diff = 0.;
+static std::vector<uint32_t> job_ages;    /* ms, accepted shares */
+static std::vector<uint32_t> stale_lags;  /* ms after the clean job */
+static uint32_t connects, disconnects;
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static std::string random_hex(size_t bytes)
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string s(bytes * 2, '0');
+	for(size_t i = 0; i < s.size(); i++)
+		s[i] = hex[rand() & 15];
+	return s;
+}
+
+static bool hex2bin(uint8_t *p, const char *hexstr, size_t len)
+{
+	for(size_t i = 0; i < len; i++)
+	{
+		unsigned int v;
+		if(!hexstr[2 * i] || !hexstr[2 * i + 1] || sscanf(&hexstr[2 * i], "%2x", &v) != 1)
+			return false;
+		p[i] = (uint8_t)v;
+	}
+	return true;
+}
+
+static void sha256d(uint8_t *hash, const uint8_t *data, size_t len)
+{
+	uint8_t h[32];
+	SHA256(data, len, h);
+	SHA256(h, 32, hash);
+}
+
+/* network */
+
+static void client_send(struct sim_client *c, const char *line)
+{
+	c->out += line;
+	c->out += '\n';
+}
+
+static void client_send_json(struct sim_client *c, json_t *val)
+{
+	char *s = json_dumps(val, JSON_COMPACT);
+	client_send(c, s);
+	free(s);
+	json_decref(val);
+}
+
+static struct sim_client *find_client(uint32_t id)
+{
+	for(size_t i = 0; i < clients.size(); i++)
+	{
+		if(clients[i]->id == id)
+			return clients[i];
+	}
+	return NULL;
+}
+
+static void send_difficulty(struct sim_client *c)
+{
+	client_send_json(c, json_pack("{s:n, s:s, s:[f]}", "id", "method", "mining.set_difficulty", "params", c->diff));
+}
+
+static void send_job(struct sim_client *c, const struct sim_job *job, bool clean)
+{
+	char jid[16];
+	json_t *merkle = json_array();
+	for(size_t i = 0; i < job->merkle.size(); i++)
+		json_array_append_new(merkle, json_string(job->merkle[i].c_str()));
+	snprintf(jid, sizeof(jid), "%x", job->id);
+	client_send_json(c, json_pack("{s:n, s:s, s:[s, s, s, s, o, s, s, s, b]}", "id", "method", "mining.notify",
+		"params", jid, job->prevhash.c_str(), job->coinb1.c_str(), job->coinb2.c_str(), merkle,
+		job->version.c_str(), job->nbits.c_str(), job->ntime.c_str(), clean));
+
+	struct sim_sent_job sent;
+	sent.id = job->id;
+	sent.diff = c->diff;
+	memcpy(sent.xnonce1, c->xnonce1, sizeof(sent.xnonce1));
+	c->jobs.push_back(sent);
+	if(c->jobs.size() > SIM_JOBS)
+		c->jobs.pop_front();
+}
+
+static void new_xnonce1(struct sim_client *c)
+{
+	snprintf(c->xnonce1, sizeof(c->xnonce1), "%08x", next_xnonce1++);
+}
+
+static void new_job(uint64_t now, bool clean)
+{
+	struct sim_job job;
+	char buf[16];
+
+	if(clean || jobs.empty())
+	{
+		clean = true;
+		height++;
+		for(size_t i = 0; i < jobs.size(); i++)
+		{
+			if(!jobs[i].t_obsolete)
+				jobs[i].t_obsolete = now;
+		}
+	}
+	job.id = next_job_id++;
+	job.clean = clean;
+	job.height = height;
+	job.t_sent = now;
+	job.t_obsolete = 0;
+	job.prevhash = (clean || jobs.empty()) ? random_hex(32) : jobs.back().prevhash;
+	job.version = "20000000";
+	job.nbits = "1d00ffff";
+	snprintf(buf, sizeof(buf), "%08x", (uint32_t)time(NULL));
+	job.ntime = buf;
+
+	/* coinbase: version, 1 input, script with the height, then the extranonces */
+	const std::string tag = random_hex(8);
+	snprintf(buf, sizeof(buf), "%02x03%02x%02x%02x", 4 + (int)tag.size() / 2 + SIM_XNONCE1_SIZE + opt_xn2size,
+		height & 0xff, (height >> 8) & 0xff, (height >> 16) & 0xff);
+	job.coinb1 = "01000000" "01" + std::string(64, '0') + "ffffffff" + buf + tag;
+	job.coinb2 = "ffffffff" "01" "00f2052a01000000" "1976a914" + random_hex(20) + "88ac" "00000000";
+	for(int i = 0; i < opt_merkle; i++)
+		job.merkle.push_back(random_hex(32));
+
+	jobs.push_back(job);
+	if(jobs.size() > SIM_JOBS)
+		jobs.pop_front();
+
+	for(size_t i = 0; i < clients.size(); i++)
+	{
+		if(clients[i]->authorized)
+			send_job(clients[i], &jobs.back(), clean);
+	}
+}
+
+static struct sim_job *find_job(uint32_t id)
+{
+	for(size_t i = 0; i < jobs.size(); i++)
+	{
+		if(jobs[i].id == id)
+			return &jobs[i];
+	}
+	return NULL;
+}
+
+/* share validation */
+
+static double share_difficulty(const struct sim_job *job, const char *xnonce1, const char *xnonce2,
+	const char *ntime, const char *nonce)
+{
+	std::string cbhex = job->coinb1 + xnonce1 + xnonce2 + job->coinb2;
+	std::vector<uint8_t> coinbase(cbhex.size() / 2);
+	uint8_t root[64], b[4], header[80], hash[32];
+
+	hex2bin(coinbase.data(), cbhex.c_str(), coinbase.size());
+	sha256d(root, coinbase.data(), coinbase.size());
+	for(size_t i = 0; i < job->merkle.size(); i++)
+	{
+		hex2bin(root + 32, job->merkle[i].c_str(), 32);
+		sha256d(root, root, 64);
+	}
+
+	/* header words as the miner hashes them (big endian of its le32dec) */
+	hex2bin(b, job->version.c_str(), 4);
+	for(int k = 0; k < 4; k++) header[k] = b[3 - k];
+	hex2bin(header + 4, job->prevhash.c_str(), 32);
+	for(int w = 0; w < 8; w++)
+		std::reverse(header + 4 + 4 * w, header + 8 + 4 * w);
+	memcpy(header + 36, root, 32);
+	hex2bin(b, ntime, 4);
+	for(int k = 0; k < 4; k++) header[68 + k] = b[3 - k];
+	hex2bin(b, job->nbits.c_str(), 4);
+	for(int k = 0; k < 4; k++) header[72 + k] = b[3 - k];
+	hex2bin(b, nonce, 4);
+	for(int k = 0; k < 4; k++) header[76 + k] = b[3 - k];
+
+	if(opt_algo->chain)
+		chain_hash(opt_algo->chain, hash, header);
+	else
+		opt_algo->hash(hash, header);
+
+	/* hash as a little endian 256-bit number, diff 1 is 0xffff0000 << 192 */
+	double h = 0.;
+	for(int i = 31; i >= 0; i--)
+		h = h * 256. + hash[i];
+	return h > 0. ? (4294901760.0 * ldexp(1., 192)) / h : 1e300;
+}
+
+static void vardiff(struct sim_client *c, uint64_t now)
+{
+	uint64_t window = (uint64_t)opt_vardiff * SIM_VARDIFF_SHARES * 1000;
+	if(!opt_vardiff || now < c->vardiff_start + window)
+		return;
+	double ratio = (double)c->vardiff_shares / SIM_VARDIFF_SHARES;
+	ratio = std::max(0.25, std::min(4., ratio > 0. ? ratio : 0.5));
+	c->vardiff_start = now;
+	c->vardiff_shares = 0;
+	if(fabs(ratio - 1.) < 0.25)
+		return;
+	c->diff = std::max(1. / 65536., c->diff * ratio);
+	send_difficulty(c);
+}
+
+static int check_share(struct sim_client *c, json_t *params, uint64_t now)
+{
+	const char *jobid = json_string_value(json_array_get(params, 1));
+	const char *xnonce2 = json_string_value(json_array_get(params, 2));
+	const char *ntime = json_string_value(json_array_get(params, 3));
+	const char *nonce = json_string_value(json_array_get(params, 4));
+
+	if(!jobid || !xnonce2 || !ntime || !nonce || strlen(xnonce2) != 2 * (size_t)opt_xn2size ||
+		strlen(ntime) != 8 || strlen(nonce) != 8)
+		return SIM_INVALID;
+
+	uint32_t id = (uint32_t)strtoul(jobid, NULL, 16);
+	const struct sim_sent_job *sent = NULL;
+	for(size_t i = 0; i < c->jobs.size(); i++)
+	{
+		if(c->jobs[i].id == id)
+			sent = &c->jobs[i];
+	}
+	struct sim_job *job = find_job(id);
+	if(!sent || !job)
+		return SIM_NOTFOUND;
+	if(job->t_obsolete)
+	{
+		stale_lags.push_back((uint32_t)(now - job->t_obsolete));
+		return SIM_STALE;
+	}
+	std::string key = std::string(sent->xnonce1) + xnonce2 + ntime + nonce;
+	if(!job->shares.insert(key).second)
+		return SIM_DUPLICATE;
+	if(opt_algo->chain || opt_algo->hash)
+	{
+		if(share_difficulty(job, sent->xnonce1, xnonce2, ntime, nonce) < sent->diff * 0.999999)
+			return SIM_LOWDIFF;
+	}
+	job_ages.push_back((uint32_t)(now - job->t_sent));
+	accepted_diff += sent->diff;
+	c->vardiff_shares++;
+	return SIM_ACCEPTED;
+}
+
+static void answer(struct sim_client *c, json_t *val, uint64_t now)
+{
+	if(!opt_delay)
+	{
+		client_send_json(c, val);
+		return;
+	}
+	struct sim_answer a;
+	char *s = json_dumps(val, JSON_COMPACT);
+	a.due = now + opt_delay;
+	a.client = c->id;
+	a.line = s;
+	free(s);
+	json_decref(val);
+	answers.push_back(a);
+}
+
+static void handle_line(struct sim_client *c, const char *line, uint64_t now)
+{
+	json_error_t err;
+	json_t *val = json_loads(line, 0, &err);
+	if(!val)
+	{
+		fprintf(stderr, "client %u: invalid json: %s\n", c->id, err.text);
+		return;
+	}
+	const char *method = json_string_value(json_object_get(val, "method"));
+	json_t *id = json_object_get(val, "id");
+	json_t *params = json_object_get(val, "params");
+
+	if(!method)
+	{
+		/* answer to a server request, nothing to do */
+	}
+	else if(!strcmp(method, "mining.subscribe"))
+	{
+		client_send_json(c, json_pack("{s:O, s:[[[s, s], [s, s]], s, i], s:n}", "id", id,
+			"result", "mining.set_difficulty", c->xnonce1, "mining.notify", c->xnonce1, c->xnonce1, opt_xn2size,
+			"error"));
+	}
+	else if(!strcmp(method, "mining.authorize"))
+	{
+		client_send_json(c, json_pack("{s:O, s:b, s:n}", "id", id, "result", 1, "error"));
+		if(!c->authorized)
+		{
+			c->authorized = true;
+			c->vardiff_start = now;
+			send_difficulty(c);
+			if(!jobs.empty())
+				send_job(c, &jobs.back(), true);
+		}
+	}
+	else if(!strcmp(method, "mining.extranonce.subscribe"))
+	{
+		c->extranonce = true;
+		client_send_json(c, json_pack("{s:O, s:b, s:n}", "id", id, "result", 1, "error"));
+	}
+	else if(!strcmp(method, "mining.submit"))
+	{
+		int outcome = c->authorized ? check_share(c, params, now) : SIM_INVALID;
+		outcomes[outcome]++;
+		switch(outcome)
+		{
+		case SIM_ACCEPTED:
+			answer(c, json_pack("{s:O, s:b, s:n}", "id", id, "result", 1, "error"), now);
+			vardiff(c, now);
+			break;
+		case SIM_STALE:
+			answer(c, json_pack("{s:O, s:n, s:[i, s, n]}", "id", id, "result", "error", 21, "Stale share"), now);
+			break;
+		case SIM_NOTFOUND:
+			answer(c, json_pack("{s:O, s:n, s:[i, s, n]}", "id", id, "result", "error", 21, "Job not found"), now);
+			break;
+		case SIM_DUPLICATE:
+			answer(c, json_pack("{s:O, s:n, s:[i, s, n]}", "id", id, "result", "error", 22, "Duplicate share"), now);
+			break;
+		case SIM_LOWDIFF:
+			answer(c, json_pack("{s:O, s:n, s:[i, s, n]}", "id", id, "result", "error", 23, "Low difficulty share"), now);
+			break;
+		default:
+			answer(c, json_pack("{s:O, s:n, s:[i, s, n]}", "id", id, "result", "error", 20, "Invalid share"), now);
+		}
+	}
+	else if(!json_is_null(id))
+	{
+		client_send_json(c, json_pack("{s:O, s:n, s:[i, s, n]}", "id", id, "result", "error", 20, "Unknown method"));
+	}
+	json_decref(val);
+}
+
+static void client_close(struct sim_client *c)
+{
+	close(c->fd);
+	clients.erase(std::find(clients.begin(), clients.end(), c));
+	delete c;
+	disconnects++;
+}
+
+static void accept_client(int lsock, uint64_t now)
+{
+	struct sockaddr_in sin;
+	socklen_t len = sizeof(sin);
+	int fd = accept(lsock, (struct sockaddr *)&sin, &len);
+	if(fd < 0)
+		return;
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	struct sim_client *c = new sim_client();
+	c->fd = fd;
+	c->id = next_client_id++;
+	snprintf(c->addr, sizeof(c->addr), "%s", inet_ntoa(sin.sin_addr));
+	c->diff = opt_diff;
+	c->vardiff_start = now;
+	new_xnonce1(c);
+	clients.push_back(c);
+	connects++;
+}
+
+/* false if the connection is closed */
+static bool client_read(struct sim_client *c, uint64_t now)
+{
+	char buf[4096];
+	ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+	if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+		return false;
+	if(n > 0)
+		c->in.append(buf, n);
+	size_t pos;
+	while((pos = c->in.find('\n')) != std::string::npos)
+	{
+		std::string line = c->in.substr(0, pos);
+		c->in.erase(0, pos + 1);
+		if(!line.empty())
+			handle_line(c, line.c_str(), now);
+	}
+	return c->in.size() < SIM_MAX_LINE;
+}
+
+static bool client_write(struct sim_client *c)
+{
+	ssize_t n = send(c->fd, c->out.data(), c->out.size(), MSG_NOSIGNAL);
+	if(n < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+	c->out.erase(0, n);
+	return true;
+}
+
+/* stats */
+
+static uint32_t percentile(std::vector<uint32_t> &v, double p)
+{
+	if(v.empty())
+		return 0;
+	size_t k = std::min(v.size() - 1, (size_t)(p * v.size()));
+	std::nth_element(v.begin(), v.begin() + k, v.end());
+	return v[k];
+}
+
+static void print_stats(uint64_t now)
+{
+	double elapsed = (now - t_start) / 1000.;
+	printf("poolsim: %.0fs, %u clients (%u connects, %u drops), height %u, job %x\n",
+		elapsed, (unsigned)clients.size(), connects, disconnects, height, next_job_id - 1);
+	printf("  shares:");
+	for(int i = 0; i < SIM_OUTCOMES; i++)
+		printf(" %s=%llu", sim_outcome_names[i], (unsigned long long)outcomes[i]);
+	printf("\n  pool hashrate %.2f kH/s\n", elapsed > 0. ? accepted_diff * 4294967296. / elapsed / 1000. : 0.);
+	printf("  job age ms p50=%u p90=%u p99=%u, stale lag ms p50=%u p99=%u max=%u\n",
+		percentile(job_ages, .5), percentile(job_ages, .9), percentile(job_ages, .99),
+		percentile(stale_lags, .5), percentile(stale_lags, .99), percentile(stale_lags, 1.));
+	fflush(stdout);
+}
+
+static int listen_socket(void)
+{
+	struct sockaddr_in sin;
+	int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons((uint16_t)opt_port);
+	if(bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(fd, 64) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	return fd;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int key;
+	while((key = getopt_long(argc, argv, "a:c:d:e:hH:j:l:m:p:r:s:t:v:x:", options, NULL)) != -1)
+	{
+		switch(key)
+		{
+		case 'a':
+			for(opt_algo = sim_algos; opt_algo->name && strcasecmp(opt_algo->name, optarg); opt_algo++);
+			if(!opt_algo->name)
+			{
+				fprintf(stderr, "unknown algo %s\n", optarg);
+				exit(1);
+			}
+			break;
+		case 'c': opt_clean = atof(optarg); break;
+		case 'd': opt_diff = atof(optarg); break;
+		case 'e': opt_extranonce = atoi(optarg); break;
+		case 'H': opt_host = optarg; break;
+		case 'j': opt_job_ms = atoi(optarg); break;
+		case 'l': opt_delay = atoi(optarg); break;
+		case 'm': opt_merkle = atoi(optarg); break;
+		case 'p': opt_port = atoi(optarg); break;
+		case 'r': opt_reconnect = atoi(optarg); break;
+		case 's': opt_storm = atoi(optarg); break;
+		case 't': opt_stats = atoi(optarg); break;
+		case 'v': opt_vardiff = atoi(optarg); break;
+		case 'x': opt_xn2size = atoi(optarg); break;
+		default:
+			printf("%s", usage);
+			exit(key == 'h' ? 0 : 1);
+		}
+	}
+	if(opt_diff <= 0. || opt_job_ms < 10 || opt_merkle < 0 || opt_xn2size < 2 || opt_xn2size > 16 || opt_port <= 0)
+	{
+		fprintf(stderr, "%s", usage);
+		exit(1);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	parse_args(argc, argv);
+	signal(SIGPIPE, SIG_IGN);
+	srand((unsigned)time(NULL));
+
+	int lsock = listen_socket();
+	if(lsock < 0)
+	{
+		fprintf(stderr, "poolsim: unable to listen on port %d: %s\n", opt_port, strerror(errno));
+		return 1;
+	}
+	printf("poolsim: listening on port %d, algo %s, diff %g, a job each %d ms\n",
+		opt_port, opt_algo->name, opt_diff, opt_job_ms);
+
+	uint64_t now = t_start = now_ms();
+	uint64_t next_job = now, next_stats = now + opt_stats * 1000ULL;
+	uint64_t next_reconnect = now + opt_reconnect * 1000ULL;
+	uint64_t next_storm = now + opt_storm * 1000ULL;
+	uint64_t next_extranonce = now + opt_extranonce * 1000ULL;
+
+	for(;;)
+	{
+		now = now_ms();
+		if(now >= next_job)
+		{
+			new_job(now, (double)rand() / RAND_MAX < opt_clean);
+			next_job = now + opt_job_ms;
+		}
+		if(opt_reconnect && now >= next_reconnect)
+		{
+			for(size_t i = 0; i < clients.size(); i++)
+				client_send_json(clients[i], json_pack("{s:n, s:s, s:[s, i, i]}", "id", "method", "client.reconnect",
+					"params", opt_host, opt_port, 0));
+			next_reconnect = now + opt_reconnect * 1000ULL;
+		}
+		if(opt_storm && now >= next_storm)
+		{
+			while(!clients.empty())
+				client_close(clients.back());
+			next_storm = now + opt_storm * 1000ULL;
+		}
+		if(opt_extranonce && now >= next_extranonce)
+		{
+			for(size_t i = 0; i < clients.size(); i++)
+			{
+				if(!clients[i]->extranonce)
+					continue;
+				new_xnonce1(clients[i]);
+				client_send_json(clients[i], json_pack("{s:n, s:s, s:[s, i]}", "id", "method", "mining.set_extranonce",
+					"params", clients[i]->xnonce1, opt_xn2size));
+			}
+			next_extranonce = now + opt_extranonce * 1000ULL;
+		}
+		while(!answers.empty() && answers.front().due <= now)
+		{
+			struct sim_client *c = find_client(answers.front().client);
+			if(c)
+				client_send(c, answers.front().line.c_str());
+			answers.pop_front();
+		}
+		for(size_t i = 0; i < clients.size(); i++)
+			vardiff(clients[i], now);
+		if(opt_stats && now >= next_stats)
+		{
+			print_stats(now);
+			next_stats = now + opt_stats * 1000ULL;
+		}
+
+		std::vector<struct pollfd> pfd(clients.size() + 1);
+		pfd[0].fd = lsock;
+		pfd[0].events = POLLIN;
+		for(size_t i = 0; i < clients.size(); i++)
+		{
+			pfd[i + 1].fd = clients[i]->fd;
+			pfd[i + 1].events = POLLIN | (clients[i]->out.empty() ? 0 : POLLOUT);
+		}
+		uint64_t wake = next_job;
+		if(!answers.empty())
+			wake = std::min(wake, answers.front().due);
+		if(opt_stats)
+			wake = std::min(wake, next_stats);
+		int timeout = wake > now ? (int)std::min(wake - now, (uint64_t)1000) : 0;
+		if(poll(pfd.data(), pfd.size(), timeout) < 0 && errno != EINTR)
+			break;
+
+		now = now_ms();
+		std::vector<struct sim_client *> snapshot(clients);
+		for(size_t i = 0; i < snapshot.size(); i++)
+		{
+			struct sim_client *c = snapshot[i];
+			short ev = pfd[i + 1].revents;
+			bool ok = true;
+			if(ev & (POLLIN | POLLHUP | POLLERR))
+				ok = client_read(c, now);
+			if(ok && !c->out.empty())
+				ok = client_write(c);
+			if(!ok)
+				client_close(c);
+		}
+		if(pfd[0].revents & POLLIN)
+			accept_client(lsock, now);
+	}
+	close(lsock);
+	return 0;
+}
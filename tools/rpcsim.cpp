@@ -0,0 +1,443 @@
+/**
+ * Getwork node simulator (make rpcsim)
+ *
+ * A local JSON-RPC server to test the solo/getwork path of the miner: it
+ * answers getwork (with and without data), getmininginfo and
+ * getblocktemplate over HTTP/1.1 keep-alive, finds a new block at a fixed
+ * rate and can hold a longpoll request until then.
+ *
+ * A delay can be added to each answer, like a remote node. The number of
+ * connections, of requests per method and per connection are printed
+ * periodically: a miner which keeps its connections makes a few of them
+ * only, and the block infos are asked once per block.
+ *
+ * Linux only, single thread, poll() based.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h>
+#include <errno.h>
+#include <time.h>
+#include <signal.h>
+#include <getopt.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <algorithm>
+#include <deque>
+#include <string>
+#include <vector>
+
+#include <jansson.h>
+
+#define SIM_MAX_REQUEST 65536
+
+/* options */
+
+static int opt_port = 8332;
+static int opt_delay = 0;
+static int opt_block = 60;
+static int opt_longpoll = 0;
+static int opt_stats = 30;
+
+static const char usage[] = "\
+Usage: rpcsim [OPTIONS]\n\
+Options:\n\
+  -p, --port=N          listen port (default: 8332)\n\
+  -l, --delay=N         answer the requests after N ms\n\
+  -b, --block=S         new block each S seconds (default: 60)\n\
+  -L, --longpoll        announce longpoll, held until the next block\n\
+  -t, --stats=S         print the statistics each S seconds (default: 30)\n\
+  -h, --help            display this help text and exit\n";
+
+static struct option const options[] = {
+	{ "block", 1, NULL, 'b' },
+	{ "delay", 1, NULL, 'l' },
+	{ "help", 0, NULL, 'h' },
+	{ "longpoll", 0, NULL, 'L' },
+	{ "port", 1, NULL, 'p' },
+	{ "stats", 1, NULL, 't' },
+	{ 0, 0, 0, 0 }
+};
+
+/* state */
+
+struct sim_client {
+	int fd;
+	uint32_t id;
+	uint32_t requests;
+	std::string in, out;
+	bool longpoll;         /* a longpoll request waits for the next block */
+	json_t *longpoll_id;
+	bool close_after;      /* Connection: close */
+};
+
+struct sim_answer {
+	uint64_t due;
+	uint32_t client;
+	std::string reply;
+	bool close_after;
+};
+
+enum {
+	SIM_GETWORK, SIM_SUBMIT, SIM_MININGINFO, SIM_GBT, SIM_LONGPOLL, SIM_OTHER, SIM_METHODS
+};
+static const char *sim_method_names[SIM_METHODS] = { "getwork", "submit", "getmininginfo", "getblocktemplate", "longpoll", "other" };
+
+static std::vector<struct sim_client *> clients;
+static std::deque<struct sim_answer> answers;
+static uint32_t height = 100000;
+static std::string prevhash;
+static uint64_t t_start;
+
+static uint64_t requests[SIM_METHODS];
+static uint64_t accepted, stale;
+static uint32_t connects, disconnects, next_client_id = 1;
+
+static uint64_t now_ms(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static std::string random_hex(size_t bytes)
+{
+	static const char hex[] = "0123456789abcdef";
+	std::string s(bytes * 2, '0');
+	for(size_t i = 0; i < s.size(); i++)
+		s[i] = hex[rand() & 15];
+	return s;
+}
+
+/* getwork data: the header in 32-bit little endian words and its sha256 padding */
+static json_t *getwork_result(void)
+{
+	char ntime[9];
+	snprintf(ntime, sizeof(ntime), "%08x", (uint32_t)time(NULL));
+	std::string data = "00000020" + prevhash + random_hex(32) + ntime + "ffff001d" + "00000000" +
+		"00000080" + std::string(80, '0') + "80020000";
+	std::string target = std::string(56, 'f') + "00000000";
+	return json_pack("{s:s, s:s}", "data", data.c_str(), "target", target.c_str());
+}
+
+static void new_block(void)
+{
+	height++;
+	prevhash = random_hex(32);
+}
+
+/* network */
+
+static std::string http_reply(json_t *id, json_t *result, json_t *error)
+{
+	json_t *val = json_pack("{s:O, s:o, s:o}", "id", id ? id : json_null(), "result", result ? result : json_null(),
+		"error", error ? error : json_null());
+	char *s = json_dumps(val, JSON_COMPACT);
+	char hdr[256];
+	snprintf(hdr, sizeof(hdr), "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nContent-Length: %u\r\n%s\r\n",
+		(unsigned)strlen(s) + 1, opt_longpoll ? "X-Long-Polling: /lp\r\n" : "");
+	std::string reply = std::string(hdr) + s + "\n";
+	free(s);
+	json_decref(val);
+	return reply;
+}
+
+static void answer(struct sim_client *c, const std::string &reply, uint64_t now)
+{
+	struct sim_answer a;
+	a.due = now + opt_delay;
+	a.client = c->id;
+	a.reply = reply;
+	a.close_after = c->close_after;
+	answers.push_back(a);
+}
+
+static void handle_request(struct sim_client *c, const std::string &path, const char *body, uint64_t now)
+{
+	json_error_t err;
+	json_t *val = json_loads(body, 0, &err);
+	json_t *id = json_object_get(val, "id");
+	const char *method = json_string_value(json_object_get(val, "method"));
+	json_t *params = json_object_get(val, "params");
+
+	c->requests++;
+	if(!method)
+	{
+		requests[SIM_OTHER]++;
+		answer(c, http_reply(id, NULL, json_pack("{s:i, s:s}", "code", -32700, "message", "Parse error")), now);
+	}
+	else if(path == "/lp" && opt_longpoll)
+	{
+		requests[SIM_LONGPOLL]++;
+		c->longpoll = true;
+		c->longpoll_id = json_incref(id ? id : json_null());
+	}
+	else if(!strcasecmp(method, "getwork") && json_array_size(params) > 0)
+	{
+		const char *data = json_string_value(json_array_get(params, 0));
+		requests[SIM_SUBMIT]++;
+		bool ok = data && strlen(data) >= 72 && !strncmp(data + 8, prevhash.c_str(), 64);
+		ok ? accepted++ : stale++;
+		answer(c, http_reply(id, json_boolean(ok), NULL), now);
+	}
+	else if(!strcasecmp(method, "getwork"))
+	{
+		requests[SIM_GETWORK]++;
+		answer(c, http_reply(id, getwork_result(), NULL), now);
+	}
+	else if(!strcasecmp(method, "getmininginfo"))
+	{
+		requests[SIM_MININGINFO]++;
+		answer(c, http_reply(id, json_pack("{s:i, s:f, s:I}", "blocks", height - 1, "difficulty", 1.0,
+			"networkhashps", (json_int_t)7158278), NULL), now);
+	}
+	else if(!strcasecmp(method, "getblocktemplate"))
+	{
+		requests[SIM_GBT]++;
+		answer(c, http_reply(id, json_pack("{s:i, s:s}", "height", height, "previousblockhash", prevhash.c_str()), NULL), now);
+	}
+	else
+	{
+		requests[SIM_OTHER]++;
+		answer(c, http_reply(id, NULL, json_pack("{s:i, s:s}", "code", -32601, "message", "Method not found")), now);
+	}
+	json_decref(val);
+}
+
+static void client_close(struct sim_client *c)
+{
+	close(c->fd);
+	json_decref(c->longpoll_id);
+	clients.erase(std::find(clients.begin(), clients.end(), c));
+	delete c;
+	disconnects++;
+}
+
+static void accept_client(int lsock)
+{
+	int fd = accept(lsock, NULL, NULL);
+	if(fd < 0)
+		return;
+	int one = 1;
+	setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	struct sim_client *c = new sim_client();
+	c->fd = fd;
+	c->id = next_client_id++;
+	clients.push_back(c);
+	connects++;
+}
+
+/* the complete requests of the buffer, false if the connection is closed */
+static bool client_read(struct sim_client *c, uint64_t now)
+{
+	char buf[4096];
+	ssize_t n = recv(c->fd, buf, sizeof(buf), 0);
+	if(n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+		return false;
+	if(n > 0)
+		c->in.append(buf, n);
+	size_t end;
+	while((end = c->in.find("\r\n\r\n")) != std::string::npos)
+	{
+		std::string head = c->in.substr(0, end + 2);
+		size_t len = 0, pos = 0;
+		while((pos = head.find("\r\n", pos)) != std::string::npos && pos + 2 < head.size())
+		{
+			const char *line = head.c_str() + pos + 2;
+			if(!strncasecmp(line, "Content-Length:", 15))
+				len = strtoul(line + 15, NULL, 10);
+			else if(!strncasecmp(line, "Connection:", 11) && strstr(line, "close"))
+				c->close_after = true;
+			pos += 2;
+		}
+		if(c->in.size() < end + 4 + len)
+			break;
+		std::string body = c->in.substr(end + 4, len);
+		size_t sp = head.find(' ');
+		std::string path = head.substr(sp + 1, head.find(' ', sp + 1) - sp - 1);
+		c->in.erase(0, end + 4 + len);
+		handle_request(c, path, body.c_str(), now);
+	}
+	return c->in.size() < SIM_MAX_REQUEST;
+}
+
+static bool client_write(struct sim_client *c)
+{
+	ssize_t n = send(c->fd, c->out.data(), c->out.size(), MSG_NOSIGNAL);
+	if(n < 0)
+		return errno == EAGAIN || errno == EWOULDBLOCK;
+	c->out.erase(0, n);
+	return !(c->out.empty() && c->close_after);
+}
+
+static struct sim_client *find_client(uint32_t id)
+{
+	for(size_t i = 0; i < clients.size(); i++)
+	{
+		if(clients[i]->id == id)
+			return clients[i];
+	}
+	return NULL;
+}
+
+/* stats */
+
+static void print_stats(uint64_t now)
+{
+	uint64_t total = 0;
+	for(int i = 0; i < SIM_METHODS; i++)
+		total += requests[i];
+	printf("rpcsim: %.0fs, height %u, %u connections (%u open)\n", (now - t_start) / 1000., height,
+		connects, (unsigned)clients.size());
+	printf("  requests:");
+	for(int i = 0; i < SIM_METHODS; i++)
+		printf(" %s=%llu", sim_method_names[i], (unsigned long long)requests[i]);
+	printf("\n  %.1f requests per connection, shares accepted=%llu stale=%llu\n",
+		connects ? (double)total / connects : 0., (unsigned long long)accepted, (unsigned long long)stale);
+	fflush(stdout);
+}
+
+static int listen_socket(void)
+{
+	struct sockaddr_in sin;
+	int one = 1;
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	if(fd < 0)
+		return -1;
+	setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_ANY);
+	sin.sin_port = htons((uint16_t)opt_port);
+	if(bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 || listen(fd, 64) < 0)
+	{
+		close(fd);
+		return -1;
+	}
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+	return fd;
+}
+
+static void parse_args(int argc, char *argv[])
+{
+	int key;
+	while((key = getopt_long(argc, argv, "b:hl:Lp:t:", options, NULL)) != -1)
+	{
+		switch(key)
+		{
+		case 'b': opt_block = atoi(optarg); break;
+		case 'l': opt_delay = atoi(optarg); break;
+		case 'L': opt_longpoll = 1; break;
+		case 'p': opt_port = atoi(optarg); break;
+		case 't': opt_stats = atoi(optarg); break;
+		default:
+			printf("%s", usage);
+			exit(key == 'h' ? 0 : 1);
+		}
+	}
+	if(opt_block <= 0 || opt_delay < 0 || opt_port <= 0)
+	{
+		fprintf(stderr, "%s", usage);
+		exit(1);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	parse_args(argc, argv);
+	signal(SIGPIPE, SIG_IGN);
+	srand((unsigned)time(NULL));
+
+	int lsock = listen_socket();
+	if(lsock < 0)
+	{
+		fprintf(stderr, "rpcsim: unable to listen on port %d: %s\n", opt_port, strerror(errno));
+		return 1;
+	}
+	printf("rpcsim: listening on port %d, a block each %d s, %d ms per answer%s\n",
+		opt_port, opt_block, opt_delay, opt_longpoll ? ", longpoll" : "");
+
+	new_block();
+	uint64_t now = t_start = now_ms();
+	uint64_t next_block = now + opt_block * 1000ULL, next_stats = now + opt_stats * 1000ULL;
+
+	for(;;)
+	{
+		now = now_ms();
+		if(now >= next_block)
+		{
+			new_block();
+			for(size_t i = 0; i < clients.size(); i++)
+			{
+				struct sim_client *c = clients[i];
+				if(!c->longpoll)
+					continue;
+				answer(c, http_reply(c->longpoll_id, getwork_result(), NULL), now);
+				json_decref(c->longpoll_id);
+				c->longpoll_id = NULL;
+				c->longpoll = false;
+			}
+			next_block = now + opt_block * 1000ULL;
+		}
+		while(!answers.empty() && answers.front().due <= now)
+		{
+			struct sim_client *c = find_client(answers.front().client);
+			if(c)
+			{
+				c->out += answers.front().reply;
+				c->close_after = answers.front().close_after;
+			}
+			answers.pop_front();
+		}
+		if(opt_stats && now >= next_stats)
+		{
+			print_stats(now);
+			next_stats = now + opt_stats * 1000ULL;
+		}
+
+		std::vector<struct pollfd> pfd(clients.size() + 1);
+		pfd[0].fd = lsock;
+		pfd[0].events = POLLIN;
+		for(size_t i = 0; i < clients.size(); i++)
+		{
+			pfd[i + 1].fd = clients[i]->fd;
+			pfd[i + 1].events = POLLIN | (clients[i]->out.empty() ? 0 : POLLOUT);
+		}
+		uint64_t wake = next_block;
+		if(!answers.empty())
+			wake = std::min(wake, answers.front().due);
+		if(opt_stats)
+			wake = std::min(wake, next_stats);
+		int timeout = wake > now ? (int)std::min(wake - now, (uint64_t)1000) : 0;
+		if(poll(pfd.data(), pfd.size(), timeout) < 0 && errno != EINTR)
+			break;
+
+		now = now_ms();
+		std::vector<struct sim_client *> snapshot(clients);
+		for(size_t i = 0; i < snapshot.size(); i++)
+		{
+			struct sim_client *c = snapshot[i];
+			short ev = pfd[i + 1].revents;
+			bool ok = true;
+			if(ev & (POLLIN | POLLHUP | POLLERR))
+				ok = client_read(c, now);
+			if(ok && !c->out.empty())
+				ok = client_write(c);
+			if(!ok)
+				client_close(c);
+		}
+		if(pfd[0].revents & POLLIN)
+			accept_client(lsock);
+	}
+	close(lsock);
+	return 0;
+}
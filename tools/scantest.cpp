@@ -0,0 +1,277 @@
+/**
+ * Test of the scan driver on the cpu and mock backends (make check)
+ *
+ * scanhash_generic() scans a Keccak-256 algo (the batched cpu kernel,
+ * verified by the sph reference) on a thread of each backend. The
+ * nonces found must be the first ones of the range below the target,
+ * found by hashing each nonce with the reference, and pdata[19],
+ * pdata[21] and hashes_done must tell where the scan stopped. The mock
+ * backend at a synthetic hashrate must return nonces of its batch.
+ * Nothing here needs CUDA.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+#include <math.h>
+
+extern "C"
+{
+#include "sph/sph_keccak.h"
+}
+
+#include "miner.h"
+#include "scan.h"
+
+/* globals of ccminer.cpp, util.cpp and shares.cpp used by the driver */
+bool opt_debug = false;
+int num_cpus = 1;
+bool opt_verify = true;
+bool opt_benchmark = false;
+bool stop_mining = false;
+volatile bool mining_has_stopped[MAX_GPUS];
+int opt_n_threads = 0;
+int device_map[MAX_GPUS];
+char *device_name[MAX_GPUS];
+uint32_t gpus_intensity[MAX_GPUS];
+struct work_restart *work_restart;
+
+void applog(int prio, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	printf("\n");
+}
+
+void proper_exit(int reason)
+{
+	exit(reason ? reason : 1);
+}
+
+/* sph/blake.c reads the round count of blake256.cu */
+extern "C" { int blake256_rounds = 14; }
+
+void *aligned_calloc(int size)
+{
+	void *p = NULL;
+	if(posix_memalign(&p, 64, size))
+		return NULL;
+	memset(p, 0, size);
+	return p;
+}
+
+void aligned_free(void *ptr)
+{
+	free(ptr);
+}
+
+int timeval_subtract(struct timeval *result, struct timeval *x, struct timeval *y)
+{
+	uint64_t end = x->tv_usec + 1000000 * (uint64_t)x->tv_sec;
+	uint64_t start = y->tv_usec + 1000000 * (uint64_t)y->tv_sec;
+	uint64_t diff = start <= end ? end - start : 0;
+	result->tv_sec = (long)(diff / 1000000);
+	result->tv_usec = diff % 1000000;
+	return start > end;
+}
+
+bool fulltest(const uint32_t *hash, const uint32_t *target)
+{
+	for(int i = 7; i >= 0; i--)
+	{
+		if(hash[i] != target[i])
+			return hash[i] < target[i];
+	}
+	return true;
+}
+
+double target_to_hashes(const uint32_t *target)
+{
+	double t = 0.;
+	for(int i = 0; i < 8; i++)
+		t += ldexp((double)target[i], 32 * i - 256);
+	return (t > 0.) ? 1.0 / t : 0.;
+}
+
+/* the CUDA backend of scan_cuda.cpp, never picked here */
+static bool nocuda_init(struct scan_ctx *ctx)
+{
+	return false;
+}
+
+static void nocuda_set_block(struct scan_ctx *ctx)
+{
+}
+
+static void nocuda_hash_batch(struct scan_ctx *ctx, uint32_t first_nonce, uint32_t count)
+{
+}
+
+static int nocuda_collect_candidates(struct scan_ctx *ctx, uint32_t *nonces, int max)
+{
+	return 0;
+}
+
+static void nocuda_release(struct scan_ctx *ctx)
+{
+}
+
+const struct scan_backend scan_backend_cuda = {
+	"cuda",
+	nocuda_init,
+	nocuda_set_block,
+	nocuda_hash_batch,
+	nocuda_collect_candidates,
+	nocuda_release
+};
+
+int scan_cuda_driver_version(void)
+{
+	return 0;
+}
+
+#define TEST_RANGE 0x10000U
+
+static void keccak256_ref(void *state, const void *input)
+{
+	sph_keccak_context ctx;
+	uint32_t hash[16];
+
+	sph_keccak256_init(&ctx);
+	sph_keccak256(&ctx, input, 80);
+	sph_keccak256_close(&ctx, hash);
+	memcpy(state, hash, 32);
+}
+
+static const struct scan_algo test_algo = {
+	"keccak",
+	keccak256_ref,
+	0xff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	keccak256_cpu_hash,
+	NULL
+};
+
+/* next nonce of [nonce, end) below the target with the reference hash, end if none */
+static uint32_t test_next_share(const uint32_t *pdata, const uint32_t *target, uint32_t nonce, uint32_t end)
+{
+	uint32_t data[20], hash[8];
+
+	for(int k = 0; k < 20; k++)
+		be32enc(&data[k], pdata[k]);
+	for(; nonce < end; nonce++)
+	{
+		be32enc(&data[19], nonce);
+		keccak256_ref(hash, data);
+		if(hash[7] <= target[7] && fulltest(hash, target))
+			break;
+	}
+	return nonce;
+}
+
+static void test_header(uint32_t *pdata, uint32_t seed)
+{
+	for(int k = 0; k < 20; k++)
+		pdata[k] = seed * 0x9E3779B9U + k * 0x01000193U;
+}
+
+/* a scan which finds shares, then one which can't */
+static bool test_hashing(int thr_id)
+{
+	const char *name = scan_backend_get(thr_id)->name;
+	uint32_t pdata[22], target[8], hashes_done = 0;
+
+	test_header(pdata, thr_id + 1);
+	const uint32_t first = pdata[19] = 1000 + thr_id;
+	memset(target, 0xff, sizeof(target));
+	target[7] = 0x00ffffff;
+
+	const uint32_t share = test_next_share(pdata, target, first, first + TEST_RANGE);
+	int rc = scanhash_generic(thr_id, &test_algo, pdata, target, first + TEST_RANGE, &hashes_done);
+	if(rc < 1 || pdata[19] != share)
+	{
+		printf("%s: found %d nonces, %08x instead of %08x\n", name, rc, pdata[19], share);
+		return false;
+	}
+	if(hashes_done <= share - first || hashes_done > TEST_RANGE)
+	{
+		printf("%s: %u hashes done for a share at +%u\n", name, hashes_done, share - first);
+		return false;
+	}
+	if(rc > 1 && pdata[21] != test_next_share(pdata, target, share + 1, first + hashes_done))
+	{
+		printf("%s: second nonce %08x is not the next share\n", name, pdata[21]);
+		return false;
+	}
+
+	const int found = rc;
+
+	// no share below a null target
+	memset(target, 0, sizeof(target));
+	pdata[19] = first;
+	rc = scanhash_generic(thr_id, &test_algo, pdata, target, first + TEST_RANGE, &hashes_done);
+	if(rc != 0 || !hashes_done || hashes_done > TEST_RANGE || pdata[19] != first + hashes_done)
+	{
+		printf("%s: %d nonces and %u hashes done without a share\n", name, rc, hashes_done);
+		return false;
+	}
+	printf("%s: nonce %08x (%d found), %u hashes ok\n", name, share, found, hashes_done);
+	return true;
+}
+
+/* random nonces of the batch, nothing to verify */
+static bool test_synthetic(int thr_id)
+{
+	uint32_t pdata[22], target[8], hashes_done = 0;
+
+	opt_mock_hashrate = 1e6;
+	opt_verify = false;
+	test_header(pdata, thr_id + 1);
+	const uint32_t first = pdata[19] = 5000;
+	memset(target, 0xff, sizeof(target));
+
+	int rc = scanhash_generic(thr_id, &test_algo, pdata, target, 0xffffffff, &hashes_done);
+	opt_mock_hashrate = 0.;
+	opt_verify = true;
+	if(rc < 1 || pdata[19] < first || pdata[19] - first >= hashes_done)
+	{
+		printf("mock: synthetic nonce %08x not in %08x+%u (%d found)\n", pdata[19], first, hashes_done, rc);
+		return false;
+	}
+	printf("mock: synthetic nonce %08x in %08x+%u ok\n", pdata[19], first, hashes_done);
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	bool ok = true;
+
+	opt_n_threads = 3;
+	work_restart = (struct work_restart *)calloc(opt_n_threads, sizeof(*work_restart));
+	for(int i = 0; i < MAX_GPUS; i++)
+		device_map[i] = i;
+
+	if(scan_backend_get(0) != &scan_backend_cuda || strcmp(scan_device_type(&scan_backend_cuda), "GPU"))
+	{
+		printf("the threads are not on the cuda backend by default\n");
+		ok = false;
+	}
+	scan_backend_set(0, &scan_backend_cpu);
+	scan_backend_set(1, &scan_backend_mock);
+	scan_backend_set(2, &scan_backend_mock);
+	if(scan_backend_get(1) != &scan_backend_mock || strcmp(scan_device_type(scan_backend_get(0)), "CPU"))
+	{
+		printf("the backends of the threads are not kept\n");
+		ok = false;
+	}
+
+	ok &= test_hashing(0);
+	ok &= test_hashing(1);
+	ok &= test_synthetic(2);
+	return ok ? 0 : 1;
+}
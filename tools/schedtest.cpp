@@ -0,0 +1,187 @@
+/**
+ * Test of the nonce range scheduler (make check)
+ *
+ * A few threads of different rates scan the whole nonce space of a
+ * work through nonce_sched_next() and nonce_sched_done(), on a clock of
+ * their own. Each scan is done like scanhash_generic(): whole batches of
+ * the algo granularity (throughput_mask), stopping early on a found
+ * nonce once in a while. The scanned ranges must cover the space up to
+ * its last whole batch exactly once, and every scan must progress. The
+ * CUDA loops which never set the alignment must get whole batches of
+ * 1024 nonces too.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdarg.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "miner.h"
+
+/* globals of ccminer.cpp used by noncesched.cpp */
+bool opt_debug = false;
+int opt_n_threads = 0;
+int device_map[MAX_GPUS];
+
+void applog(int prio, const char *fmt, ...)
+{
+	va_list ap;
+	va_start(ap, fmt);
+	vprintf(fmt, ap);
+	va_end(ap);
+	printf("\n");
+}
+
+#define TEST_THREADS 3
+#define TEST_SECONDS 1.0
+#define TEST_MAX_SCANS 100000
+
+struct range {
+	uint64_t start, end;
+	bool operator<(const range &o) const { return start < o.start; }
+};
+
+struct test_thread {
+	double rate;         /* nonces per second */
+	double clock;        /* end of the running scan */
+	uint32_t start, end; /* running scan */
+	bool busy;
+	bool aligned;        /* nonce_sched_set_align() done, after the first scan, or never called */
+};
+
+static uint32_t rnd_state = 1;
+
+static uint32_t rnd(void)
+{
+	rnd_state = rnd_state * 1103515245U + 12345U;
+	return rnd_state >> 8;
+}
+
+/* scanhash_generic(): nonces hashed in [start, end) with batches of 'throughput' */
+static uint32_t test_scan(uint32_t start, uint32_t end, uint32_t throughput, uint32_t mask)
+{
+	uint32_t tp = min(throughput, end - start) & mask;
+	uint32_t n = start;
+
+	if(!tp)
+		return 0;
+	do
+	{
+		// a found nonce ends the scan after its batch
+		if(rnd() % 64 == 0)
+			return n - start + tp;
+		n += tp;
+	} while((uint64_t)end > (uint64_t)n + tp);
+	return n - start;
+}
+
+static bool test_space(uint32_t mask, uint32_t throughput, uint32_t key_id, bool set_align)
+{
+	struct test_thread th[TEST_THREADS];
+	std::vector<range> done;
+	uint32_t key[20] = { 0 };
+	const uint64_t align = (uint64_t)(uint32_t)(~mask + 1);
+	const uint64_t space_end = 0xffffffffULL & ~(align - 1);
+	int idle = 0, scans = 0;
+
+	key[0] = key_id;
+	opt_n_threads = TEST_THREADS;
+	for(int i = 0; i < TEST_THREADS; i++)
+	{
+		memset(&th[i], 0, sizeof(th[i]));
+		th[i].aligned = !set_align;
+		// not multiples of anything, so are the chunks
+		th[i].rate = 9.7e6 * (i + 1) + 12345.0 * i + 777.0;
+	}
+
+	while(idle < TEST_THREADS)
+	{
+		if(++scans > TEST_MAX_SCANS)
+		{
+			printf("mask %08x: no end after %d scans\n", mask, TEST_MAX_SCANS);
+			return false;
+		}
+		idle = 0;
+		for(int i = 0; i < TEST_THREADS; i++)
+		{
+			struct test_thread *t = &th[i];
+			if(!t->busy)
+			{
+				if(!nonce_sched_next(i, key, TEST_SECONDS, &t->start, &t->end))
+				{
+					idle++;
+					continue;
+				}
+				t->busy = true;
+				t->clock += (t->end - t->start) / t->rate;
+			}
+		}
+		if(idle == TEST_THREADS)
+			break;
+
+		// the scan which ends first
+		int k = -1;
+		for(int i = 0; i < TEST_THREADS; i++)
+		{
+			if(th[i].busy && (k < 0 || th[i].clock < th[k].clock))
+				k = i;
+		}
+		struct test_thread *t = &th[k];
+		uint32_t hashes = test_scan(t->start, t->end, throughput, mask);
+		if(!hashes)
+		{
+			printf("mask %08x: thread %d got %08x-%08x, less than a batch\n", mask, k, t->start, t->end);
+			return false;
+		}
+		if(t->aligned && ((t->start & ~mask) || (hashes & ~mask)))
+		{
+			printf("mask %08x: thread %d scanned %08x+%08x, not whole batches\n", mask, k, t->start, hashes);
+			return false;
+		}
+		range r = { t->start, (uint64_t)t->start + hashes };
+		done.push_back(r);
+		nonce_sched_done(k, key, t->start, hashes, hashes / t->rate);
+		t->busy = false;
+		if(!t->aligned)
+		{
+			nonce_sched_set_align(k, ~mask + 1);
+			t->aligned = true;
+		}
+	}
+
+	std::sort(done.begin(), done.end());
+	uint64_t pos = 0;
+	for(size_t i = 0; i < done.size(); i++)
+	{
+		if(done[i].start != pos)
+		{
+			printf("mask %08x: %s at %08llx\n", mask, done[i].start < pos ? "overlap" : "hole",
+				(unsigned long long)pos);
+			return false;
+		}
+		pos = done[i].end;
+	}
+	if(pos != space_end)
+	{
+		printf("mask %08x: scanned up to %08llx instead of %08llx\n", mask,
+			(unsigned long long)pos, (unsigned long long)space_end);
+		return false;
+	}
+	printf("mask %08x: %u scans ok\n", mask, (uint32_t)done.size());
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	bool ok = true;
+
+	// first, the alignment of the threads is kept by the scheduler
+	ok &= test_space(0xfffffc00U, 0x40000U + 123, 4, false); // CUDA loop, never set
+	ok &= test_space(0xfffffc00U, 0x40000U + 123, 1, true); // x11
+	ok &= test_space(0xffffffc0U, 0x10000U, 2, true);
+	ok &= test_space(0xffffffffU, 0x30001U, 3, true);
+	return ok ? 0 : 1;
+}
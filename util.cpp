@@ -31,9 +31,16 @@
 #endif
 #include "miner.h"
 #include "elist.h"
+#include "cpu_batch.h"
+extern "C"
+{
+#include "sph/sph_luffa.h"
+}
 using namespace std;
 
 extern enum sha_algos opt_algo;
+extern "C" void whirlxHash(void *state, const void *input);
+extern "C" void c11hash(void *output, const void *input);
 extern char curl_err_str[];
 extern bool stop_mining;
 extern bool send_stale;
@@ -95,82 +102,9 @@ void applog(int prio, const char *fmt, ...)
 	va_list ap;
 
 	va_start(ap, fmt);
-
-#ifdef HAVE_SYSLOG_H
-	if(use_syslog)
-	{
-		va_list ap2;
-		char *buf;
-		int len;
-
-		/* custom colors to syslog prio */
-		if(prio > LOG_DEBUG)
-		{
-			switch(prio)
-			{
-			case LOG_BLUE: prio = LOG_NOTICE; break;
-			}
-		}
-
-		va_copy(ap2, ap);
-		len = vsnprintf(NULL, 0, fmt, ap2) + 1;
-		va_end(ap2);
-		buf = (char*)alloca(len);
-		if(vsnprintf(buf, len, fmt, ap) >= 0)
-			syslog(prio, "%s", buf);
-	}
-#else
-	if(0)
-	{
-	}
-#endif
-	else
-	{
-		const char* color = "";
-		char *f;
-		int len;
-		struct tm tm, *tm_p;
-		time_t now = time(NULL);
-
-		pthread_mutex_lock(&applog_lock);
-		tm_p = localtime(&now);
-		memcpy(&tm, tm_p, sizeof(tm));
-		pthread_mutex_unlock(&applog_lock);
-
-		switch(prio)
-		{
-		case LOG_ERR:     color = CL_RED; break;
-		case LOG_WARNING: color = CL_YLW; break;
-		case LOG_NOTICE:  color = CL_WHT; break;
-		case LOG_INFO:    color = ""; break;
-		case LOG_DEBUG:   color = CL_GRY; break;
-
-		case LOG_BLUE:
-			prio = LOG_NOTICE;
-			color = CL_CYN;
-			break;
-		}
-		if(!use_colors)
-			color = "";
-
-		len = 160 + (int)strlen(fmt) + 2;
-		f = (char*)alloca(len);
-		sprintf(f, "[%d-%02d-%02d %02d:%02d:%02d]%s %s%s\n",
-				tm.tm_year + 1900,
-				tm.tm_mon + 1,
-				tm.tm_mday,
-				tm.tm_hour,
-				tm.tm_min,
-				tm.tm_sec,
-				color,
-				fmt,
-				use_colors ? CL_N : ""
-				);
-		pthread_mutex_lock(&applog_lock);
-		vfprintf(stderr, f, ap);	/* atomic write to stderr */
-		fflush(stderr);
-		pthread_mutex_unlock(&applog_lock);
-	}
+	/* queued for the log writer thread, see logging.cpp */
+	if(!applog_queue(prio, fmt, ap))
+		applog_sync(prio, fmt, ap);
 	va_end(ap);
 }
 
@@ -444,37 +378,44 @@ static int sockopt_keepalive_cb(void *userdata, curl_socket_t fd,
 }
 #endif
 
-json_t *json_rpc_call(CURL *curl, const char *url,
-					  const char *userpass, const char *rpc_req,
-					  bool longpoll_scan, bool longpoll, int *curl_err)
-{
-	json_t *val, *err_val, *res_val;
-	CURLcode rc;
-	struct data_buffer all_data = { 0 };
-	struct upload_buffer upload_data;
-	json_error_t err;
-	struct curl_slist *headers = NULL;
-	char* httpdata;
-	char len_hdr[64], hashrate_hdr[64];
-	long timeout = opt_timeout;
-	struct header_info hi = { 0 };
-	bool lp_scanning = longpoll_scan && !have_longpoll;
+/* the state of one JSON-RPC request, until its answer is decoded */
+struct rpc_call
+{
+	struct data_buffer	all_data;
+	struct upload_buffer	upload_data;
+	struct header_info	hi;
+	struct curl_slist	*headers;
+	char			len_hdr[64];
+	char			hashrate_hdr[64];
+	char			err_str[CURL_ERROR_SIZE];
+	bool			lp_scanning;
+	bool			longpoll;
+};
+
+/*
+ * have_stratum and have_longpoll are tested and set together with the
+ * push to their thread: the requests of a multi batch end one after the
+ * other, only the first X-Stratum or X-Long-Polling answer starts it
+ */
+static pthread_mutex_t rpc_switch_lock = PTHREAD_MUTEX_INITIALIZER;
 
-	/* it is assumed that 'curl' is freshly [re]initialized at this pt */
+/* CURLOPT_PRIVATE of the handles prepared by rpc_prepare() */
+static char rpc_prepared;
 
-	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, curl_err_str);
+/**
+ * Set the options which are the same for all the requests, once per
+ * handle: it is then reused as is and keeps its connection to the node.
+ * A curl_easy_reset() clears the mark and the handle is set up again.
+ */
+static void rpc_prepare(CURL *curl)
+{
+	char *mark = NULL;
+
+	if(curl_easy_getinfo(curl, CURLINFO_PRIVATE, &mark) == CURLE_OK && mark == &rpc_prepared)
+		return;
+	curl_easy_setopt(curl, CURLOPT_PRIVATE, &rpc_prepared);
 	if(opt_protocol)
 		curl_easy_setopt(curl, CURLOPT_VERBOSE, 1);
-	rc = curl_easy_setopt(curl, CURLOPT_URL, url);
-	if(rc != CURLE_OK)
-	{
-		if(strlen(curl_err_str)>0)
-			applog(LOG_ERR, "CURLOPT_URL error: %s", curl_err_str);
-		else
-			applog(LOG_ERR, "CURLOPT_URL error: %s", curl_easy_strerror(rc));
-		curl_easy_reset(curl);
-		return NULL;
-	}
 	if(opt_cert)
 		curl_easy_setopt(curl, CURLOPT_CAINFO, opt_cert);
 	curl_easy_setopt(curl, CURLOPT_ENCODING, "");
@@ -482,61 +423,104 @@ json_t *json_rpc_call(CURL *curl, const char *url,
 	curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1);
 	curl_easy_setopt(curl, CURLOPT_TCP_NODELAY, 1);
 	curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, all_data_cb);
-	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &all_data);
 	curl_easy_setopt(curl, CURLOPT_READFUNCTION, upload_data_cb);
-	curl_easy_setopt(curl, CURLOPT_READDATA, &upload_data);
 #if LIBCURL_VERSION_NUM >= 0x071200
 	curl_easy_setopt(curl, CURLOPT_SEEKFUNCTION, &seek_data_cb);
-	curl_easy_setopt(curl, CURLOPT_SEEKDATA, &upload_data);
 #endif
 	curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1);
-	curl_easy_setopt(curl, CURLOPT_TIMEOUT, timeout);
+	curl_easy_setopt(curl, CURLOPT_TIMEOUT, (long)opt_timeout);
 	curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, resp_hdr_cb);
-	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &hi);
 	if(opt_proxy)
 	{
 		curl_easy_setopt(curl, CURLOPT_PROXY, opt_proxy);
 		curl_easy_setopt(curl, CURLOPT_PROXYTYPE, opt_proxy_type);
 	}
-	if(userpass)
+	curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+	curl_easy_setopt(curl, CURLOPT_POST, 1);
+}
+
+static void rpc_call_free(struct rpc_call *c)
+{
+	free(c->hi.lp_path);
+	free(c->hi.reason);
+	free(c->hi.stratum_url);
+	databuf_free(&c->all_data);
+	curl_slist_free_all(c->headers);
+}
+
+/* set up 'curl' for the request, false if the url is not valid */
+static bool rpc_call_begin(CURL *curl, struct rpc_call *c, const char *url,
+						   const char *userpass, const char *rpc_req,
+						   bool longpoll_scan, bool longpoll)
+{
+	CURLcode rc;
+
+	memset(c, 0, sizeof(*c));
+	c->lp_scanning = longpoll_scan && !have_longpoll;
+	c->longpoll = longpoll;
+
+	rpc_prepare(curl);
+	curl_easy_setopt(curl, CURLOPT_ERRORBUFFER, c->err_str);
+	rc = curl_easy_setopt(curl, CURLOPT_URL, url);
+	if(rc != CURLE_OK)
 	{
-		curl_easy_setopt(curl, CURLOPT_USERPWD, userpass);
-		curl_easy_setopt(curl, CURLOPT_HTTPAUTH, CURLAUTH_BASIC);
+		if(strlen(c->err_str)>0)
+			applog(LOG_ERR, "CURLOPT_URL error: %s", c->err_str);
+		else
+			applog(LOG_ERR, "CURLOPT_URL error: %s", curl_easy_strerror(rc));
+		curl_easy_reset(curl);
+		return false;
 	}
+	curl_easy_setopt(curl, CURLOPT_WRITEDATA, &c->all_data);
+	curl_easy_setopt(curl, CURLOPT_READDATA, &c->upload_data);
+#if LIBCURL_VERSION_NUM >= 0x071200
+	curl_easy_setopt(curl, CURLOPT_SEEKDATA, &c->upload_data);
+#endif
+	curl_easy_setopt(curl, CURLOPT_HEADERDATA, &c->hi);
+	curl_easy_setopt(curl, CURLOPT_USERPWD, userpass);
 #if LIBCURL_VERSION_NUM >= 0x070f06
-	if(longpoll)
-		curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, sockopt_keepalive_cb);
+	curl_easy_setopt(curl, CURLOPT_SOCKOPTFUNCTION, longpoll ? sockopt_keepalive_cb : NULL);
 #endif
-	curl_easy_setopt(curl, CURLOPT_POST, 1);
 
 	if(opt_protocol)
 		applog(LOG_DEBUG, "JSON protocol request:\n%s", rpc_req);
 
-	upload_data.buf = rpc_req;
-	upload_data.len = strlen(rpc_req);
-	upload_data.pos = 0;
-	sprintf(len_hdr, "Content-Length: %lu", (unsigned long)upload_data.len);
-	sprintf(hashrate_hdr, "X-Mining-Hashrate: %llu", (unsigned long long) global_hashrate);
-
-	headers = curl_slist_append(headers, "Content-Type: application/json");
-	headers = curl_slist_append(headers, len_hdr);
-	headers = curl_slist_append(headers, "User-Agent: " USER_AGENT);
-	headers = curl_slist_append(headers, "X-Mining-Extensions: longpoll noncerange reject-reason");
-	headers = curl_slist_append(headers, hashrate_hdr);
-	headers = curl_slist_append(headers, "Accept:"); /* disable Accept hdr*/
-	headers = curl_slist_append(headers, "Expect:"); /* disable Expect hdr*/
-
-	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-	curl_err_str[0] = 0;
-	rc = curl_easy_perform(curl);
+	c->upload_data.buf = rpc_req;
+	c->upload_data.len = strlen(rpc_req);
+	c->upload_data.pos = 0;
+	/* known size, else newer libcurl sends it chunked */
+	curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)c->upload_data.len);
+	sprintf(c->len_hdr, "Content-Length: %lu", (unsigned long)c->upload_data.len);
+	sprintf(c->hashrate_hdr, "X-Mining-Hashrate: %llu", (unsigned long long) global_hashrate);
+
+	c->headers = curl_slist_append(c->headers, "Content-Type: application/json");
+	c->headers = curl_slist_append(c->headers, c->len_hdr);
+	c->headers = curl_slist_append(c->headers, "User-Agent: " USER_AGENT);
+	c->headers = curl_slist_append(c->headers, "X-Mining-Extensions: longpoll noncerange reject-reason");
+	c->headers = curl_slist_append(c->headers, c->hashrate_hdr);
+	c->headers = curl_slist_append(c->headers, "Accept:"); /* disable Accept hdr*/
+	c->headers = curl_slist_append(c->headers, "Expect:"); /* disable Expect hdr*/
+
+	curl_easy_setopt(curl, CURLOPT_HTTPHEADER, c->headers);
+	c->err_str[0] = 0;
+	return true;
+}
+
+/* decode the answer of a performed request, NULL on error */
+static json_t *rpc_call_end(CURL *curl, struct rpc_call *c, CURLcode rc, int *curl_err)
+{
+	json_t *val, *err_val, *res_val;
+	json_error_t err;
+	char* httpdata;
+
 	if(curl_err != NULL)
 		*curl_err = rc;
 	if(rc != CURLE_OK)
 	{
-		if(!(longpoll && rc == CURLE_OPERATION_TIMEDOUT))
+		if(!(c->longpoll && rc == CURLE_OPERATION_TIMEDOUT))
 		{
-			if(strlen(curl_err_str)>0)
-				applog(LOG_ERR, "HTTP request failed: %s", curl_err_str);
+			if(strlen(c->err_str)>0)
+				applog(LOG_ERR, "HTTP request failed: %s", c->err_str);
 			else
 				applog(LOG_ERR, "HTTP request failed: %s", curl_easy_strerror(rc));
 			goto err_out;
@@ -544,36 +528,46 @@ json_t *json_rpc_call(CURL *curl, const char *url,
 	}
 
 	/* If X-Stratum was found, activate Stratum */
-	if(want_stratum && hi.stratum_url &&
-	   !strncasecmp(hi.stratum_url, "stratum+tcp://", 14) &&
+	if(want_stratum && c->hi.stratum_url &&
+	   !strncasecmp(c->hi.stratum_url, "stratum+tcp://", 14) &&
 	   !(opt_proxy && opt_proxy_type == CURLPROXY_HTTP))
 	{
-		have_stratum = true;
-		tq_push(thr_info[stratum_thr_id].q, hi.stratum_url);
-		hi.stratum_url = NULL;
+		pthread_mutex_lock(&rpc_switch_lock);
+		if(!have_stratum)
+		{
+			have_stratum = true;
+			tq_push(thr_info[stratum_thr_id].q, c->hi.stratum_url);
+			c->hi.stratum_url = NULL;
+		}
+		pthread_mutex_unlock(&rpc_switch_lock);
 	}
 
 	/* If X-Long-Polling was found, activate long polling */
-	if(lp_scanning && hi.lp_path && !have_stratum)
+	if(c->lp_scanning && c->hi.lp_path)
 	{
-		have_longpoll = true;
-		tq_push(thr_info[longpoll_thr_id].q, hi.lp_path);
-		hi.lp_path = NULL;
+		pthread_mutex_lock(&rpc_switch_lock);
+		if(!have_stratum && !have_longpoll)
+		{
+			have_longpoll = true;
+			tq_push(thr_info[longpoll_thr_id].q, c->hi.lp_path);
+			c->hi.lp_path = NULL;
+		}
+		pthread_mutex_unlock(&rpc_switch_lock);
 	}
 
-	if(!all_data.buf || !all_data.len)
+	if(!c->all_data.buf || !c->all_data.len)
 	{
 		applog(LOG_ERR, "Empty data received in json_rpc_call.");
 		goto err_out;
 	}
 
-	httpdata = (char*)all_data.buf;
+	httpdata = (char*)c->all_data.buf;
 
 	if(*httpdata != '{' && *httpdata != '[')
 	{
 		long errcode = 0;
-		CURLcode c = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &errcode);
-		if(c == CURLE_OK && errcode == 401)
+		CURLcode cc = curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &errcode);
+		if(cc == CURLE_OK && errcode == 401)
 		{
 			applog(LOG_ERR, "You are not authorized, check your login and password.");
 			goto err_out;
@@ -638,24 +632,98 @@ json_t *json_rpc_call(CURL *curl, const char *url,
 		goto err_out;
 	}
 
-	if(hi.reason)
-		json_object_set_new(val, "reject-reason", json_string(hi.reason));
+	if(c->hi.reason)
+		json_object_set_new(val, "reject-reason", json_string(c->hi.reason));
 
-	databuf_free(&all_data);
-	curl_slist_free_all(headers);
-	curl_easy_reset(curl);
+	/* the handle stays set up, with its connection */
+	rpc_call_free(c);
 	return val;
 
 err_out:
-	free(hi.lp_path);
-	free(hi.reason);
-	free(hi.stratum_url);
-	databuf_free(&all_data);
-	curl_slist_free_all(headers);
+	rpc_call_free(c);
 	curl_easy_reset(curl);
 	return NULL;
 }
 
+json_t *json_rpc_call(CURL *curl, const char *url,
+					  const char *userpass, const char *rpc_req,
+					  bool longpoll_scan, bool longpoll, int *curl_err)
+{
+	struct rpc_call c;
+
+	if(!rpc_call_begin(curl, &c, url, userpass, rpc_req, longpoll_scan, longpoll))
+		return NULL;
+	return rpc_call_end(curl, &c, curl_easy_perform(curl), curl_err);
+}
+
+/**
+ * Issue 'count' requests at once, each on its own handle, and wait for
+ * all the answers: r[i].val is the result of json_rpc_call() for each.
+ * The handles keep their connections in 'multi' between the calls.
+ */
+void json_rpc_call_multi(CURLM *multi, const char *url, const char *userpass,
+						 struct rpc_request *r, int count, bool longpoll_scan)
+{
+#if LIBCURL_VERSION_NUM >= 0x071c00
+	struct rpc_call c[RPC_MAX_REQUESTS];
+	CURLcode rc[RPC_MAX_REQUESTS];
+	bool started[RPC_MAX_REQUESTS];
+	CURLMsg *msg;
+	int running = 0, left;
+
+	if(!multi || count > RPC_MAX_REQUESTS)
+#endif
+	{
+		for(int i = 0; i < count; i++)
+			r[i].val = json_rpc_call(r[i].curl, url, userpass, r[i].rpc_req, longpoll_scan, false, r[i].curl_err);
+		return;
+	}
+
+#if LIBCURL_VERSION_NUM >= 0x071c00
+	for(int i = 0; i < count; i++)
+	{
+		r[i].val = NULL;
+		rc[i] = CURLE_FAILED_INIT;
+		started[i] = rpc_call_begin(r[i].curl, &c[i], url, userpass, r[i].rpc_req, longpoll_scan, false);
+		if(started[i] && curl_multi_add_handle(multi, r[i].curl) != CURLM_OK)
+		{
+			rpc_call_free(&c[i]);
+			curl_easy_reset(r[i].curl);
+			started[i] = false;
+		}
+	}
+
+	do
+	{
+		CURLMcode mc = curl_multi_perform(multi, &running);
+		if(mc != CURLM_OK)
+		{
+			applog(LOG_ERR, "HTTP request failed: %s", curl_multi_strerror(mc));
+			break;
+		}
+		if(running)
+			curl_multi_wait(multi, NULL, 0, 1000, NULL);
+	} while(running);
+
+	while((msg = curl_multi_info_read(multi, &left)) != NULL)
+	{
+		for(int i = 0; i < count && msg->msg == CURLMSG_DONE; i++)
+		{
+			if(r[i].curl == msg->easy_handle)
+				rc[i] = msg->data.result;
+		}
+	}
+
+	for(int i = 0; i < count; i++)
+	{
+		if(!started[i])
+			continue;
+		curl_multi_remove_handle(multi, r[i].curl);
+		r[i].val = rpc_call_end(r[i].curl, &c[i], rc[i], r[i].curl_err);
+	}
+#endif
+}
+
 /**
 * Unlike malloc, calloc set the memory to zero
 */
@@ -696,11 +764,7 @@ void aligned_free(void *ptr)
 void cbin2hex(char *out, const char *in, size_t len)
 {
 	if(out)
-	{
-		unsigned int i;
-		for(i = 0; i < len; i++)
-			sprintf(out + (i * 2), "%02x", (uint8_t)in[i]);
-	}
+		hex_encode(out, in, len);
 }
 
 char *bin2hex(const uchar *in, size_t len)
@@ -712,39 +776,30 @@ char *bin2hex(const uchar *in, size_t len)
 		proper_exit(2);
 	}
 
-	cbin2hex(s, (const char *)in, len);
+	hex_encode(s, in, len);
 
 	return s;
 }
 
 bool hex2bin(uchar *p, const char *hexstr, size_t len)
 {
-	char hex_byte[3];
-	char *ep;
-
-	hex_byte[2] = '\0';
+	// a longer string is decoded up to len but fails
+	size_t n = strnlen(hexstr, 2 * len + 1);
+	size_t pairs = min(n / 2, len);
+	size_t done = hex_decode(p, hexstr, pairs);
 
-	while(*hexstr && len)
+	if(done < pairs)
 	{
-		if(!hexstr[1])
-		{
-			applog(LOG_ERR, "hex2bin str truncated");
-			return false;
-		}
-		hex_byte[0] = hexstr[0];
-		hex_byte[1] = hexstr[1];
-		*p = (uchar)strtol(hex_byte, &ep, 16);
-		if(*ep)
-		{
-			applog(LOG_ERR, "hex2bin failed on '%s'", hex_byte);
-			return false;
-		}
-		p++;
-		hexstr += 2;
-		len--;
+		applog(LOG_ERR, "hex2bin failed on '%.2s'", hexstr + 2 * done);
+		return false;
+	}
+	if(pairs < len && (n & 1))
+	{
+		applog(LOG_ERR, "hex2bin str truncated");
+		return false;
 	}
 
-	return (len == 0 && *hexstr == 0) ? true : false;
+	return (pairs == len && n == 2 * len) ? true : false;
 }
 
 /* Subtract the `struct timeval' values X and Y,
@@ -1499,43 +1554,31 @@ static uint32_t getblocheight(struct stratum_ctx *sctx)
 	return height;
 }
 
-static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
+static bool stratum_notify_set(struct stratum_ctx *sctx, const struct stratum_notify_msg *n)
 {
-	const char *job_id, *prevhash, *coinb1, *coinb2, *version, *nbits, *nreward;
-	char *stime;
+	const struct json_span *stime = &n->ntime;
+	struct json_span version = n->version;
 	size_t coinb1_size, coinb2_size;
-	bool clean, ret = false;
-	int merkle_count, i;
-	json_t *merkle_arr;
+	bool ret = false;
+	int merkle_count = n->merkle_count, i;
 	uchar **merkle = NULL;
 	int32_t ntime;
 
-	job_id = json_string_value(json_array_get(params, 0));
-	prevhash = json_string_value(json_array_get(params, 1));
-	coinb1 = json_string_value(json_array_get(params, 2));
-	coinb2 = json_string_value(json_array_get(params, 3));
-	merkle_arr = json_array_get(params, 4);
-	if(!merkle_arr || !json_is_array(merkle_arr))
-		goto out;
-	merkle_count = (int)json_array_size(merkle_arr);
-	if(opt_algo != ALGO_SIA)
-		version = json_string_value(json_array_get(params, 5));
-	else
-		version = "00000001"; //unused
-	nbits = json_string_value(json_array_get(params, 6));
-	stime = (char *)json_string_value(json_array_get(params, 7));
-	clean = json_is_true(json_array_get(params, 8));
-	nreward = json_string_value(json_array_get(params, 9));
+	if(opt_algo == ALGO_SIA)
+	{
+		version.s = "00000001"; //unused
+		version.len = 8;
+	}
 
-	if(!job_id || !prevhash || !coinb1 || !coinb2 || !version || !nbits || !stime ||
-		 strlen(prevhash) != 64 || strlen(version) != 8 || strlen(nbits) != 8)
+	if(!n->job_id.s || !n->prevhash.s || !n->coinb1.s || !n->coinb2.s || !version.s || !n->nbits.s || !stime->s ||
+		 n->prevhash.len != 64 || version.len != 8 || n->nbits.len != 8)
 	{
 		applog(LOG_ERR, "Stratum notify: invalid parameters");
 		goto out;
 	}
 	if(opt_algo == ALGO_SIA)
 	{
-		if(strlen(stime) != 16)
+		if(stime->len != 16)
 		{
 			applog(LOG_ERR, "Stratum notify: invalid time parameter");
 			goto out;
@@ -1543,7 +1586,7 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 	}
 	else
 	{
-		if(strlen(stime) != 8)
+		if(stime->len != 8)
 		{
 			applog(LOG_ERR, "Stratum notify: invalid time parameter");
 			goto out;
@@ -1551,7 +1594,7 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 	}
 
 	/* store stratum server time diff */
-	hex2bin((uchar *)&ntime, stime, 4);
+	json_span_hex((uchar *)&ntime, stime, 4);
 	if(opt_algo!=ALGO_SIA)
 		ntime = swab32(ntime) - (uint32_t)time(0);
 	else
@@ -1577,8 +1620,7 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 	}
 	for(i = 0; i < merkle_count; i++)
 	{
-		const char *s = json_string_value(json_array_get(merkle_arr, i));
-		if(!s || strlen(s) != 64)
+		if(!n->merkle[i].s || n->merkle[i].len != 64)
 		{
 			while(i--)
 				free(merkle[i]);
@@ -1593,11 +1635,11 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 			applog(LOG_ERR, "Out of memory!");
 			proper_exit(2);
 		}
-		hex2bin(merkle[i], s, 32);
+		json_span_hex(merkle[i], &n->merkle[i], 32);
 	}
 
-	coinb1_size = strlen(coinb1) / 2;
-	coinb2_size = strlen(coinb2) / 2;
+	coinb1_size = n->coinb1.len / 2;
+	coinb2_size = n->coinb2.len / 2;
 	sctx->job.coinbase_size = coinb1_size + sctx->xnonce1_size +
 		sctx->xnonce2_size + coinb2_size;
 
@@ -1608,16 +1650,26 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 		proper_exit(2);
 	}
 	sctx->job.xnonce2 = sctx->job.coinbase + coinb1_size + sctx->xnonce1_size;
-	hex2bin(sctx->job.coinbase, coinb1, coinb1_size);
+	json_span_hex(sctx->job.coinbase, &n->coinb1, coinb1_size);
 	memcpy(sctx->job.coinbase + coinb1_size, sctx->xnonce1, sctx->xnonce1_size);
 
-	if(!sctx->job.job_id || strcmp(sctx->job.job_id, job_id))
+	if(!sctx->job.job_id || strlen(sctx->job.job_id) != n->job_id.len || memcmp(sctx->job.job_id, n->job_id.s, n->job_id.len))
 		memset(sctx->job.xnonce2, 0, sctx->xnonce2_size);
-	hex2bin(sctx->job.xnonce2 + sctx->xnonce2_size, coinb2, coinb2_size);
+	json_span_hex(sctx->job.xnonce2 + sctx->xnonce2_size, &n->coinb2, coinb2_size);
+	// the coinbase blocks before the extranonce2 are the same for all the workers
+	sctx->job.coinbase_midlen = (coinb1_size + sctx->xnonce1_size) & ~(size_t)63;
+	sha256_midstate(sctx->job.coinbase_midstate, sctx->job.coinbase, (int)sctx->job.coinbase_midlen);
 
 	free(sctx->job.job_id);
-	sctx->job.job_id = strdup(job_id);
-	hex2bin(sctx->job.prevhash, prevhash, 32);
+	sctx->job.job_id = (char*)malloc(n->job_id.len + 1);
+	if(sctx->job.job_id == NULL)
+	{
+		applog(LOG_ERR, "Out of memory!");
+		proper_exit(2);
+	}
+	memcpy(sctx->job.job_id, n->job_id.s, n->job_id.len);
+	sctx->job.job_id[n->job_id.len] = '\0';
+	json_span_hex(sctx->job.prevhash, &n->prevhash, 32);
 
 	if(opt_algo != ALGO_SIA)
 		sctx->job.height = getblocheight(sctx);
@@ -1630,18 +1682,19 @@ static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 	sctx->job.merkle = merkle;
 	sctx->job.merkle_count = merkle_count;
 
-	hex2bin(sctx->job.version, version, 4);
-	hex2bin(sctx->job.nbits, nbits, 4);
-	hex2bin(sctx->job.ntime, stime, 4);
-	if(nreward != NULL)
+	json_span_hex(sctx->job.version, &version, 4);
+	json_span_hex(sctx->job.nbits, &n->nbits, 4);
+	json_span_hex(sctx->job.ntime, stime, 4);
+	if(n->nreward.s)
 	{
-		if(strlen(nreward) == 4)
-			hex2bin(sctx->job.nreward, nreward, 2);
+		if(n->nreward.len == 4)
+			json_span_hex(sctx->job.nreward, &n->nreward, 2);
 	}
-	sctx->job.clean = clean;
-	send_stale = !clean;
+	sctx->job.clean = n->clean;
+	send_stale = !n->clean;
 
 	sctx->job.diff = sctx->next_diff;
+	gettimeofday(&sctx->job.tv_received, NULL);
 
 	pthread_mutex_unlock(&sctx->work_lock);
 
@@ -1651,12 +1704,45 @@ out:
 	return ret;
 }
 
-extern time_t g_work_time;
-static bool stratum_set_difficulty(struct stratum_ctx *sctx, json_t *params)
+static void json_span_string(struct json_span *v, const json_t *val)
+{
+	v->s = json_string_value(val);
+	v->len = v->s ? strlen(v->s) : 0;
+}
+
+static bool stratum_notify(struct stratum_ctx *sctx, json_t *params)
 {
-	double diff;
+	struct stratum_notify_msg n;
+	json_t *merkle_arr;
 
-	diff = json_number_value(json_array_get(params, 0));
+	memset(&n, 0, sizeof(n));
+	json_span_string(&n.job_id, json_array_get(params, 0));
+	json_span_string(&n.prevhash, json_array_get(params, 1));
+	json_span_string(&n.coinb1, json_array_get(params, 2));
+	json_span_string(&n.coinb2, json_array_get(params, 3));
+	merkle_arr = json_array_get(params, 4);
+	if(!merkle_arr || !json_is_array(merkle_arr))
+		return false;
+	n.merkle_count = (int)json_array_size(merkle_arr);
+	if(n.merkle_count > STRATUM_MAX_MERKLE)
+	{
+		applog(LOG_ERR, "Stratum notify: invalid Merkle branch");
+		return false;
+	}
+	for(int i = 0; i < n.merkle_count; i++)
+		json_span_string(&n.merkle[i], json_array_get(merkle_arr, i));
+	json_span_string(&n.version, json_array_get(params, 5));
+	json_span_string(&n.nbits, json_array_get(params, 6));
+	json_span_string(&n.ntime, json_array_get(params, 7));
+	n.clean = json_is_true(json_array_get(params, 8));
+	json_span_string(&n.nreward, json_array_get(params, 9));
+
+	return stratum_notify_set(sctx, &n);
+}
+
+extern time_t g_work_time;
+static bool stratum_set_diff(struct stratum_ctx *sctx, double diff)
+{
 	if(diff <= 0.0)
 		return false;
 
@@ -1675,6 +1761,47 @@ static bool stratum_set_difficulty(struct stratum_ctx *sctx, json_t *params)
 	return true;
 }
 
+static bool stratum_set_difficulty(struct stratum_ctx *sctx, json_t *params)
+{
+	return stratum_set_diff(sctx, json_number_value(json_array_get(params, 0)));
+}
+
+/* the frequent methods without jansson, -1 if the line needs it */
+static int stratum_handle_fast(struct stratum_ctx *sctx, const char *s)
+{
+	struct stratum_line m;
+
+	if(!stratum_parse_line(s, &m))
+		return -1;
+	if(!m.method.s)
+		return 0; // an answer
+	if(stratum_method_is(&m, "mining.notify"))
+	{
+		struct stratum_notify_msg n;
+		if(stratum_parse_notify(&m.params, &n))
+			return stratum_notify_set(sctx, &n);
+	}
+	else if(stratum_method_is(&m, "mining.set_difficulty"))
+	{
+		const char *p = m.params.s;
+		struct json_span v;
+		double diff;
+		// [diff]
+		if(p && m.params.len > 2 && p[0] == '[' && p[m.params.len - 1] == ']')
+		{
+			v.s = p + 1;
+			v.len = m.params.len - 2;
+			while(v.len && strchr(" \t\r\n", *v.s))
+				v.s++, v.len--;
+			while(v.len && strchr(" \t\r\n", v.s[v.len - 1]))
+				v.len--;
+			if(json_span_number(&v, &diff))
+				return stratum_set_diff(sctx, diff);
+		}
+	}
+	return -1;
+}
+
 static bool stratum_reconnect(struct stratum_ctx *sctx, json_t *params)
 {
 	json_t *port_val;
@@ -1924,6 +2051,11 @@ bool stratum_handle_method(struct stratum_ctx *sctx, const char *s)
 	json_error_t err;
 	const char *method;
 	bool ret = false;
+	int fast;
+
+	fast = stratum_handle_fast(sctx, s);
+	if(fast >= 0)
+		return fast > 0;
 
 	val = JSON_LOADS(s, &err);
 	if(!val)
@@ -2215,6 +2347,37 @@ void do_gpu_tests(void)
 #endif
 }
 
+static void jackpothash_ref(void *state, const void *input)
+{
+	jackpothash(state, input);
+}
+
+/**
+ * SPH_ROTL32 and SPH_ROTR32 inside an expression: without the outer
+ * parentheses "ROTL32(u, 2) ^ v" of sph/luffa.c xors v into the right
+ * shift only and Luffa is wrong
+ */
+static bool sph_rotate_selftest(void)
+{
+	static const uchar luffa512_abc[64] = {
+		0xf4, 0x02, 0x45, 0x97, 0x3e, 0x80, 0xd7, 0x9d, 0x0f, 0x4b, 0x9b, 0x20, 0x2d, 0xdd, 0x45, 0x05,
+		0xb8, 0x1b, 0x88, 0x30, 0x50, 0x1b, 0xea, 0x31, 0x61, 0x2b, 0x58, 0x17, 0xaa, 0xe3, 0x87, 0x92,
+		0x1d, 0xce, 0xfd, 0x80, 0x8c, 0xa2, 0xc7, 0x80, 0x20, 0xaf, 0xf5, 0x93, 0x45, 0xd6, 0xf9, 0x1f,
+		0x0e, 0xe6, 0xb2, 0xee, 0xe1, 0x13, 0xf0, 0xcb, 0xcf, 0x22, 0xb6, 0x43, 0x81, 0x38, 0x7e, 0x8a
+	};
+	volatile sph_u32 x = 0x12345678, y = 0xff00ff00;
+	sph_luffa512_context ctx;
+	uchar hash[64];
+
+	bool ok = (SPH_ROTL32(x, 8) ^ y) == 0xcb568712 && (SPH_ROTR32(x, 8) ^ y) == 0x8712cb56;
+	sph_luffa512_init(&ctx);
+	sph_luffa512(&ctx, "abc", 3);
+	sph_luffa512_close(&ctx, hash);
+	ok = ok && !memcmp(hash, luffa512_abc, 64);
+	printf("%12s: %s\n", "sph rotate", ok ? "ok" : "mismatch");
+	return ok;
+}
+
 void print_hash_tests(void)
 {
 	char s[128] = { '\0' };
@@ -2313,13 +2476,38 @@ void print_hash_tests(void)
 
 	printf("\n");
 
+	printf(CL_WHT "CPU BATCH ENGINE CHECKS:" CL_N "\n");
+	cpu_batch_init();
+	printf("kernels: %s\n", cpu_batch_level());
+	sph_rotate_selftest();
+	cpu_batch_selftest("quark", quark_cpu_hash, quarkhash, 4096);
+	cpu_batch_selftest("jackpot", jackpot_cpu_hash, jackpothash_ref, 4096);
+	cpu_batch_selftest("x11", x11_cpu_hash, x11hash, 4096);
+	cpu_batch_selftest("blakecoin", blake256_8_cpu_hash, blake256hash_8, 4099);
+	cpu_batch_selftest("blake", blake256_14_cpu_hash, blake256hash_14, 4099);
+	cpu_batch_selftest("keccak", keccak256_cpu_hash, keccak256_hash, 4099);
+	cpu_batch_selftest("whirl", whc_cpu_hash, wcoinhash, 4099);
+	cpu_batch_selftest("whirlpoolx", whirlpoolx_cpu_hash, whirlxHash, 4099);
+	cpu_batch_selftest("x13", x13_cpu_hash, x13hash, 4096);
+	cpu_batch_selftest("x15", x15_cpu_hash, x15hash, 4096);
+	cpu_batch_selftest("x17", x17_cpu_hash, x17hash, 4096);
+	cpu_batch_selftest("c11", c11_cpu_hash, c11hash, 4096);
+	cpu_batch_selftest("qubit", qubit_cpu_hash, qubithash, 4099);
+	cpu_batch_selftest("deep", deep_cpu_hash, deephash, 4099);
+	cpu_batch_selftest("doom", doom_cpu_hash, doomhash, 4099);
+	cpu_batch_selftest("groestl", groestl_cpu_hash, groestlhash, 4099);
+	cpu_batch_selftest("myr-gr", myriad_cpu_hash, myriadhash, 4099);
+	cpu_batch_selftest("skein", skein_cpu_hash, skeincoinhash, 4099);
+	cpu_kernels_selftest(67);
+
+	printf("\n");
+
 	do_gpu_tests();
 }
 
 void bin2hex(char *s, const unsigned char *p, size_t len)
 {
-	for(size_t i = 0; i < len; i++)
-		sprintf(s + (i * 2), "%02x", (unsigned int)p[i]);
+	hex_encode(s, p, len);
 }
 
 char *abin2hex(const unsigned char *p, size_t len)
@@ -15,6 +15,7 @@ extern "C"
 }
 
 #include "miner.h"
+#include "scan.h"
 //#include <cuda.h>
 //#include <cuda_runtime.h>
 #include "cuda_helper.h"
@@ -125,12 +126,27 @@ extern "C" void c11hash(void *output, const void *input)
 		memcpy(output, hash, 32);
 }
 
+/* scanner of the cpu backend (x11/cpu_c11.cpp), the GPU loop is below */
+static const struct scan_algo c11_scan = {
+	"c11",
+	c11hash,
+	0x4f,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	c11_cpu_hash,
+	NULL
+};
+
 static THREAD uint32_t *d_hash = nullptr;
 
 int scanhash_c11(int thr_id, uint32_t *pdata,
 				 uint32_t *ptarget, uint32_t max_nonce,
 				 uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &c11_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	uint32_t foundnonces[2];
 	const uint32_t first_nonce = pdata[19];
 
@@ -0,0 +1,23 @@
+/**
+ * C11 on the cpu, batched
+ *
+ * The x11 stages with jh512 and keccak512 before skein512, as c11hash().
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void c11_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.blake512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.bmw512(l->hash, l->count);
+	cpu_hash.groestl512(l->hash, l->count);
+	cpu_hash.jh512(l->hash, l->count);
+	cpu_hash.keccak512(l->hash, l->count);
+	cpu_hash.skein512(l->hash, l->count);
+	cpu_hash.luffa_cubehash512(l->hash, l->count);
+	cpu_hash.shavite512(l->hash, l->count);
+	cpu_hash.simd512(l->hash, l->count);
+	cpu_hash.echo512(l->hash, l->count);
+}
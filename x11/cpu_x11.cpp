@@ -0,0 +1,24 @@
+/**
+ * X11 on the cpu, batched
+ *
+ * Same stages as x11hash(), no branch: each kernel runs on all the lanes.
+ * Luffa and CubeHash are one stage, as on the GPU.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void x11_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.blake512_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.bmw512(l->hash, l->count);
+	cpu_hash.groestl512(l->hash, l->count);
+	cpu_hash.skein512(l->hash, l->count);
+	cpu_hash.jh512(l->hash, l->count);
+	cpu_hash.keccak512(l->hash, l->count);
+	cpu_hash.luffa_cubehash512(l->hash, l->count);
+	cpu_hash.shavite512(l->hash, l->count);
+	cpu_hash.simd512(l->hash, l->count);
+	cpu_hash.echo512(l->hash, l->count);
+}
@@ -18,6 +18,7 @@ extern "C"
 //#include <cuda.h>
 //#include <cuda_runtime.h>
 #include "cuda_helper.h"
+#include "scan.h"
 
 #include <stdio.h>
 #include <memory.h>
@@ -128,142 +129,88 @@ void x11hash(void *output, const void *input)
 	memcpy(output, hash, 32);
 }
 
-extern int scanhash_x11(int thr_id, uint32_t *pdata,
-    uint32_t *ptarget, uint32_t max_nonce,
-    uint32_t *hashes_done)
+static void x11_gpu_init(int thr_id, uint32_t threads)
 {
-	static THREAD uint32_t *d_hash = nullptr;
-	static THREAD uint32_t *h_found = nullptr;
+	quark_groestl512_cpu_init(thr_id, threads);
+	quark_bmw512_cpu_init(thr_id, threads);
+	x11_echo512_cpu_init(thr_id, threads);
+	x11_simd512_cpu_init(thr_id, threads);
+}
 
-	const uint32_t first_nonce = pdata[19];
+static void x11_gpu_set_block(int thr_id, uint32_t *endiandata)
+{
+	quark_blake512_cpu_setBlock_80(thr_id, (uint64_t *)endiandata);
+}
 
-	cudaDeviceProp props;
-	CUDA_SAFE_CALL(cudaGetDeviceProperties(&props, device_map[thr_id]));
-	static THREAD uint32_t throughputmax;
+static void x11_bmw512(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash)
+{
+	quark_bmw512_cpu_hash_64(thr_id, threads, startNounce, NULL, d_hash);
+}
 
-	if (opt_benchmark)
-		ptarget[7] = 0x4f;
+static void x11_groestl512(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash)
+{
+	quark_groestl512_cpu_hash_64(thr_id, threads, startNounce, NULL, d_hash);
+}
 
-	static THREAD volatile bool init = false;
-	if(!init)
-	{
-		CUDA_SAFE_CALL(cudaSetDevice(device_map[thr_id]));
-		CUDA_SAFE_CALL(cudaDeviceReset());
-		CUDA_SAFE_CALL(cudaSetDeviceFlags(cudaDeviceScheduleBlockingSync));
-		CUDA_SAFE_CALL(cudaDeviceSetCacheConfig(cudaFuncCachePreferL1));
-		CUDA_SAFE_CALL(cudaStreamCreate(&gpustream[thr_id]));
+static void x11_skein512(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash)
+{
+	quark_skein512_cpu_hash_64(thr_id, threads, startNounce, NULL, d_hash);
+}
 
-		unsigned int intensity;
+static void x11_simd512(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash)
+{
+	uint32_t simdthreads = (device_sm[device_map[thr_id]] > 500) ? 256 : 32;
+	x11_simd512_cpu_hash_64(thr_id, threads, startNounce, d_hash, simdthreads);
+}
+
+static void x11_echo512_final(int thr_id, uint32_t threads, uint32_t startNounce, uint32_t *d_hash, uint32_t target, uint32_t *h_found)
+{
+	x11_echo512_cpu_hash_64_final(thr_id, threads, startNounce, d_hash, target, h_found);
+}
+
+static const scan_gpu_stage_fn x11_stages[] = {
+	quark_blake512_cpu_hash_80,
+	x11_bmw512,
+	x11_groestl512,
+	x11_skein512,
+	cuda_jh512Keccak512_cpu_hash_64,
+	x11_luffaCubehash512_cpu_hash_64,
+	x11_shavite512_cpu_hash_64,
+	x11_simd512,
+	NULL
+};
+
+static const struct scan_intensity x11_intensity[] = {
 #if defined WIN32 && !defined _WIN64
-		intensity = 256 * 256 * 16;
+	{ NULL, 256 * 256 * 16 }
 #else
-		if(strstr(props.name, "Titan"))		  intensity = (256 * 256 * 22);
-		else if(strstr(props.name, "970"))	  intensity = (256 * 256 * 22);
-		else if(strstr(props.name, "980"))    intensity = (256 * 256 * 22);
-		else if(strstr(props.name, "1070"))   intensity = (256 * 256 * 22);
-		else if(strstr(props.name, "1080"))   intensity = (256 * 256 * 22);
-		else if(strstr(props.name, "750 Ti")) intensity = (256 * 256 * 20);
-		else if(strstr(props.name, "750"))    intensity = (256 * 256 * 19);
-		else if(strstr(props.name, "960"))    intensity = (256 * 256 * 19);
-		else intensity = (256 * 256 * 19);
-#endif
-		throughputmax = device_intensity(device_map[thr_id], __func__, intensity);
-		if(throughputmax == intensity)
-			applog(LOG_INFO, "GPU #%d: using default intensity %.3f", device_map[thr_id], throughput2intensity(throughputmax));
-#if defined WIN32 && !defined _WIN64
-		// 2GB limit for cudaMalloc
-		if(throughputmax > 0x7fffffffULL / (64 * sizeof(uint4)))
-		{
-			applog(LOG_ERR, "intensity too high");
-			mining_has_stopped[thr_id] = true;
-			cudaStreamDestroy(gpustream[thr_id]);
-			proper_exit(2);
-		}
+	{ "Titan", 256 * 256 * 22 },
+	{ "970", 256 * 256 * 22 },
+	{ "980", 256 * 256 * 22 },
+	{ "1070", 256 * 256 * 22 },
+	{ "1080", 256 * 256 * 22 },
+	{ "750 Ti", 256 * 256 * 20 },
+	{ NULL, 256 * 256 * 19 }
 #endif
-		quark_groestl512_cpu_init(thr_id, throughputmax);
-		quark_bmw512_cpu_init(thr_id, throughputmax);
-		x11_echo512_cpu_init(thr_id, throughputmax);
-		x11_simd512_cpu_init(thr_id, throughputmax);
-
-		CUDA_SAFE_CALL(cudaMalloc(&d_hash, 16ULL * 4 * throughputmax));
-		CUDA_SAFE_CALL(cudaMallocHost(&h_found, 2 * sizeof(uint32_t)));
-		mining_has_stopped[thr_id] = false;
-		init = true;
-	}
-	uint32_t throughput = min(throughputmax, max_nonce - first_nonce) & 0xfffffc00;
-	uint32_t simdthreads = (device_sm[device_map[thr_id]] > 500) ? 256 : 32;
-
-	uint32_t endiandata[20];
-	for (int k=0; k < 20; k++)
-		be32enc(&endiandata[k], pdata[k]);
+};
+
+static const struct scan_algo x11_scan = {
+	"x11",
+	x11hash,
+	0x4f,
+	0xfffffc00,
+	x11_intensity,
+	x11_gpu_init,
+	x11_gpu_set_block,
+	x11_stages,
+	x11_echo512_final,
+	x11_cpu_hash,
+	NULL
+};
 
-	quark_blake512_cpu_setBlock_80(thr_id, (uint64_t *)endiandata);
-	CUDA_SAFE_CALL(cudaGetLastError());
-	do
-	{
-		quark_blake512_cpu_hash_80(thr_id, throughput, pdata[19], d_hash);
-		quark_bmw512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash);
-		quark_groestl512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash);
-		quark_skein512_cpu_hash_64(thr_id, throughput, pdata[19], NULL, d_hash);
-		cuda_jh512Keccak512_cpu_hash_64(thr_id, throughput, pdata[19], d_hash);
-		x11_luffaCubehash512_cpu_hash_64(thr_id, throughput, pdata[19], d_hash);
-		x11_shavite512_cpu_hash_64(thr_id, throughput, pdata[19], d_hash);
-		x11_simd512_cpu_hash_64(thr_id, throughput, pdata[19], d_hash, simdthreads);
-		x11_echo512_cpu_hash_64_final(thr_id, throughput, pdata[19], d_hash, ptarget[7], h_found);
-		if(stop_mining) {mining_has_stopped[thr_id] = true; cudaStreamDestroy(gpustream[thr_id]); pthread_exit(nullptr);}
-		if(h_found[0] != 0xffffffff)
-		{
-			const uint32_t Htarg = ptarget[7];
-			uint32_t vhash64[8] = {0};
-			if(opt_verify)
-			{
-				be32enc(&endiandata[19], h_found[0]);
-				x11hash(vhash64, endiandata);
-
-			}
-			if(vhash64[7] <= Htarg && fulltest(vhash64, ptarget))
-			{
-				int res = 1;
-				*hashes_done = pdata[19] - first_nonce + throughput;
-				if(h_found[1] != 0xffffffff)
-				{
-					if(opt_verify)
-					{
-						be32enc(&endiandata[19], h_found[1]);
-						x11hash(vhash64, endiandata);
-					} if(vhash64[7] <= Htarg && fulltest(vhash64, ptarget))
-					{
-
-						pdata[21] = h_found[1];
-						res++;
-						if(opt_benchmark)
-							applog(LOG_INFO, "GPU #%d Found second nonce %08x", device_map[thr_id], h_found[1]);
-					}
-					else
-					{
-						if(vhash64[7] != Htarg)
-						{
-							applog(LOG_WARNING, "GPU #%d: result for %08x does not validate on CPU!", device_map[thr_id], h_found[1]);
-						}
-					}
-
-				}
-				pdata[19] = h_found[0];
-				if(opt_benchmark)
-					applog(LOG_INFO, "GPU #%d Found nounce %08x", device_map[thr_id], h_found[0]);
-				return res;
-			}
-			else
-			{
-				if(vhash64[7] != Htarg)
-				{
-					applog(LOG_WARNING, "GPU #%d: result for %08x does not validate on CPU!", device_map[thr_id], h_found[0]);
-				}
-			}
-		}
-		pdata[19] += throughput;
-	} while(!work_restart[thr_id].restart && ((uint64_t)max_nonce > ((uint64_t)(pdata[19]) + (uint64_t)throughput)));
-
-	*hashes_done = pdata[19] - first_nonce ;
-	return 0;
+extern int scanhash_x11(int thr_id, uint32_t *pdata,
+    uint32_t *ptarget, uint32_t max_nonce,
+    uint32_t *hashes_done)
+{
+	return scanhash_generic(thr_id, &x11_scan, pdata, ptarget, max_nonce, hashes_done);
 }
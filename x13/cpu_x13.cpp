@@ -0,0 +1,15 @@
+/**
+ * X13 on the cpu, batched
+ *
+ * The x11 stages then hamsi512 and fugue512, as x13hash().
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void x13_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	x11_cpu_hash(l, endiandata, first_nonce, count);
+
+	cpu_hash.hamsi512(l->hash, l->count);
+	cpu_hash.fugue512(l->hash, l->count);
+}
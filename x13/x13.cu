@@ -20,6 +20,7 @@ extern "C"
 #include "sph/sph_fugue.h"
 }
 #include "miner.h"
+#include "scan.h"
 
 #include "cuda_helper.h"
 
@@ -149,10 +150,25 @@ void x13hash(void *output, const void *input)
 	memcpy(output, hash, 32);
 }
 
+/* scanner of the cpu backend (x13/cpu_x13.cpp), the GPU loop is below */
+static const struct scan_algo x13_scan = {
+	"x13",
+	x13hash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	x13_cpu_hash,
+	NULL
+};
+
 extern int scanhash_x13(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &x13_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *d_hash = nullptr;
 	static THREAD uint32_t *h_found = nullptr;
 
@@ -0,0 +1,34 @@
+/**
+ * Whirlcoin and WhirlpoolX on the cpu, batched
+ *
+ * wcoinhash() is four Whirlpool-T passes, whirlxHash() one Whirlpool
+ * pass of the header folded to 256 bits.
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void whc_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.whirlpool1_80(l->hash, endiandata, l->nonce, l->count);
+	cpu_hash.whirlpool1(l->hash, l->count);
+	cpu_hash.whirlpool1(l->hash, l->count);
+	cpu_hash.whirlpool1(l->hash, l->count);
+}
+
+void whirlpoolx_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	cpu_lanes_set_nonces(l, first_nonce, count);
+
+	cpu_hash.whirlpool_80(l->hash, endiandata, l->nonce, l->count);
+	// out[i] = h[i] ^ h[i + 16] (bytes), in place from the low words
+	for(uint32_t i = 0; i < l->count; i++)
+	{
+		uint64_t *h = &l->hash[i * 8];
+		h[0] ^= h[2];
+		h[1] ^= h[3];
+		h[2] ^= h[4];
+		h[3] ^= h[5];
+	}
+}
@@ -0,0 +1,15 @@
+/**
+ * X15 on the cpu, batched
+ *
+ * The x13 stages then shabal512 and whirlpool, as x15hash().
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void x15_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	x13_cpu_hash(l, endiandata, first_nonce, count);
+
+	cpu_hash.shabal512(l->hash, l->count);
+	cpu_hash.whirlpool(l->hash, l->count);
+}
@@ -6,6 +6,7 @@ extern "C"
 #include "sph/sph_whirlpool.h"
 }
 #include "miner.h"
+#include "scan.h"
 #include "cuda_helper.h"
 
 extern void x15_whirlpool_cpu_init(int thr_id, uint32_t threads, int mode);
@@ -46,10 +47,25 @@ void wcoinhash(void *state, const void *input)
 	memcpy(state, hash, 32);
 }
 
+/* scanner of the cpu backend (x15/cpu_whc.cpp), the GPU loop is below */
+static const struct scan_algo whc_scan = {
+	"whirl",
+	wcoinhash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	whc_cpu_hash,
+	NULL
+};
+
 extern int scanhash_whc(int thr_id, uint32_t *pdata,
     uint32_t *ptarget, uint32_t max_nonce,
     uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &whc_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *d_hash = nullptr;
 
 	const uint32_t first_nonce = pdata[19];
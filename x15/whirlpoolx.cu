@@ -7,6 +7,7 @@ extern "C"
 #include "sph/sph_whirlpool.h"
 }
 #include "miner.h"
+#include "scan.h"
 
 
 #include "cuda_helper.h"
@@ -38,8 +39,23 @@ extern "C" void whirlxHash(void *state, const void *input)
 	memcpy(state, hash_xored, 32);
 }
 
+/* scanner of the cpu backend (x15/cpu_whc.cpp), the GPU loop is below */
+static const struct scan_algo whirlpoolx_scan = {
+	"whirlpoolx",
+	whirlxHash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	whirlpoolx_cpu_hash,
+	NULL
+};
+
 int scanhash_whirlpoolx(int thr_id, uint32_t *pdata, uint32_t *ptarget, uint32_t max_nonce, uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &whirlpoolx_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	const uint32_t first_nonce = pdata[19];
 	uint32_t endiandata[20];
 	uint32_t throughputmax = device_intensity(device_map[thr_id], __func__, (1 << 27));
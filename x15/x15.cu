@@ -24,6 +24,7 @@ extern "C" {
 }
 
 #include "miner.h"
+#include "scan.h"
 
 #include "cuda_helper.h"
 
@@ -159,10 +160,25 @@ void x15hash(void *output, const void *input)
 	memcpy(output, hash, 32);
 }
 
+/* scanner of the cpu backend (x15/cpu_x15.cpp), the GPU loop is below */
+static const struct scan_algo x15_scan = {
+	"x15",
+	x15hash,
+	0x000000ff,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	x15_cpu_hash,
+	NULL
+};
+
 extern int scanhash_x15(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &x15_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	static THREAD uint32_t *d_hash = nullptr;
 
 	const uint32_t first_nonce = pdata[19];
@@ -0,0 +1,15 @@
+/**
+ * X17 on the cpu, batched
+ *
+ * The x15 stages then sha512 and haval256_5, as x17hash().
+ */
+#include "miner.h"
+#include "cpu_batch.h"
+
+void x17_cpu_hash(struct cpu_lanes *l, const uint32_t *endiandata, uint32_t first_nonce, uint32_t count)
+{
+	x15_cpu_hash(l, endiandata, first_nonce, count);
+
+	cpu_hash.sha512(l->hash, l->count);
+	cpu_hash.haval256_5(l->hash, l->count);
+}
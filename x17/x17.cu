@@ -29,6 +29,7 @@ extern "C"
 }
 
 #include "miner.h"
+#include "scan.h"
 #include "cuda_helper.h"
 
 static uint32_t *d_hash[MAX_GPUS];
@@ -181,10 +182,25 @@ void x17hash(void *output, const void *input)
 
 static volatile bool init[MAX_GPUS] = { false };
 
+/* scanner of the cpu backend (x17/cpu_x17.cpp), the GPU loop is below */
+static const struct scan_algo x17_scan = {
+	"x17",
+	x17hash,
+	0x0000003f,
+	0xffffffff,
+	NULL,
+	NULL, NULL, NULL, NULL,
+	x17_cpu_hash,
+	NULL
+};
+
 extern int scanhash_x17(int thr_id, uint32_t *pdata,
 	uint32_t *ptarget, uint32_t max_nonce,
 	uint32_t *hashes_done)
 {
+	if(scan_backend_get(thr_id) != &scan_backend_cuda)
+		return scanhash_generic(thr_id, &x17_scan, pdata, ptarget, max_nonce, hashes_done);
+
 	const uint32_t first_nonce = pdata[19];
 
 	int intensity = 256 * 256 * 9;